@@ -324,6 +324,103 @@ class QueryBench final : public td::Benchmark {
   td::ActorOwn<ServerActor> server_;
 };
 
+class SkewedLoadBench final : public td::Benchmark {
+ public:
+  struct CounterActor;
+
+  struct WorkActor final : public td::Actor {
+    td::ActorId<CounterActor> counter;
+    int left = 0;
+    td::uint64 state = 1;
+
+    void start_up() final {
+      set_migratable(true);
+    }
+
+    void work(int n) {
+      left = n;
+      do_work();
+    }
+
+    void do_work() {
+      for (int i = 0; i < 1000; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+      }
+      if (--left > 0) {
+        send_closure_later(actor_id(this), &WorkActor::do_work);
+      } else {
+        send_closure(counter, &CounterActor::on_done, state);
+      }
+    }
+  };
+
+  struct CounterActor final : public td::Actor {
+    int left = 0;
+    td::uint64 result = 0;
+
+    void on_done(td::uint64 state) {
+      result ^= state;
+      if (--left == 0) {
+        td::Scheduler::instance()->finish();
+      }
+    }
+  };
+
+ private:
+  static constexpr int ACTOR_COUNT = 256;
+  int thread_n_ = -1;
+  bool is_work_stealing_enabled_ = false;
+  td::vector<td::ActorId<WorkActor>> actors_;
+  td::ActorId<CounterActor> counter_;
+  td::unique_ptr<td::ConcurrentScheduler> scheduler_;
+
+ public:
+  SkewedLoadBench(int thread_n, bool is_work_stealing_enabled)
+      : thread_n_(thread_n), is_work_stealing_enabled_(is_work_stealing_enabled) {
+  }
+
+  td::string get_description() const final {
+    return PSTRING() << "SkewedLoad (threads_n = " << thread_n_
+                     << ", work stealing = " << is_work_stealing_enabled_ << ")";
+  }
+
+  void start_up() final {
+    scheduler_ = td::make_unique<td::ConcurrentScheduler>(thread_n_ - 1, 0);
+    if (is_work_stealing_enabled_) {
+      scheduler_->enable_work_stealing();
+    }
+
+    // all actors are created on the main scheduler
+    counter_ = scheduler_->create_actor_unsafe<CounterActor>(0, "CounterActor").release();
+    actors_.clear();
+    for (int i = 0; i < ACTOR_COUNT; i++) {
+      actors_.push_back(scheduler_->create_actor_unsafe<WorkActor>(0, "WorkActor").release());
+      actors_.back().get_actor_unsafe()->counter = counter_;
+    }
+    scheduler_->start();
+  }
+
+  void run(int n) final {
+    {
+      auto guard = scheduler_->get_main_guard();
+      counter_.get_actor_unsafe()->left = ACTOR_COUNT;
+      for (auto &actor : actors_) {
+        send_closure_later(actor, &WorkActor::work, td::max(n / ACTOR_COUNT, 1));
+      }
+    }
+    while (scheduler_->run_main(10)) {
+      // empty
+    }
+  }
+
+  void tear_down() final {
+    scheduler_->finish();
+    scheduler_.reset();
+  }
+};
+
 int main() {
   td::init_openssl_threads();
 
@@ -346,4 +443,8 @@ int main() {
   bench(RingBench<0>(504, 2));
   bench(RingBench<1>(504, 2));
   bench(RingBench<2>(504, 2));
+  for (int thread_n : {1, 2, 4, 8, 16}) {
+    bench(SkewedLoadBench(thread_n, false));
+    bench(SkewedLoadBench(thread_n, true));
+  }
 }
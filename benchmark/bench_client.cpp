@@ -0,0 +1,107 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/Client.h"
+#include "td/telegram/td_api.h"
+
+#include "td/utils/common.h"
+#include "td/utils/logging.h"
+#include "td/utils/misc.h"
+#include "td/utils/Time.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+struct Topology {
+  int instance_count;
+  int thread_count;
+};
+
+static void bench_topology(const Topology &topology, int client_count, int requests_per_client) {
+  if (!td::ClientManager::set_thread_topology(topology.instance_count, topology.thread_count, 0)) {
+    LOG(ERROR) << "Failed to set topology " << topology.instance_count << 'x' << topology.thread_count;
+    return;
+  }
+
+  td::ClientManager client_manager;
+  td::vector<td::ClientManager::ClientId> client_ids;
+  for (int i = 0; i < client_count; i++) {
+    client_ids.push_back(client_manager.create_client_id());
+  }
+
+  td::ClientManager::RequestId total_request_count =
+      static_cast<td::ClientManager::RequestId>(client_count) * requests_per_client;
+  td::vector<double> send_times(static_cast<size_t>(total_request_count) + 1);
+  td::vector<double> latencies;
+  latencies.reserve(static_cast<size_t>(total_request_count));
+
+  auto start_time = td::Time::now();
+  td::ClientManager::RequestId request_id = 0;
+  for (int i = 0; i < requests_per_client; i++) {
+    for (auto client_id : client_ids) {
+      request_id++;
+      send_times[static_cast<size_t>(request_id)] = td::Time::now();
+      client_manager.send(client_id, request_id, td::td_api::make_object<td::td_api::testSquareInt>(i));
+    }
+  }
+  while (static_cast<td::ClientManager::RequestId>(latencies.size()) < total_request_count) {
+    auto response = client_manager.receive(10.0);
+    if (response.object == nullptr) {
+      LOG(ERROR) << "Receive timeout expired";
+      break;
+    }
+    if (response.request_id == 0) {
+      continue;
+    }
+    CHECK(response.object->get_id() == td::td_api::testInt::ID);
+    latencies.push_back(td::Time::now() - send_times[static_cast<size_t>(response.request_id)]);
+  }
+  auto total_time = td::Time::now() - start_time;
+
+  for (auto client_id : client_ids) {
+    client_manager.send(client_id, 0, td::td_api::make_object<td::td_api::close>());
+  }
+  size_t closed_client_count = 0;
+  while (closed_client_count < client_ids.size()) {
+    auto response = client_manager.receive(10.0);
+    if (response.object == nullptr) {
+      break;
+    }
+    if (response.request_id == 0 && response.object->get_id() == td::td_api::updateAuthorizationState::ID &&
+        static_cast<const td::td_api::updateAuthorizationState *>(response.object.get())
+                ->authorization_state_->get_id() == td::td_api::authorizationStateClosed::ID) {
+      closed_client_count++;
+    }
+  }
+
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto get_percentile = [&](size_t percent) {
+    return latencies[td::min(latencies.size() - 1, latencies.size() * percent / 100)] * 1e6;
+  };
+  LOG(PLAIN) << "Topology " << topology.instance_count << 'x' << topology.thread_count << ", " << client_count
+             << " clients: " << static_cast<double>(latencies.size()) / total_time << " requests/s, p50 "
+             << get_percentile(50) << "us, p99 " << get_percentile(99) << "us";
+}
+
+int main(int argc, char **argv) {
+  td::ClientManager::execute(td::td_api::make_object<td::td_api::setLogVerbosityLevel>(1));
+
+  int total_request_count = 100000;
+  if (argc > 1) {
+    total_request_count = td::max(std::atoi(argv[1]), 1);
+  }
+
+  // 0 means the default value
+  td::vector<Topology> topologies{{0, 0}, {1, 4}, {2, 2}, {4, 2}, {4, 4}, {8, 2}, {16, 1}};
+  for (auto &topology : topologies) {
+    for (int client_count : {1, 10, 100, 1000}) {
+      bench_topology(topology, client_count, td::max(total_request_count / client_count, 1));
+    }
+  }
+}
@@ -8,10 +8,12 @@
 
 #include "td/utils/common.h"
 #include "td/utils/crypto.h"
+#include "td/utils/logging.h"
 #include "td/utils/port/thread.h"
 #include "td/utils/Random.h"
 #include "td/utils/Slice.h"
 #include "td/utils/SliceBuilder.h"
+#include "td/utils/StringBuilder.h"
 #include "td/utils/UInt.h"
 
 #include <openssl/evp.h>
@@ -373,6 +375,54 @@ class AesIgeShortBench final : public td::Benchmark {
   }
 };
 
+template <bool is_encrypt>
+class AesIgePacketBench final : public td::Benchmark {
+ public:
+  explicit AesIgePacketBench(std::size_t packet_size) : data(packet_size, '\0') {
+  }
+
+  std::string get_description() const final {
+    return PSTRING() << "AES IGE " << (is_encrypt ? "encrypt" : "decrypt") << " packet [" << (data.size() >> 10)
+                     << "KB]";
+  }
+
+  void start_up() final {
+    std::fill(data.begin(), data.end(), '\x7b');
+    td::Random::secure_bytes(as_mutable_slice(key));
+    td::Random::secure_bytes(as_mutable_slice(iv));
+  }
+
+  void run(int n) final {
+    td::MutableSlice data_slice(data);
+    for (int i = 0; i < n; i++) {
+      // every MTProto packet has its own key and IV, so the whole state is initialized for each packet
+      if (is_encrypt) {
+        td::aes_ige_encrypt(as_slice(key), as_mutable_slice(iv), data_slice, data_slice);
+      } else {
+        td::aes_ige_decrypt(as_slice(key), as_mutable_slice(iv), data_slice, data_slice);
+      }
+    }
+  }
+
+ private:
+  std::string data;
+  td::UInt256 key;
+  td::UInt256 iv;
+};
+
+template <bool is_encrypt>
+static void bench_aes_ige_packets(std::size_t packet_size) {
+  AesIgePacketBench<is_encrypt> bench(packet_size);
+  td::bench_n(bench, 16);
+
+  // the benchmark is single-threaded, so this is the throughput per core
+  int n = static_cast<int>(std::max(static_cast<std::size_t>(1), (static_cast<std::size_t>(256) << 20) / packet_size));
+  double time = td::bench_n(bench, n).first;
+  LOG(ERROR) << bench.get_description() << ": "
+             << td::StringBuilder::FixedDouble(static_cast<double>(packet_size) * n / time / (1 << 20), 1)
+             << " MB/s per core";
+}
+
 BENCH(Rand, "std_rand") {
   int res = 0;
   for (int i = 0; i < n; i++) {
@@ -501,6 +551,10 @@ int main() {
   td::bench(AesIgeShortBench<false>());
   td::bench(AesIgeEncryptBench());
   td::bench(AesIgeDecryptBench());
+  for (auto packet_size : {1 << 10, 16 << 10, 512 << 10}) {
+    bench_aes_ige_packets<true>(packet_size);
+    bench_aes_ige_packets<false>(packet_size);
+  }
   td::bench(AesEcbBench());
 
   td::bench(Pbkdf2Bench());
@@ -0,0 +1,265 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/td_api.h"
+#include "td/telegram/td_api_json.h"
+
+#include "td/utils/common.h"
+#include "td/utils/JsonBuilder.h"
+#include "td/utils/logging.h"
+#include "td/utils/Parser.h"
+#include "td/utils/Slice.h"
+#include "td/utils/SliceBuilder.h"
+#include "td/utils/StackAllocator.h"
+#include "td/utils/StringBuilder.h"
+#include "td/utils/Time.h"
+
+#include <cstring>
+
+static td::td_api::object_ptr<td::td_api::file> get_file_object(td::int32 id) {
+  return td::td_api::make_object<td::td_api::file>(
+      id, 123456, 123456,
+      td::td_api::make_object<td::td_api::localFile>(
+          "/android/data/0/data/org.telegram.data/files/photos/12345678901234567890_123.jpg", true, true, false, true,
+          0, 123456, 123456),
+      td::td_api::make_object<td::td_api::remoteFile>("abacabadabacabaeabacabadabacabafabacabadabacabaeabacabadabacaba",
+                                                      "abacabadabacabaeabacabadabacaba", false, true, 123456));
+}
+
+static td::td_api::object_ptr<td::td_api::message> get_message_object(td::int64 message_id, bool with_photo) {
+  auto message = td::td_api::make_object<td::td_api::message>();
+  message->id_ = message_id;
+  message->sender_id_ = td::td_api::make_object<td::td_api::messageSenderUser>(123456000112);
+  message->chat_id_ = 123456000112;
+  message->date_ = 1699999999;
+  message->can_be_edited_ = true;
+  message->can_be_forwarded_ = true;
+  if (with_photo) {
+    auto photo = td::td_api::make_object<td::td_api::photo>();
+    for (td::int32 i = 0; i < 4; i++) {
+      photo->sizes_.push_back(td::td_api::make_object<td::td_api::photoSize>(
+          "x", get_file_object(i + 1), 160 * (i + 1), 120 * (i + 1),
+          td::vector<td::int32>{10000, 20000, 30000, 50000, 70000, 90000, 120000, 150000, 180000, 220000}));
+    }
+    message->content_ = td::td_api::make_object<td::td_api::messagePhoto>(
+        std::move(photo), td::td_api::make_object<td::td_api::formattedText>("Photo \"caption\"", td::Auto()), false,
+        false);
+  } else {
+    td::vector<td::td_api::object_ptr<td::td_api::textEntity>> entities;
+    entities.push_back(td::td_api::make_object<td::td_api::textEntity>(
+        0, 5, td::td_api::make_object<td::td_api::textEntityTypeBold>()));
+    entities.push_back(td::td_api::make_object<td::td_api::textEntity>(
+        6, 20, td::td_api::make_object<td::td_api::textEntityTypeUrl>()));
+    message->content_ = td::td_api::make_object<td::td_api::messageText>(
+        td::td_api::make_object<td::td_api::formattedText>(
+            "Hello https://telegram.org\nThis is a \"typical\" text message with some\tescaped characters",
+            std::move(entities)),
+        nullptr, nullptr);
+  }
+  return message;
+}
+
+// a mix of the most frequent updates received by bots and user accounts
+static td::vector<td::td_api::object_ptr<td::td_api::Object>> get_update_corpus() {
+  td::vector<td::td_api::object_ptr<td::td_api::Object>> result;
+  for (int i = 0; i < 10; i++) {
+    result.push_back(td::td_api::make_object<td::td_api::updateNewMessage>(get_message_object(1000 + i, i % 5 == 0)));
+    result.push_back(td::td_api::make_object<td::td_api::updateChatLastMessage>(
+        123456000112, get_message_object(1000 + i, false), td::Auto()));
+    result.push_back(td::td_api::make_object<td::td_api::updateChatReadInbox>(123456000112, 1000 + i, i));
+    result.push_back(td::td_api::make_object<td::td_api::updateUserStatus>(
+        123456000112 + i, td::td_api::make_object<td::td_api::userStatusOnline>(1700000000 + i)));
+    result.push_back(td::td_api::make_object<td::td_api::updateChatAction>(
+        123456000112, 0, td::td_api::make_object<td::td_api::messageSenderUser>(123456000112 + i),
+        td::td_api::make_object<td::td_api::chatActionTyping>()));
+    result.push_back(td::td_api::make_object<td::td_api::updateFile>(get_file_object(i + 1)));
+  }
+  return result;
+}
+
+static td::string *output;
+
+// the baseline implementation: a temporary buffer on the stack, which is copied to a new string
+static const char *encode_with_copy(const td::td_api::Object &object) {
+  auto buf = td::StackAllocator::alloc(1 << 18);
+  td::JsonBuilder jb(td::StringBuilder(buf.as_slice(), true), -1);
+  jb.enter_value() << ToJson(object);
+  *output = jb.string_builder().as_cslice().str();
+  return output->c_str();
+}
+
+// the same way as in ClientJson: JSON is written directly to a reusable buffer
+static const char *encode_to_reusable_buffer(const td::td_api::Object &object) {
+  if (output->size() < (1 << 14) || output->size() > (1 << 18)) {
+    td::string(1 << 14, '\0').swap(*output);
+  }
+  td::JsonBuilder jb(td::StringBuilder(td::MutableSlice(&(*output)[0], output->size()), true), -1);
+  jb.enter_value() << ToJson(object);
+  auto result = jb.string_builder().as_cslice();
+  if (result.begin() != output->data()) {
+    td::string new_output(result.size() * 2, '\0');
+    std::memcpy(&new_output[0], result.begin(), result.size() + 1);
+    *output = std::move(new_output);
+  }
+  return output->c_str();
+}
+
+template <class F>
+static void bench_encode(td::Slice name, const td::vector<td::td_api::object_ptr<td::td_api::Object>> &corpus,
+                         F &&encode) {
+  size_t total_size = 0;
+  size_t iteration_count = 0;
+  auto start_time = td::Time::now();
+  double passed_time = 0.0;
+  do {
+    for (auto &object : corpus) {
+      total_size += std::strlen(encode(*object));
+    }
+    iteration_count++;
+    passed_time = td::Time::now() - start_time;
+  } while (passed_time < 1.0);
+  LOG(PLAIN) << name << ": " << static_cast<double>(total_size) / passed_time / (1 << 20) << " MB/s, "
+             << static_cast<double>(iteration_count * corpus.size()) / passed_time << " objects/s";
+}
+
+
+// the generated to_json functions were changed to write field names as pre-quoted raw JSON instead of escaping them;
+// both ways can't be compiled together for td_api objects, so they are compared on objects with typical field names
+template <bool is_raw>
+static void bench_field_names() {
+  td::vector<td::Slice> names{"@type", "id", "sender_id", "chat_id", "date", "content", "text", "offset", "type"};
+  td::vector<td::string> quoted_names;
+  for (auto name : names) {
+    quoted_names.push_back(PSTRING() << '"' << name << '"');
+  }
+  auto buf = td::StackAllocator::alloc(1 << 14);
+  size_t total_size = 0;
+  size_t object_count = 0;
+  auto start_time = td::Time::now();
+  double passed_time = 0.0;
+  do {
+    for (int i = 0; i < 1000; i++) {
+      td::JsonBuilder jb(td::StringBuilder(buf.as_slice(), true), -1);
+      {
+        auto jv = jb.enter_value();
+        auto jo = jv.enter_object();
+        for (size_t j = 0; j < quoted_names.size(); j++) {
+          if (is_raw) {
+            jo(td::JsonRaw(quoted_names[j]), i);
+          } else {
+            jo(names[j], i);
+          }
+        }
+      }
+      total_size += jb.string_builder().as_cslice().size();
+    }
+    object_count += 1000;
+    passed_time = td::Time::now() - start_time;
+  } while (passed_time < 1.0);
+  LOG(PLAIN) << (is_raw ? "Raw field names" : "Escaped field names") << ": "
+             << static_cast<double>(total_size) / passed_time / (1 << 20) << " MB/s, "
+             << static_cast<double>(object_count) / passed_time << " objects/s";
+}
+
+// the most frequent requests sent by bots
+static td::vector<td::string> get_request_corpus() {
+  td::vector<td::string> result;
+  for (int i = 0; i < 10; i++) {
+    result.push_back(PSTRING() << "{\"@type\":\"sendMessage\",\"chat_id\":" << 123456000112 + i
+                               << ",\"input_message_content\":{\"@type\":\"inputMessageText\",\"text\":{"
+                               << "\"@type\":\"formattedText\",\"text\":\"Hello, \\\"user\\\" " << i
+                               << "\\nThis is a typical text message\",\"entities\":[{\"@type\":\"textEntity\","
+                               << "\"offset\":0,\"length\":5,\"type\":{\"@type\":\"textEntityTypeBold\"}}]}},"
+                               << "\"@extra\":" << i << "}");
+    result.push_back(PSTRING() << "{\"@type\":\"getMessages\",\"chat_id\":123456000112,\"message_ids\":[" << i
+                               << ",1048576,2097152,3145728],\"@extra\":\"request_" << i << "\"}");
+    result.push_back(PSTRING() << "{\"@type\":\"getChatMember\",\"chat_id\":-1001234567890,\"member_id\":{"
+                               << "\"@type\":\"messageSenderUser\",\"user_id\":" << 123456000112 + i << "}}");
+    result.push_back(PSTRING() << "{\"@type\":\"answerCallbackQuery\",\"callback_query_id\":\"" << 12345678901234 + i
+                               << "\",\"text\":\"Done\",\"show_alert\":false,\"url\":\"\",\"cache_time\":0}");
+  }
+  return result;
+}
+
+template <class F>
+static void bench_decode(td::Slice name, const td::vector<td::string> &corpus, F &&decode) {
+  size_t total_size = 0;
+  size_t iteration_count = 0;
+  auto start_time = td::Time::now();
+  double passed_time = 0.0;
+  td::string buf;
+  do {
+    for (auto &request : corpus) {
+      buf = request;
+      auto function = decode(buf);
+      CHECK(function != nullptr);
+      total_size += request.size();
+    }
+    iteration_count++;
+    passed_time = td::Time::now() - start_time;
+  } while (passed_time < 1.0);
+  LOG(PLAIN) << name << ": " << static_cast<double>(total_size) / passed_time / (1 << 20) << " MB/s, "
+             << static_cast<double>(iteration_count * corpus.size()) / passed_time << " requests/s";
+}
+
+static td::td_api::object_ptr<td::td_api::Function> decode_with_tree(td::MutableSlice request, td::string &extra) {
+  auto json_value = td::json_decode(request).move_as_ok();
+  if (json_value.get_object().has_field("@extra")) {
+    extra = td::json_encode<td::string>(json_value.get_object().extract_field("@extra"));
+  }
+  td::td_api::object_ptr<td::td_api::Function> function;
+  td::td_api::from_json(function, std::move(json_value)).ensure();
+  return function;
+}
+
+static td::td_api::object_ptr<td::td_api::Function> decode_directly(td::MutableSlice request, td::string &extra) {
+  td::Parser parser(request);
+  td::td_api::object_ptr<td::td_api::Function> function;
+  td::td_api::from_json(function, parser, extra).ensure();
+  return function;
+}
+
+int main() {
+  SET_VERBOSITY_LEVEL(VERBOSITY_NAME(INFO));
+
+  td::string output_storage;
+  output = &output_storage;
+
+  auto corpus = get_update_corpus();
+  for (int i = 0; i < 3; i++) {
+    bench_encode("JSON to new string", corpus, encode_with_copy);
+    bench_encode("JSON to reusable buffer", corpus, encode_to_reusable_buffer);
+  }
+  for (int i = 0; i < 3; i++) {
+    bench_field_names<false>();
+    bench_field_names<true>();
+  }
+
+  auto requests = get_request_corpus();
+  auto checked_requests = requests;
+  // only the first occurrence of a field must be used
+  checked_requests.push_back(
+      "{\"@type\":\"getMessage\",\"chat_id\":1,\"@extra\":\"first\",\"message_id\":2,\"@type\":\"getChat\","
+      "\"chat_id\":3,\"message_id\":4,\"@extra\":\"second\"}");
+  checked_requests.push_back(
+      "{\"chat_id\":1,\"message_id\":2,\"@extra\":3,\"@type\":\"getMessage\",\"chat_id\":4,\"@type\":\"getChat\"}");
+  for (auto &request : checked_requests) {
+    auto tree_request = request;
+    auto direct_request = request;
+    td::string tree_extra;
+    td::string direct_extra;
+    CHECK(to_string(decode_with_tree(tree_request, tree_extra)) ==
+          to_string(decode_directly(direct_request, direct_extra)));
+    CHECK(tree_extra == direct_extra);
+  }
+  td::string extra;
+  for (int i = 0; i < 3; i++) {
+    bench_decode("JSON through JsonValue tree", requests,
+                 [&](td::MutableSlice request) { return decode_with_tree(request, extra); });
+    bench_decode("JSON directly to td_api", requests,
+                 [&](td::MutableSlice request) { return decode_directly(request, extra); });
+  }
+}
@@ -0,0 +1,88 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/mtproto/AuthKey.h"
+#include "td/mtproto/KDF.h"
+#include "td/mtproto/Transport.h"
+
+#include "td/utils/as.h"
+#include "td/utils/benchmark.h"
+#include "td/utils/common.h"
+#include "td/utils/crypto.h"
+#include "td/utils/logging.h"
+#include "td/utils/Random.h"
+#include "td/utils/Slice.h"
+#include "td/utils/SliceBuilder.h"
+#include "td/utils/StringBuilder.h"
+#include "td/utils/UInt.h"
+
+#include <algorithm>
+
+// key derivation, which is done for every MTProto 2.0 packet: msg_key calculation and KDF2
+template <bool use_cached_state>
+class PacketKeyBench final : public td::Benchmark {
+ public:
+  explicit PacketKeyBench(size_t packet_size) : data_(packet_size, 'a') {
+  }
+
+  td::string get_description() const final {
+    return PSTRING() << "Packet keys " << (use_cached_state ? "cached" : "uncached") << " [" << data_.size() << "B]";
+  }
+
+  void start_up() final {
+    td::string key(256, '\0');
+    td::Random::secure_bytes(key);
+    auth_key_ = td::mtproto::AuthKey(0, std::move(key));
+  }
+
+  void run(int n) final {
+    td::UInt256 aes_key;
+    td::UInt256 aes_iv;
+    for (int i = 0; i < n; i++) {
+      int X = (i & 1) * 8;
+      if (use_cached_state) {
+        auto message_key = td::mtproto::Transport::calc_message_key2(auth_key_, X, data_).second;
+        td::mtproto::KDF2(auth_key_, message_key, X, &aes_key, &aes_iv);
+      } else {
+        // the way the keys were calculated before the auth key started to cache SHA-256 states
+        td::Sha256State state;
+        state.init();
+        state.feed(td::Slice(auth_key_.key()).substr(88 + X, 32));
+        state.feed(data_);
+        td::UInt256 message_key_large;
+        state.extract(as_mutable_slice(message_key_large), true);
+        auto message_key = td::as<td::UInt128>(message_key_large.raw + 8);
+        td::mtproto::KDF2(auth_key_.key(), message_key, X, &aes_key, &aes_iv);
+      }
+      data_[0] = static_cast<char>(aes_key.raw[0]);
+    }
+  }
+
+ private:
+  td::string data_;
+  td::mtproto::AuthKey auth_key_;
+};
+
+template <bool use_cached_state>
+static double bench_packet_keys(size_t packet_size) {
+  PacketKeyBench<use_cached_state> bench(packet_size);
+  td::bench(bench);
+
+  int n = static_cast<int>(std::max(static_cast<size_t>(100000), (static_cast<size_t>(256) << 20) / packet_size));
+  return td::bench_n(bench, n).first / n;
+}
+
+int main() {
+  SET_VERBOSITY_LEVEL(VERBOSITY_NAME(ERROR));
+  for (size_t packet_size : {64, 1024, 16384}) {
+    auto uncached_time = bench_packet_keys<false>(packet_size);
+    auto cached_time = bench_packet_keys<true>(packet_size);
+    LOG(ERROR) << "Packet of size " << packet_size << ": "
+               << td::StringBuilder::FixedDouble((uncached_time - cached_time) * 1e9, 1) << "ns of CPU time saved ("
+               << td::StringBuilder::FixedDouble(uncached_time * 1e9, 1) << "ns -> "
+               << td::StringBuilder::FixedDouble(cached_time * 1e9, 1) << "ns)";
+  }
+}
@@ -11,6 +11,7 @@
 #include "td/utils/algorithm.h"
 #include "td/utils/benchmark.h"
 #include "td/utils/common.h"
+#include "td/utils/JsonBuilder.h"
 #include "td/utils/logging.h"
 #include "td/utils/port/Clocks.h"
 #include "td/utils/port/EventFd.h"
@@ -126,6 +127,71 @@ BENCH(TlToStringMessage, "TL to_string message") {
   td::do_not_optimize_away(res);
 }
 
+static td::string get_send_message_json(bool pretty) {
+  td::string text;
+  for (int i = 0; i < 200; i++) {
+    text += "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore. ";
+    if (i % 10 == 0) {
+      text += "\\\"quoted\\\"\\n\\u0442\\u0435\\u043a\\u0441\\u0442\\n";
+    }
+  }
+  td::string entities;
+  for (int i = 0; i < 100; i++) {
+    if (i != 0) {
+      entities += ',';
+    }
+    entities += PSTRING() << "{\"@type\":\"textEntity\",\"offset\":" << i * 100
+                          << ",\"length\":10,\"type\":{\"@type\":\"textEntityTypeBold\"}}";
+  }
+  td::string result = PSTRING() << "{\"@type\":\"sendMessage\",\"chat_id\":123456000112,\"input_message_content\":{"
+                                << "\"@type\":\"inputMessageText\",\"text\":{\"@type\":\"formattedText\",\"text\":\""
+                                << text << "\",\"entities\":[" << entities << "]}},\"@extra\":\"request_1\"}";
+  if (!pretty) {
+    return result;
+  }
+  return td::json_encode<td::string>(td::json_decode(td::MutableSlice(result)).move_as_ok(), true);
+}
+
+static td::string get_set_tdlib_parameters_json(bool pretty) {
+  td::string result = PSTRING()
+                      << "{\"@type\":\"setTdlibParameters\",\"use_test_dc\":false,\"database_directory\":\""
+                      << td::string(1000, 'd') << "\",\"files_directory\":\"" << td::string(1000, 'f')
+                      << "\",\"database_encryption_key\":\"" << td::string(1000, 'k')
+                      << "\",\"use_file_database\":true,\"use_chat_info_database\":true,"
+                      << "\"use_message_database\":true,\"use_secret_chats\":false,\"api_id\":94575,"
+                      << "\"api_hash\":\"a3406de8d171bb422bb6ddf3bbd800e2\",\"system_language_code\":\"en\","
+                      << "\"device_model\":\"Desktop\",\"system_version\":\"Unknown\",\"application_version\":\"1.0\"}";
+  if (!pretty) {
+    return result;
+  }
+  return td::json_encode<td::string>(td::json_decode(td::MutableSlice(result)).move_as_ok(), true);
+}
+
+class JsonDecodeBench final : public td::Benchmark {
+  td::string name_;
+  td::string json_;
+  td::string buf_;
+
+ public:
+  JsonDecodeBench(td::string name, td::string json) : name_(std::move(name)), json_(std::move(json)) {
+  }
+
+  td::string get_description() const final {
+    return PSTRING() << "json_decode " << name_ << " of size " << json_.size();
+  }
+
+  void run(int n) final {
+    std::size_t res = 0;
+    for (int i = 0; i < n; i++) {
+      buf_ = json_;
+      auto r_value = td::json_decode(buf_);
+      CHECK(r_value.is_ok());
+      res += r_value.ok().get_object().field_count();
+    }
+    td::do_not_optimize_away(res);
+  }
+};
+
 #if !TD_EVENTFD_UNSUPPORTED
 BENCH(EventFd, "EventFd") {
   td::EventFd fd;
@@ -767,6 +833,11 @@ int main() {
   td::bench(TlToStringUpdateFileBench());
   td::bench(TlToStringMessageBench());
 
+  td::bench(JsonDecodeBench("sendMessage", get_send_message_json(false)));
+  td::bench(JsonDecodeBench("pretty sendMessage", get_send_message_json(true)));
+  td::bench(JsonDecodeBench("setTdlibParameters", get_set_tdlib_parameters_json(false)));
+  td::bench(JsonDecodeBench("pretty setTdlibParameters", get_set_tdlib_parameters_json(true)));
+
   td::bench(DuplicateCheckerBenchEvenOdd<IdDuplicateCheckerNew<1000>>());
   td::bench(DuplicateCheckerBenchEvenOdd<IdDuplicateCheckerNew<300>>());
   td::bench(DuplicateCheckerBenchEvenOdd<IdDuplicateCheckerArray<1000>>());
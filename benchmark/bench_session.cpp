@@ -0,0 +1,1051 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/mtproto/AuthData.h"
+#include "td/mtproto/AuthKey.h"
+#include "td/mtproto/DhCallback.h"
+#include "td/mtproto/DhHandshake.h"
+#include "td/mtproto/Handshake.h"
+#include "td/mtproto/HandshakeActor.h"
+#include "td/mtproto/KDF.h"
+#include "td/mtproto/MessageId.h"
+#include "td/mtproto/mtproto_api.h"
+#include "td/mtproto/RawConnection.h"
+#include "td/mtproto/RSA.h"
+#include "td/mtproto/SessionConnection.h"
+#include "td/mtproto/TcpTransport.h"
+#include "td/mtproto/Transport.h"
+#include "td/mtproto/TransportType.h"
+#include "td/mtproto/utils.h"
+
+#include "td/net/HttpHeaderCreator.h"
+#include "td/net/HttpQuery.h"
+#include "td/net/HttpReader.h"
+#include "td/net/TcpListener.h"
+
+#include "td/actor/actor.h"
+#include "td/actor/ConcurrentScheduler.h"
+
+#include "td/utils/AesCtrByteFlow.h"
+#include "td/utils/algorithm.h"
+#include "td/utils/as.h"
+#include "td/utils/base64.h"
+#include "td/utils/BigNum.h"
+#include "td/utils/buffer.h"
+#include "td/utils/BufferedFd.h"
+#include "td/utils/ByteFlow.h"
+#include "td/utils/common.h"
+#include "td/utils/crypto.h"
+#include "td/utils/FlatHashMap.h"
+#include "td/utils/logging.h"
+#include "td/utils/misc.h"
+#include "td/utils/port/Clocks.h"
+#include "td/utils/port/IPAddress.h"
+#include "td/utils/port/ServerSocketFd.h"
+#include "td/utils/port/SocketFd.h"
+#include "td/utils/Promise.h"
+#include "td/utils/Random.h"
+#include "td/utils/Slice.h"
+#include "td/utils/SliceBuilder.h"
+#include "td/utils/Status.h"
+#include "td/utils/Time.h"
+#include "td/utils/tl_parsers.h"
+#include "td/utils/tl_storers.h"
+#include "td/utils/UInt.h"
+#include "td/utils/VectorQueue.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+
+// The benchmark runs SessionConnection against a loopback MTProto server emulator, which creates an auth key,
+// acknowledges queries, answers them after a configurable delay with answers of a configurable size and pushes updates.
+// The emulator has its own RSA key, so it can't be used as a replacement for real servers.
+
+static const char bench_rsa_public_key[] =
+    "-----BEGIN RSA PUBLIC KEY-----\n"
+    "MIIBCgKCAQEAz9WnGF8zuXcW8EVADPxzxVQ7RcI3e92rmVtlIpTmRRhehYJtV77L\n"
+    "2UqBcCHxYh22Ql0DoKr8HnF+tg4cKiQ1Jfc9o01cDFKijl1dW5KnsxPvCGJOOHRp\n"
+    "nDcbWmuVkFIrEhtv6X5zFUQuPMTRS4/5sG9OCDzM+73+wB2/HqqnczICbdk490bw\n"
+    "sCQOvxiKpaw8XRU3E1r6guKMJo61l2GVgnE4joJk07N/OVOREoYPO3t/jm83h2OF\n"
+    "DEUOwzcYxvv4wU+eQbALMg2Hdxhb9ydeABEJ9qJ8n/D8QhOM+D/uxdzy0cxs/pW8\n"
+    "FL3DkMxZegBe2vmELqZVA3grW6oUC27idQIDAQAB\n"
+    "-----END RSA PUBLIC KEY-----";
+static const char bench_rsa_modulus_hex[] =
+    "CFD5A7185F33B97716F045400CFC73C5543B45C2377BDDAB995B652294E645185E85826D57BECBD94A817021F1621DB6425D03A0AAFC1E71"
+    "7EB60E1C2A243525F73DA34D5C0C52A28E5D5D5B92A7B313EF08624E3874699C371B5A6B9590522B121B6FE97E7315442E3CC4D14B8FF9B0"
+    "6F4E083CCCFBBDFEC01DBF1EAAA77332026DD938F746F0B0240EBF188AA5AC3C5D1537135AFA82E28C268EB59761958271388E8264D3B37F"
+    "39539112860F3B7B7F8E6F378763850C450EC33718C6FBF8C14F9E41B00B320D8777185BF7275E001109F6A27C9FF0FC42138CF83FEEC5DC"
+    "F2D1CC6CFE95BC14BDC390CC597A005EDAF9842EA65503782B5BAA140B6EE275";
+static const char bench_rsa_private_exponent_hex[] =
+    "0424abbc9a254354c2f1ce479d1aa94a2d4833375078d92df31435db6f217a0e26d03d8de57a69c0eeb1cee4f65570e731c27df085881a29"
+    "440fe80f1aadf71b472704eae5635f805b1b3461bf76356537d6307383bf9a5d6161dbb71a57b2b3a61c42ea6239741a945b64c7115d10ea"
+    "ba0551b7b8946a30ba6ebd6124a0caf4928de7748e85c41d2b0860e907d5edd5d0b31a7986293370168655043e27d6d4f5cd39d84fe5b7c6"
+    "63ba5c48a074d9b1924d67a065e67b99a17d1d3d47022e5efbf8920b08969c665276ac623c475e2596d89c99af7f6b3da692be76982d67dd"
+    "c8541180119c97920fe431e17a631dee0b814115719ad5d58ff4047a0b4c2baf";
+
+static const td::int32 dh_g = 3;
+static const char dh_prime_base64[] =
+    "xxyuucaxyQSObFIvcPE_c5gNQCOOPiHBSTTQN1Y9kw9IGYoKp8FAWCKUk9IlMPTb-jNvbgrJJROVQ67UTM58NyD9UfaUWHBaxozU_mtrE6vcl0ZRKW"
+    "kyhFTxj6-MWV9kJHf-lrsqlB1bzR1KyMxJiAcI-ps3jjxPOpBgvuZ8-aSkppWBEFGQfhYnU7VrD2tBDbp02KhLKhSzFE4O8ShHVP0X7ZUNWWW0ud1G"
+    "WC2xF40WnGvEZbDW_5yjko_vW5rk5Bj8Feg-vqD4f6n_Xu1wBQ3tKEn0e_lZ2VaFDOkphR8NgRX2NbEF7i5OFdBLJFS_b0-t8DSxBAMRnNjjuS_MW"
+    "w";
+
+// pq = 1229739323 * 1402015859
+static const td::uint64 bench_pq = 0x17ED48941A08F981;
+
+// constructors, which aren't used by MTProto
+static const td::int32 bench_query_id = 0x0badf00d;
+static const td::int32 bench_answer_id = 0x0badcafe;
+static const td::int32 bench_update_id = 0x0badbeef;
+
+static const td::int32 rpc_result_id = static_cast<td::int32>(0xf35c6d01);
+static const td::int32 msg_container_id = 0x73f1f8dc;
+
+static const size_t update_size = 64;
+
+struct SessionBenchOptions {
+  td::mtproto::TransportType::Type transport_type;
+  int query_count;
+  int max_in_flight_query_count;
+  size_t query_size;
+  size_t answer_size;
+  double answer_delay;
+  int answers_per_update;  // 0 means that no updates are sent
+};
+
+static td::Slice get_transport_name(td::mtproto::TransportType::Type transport_type) {
+  switch (transport_type) {
+    case td::mtproto::TransportType::Tcp:
+      return td::Slice("TCP");
+    case td::mtproto::TransportType::ObfuscatedTcp:
+      return td::Slice("obfuscated TCP");
+    case td::mtproto::TransportType::Http:
+      return td::Slice("HTTP");
+    default:
+      UNREACHABLE();
+      return td::Slice();
+  }
+}
+
+static td::mtproto::RSA get_bench_rsa_key() {
+  return td::mtproto::RSA::from_pem_public_key(bench_rsa_public_key).move_as_ok();
+}
+
+template <class T>
+static td::string store_object(const T &object) {
+  auto storer = td::TLObjectStorer<T>(object);
+  td::string result(storer.size(), '\0');
+  auto real_size = storer.store(td::MutableSlice(result).ubegin());
+  CHECK(real_size == result.size());
+  return result;
+}
+
+// server side of a single connection
+class EmulatedServerConnection final : public td::Actor {
+ public:
+  EmulatedServerConnection(td::SocketFd socket_fd, const SessionBenchOptions &options)
+      : fd_(std::move(socket_fd)), options_(options) {
+  }
+
+ private:
+  enum class Transport : td::int32 { Unknown, Tcp, ObfuscatedTcp, Http };
+
+  struct PendingAnswer {
+    double answer_at;
+    td::uint64 query_message_id;
+  };
+
+  struct OutboundMessage {
+    td::uint64 message_id;
+    td::int32 seq_no;
+    td::string data;
+  };
+
+  td::BufferedFd<td::SocketFd> fd_;
+  const SessionBenchOptions &options_;
+
+  Transport transport_ = Transport::Unknown;
+  td::mtproto::tcp::IntermediateTransport intermediate_transport_{false};
+  td::ChainBufferReader *input_ = nullptr;
+  td::AesCtrByteFlow input_aes_ctr_byte_flow_;
+  td::ByteFlowSink input_byte_flow_sink_;
+  td::AesCtrState output_aes_ctr_state_;
+  td::HttpReader http_reader_;
+  td::HttpQuery http_query_;
+  bool has_http_query_ = false;
+
+  td::UInt128 nonce_;
+  td::UInt128 server_nonce_;
+  td::UInt256 new_nonce_;
+  td::mtproto::DhHandshake dh_handshake_;
+  td::mtproto::AuthKey auth_key_;
+  td::uint64 server_salt_ = 0;
+
+  td::uint64 session_id_ = 0;
+  td::uint64 last_message_id_ = 0;
+  td::int32 seq_no_ = 0;
+  td::vector<td::int64> to_ack_;
+  td::vector<OutboundMessage> to_send_;
+  td::VectorQueue<PendingAnswer> pending_answers_;
+  td::uint64 answer_count_ = 0;
+
+  void start_up() final {
+    td::Scheduler::subscribe(fd_.get_poll_info().extract_pollable_fd(this));
+  }
+
+  void tear_down() final {
+    td::Scheduler::unsubscribe_before_close(fd_.get_poll_info().get_pollable_fd_ref());
+    fd_.close();
+  }
+
+  void loop() final {
+    auto status = do_loop();
+    if (status.is_error()) {
+      LOG(INFO) << "Close emulated connection: " << status;
+      stop();
+    }
+  }
+
+  td::Status do_loop() {
+    sync_with_poll(fd_);
+    TRY_STATUS(fd_.flush_read());
+    TRY_STATUS(read_packets());
+    flush_answers();
+    TRY_STATUS(fd_.flush_write());
+    if (can_close_local(fd_)) {
+      return td::Status::Error("Connection closed");
+    }
+    if (pending_answers_.empty()) {
+      cancel_timeout();
+    } else {
+      set_timeout_at(pending_answers_.front().answer_at);
+    }
+    return td::Status::OK();
+  }
+
+  td::Status init_transport() {
+    auto &input = fd_.input_buffer();
+    if (input.size() < 4) {
+      return td::Status::OK();
+    }
+    td::uint32 first_int = 0;
+    input.clone().advance(4, td::MutableSlice(reinterpret_cast<char *>(&first_int), sizeof(first_int)));
+    if (first_int == 0xeeeeeeee || first_int == 0xdddddddd) {
+      input.advance(4);
+      input_ = &input;
+      transport_ = Transport::Tcp;
+      return td::Status::OK();
+    }
+    if (first_int == 0x54534f50) {  // "POST"
+      http_reader_.init(&input);
+      transport_ = Transport::Http;
+      return td::Status::OK();
+    }
+
+    const size_t header_size = 64;
+    if (input.size() < header_size) {
+      return td::Status::OK();
+    }
+    td::string header(header_size, '\0');
+    input.clone().advance(header_size, header);
+    td::string rheader = header;
+    std::reverse(rheader.begin(), rheader.end());
+    input_aes_ctr_byte_flow_.init(td::as<td::UInt256>(header.data() + 8), td::as<td::UInt128>(header.data() + 40));
+    input_aes_ctr_byte_flow_.set_input(&input);
+    input_aes_ctr_byte_flow_ >> input_byte_flow_sink_;
+    output_aes_ctr_state_.init(td::Slice(rheader).substr(8, 32), td::Slice(rheader).substr(40, 16));
+
+    input_aes_ctr_byte_flow_.wakeup();
+    input_ = input_byte_flow_sink_.get_output();
+    input_->advance(header_size, header);
+    auto magic = td::as<td::uint32>(header.data() + 56);
+    if (magic != 0xeeeeeeee && magic != 0xdddddddd) {
+      return td::Status::Error("Unsupported transport");
+    }
+    transport_ = Transport::ObfuscatedTcp;
+    return td::Status::OK();
+  }
+
+  td::Status read_packets() {
+    if (transport_ == Transport::Unknown) {
+      TRY_STATUS(init_transport());
+      if (transport_ == Transport::Unknown) {
+        return td::Status::OK();
+      }
+    }
+
+    while (true) {
+      td::BufferSlice packet;
+      if (transport_ == Transport::Http) {
+        if (has_http_query_) {
+          // the client can't send a new request before receiving the response
+          break;
+        }
+        TRY_RESULT(wait_size, http_reader_.read_next(&http_query_));
+        if (wait_size != 0) {
+          break;
+        }
+        if (http_query_.type_ != td::HttpQuery::Type::Post || http_query_.container_.size() != 2u) {
+          return td::Status::Error("Wrong HTTP query");
+        }
+        packet = std::move(http_query_.container_[1]);
+        has_http_query_ = true;
+      } else {
+        if (transport_ == Transport::ObfuscatedTcp) {
+          input_aes_ctr_byte_flow_.wakeup();
+        }
+        td::uint32 quick_ack = 0;
+        auto wait_size = intermediate_transport_.read_from_stream(input_, &packet, &quick_ack);
+        if (wait_size != 0) {
+          break;
+        }
+        if (quick_ack != 0) {
+          continue;
+        }
+      }
+
+      if (!td::is_aligned_pointer<4>(packet.as_slice().ubegin())) {
+        td::BufferSlice new_packet(packet.size());
+        new_packet.as_mutable_slice().copy_from(packet.as_slice());
+        packet = std::move(new_packet);
+      }
+      TRY_STATUS(on_packet(packet.as_mutable_slice()));
+    }
+    return td::Status::OK();
+  }
+
+  td::Status on_packet(td::MutableSlice packet) {
+    if (packet.size() < 24) {
+      return td::Status::Error("Packet is too small");
+    }
+    auto auth_key_id = td::as<td::uint64>(packet.begin());
+    if (auth_key_id == 0) {
+      // auth_key_id:long message_id:long message_data_length:int message_data:bytes
+      auto data_size = static_cast<size_t>(td::as<td::int32>(packet.begin() + 16));
+      if (data_size > packet.size() - 20) {
+        return td::Status::Error("Wrong unencrypted packet size");
+      }
+      return on_handshake_query(packet.substr(20, data_size));
+    }
+    if (auth_key_.empty() || auth_key_id != auth_key_.id()) {
+      return td::Status::Error("Unknown auth key");
+    }
+
+    // auth_key_id:long msg_key:int128 encrypted_data:bytes
+    td::UInt128 message_key = td::as<td::UInt128>(packet.begin() + 8);
+    auto encrypted_data = packet.substr(24);
+    encrypted_data.truncate(encrypted_data.size() & ~static_cast<size_t>(15));
+    td::UInt256 aes_key;
+    td::UInt256 aes_iv;
+    td::mtproto::KDF2(auth_key_, message_key, 0, &aes_key, &aes_iv);
+    td::aes_ige_decrypt(as_slice(aes_key), as_mutable_slice(aes_iv), encrypted_data, encrypted_data);
+    if (td::mtproto::Transport::calc_message_key2(auth_key_, 0, encrypted_data).second != message_key) {
+      return td::Status::Error("Wrong message key");
+    }
+
+    // salt:long session_id:long message_id:long seq_no:int message_data_length:int message_data:bytes padding
+    td::TlParser parser(encrypted_data);
+    parser.fetch_long();
+    auto session_id = static_cast<td::uint64>(parser.fetch_long());
+    auto message_id = static_cast<td::uint64>(parser.fetch_long());
+    auto seq_no = parser.fetch_int();
+    auto data_size = static_cast<size_t>(parser.fetch_int());
+    auto data = parser.fetch_string_raw<td::Slice>(data_size);
+    TRY_STATUS(parser.get_status());
+
+    if (session_id != session_id_) {
+      session_id_ = session_id;
+      add_message(store_object(td::mtproto_api::new_session_created(static_cast<td::int64>(message_id),
+                                                                    td::Random::secure_int64(), server_salt_)),
+                  true, false);
+    }
+    return on_message(message_id, seq_no, data);
+  }
+
+  td::Status on_message(td::uint64 message_id, td::int32 seq_no, td::Slice data) {
+    if ((seq_no & 1) != 0) {
+      to_ack_.push_back(static_cast<td::int64>(message_id));
+    }
+
+    td::TlParser parser(data);
+    auto constructor_id = parser.fetch_int();
+    switch (constructor_id) {
+      case msg_container_id: {
+        auto message_count = parser.fetch_int();
+        for (td::int32 i = 0; i < message_count; i++) {
+          auto inner_message_id = static_cast<td::uint64>(parser.fetch_long());
+          auto inner_seq_no = parser.fetch_int();
+          auto inner_data_size = static_cast<size_t>(parser.fetch_int());
+          auto inner_data = parser.fetch_string_raw<td::Slice>(inner_data_size);
+          TRY_STATUS(parser.get_status());
+          TRY_STATUS(on_message(inner_message_id, inner_seq_no, inner_data));
+        }
+        break;
+      }
+      case bench_query_id:
+        pending_answers_.push(PendingAnswer{td::Time::now() + options_.answer_delay, message_id});
+        break;
+      case td::mtproto_api::ping_delay_disconnect::ID: {
+        td::mtproto_api::ping_delay_disconnect ping(parser);
+        add_message(store_object(td::mtproto_api::pong(static_cast<td::int64>(message_id), ping.ping_id_)), true,
+                    true);
+        break;
+      }
+      case td::mtproto_api::get_future_salts::ID: {
+        auto now = static_cast<td::int32>(td::Clocks::system());
+        td::vector<td::mtproto_api::object_ptr<td::mtproto_api::future_salt>> salts;
+        salts.push_back(td::mtproto_api::make_object<td::mtproto_api::future_salt>(
+            now - 60, now + 3600, static_cast<td::int64>(server_salt_)));
+        add_message(store_object(td::mtproto_api::future_salts(static_cast<td::int64>(message_id), now,
+                                                               std::move(salts))),
+                    true, true);
+        break;
+      }
+      case td::mtproto_api::msgs_ack::ID:
+      case td::mtproto_api::http_wait::ID:
+        break;
+      default:
+        LOG(WARNING) << "Ignore unsupported query " << td::format::as_hex(constructor_id);
+        break;
+    }
+    return parser.get_status();
+  }
+
+  td::Status on_handshake_query(td::Slice data) {
+    td::TlParser parser(data);
+    switch (parser.fetch_int()) {
+      case td::mtproto_api::req_pq_multi::ID: {
+        td::mtproto_api::req_pq_multi req_pq(parser);
+        TRY_STATUS(parser.get_status());
+        nonce_ = req_pq.nonce_;
+        td::Random::secure_bytes(server_nonce_.raw, sizeof(server_nonce_));
+        td::string pq(8, '\0');
+        for (size_t i = 0; i < pq.size(); i++) {
+          pq[i] = static_cast<char>((bench_pq >> (8 * (7 - i))) & 0xFF);
+        }
+        send_unencrypted(store_object(td::mtproto_api::resPQ(
+            nonce_, server_nonce_, pq, td::vector<td::int64>{get_bench_rsa_key().get_fingerprint()})));
+        return td::Status::OK();
+      }
+      case td::mtproto_api::req_DH_params::ID: {
+        td::mtproto_api::req_DH_params req_dh_params(parser);
+        TRY_STATUS(parser.get_status());
+        if (req_dh_params.nonce_ != nonce_ || req_dh_params.server_nonce_ != server_nonce_) {
+          return td::Status::Error("Nonce mismatch");
+        }
+        TRY_STATUS(decrypt_inner_data(req_dh_params.encrypted_data_));
+
+        auto prime = td::base64url_decode(dh_prime_base64).move_as_ok();
+        dh_handshake_.set_config(dh_g, prime);
+        auto g_a = dh_handshake_.get_g_b();
+        auto inner_data = store_object(td::mtproto_api::server_DH_inner_data(
+            nonce_, server_nonce_, dh_g, prime, g_a, static_cast<td::int32>(td::Clocks::system())));
+
+        // encrypted_answer := AES256_ige_encrypt(SHA1(answer) + answer + (0-15 random bytes), tmp_aes_key, tmp_aes_iv)
+        size_t answer_size = 20 + inner_data.size();
+        td::string answer((answer_size + 15) & ~static_cast<size_t>(15), '\0');
+        td::MutableSlice answer_slice = answer;
+        td::sha1(inner_data, answer_slice.ubegin());
+        answer_slice.substr(20).copy_from(inner_data);
+        td::Random::secure_bytes(answer_slice.substr(answer_size));
+        td::UInt256 tmp_aes_key;
+        td::UInt256 tmp_aes_iv;
+        td::mtproto::tmp_KDF(server_nonce_, new_nonce_, &tmp_aes_key, &tmp_aes_iv);
+        td::aes_ige_encrypt(as_slice(tmp_aes_key), as_mutable_slice(tmp_aes_iv), answer_slice, answer_slice);
+
+        send_unencrypted(store_object(td::mtproto_api::server_DH_params_ok(nonce_, server_nonce_, answer)));
+        return td::Status::OK();
+      }
+      case td::mtproto_api::set_client_DH_params::ID: {
+        td::mtproto_api::set_client_DH_params set_client_dh_params(parser);
+        TRY_STATUS(parser.get_status());
+        if (set_client_dh_params.nonce_ != nonce_ || set_client_dh_params.server_nonce_ != server_nonce_) {
+          return td::Status::Error("Nonce mismatch");
+        }
+        auto encrypted_data = set_client_dh_params.encrypted_data_.str();
+        if (encrypted_data.size() % 16 != 0 || encrypted_data.size() < 20) {
+          return td::Status::Error("Wrong encrypted data size");
+        }
+        td::UInt256 tmp_aes_key;
+        td::UInt256 tmp_aes_iv;
+        td::mtproto::tmp_KDF(server_nonce_, new_nonce_, &tmp_aes_key, &tmp_aes_iv);
+        td::aes_ige_decrypt(as_slice(tmp_aes_key), as_mutable_slice(tmp_aes_iv), encrypted_data, encrypted_data);
+
+        td::TlParser inner_parser(td::Slice(encrypted_data).substr(20));
+        if (inner_parser.fetch_int() != td::mtproto_api::client_DH_inner_data::ID) {
+          return td::Status::Error("Failed to fetch client_DH_inner_data");
+        }
+        td::mtproto_api::client_DH_inner_data inner_data(inner_parser);
+        TRY_STATUS(inner_parser.get_status());
+
+        dh_handshake_.set_g_a(inner_data.g_b_);
+        auto auth_key_params = dh_handshake_.gen_key();
+        auth_key_ =
+            td::mtproto::AuthKey(static_cast<td::uint64>(auth_key_params.first), std::move(auth_key_params.second));
+        server_salt_ = td::as<td::uint64>(new_nonce_.raw) ^ td::as<td::uint64>(server_nonce_.raw);
+
+        td::UInt<160> auth_key_sha1;
+        td::sha1(auth_key_.key(), auth_key_sha1.raw);
+        auto new_nonce_hash =
+            td::sha1(PSLICE() << new_nonce_.as_slice() << '\x01' << auth_key_sha1.as_slice().substr(0, 8));
+        td::UInt128 new_nonce_hash1;
+        as_mutable_slice(new_nonce_hash1).copy_from(td::Slice(new_nonce_hash).substr(4));
+        send_unencrypted(store_object(td::mtproto_api::dh_gen_ok(nonce_, server_nonce_, new_nonce_hash1)));
+        return td::Status::OK();
+      }
+      default:
+        return td::Status::Error("Unsupported unencrypted query");
+    }
+  }
+
+  // decrypts RSA_PAD-encrypted p_q_inner_data_dc and extracts new_nonce from it
+  td::Status decrypt_inner_data(td::Slice encrypted_data) {
+    if (encrypted_data.size() != 256) {
+      return td::Status::Error("Wrong encrypted data size");
+    }
+    td::BigNumContext context;
+    td::BigNum decrypted_data;
+    td::BigNum::mod_exp(decrypted_data, td::BigNum::from_binary(encrypted_data),
+                        td::BigNum::from_hex(bench_rsa_private_exponent_hex).move_as_ok(),
+                        td::BigNum::from_hex(bench_rsa_modulus_hex).move_as_ok(), context);
+    auto key_aes_encrypted = decrypted_data.to_binary(256);
+    td::MutableSlice aes_encrypted = td::MutableSlice(key_aes_encrypted).substr(32);
+    auto hash = td::sha256(aes_encrypted);
+    td::string aes_key(32, '\0');
+    for (size_t i = 0; i < aes_key.size(); i++) {
+      aes_key[i] = static_cast<char>(key_aes_encrypted[i] ^ hash[i]);
+    }
+    td::string aes_iv(32, '\0');
+    td::aes_ige_decrypt(aes_key, aes_iv, aes_encrypted, aes_encrypted);
+
+    td::string data_with_padding = aes_encrypted.substr(0, 192).str();
+    std::reverse(data_with_padding.begin(), data_with_padding.end());
+    if (td::sha256(aes_key + data_with_padding) != aes_encrypted.substr(192)) {
+      return td::Status::Error("Wrong inner data hash");
+    }
+
+    td::TlParser parser(data_with_padding);
+    if (parser.fetch_int() != td::mtproto_api::p_q_inner_data_dc::ID) {
+      return td::Status::Error("Failed to fetch p_q_inner_data_dc");
+    }
+    td::mtproto_api::p_q_inner_data_dc inner_data(parser);
+    TRY_STATUS(parser.get_status());
+    if (inner_data.nonce_ != nonce_ || inner_data.server_nonce_ != server_nonce_) {
+      return td::Status::Error("Nonce mismatch");
+    }
+    new_nonce_ = inner_data.new_nonce_;
+    return td::Status::OK();
+  }
+
+  td::uint64 next_message_id(bool is_answer) {
+    auto message_id = td::max(static_cast<td::uint64>(td::Clocks::system() * 4294967296.0), last_message_id_ + 1);
+    while ((message_id & 3) != (is_answer ? 1u : 3u)) {
+      message_id++;
+    }
+    last_message_id_ = message_id;
+    return message_id;
+  }
+
+  td::int32 next_seq_no(bool is_content_related) {
+    td::int32 result = seq_no_;
+    if (is_content_related) {
+      result |= 1;
+      seq_no_ += 2;
+    }
+    return result;
+  }
+
+  void add_message(td::string data, bool is_content_related, bool is_answer) {
+    auto message_id = next_message_id(is_answer);
+    auto seq_no = next_seq_no(is_content_related);
+    to_send_.push_back(OutboundMessage{message_id, seq_no, std::move(data)});
+  }
+
+  void add_answer(td::uint64 query_message_id) {
+    // rpc_result#f35c6d01 req_msg_id:long result:Object = RpcResult;
+    td::string answer(12 + options_.answer_size, '\0');
+    td::MutableSlice answer_slice = answer;
+    td::as<td::int32>(answer_slice.begin()) = rpc_result_id;
+    td::as<td::uint64>(answer_slice.begin() + 4) = query_message_id;
+    td::as<td::int32>(answer_slice.begin() + 12) = bench_answer_id;
+    add_message(std::move(answer), true, true);
+
+    answer_count_++;
+    if (options_.answers_per_update != 0 && answer_count_ % options_.answers_per_update == 0) {
+      td::string update(update_size, '\0');
+      td::as<td::int32>(&update[0]) = bench_update_id;
+      add_message(std::move(update), true, false);
+    }
+  }
+
+  void flush_answers() {
+    if (auth_key_.empty()) {
+      return;
+    }
+    auto now = td::Time::now();
+    while (!pending_answers_.empty() && pending_answers_.front().answer_at <= now) {
+      add_answer(pending_answers_.front().query_message_id);
+      pending_answers_.pop();
+    }
+    if (transport_ == Transport::Http) {
+      // there is no long poll connection, so the response is delayed until all answers are ready
+      if (!has_http_query_ || !pending_answers_.empty()) {
+        return;
+      }
+    }
+    // an HTTP response must be non-empty
+    if (!to_ack_.empty() || (transport_ == Transport::Http && to_send_.empty())) {
+      add_message(store_object(td::mtproto_api::msgs_ack(std::move(to_ack_))), false, false);
+      to_ack_.clear();
+    }
+    if (to_send_.empty()) {
+      return;
+    }
+
+    td::uint64 message_id;
+    td::int32 seq_no;
+    td::string container;
+    td::Slice data;
+    if (to_send_.size() == 1) {
+      message_id = to_send_[0].message_id;
+      seq_no = to_send_[0].seq_no;
+      data = to_send_[0].data;
+    } else {
+      // msg_container#73f1f8dc messages:vector<%Message> = MessageContainer;
+      size_t container_size = 8;
+      for (auto &message : to_send_) {
+        container_size += 16 + message.data.size();
+      }
+      container.resize(container_size);
+      td::TlStorerUnsafe storer(td::MutableSlice(container).ubegin());
+      storer.store_int(msg_container_id);
+      storer.store_int(static_cast<td::int32>(to_send_.size()));
+      for (auto &message : to_send_) {
+        storer.store_long(static_cast<td::int64>(message.message_id));
+        storer.store_int(message.seq_no);
+        storer.store_int(static_cast<td::int32>(message.data.size()));
+        storer.store_slice(message.data);
+      }
+      message_id = next_message_id(false);
+      seq_no = next_seq_no(false);
+      data = container;
+    }
+    send_encrypted(message_id, seq_no, data);
+    to_send_.clear();
+  }
+
+  void send_encrypted(td::uint64 message_id, td::int32 seq_no, td::Slice data) {
+    // auth_key_id:long msg_key:int128 encrypted_data:bytes
+    size_t data_size = 32 + data.size();
+    size_t encrypted_size = (data_size + 12 + 15) & ~static_cast<size_t>(15);
+    td::BufferWriter packet(24 + encrypted_size, 4, 0);
+    auto packet_slice = packet.as_mutable_slice();
+    td::as<td::uint64>(packet_slice.begin()) = auth_key_.id();
+
+    auto encrypted_data = packet_slice.substr(24);
+    td::TlStorerUnsafe storer(encrypted_data.ubegin());
+    storer.store_long(static_cast<td::int64>(server_salt_));
+    storer.store_long(static_cast<td::int64>(session_id_));
+    storer.store_long(static_cast<td::int64>(message_id));
+    storer.store_int(seq_no);
+    storer.store_int(static_cast<td::int32>(data.size()));
+    storer.store_slice(data);
+    td::Random::secure_bytes(encrypted_data.substr(data_size));
+
+    auto message_key = td::mtproto::Transport::calc_message_key2(auth_key_, 8, encrypted_data).second;
+    packet_slice.substr(8, 16).copy_from(as_slice(message_key));
+    td::UInt256 aes_key;
+    td::UInt256 aes_iv;
+    td::mtproto::KDF2(auth_key_, message_key, 8, &aes_key, &aes_iv);
+    td::aes_ige_encrypt(as_slice(aes_key), as_mutable_slice(aes_iv), encrypted_data, encrypted_data);
+    write_packet(std::move(packet));
+  }
+
+  void send_unencrypted(td::Slice data) {
+    // auth_key_id:long message_id:long message_data_length:int message_data:bytes
+    td::BufferWriter packet(20 + data.size(), 4, 0);
+    td::TlStorerUnsafe storer(packet.as_mutable_slice().ubegin());
+    storer.store_long(0);
+    storer.store_long(static_cast<td::int64>(next_message_id(true)));
+    storer.store_int(static_cast<td::int32>(data.size()));
+    storer.store_slice(data);
+    write_packet(std::move(packet));
+  }
+
+  void write_packet(td::BufferWriter &&packet) {
+    switch (transport_) {
+      case Transport::Tcp:
+        intermediate_transport_.write_prepare_inplace(&packet, false);
+        break;
+      case Transport::ObfuscatedTcp:
+        intermediate_transport_.write_prepare_inplace(&packet, false);
+        output_aes_ctr_state_.encrypt(packet.as_slice(), packet.as_mutable_slice());
+        break;
+      case Transport::Http: {
+        CHECK(has_http_query_);
+        has_http_query_ = false;
+        td::HttpHeaderCreator hc;
+        hc.init_ok();
+        hc.set_keep_alive();
+        hc.set_content_size(packet.size());
+        fd_.output_buffer().append(hc.finish().move_as_ok());
+        break;
+      }
+      default:
+        UNREACHABLE();
+    }
+    fd_.output_buffer().append(packet.as_buffer_slice());
+  }
+};
+
+class BenchPublicRsaKey final : public td::mtproto::PublicRsaKeyInterface {
+ public:
+  td::Result<RsaKey> get_rsa_key(const td::vector<td::int64> &fingerprints) final {
+    auto rsa = get_bench_rsa_key();
+    auto fingerprint = rsa.get_fingerprint();
+    if (!td::contains(fingerprints, fingerprint)) {
+      return td::Status::Error("Unknown fingerprints");
+    }
+    return RsaKey{std::move(rsa), fingerprint};
+  }
+
+  void drop_keys() final {
+  }
+};
+
+class BenchHandshakeContext final : public td::mtproto::AuthKeyHandshakeContext {
+ public:
+  td::mtproto::DhCallback *get_dh_callback() final {
+    return nullptr;
+  }
+  td::mtproto::PublicRsaKeyInterface *get_public_rsa_key_interface() final {
+    return &public_rsa_key_;
+  }
+
+ private:
+  BenchPublicRsaKey public_rsa_key_;
+};
+
+struct SessionBenchResult {
+  int answered_query_count = 0;
+  int update_count = 0;
+  double total_time = 0;
+  double cpu_time = 0;
+  td::vector<double> latencies;
+};
+
+class SessionBenchClient final
+    : public td::Actor
+    , public td::mtproto::SessionConnection::Callback {
+ public:
+  SessionBenchClient(const SessionBenchOptions &options, int port, td::Promise<SessionBenchResult> promise)
+      : options_(options), port_(port), promise_(std::move(promise)) {
+  }
+
+ private:
+  const SessionBenchOptions &options_;
+  int port_;
+  td::Promise<SessionBenchResult> promise_;
+
+  td::unique_ptr<td::mtproto::RawConnection> raw_connection_;
+  td::unique_ptr<td::mtproto::AuthKeyHandshake> handshake_;
+  td::mtproto::AuthData auth_data_;
+  td::unique_ptr<td::mtproto::SessionConnection> connection_;
+  bool is_closed_ = false;
+
+  int sent_query_count_ = 0;
+  td::FlatHashMap<td::mtproto::MessageId, double, td::mtproto::MessageIdHash> query_sent_at_;
+  double start_time_ = 0;
+  std::clock_t start_cpu_time_ = 0;
+  SessionBenchResult result_;
+
+  void start_up() final {
+    td::IPAddress ip_address;
+    ip_address.init_ipv4_port("127.0.0.1", port_).ensure();
+    auto r_socket_fd = td::SocketFd::open(ip_address);
+    if (r_socket_fd.is_error()) {
+      return finish(r_socket_fd.move_as_error());
+    }
+    auto raw_connection = td::mtproto::RawConnection::create(
+        ip_address, td::BufferedFd<td::SocketFd>(r_socket_fd.move_as_ok()),
+        td::mtproto::TransportType{options_.transport_type, 2, td::mtproto::ProxySecret()}, nullptr);
+    td::create_actor<td::mtproto::HandshakeActor>(
+        "HandshakeActor", td::make_unique<td::mtproto::AuthKeyHandshake>(2, 0), std::move(raw_connection),
+        td::make_unique<BenchHandshakeContext>(), 10.0,
+        td::PromiseCreator::lambda(
+            [actor_id = actor_id(this)](td::Result<td::unique_ptr<td::mtproto::RawConnection>> r_raw_connection) {
+              td::send_closure(actor_id, &SessionBenchClient::on_raw_connection, std::move(r_raw_connection));
+            }),
+        td::PromiseCreator::lambda(
+            [actor_id = actor_id(this)](td::Result<td::unique_ptr<td::mtproto::AuthKeyHandshake>> r_handshake) {
+              td::send_closure(actor_id, &SessionBenchClient::on_handshake, std::move(r_handshake));
+            }))
+        .release();
+  }
+
+  void on_raw_connection(td::Result<td::unique_ptr<td::mtproto::RawConnection>> r_raw_connection) {
+    if (r_raw_connection.is_error()) {
+      return finish(r_raw_connection.move_as_error());
+    }
+    raw_connection_ = r_raw_connection.move_as_ok();
+    try_start_session();
+  }
+
+  void on_handshake(td::Result<td::unique_ptr<td::mtproto::AuthKeyHandshake>> r_handshake) {
+    if (r_handshake.is_error()) {
+      return finish(r_handshake.move_as_error());
+    }
+    handshake_ = r_handshake.move_as_ok();
+    try_start_session();
+  }
+
+  void try_start_session() {
+    if (raw_connection_ == nullptr || handshake_ == nullptr) {
+      return;
+    }
+    if (!handshake_->is_ready_for_finish()) {
+      return finish(td::Status::Error("Failed to create auth key"));
+    }
+
+    auth_data_.set_use_pfs(false);
+    auth_data_.set_main_auth_key(handshake_->release_auth_key());
+    auth_data_.reset_server_time_difference(handshake_->get_server_time_diff());
+    auth_data_.set_server_salt(handshake_->get_server_salt(), td::Time::now());
+    auth_data_.set_session_id(td::Random::secure_uint64() | 1);
+
+    auto mode = options_.transport_type == td::mtproto::TransportType::Http ? td::mtproto::SessionConnection::Mode::Http
+                                                                            : td::mtproto::SessionConnection::Mode::Tcp;
+    connection_ = td::make_unique<td::mtproto::SessionConnection>(mode, std::move(raw_connection_), &auth_data_);
+    connection_->set_online(true, true);
+    td::Scheduler::subscribe(connection_->get_poll_info().extract_pollable_fd(this));
+
+    start_time_ = td::Time::now();
+    start_cpu_time_ = std::clock();
+    loop();
+  }
+
+  void send_queries() {
+    while (sent_query_count_ < options_.query_count &&
+           static_cast<int>(query_sent_at_.size()) < options_.max_in_flight_query_count) {
+      td::BufferSlice query(options_.query_size);
+      query.as_mutable_slice().fill('\0');
+      td::as<td::int32>(query.as_mutable_slice().begin()) = bench_query_id;
+      auto message_id = connection_->send_query(std::move(query), false).move_as_ok();
+      query_sent_at_.emplace(message_id, td::Time::now());
+      sent_query_count_++;
+    }
+  }
+
+  void loop() final {
+    while (connection_ != nullptr) {
+      auto answered_query_count = result_.answered_query_count;
+      send_queries();
+      auto wakeup_at = connection_->flush(this);
+      if (is_closed_) {
+        return finish(td::Status::Error("Connection closed"));
+      }
+      if (result_.answered_query_count == options_.query_count) {
+        return finish(td::Status::OK());
+      }
+      if (answered_query_count == result_.answered_query_count) {
+        if (wakeup_at != 0) {
+          set_timeout_at(wakeup_at);
+        }
+        break;
+      }
+    }
+  }
+
+  void finish(td::Status status) {
+    if (connection_ != nullptr) {
+      td::Scheduler::unsubscribe_before_close(connection_->get_poll_info().get_pollable_fd_ref());
+      if (!is_closed_) {
+        connection_->force_close(this);
+      }
+      auto raw_connection = connection_->move_as_raw_connection();
+      connection_ = nullptr;
+      raw_connection->close();
+    }
+    if (status.is_error()) {
+      promise_.set_error(std::move(status));
+    } else {
+      result_.total_time = td::Time::now() - start_time_;
+      result_.cpu_time = static_cast<double>(std::clock() - start_cpu_time_) / CLOCKS_PER_SEC;
+      promise_.set_value(std::move(result_));
+    }
+    stop();
+  }
+
+  void on_answer(td::mtproto::MessageId message_id) {
+    auto it = query_sent_at_.find(message_id);
+    if (it == query_sent_at_.end()) {
+      LOG(ERROR) << "Receive answer to unknown " << message_id;
+      return;
+    }
+    result_.latencies.push_back(td::Time::now() - it->second);
+    result_.answered_query_count++;
+    query_sent_at_.erase(it);
+  }
+
+  void on_connected() final {
+  }
+
+  void on_closed(td::Status status) final {
+    LOG_IF(ERROR, status.is_error()) << "Connection closed: " << status;
+    is_closed_ = true;
+  }
+
+  void on_server_salt_updated() final {
+  }
+
+  void on_server_time_difference_updated(bool force) final {
+  }
+
+  void on_new_session_created(td::uint64 unique_id, td::mtproto::MessageId first_message_id) final {
+  }
+
+  void on_session_failed(td::Status status) final {
+    LOG(ERROR) << "Session failed: " << status;
+  }
+
+  void on_container_sent(td::mtproto::MessageId container_message_id,
+                         td::vector<td::mtproto::MessageId> message_ids) final {
+  }
+
+  td::Status on_pong() final {
+    return td::Status::OK();
+  }
+
+  td::Status on_update(td::BufferSlice packet) final {
+    result_.update_count++;
+    return td::Status::OK();
+  }
+
+  void on_message_ack(td::mtproto::MessageId message_id) final {
+  }
+
+  td::Status on_message_result_ok(td::mtproto::MessageId message_id, td::BufferSlice packet,
+                                  size_t original_size) final {
+    on_answer(message_id);
+    return td::Status::OK();
+  }
+
+  void on_message_result_error(td::mtproto::MessageId message_id, int code, td::string message) final {
+    LOG(ERROR) << "Receive error " << code << " " << message;
+    on_answer(message_id);
+  }
+
+  void on_message_failed(td::mtproto::MessageId message_id, td::Status status) final {
+    LOG(ERROR) << "Failed to send " << message_id << ": " << status;
+  }
+
+  void on_message_info(td::mtproto::MessageId message_id, td::int32 state, td::mtproto::MessageId answer_message_id,
+                       td::int32 answer_size, td::int32 source) final {
+  }
+
+  td::Status on_destroy_auth_key() final {
+    return td::Status::OK();
+  }
+};
+
+class SessionBench final : public td::TcpListener::Callback {
+ public:
+  SessionBench(const SessionBenchOptions &options, td::Result<SessionBenchResult> *result)
+      : options_(options), result_(result) {
+  }
+
+ private:
+  const SessionBenchOptions &options_;
+  td::Result<SessionBenchResult> *result_;
+  td::ActorOwn<td::TcpListener> listener_;
+  td::vector<td::ActorOwn<EmulatedServerConnection>> server_connections_;
+
+  void start_up() final {
+    // listen on a random free port, so that several benchmarks can run in parallel
+    int port = 0;
+    td::Result<td::ServerSocketFd> r_server_fd = td::Status::Error("Failed to find a free port");
+    for (int i = 0; i < 100 && r_server_fd.is_error(); i++) {
+      port = td::Random::fast(20000, 59999);
+      r_server_fd = td::ServerSocketFd::open(port, "127.0.0.1");
+    }
+    if (r_server_fd.is_error()) {
+      return on_result(r_server_fd.move_as_error());
+    }
+    listener_ = td::create_actor<td::TcpListener>("TcpListener", r_server_fd.move_as_ok(), actor_shared(this));
+    td::create_actor<SessionBenchClient>(
+        "SessionBenchClient", options_, port,
+        td::PromiseCreator::lambda([actor_id = actor_id(this)](td::Result<SessionBenchResult> r_result) {
+          td::send_closure(actor_id, &SessionBench::on_result, std::move(r_result));
+        }))
+        .release();
+  }
+
+  void accept(td::SocketFd fd) final {
+    server_connections_.push_back(
+        td::create_actor<EmulatedServerConnection>("EmulatedServerConnection", std::move(fd), options_));
+  }
+
+  void on_result(td::Result<SessionBenchResult> r_result) {
+    *result_ = std::move(r_result);
+    server_connections_.clear();
+    listener_.reset();
+    stop();
+    td::Scheduler::instance()->finish();
+  }
+};
+
+static void bench_session(const SessionBenchOptions &options) {
+  td::Result<SessionBenchResult> r_result = td::Status::Error("Benchmark was interrupted");
+  {
+    td::ConcurrentScheduler scheduler(0, 0);
+    scheduler.create_actor_unsafe<SessionBench>(0, "SessionBench", options, &r_result).release();
+    scheduler.start();
+    while (scheduler.run_main(10)) {
+      // empty
+    }
+    scheduler.finish();
+  }
+
+  auto description = PSTRING() << get_transport_name(options.transport_type) << ", " << options.query_size
+                               << "-byte queries, " << options.answer_size << "-byte answers in "
+                               << static_cast<int>(options.answer_delay * 1e3) << "ms, "
+                               << options.max_in_flight_query_count << " in flight";
+  if (r_result.is_error()) {
+    LOG(ERROR) << description << ": " << r_result.error();
+    return;
+  }
+  auto result = r_result.move_as_ok();
+  auto &latencies = result.latencies;
+  CHECK(!latencies.empty());
+  std::sort(latencies.begin(), latencies.end());
+  auto get_percentile = [&](size_t percent) {
+    return latencies[td::min(latencies.size() - 1, latencies.size() * percent / 100)] * 1e6;
+  };
+  // CPU time includes the time spent by the emulator, which runs in the same thread
+  LOG(PLAIN) << description << ": " << static_cast<double>(result.answered_query_count) / result.total_time
+             << " queries/s, p50 " << get_percentile(50) << "us, p99 " << get_percentile(99) << "us, CPU "
+             << result.cpu_time * 1e6 / result.answered_query_count << "us/query, " << result.update_count
+             << " updates";
+}
+
+int main(int argc, char **argv) {
+  SET_VERBOSITY_LEVEL(VERBOSITY_NAME(ERROR));
+
+  int query_count = 20000;
+  if (argc > 1) {
+    query_count = td::max(std::atoi(argv[1]), 10);
+  }
+
+  for (auto transport_type : {td::mtproto::TransportType::Tcp, td::mtproto::TransportType::ObfuscatedTcp,
+                              td::mtproto::TransportType::Http}) {
+    // sequential queries; each of them waits for the query batching delay of SessionConnection
+    bench_session({transport_type, query_count / 10, 1, 64, 64, 0.0, 10});
+    bench_session({transport_type, query_count, 100, 64, 64, 0.0, 10});
+    bench_session({transport_type, query_count, 100, 64, 16384, 0.0, 10});
+    bench_session({transport_type, query_count, 100, 512, 64, 0.02, 10});
+  }
+}
@@ -11,6 +11,8 @@
 #include "td/telegram/ServerMessageId.h"
 #include "td/telegram/UserId.h"
 
+#include "td/db/binlog/Binlog.h"
+#include "td/db/binlog/BinlogEvent.h"
 #include "td/db/DbKey.h"
 #include "td/db/SqliteConnectionSafe.h"
 #include "td/db/SqliteDb.h"
@@ -21,10 +23,19 @@
 #include "td/utils/buffer.h"
 #include "td/utils/common.h"
 #include "td/utils/logging.h"
+#include "td/utils/misc.h"
+#include "td/utils/port/FileFd.h"
+#include "td/utils/port/Stat.h"
 #include "td/utils/Promise.h"
 #include "td/utils/Random.h"
+#include "td/utils/SliceBuilder.h"
 #include "td/utils/Status.h"
+#include "td/utils/Storer.h"
+#include "td/utils/Time.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <memory>
 
 static td::Status init_db(td::SqliteDb &db) {
@@ -92,6 +103,7 @@ class MessageDbBench final : public td::Benchmark {
     auto guard = scheduler_->get_main_guard();
 
     td::string sql_db_name = "testdb.sqlite";
+    td::SqliteDb::open_with_key(sql_db_name, true, td::DbKey::empty()).move_as_ok();
     sql_connection_ = std::make_shared<td::SqliteConnectionSafe>(sql_db_name, td::DbKey::empty());
     auto &db = sql_connection_->get();
     TRY_STATUS(init_db(db));
@@ -107,7 +119,289 @@ class MessageDbBench final : public td::Benchmark {
   }
 };
 
-int main() {
+// interleaves message additions with full-text searches and measures total throughput
+static void bench_message_db_mixed(int read_thread_count, int operation_count) {
+  td::ConcurrentScheduler scheduler(1 + read_thread_count, 0);
+
+  td::string sql_db_name = "bench_mixed.sqlite";
+  td::SqliteDb::destroy(sql_db_name).ignore();
+  td::SqliteDb::open_with_key(sql_db_name, true, td::DbKey::empty()).move_as_ok();
+  std::shared_ptr<td::SqliteConnectionSafe> sql_connection;
+  std::shared_ptr<td::MessageDbSyncSafeInterface> message_db_sync_safe;
+  std::shared_ptr<td::MessageDbAsyncInterface> message_db_async;
+  const int prefill_count = 50000;
+  auto add_message = [&](int i, td::Promise<td::Unit> promise) {
+    auto dialog_id = td::DialogId(td::UserId(static_cast<td::int64>(i % 100 + 1)));
+    auto message_id = td::MessageId{td::ServerMessageId{i + 1}};
+    auto text = PSTRING() << "message text word" << i % 1000;
+    message_db_async->add_message({dialog_id, message_id}, td::ServerMessageId(), dialog_id, 0, 0, 1, i + 1,
+                                  std::move(text), td::NotificationId(), td::MessageId(),
+                                  td::BufferSlice(td::Random::fast(100, 299)), std::move(promise));
+  };
+  {
+    auto guard = scheduler.get_main_guard();
+    sql_connection = std::make_shared<td::SqliteConnectionSafe>(sql_db_name, td::DbKey::empty());
+    auto &db = sql_connection->get();
+    init_db(db).ensure();
+    db.exec("BEGIN TRANSACTION").ensure();
+    init_message_db(db, 0).ensure();
+    db.exec("COMMIT TRANSACTION").ensure();
+
+    message_db_sync_safe = td::create_message_db_sync(sql_connection);
+    td::vector<td::int32> read_scheduler_ids;
+    for (int i = 0; i < read_thread_count; i++) {
+      read_scheduler_ids.push_back(i + 1);
+    }
+    message_db_async = td::create_message_db_async(message_db_sync_safe, 0, std::move(read_scheduler_ids));
+  }
+  scheduler.start();
+
+  std::atomic<int> left_count{prefill_count};
+  {
+    auto guard = scheduler.get_main_guard();
+    for (int i = 0; i < prefill_count; i++) {
+      add_message(i, td::PromiseCreator::lambda([&left_count](td::Unit) { left_count--; }));
+    }
+  }
+  while (left_count.load() > 0) {
+    scheduler.run_main(0.01);
+  }
+
+  // every fourth operation is a search
+  left_count = operation_count;
+  std::atomic<td::int64> found_count{0};
+  auto start_time = td::Time::now();
+  {
+    auto guard = scheduler.get_main_guard();
+    for (int i = 0; i < operation_count; i++) {
+      if (i % 4 == 0) {
+        td::MessageDbFtsQuery query;
+        query.query = PSTRING() << "word" << td::Random::fast(0, 999);
+        query.limit = 100;
+        message_db_async->get_messages_fts(
+            std::move(query), td::PromiseCreator::lambda([&](td::MessageDbFtsResult result) {
+              found_count += static_cast<td::int64>(result.messages.size());
+              left_count--;
+            }));
+      } else {
+        add_message(prefill_count + i, td::PromiseCreator::lambda([&left_count](td::Unit) { left_count--; }));
+      }
+    }
+  }
+  while (left_count.load() > 0) {
+    scheduler.run_main(0.01);
+  }
+  auto passed_time = td::Time::now() - start_time;
+  LOG(PLAIN) << "MessageDb mixed reads and writes with " << read_thread_count
+             << " read connections: " << static_cast<double>(operation_count) / passed_time << " operations/s, found "
+             << found_count.load() << " messages";
+
+  {
+    auto guard = scheduler.get_main_guard();
+    message_db_sync_safe.reset();
+    message_db_async->close(
+        td::PromiseCreator::lambda([&, sql_connection = std::move(sql_connection)](td::Unit) mutable {
+          sql_connection->close_and_destroy();
+          sql_connection.reset();
+          message_db_async.reset();
+          td::Scheduler::instance()->finish();
+        }));
+  }
+  while (scheduler.run_main(10)) {
+  }
+  scheduler.finish();
+}
+
+// stores a history preload with full-text indexing one message at a time or in batches of batch_size messages
+static void bench_message_db_add_messages(int message_count, int batch_size) {
+  td::ConcurrentScheduler scheduler(0, 0);
+
+  td::string sql_db_name = "bench_add_messages.sqlite";
+  td::SqliteDb::destroy(sql_db_name).ignore();
+  td::SqliteDb::open_with_key(sql_db_name, true, td::DbKey::empty()).move_as_ok();
+  std::shared_ptr<td::SqliteConnectionSafe> sql_connection;
+  std::shared_ptr<td::MessageDbSyncSafeInterface> message_db_sync_safe;
+  std::shared_ptr<td::MessageDbAsyncInterface> message_db_async;
+  {
+    auto guard = scheduler.get_main_guard();
+    sql_connection = std::make_shared<td::SqliteConnectionSafe>(sql_db_name, td::DbKey::empty());
+    auto &db = sql_connection->get();
+    init_db(db).ensure();
+    db.exec("BEGIN TRANSACTION").ensure();
+    init_message_db(db, 0).ensure();
+    db.exec("COMMIT TRANSACTION").ensure();
+
+    message_db_sync_safe = td::create_message_db_sync(sql_connection);
+    message_db_async = td::create_message_db_async(message_db_sync_safe, 0);
+  }
+  scheduler.start();
+
+  auto get_message = [](int i) {
+    td::MessageDbMessageToAdd message;
+    auto dialog_id = td::DialogId(td::UserId(static_cast<td::int64>(i % 10 + 1)));
+    message.message_full_id = {dialog_id, td::MessageId{td::ServerMessageId{i + 1}}};
+    message.sender_dialog_id = dialog_id;
+    message.index_mask = 1;
+    message.search_id = i + 1;
+    message.text = PSTRING() << "message text word" << i % 1000;
+    message.data = td::BufferSlice(td::Random::fast(100, 299));
+    return message;
+  };
+
+  std::atomic<int> left_count{0};
+  auto start_time = td::Time::now();
+  {
+    auto guard = scheduler.get_main_guard();
+    for (int i = 0; i < message_count; i += batch_size) {
+      left_count++;
+      auto promise = td::PromiseCreator::lambda([&left_count](td::Unit) { left_count--; });
+      if (batch_size == 1) {
+        auto message = get_message(i);
+        message_db_async->add_message(message.message_full_id, message.unique_message_id, message.sender_dialog_id,
+                                      message.random_id, message.ttl_expires_at, message.index_mask, message.search_id,
+                                      std::move(message.text), message.notification_id, message.top_thread_message_id,
+                                      std::move(message.data), std::move(promise));
+      } else {
+        td::vector<td::MessageDbMessageToAdd> messages;
+        for (int j = i; j < td::min(i + batch_size, message_count); j++) {
+          messages.push_back(get_message(j));
+        }
+        message_db_async->add_messages(std::move(messages), std::move(promise));
+      }
+    }
+  }
+  while (left_count.load() > 0) {
+    scheduler.run_main(0.01);
+  }
+  auto passed_time = td::Time::now() - start_time;
+  LOG(PLAIN) << "MessageDb add " << message_count << " messages in batches of " << batch_size << ": "
+             << static_cast<double>(message_count) / passed_time << " messages/s";
+
+  {
+    auto guard = scheduler.get_main_guard();
+    message_db_sync_safe.reset();
+    message_db_async->close(
+        td::PromiseCreator::lambda([&, sql_connection = std::move(sql_connection)](td::Unit) mutable {
+          sql_connection->close_and_destroy();
+          sql_connection.reset();
+          message_db_async.reset();
+          td::Scheduler::instance()->finish();
+        }));
+  }
+  while (scheduler.run_main(10)) {
+  }
+  scheduler.finish();
+}
+
+static td::uint64 get_resident_size(bool is_peak) {
+  auto r_mem_stat = td::mem_stat();
+  if (r_mem_stat.is_error()) {
+    return 0;
+  }
+  return is_peak ? r_mem_stat.ok().resident_size_peak_ : r_mem_stat.ok().resident_size_;
+}
+
+// writes the binlog file directly to keep the process memory usage low before the replay
+static void create_binlog(td::CSlice path, int event_count) {
+  td::Binlog::destroy(path).ignore();
+  auto fd = td::FileFd::open(path.str(), td::FileFd::Flags::Write | td::FileFd::Flags::Create).move_as_ok();
+  td::string data;
+  for (int i = 1; i <= event_count; i++) {
+    auto event_data = td::string(td::Random::fast(25, 150) * 4, static_cast<char>('a' + i % 26));
+    auto raw_event = td::BinlogEvent::create_raw(static_cast<td::uint64>(i), 1, 0, td::create_storer(event_data));
+    data.append(raw_event.as_slice().begin(), raw_event.size());
+    if (data.size() >= (1 << 20) || i == event_count) {
+      CHECK(fd.write(data).move_as_ok() == data.size());
+      data.clear();
+    }
+  }
+  fd.close();
+}
+
+static void bench_binlog_replay(td::CSlice path, const td::DbKey &db_key) {
+  auto resident_size = get_resident_size(false);
+  auto start_time = td::Time::now();
+  size_t event_count = 0;
+  size_t total_size = 0;
+  {
+    td::Binlog binlog;
+    binlog
+        .init(
+            path.str(),
+            [&](const td::BinlogEvent &event) {
+              event_count++;
+              total_size += event.get_data().size();
+            },
+            db_key)
+        .ensure();
+    auto passed_time = td::Time::now() - start_time;
+    LOG(PLAIN) << "Binlog replay" << (db_key.is_empty() ? "" : " with encryption") << ": " << event_count
+               << " events of total size " << (total_size >> 20) << " MB in " << passed_time
+               << " seconds, resident memory grew by " << ((get_resident_size(false) - resident_size) >> 20)
+               << " MB, peak resident memory is " << (get_resident_size(true) >> 20) << " MB";
+  }
+}
+
+// rewrites random events until the binlog is reindexed in the background and measures latency of each rewrite
+static void bench_binlog_append_latency(td::CSlice path, const td::DbKey &db_key) {
+  td::Binlog binlog;
+  td::uint64 max_event_id = 0;
+  binlog.init(path.str(), [&](const td::BinlogEvent &event) { max_event_id = event.id_; }, db_key).ensure();
+  CHECK(max_event_id > 0);
+
+  auto new_path = path.str() + ".new";
+  td::vector<double> latencies;
+  size_t reindex_append_count = 0;
+  while (true) {
+    auto event_id = static_cast<td::uint64>(td::Random::fast(1, static_cast<int>(max_event_id)));
+    auto event_data = td::string(td::Random::fast(25, 150) * 4, 'b');
+    auto start_time = td::Time::now();
+    binlog.rewrite(event_id, 1, td::create_storer(event_data));
+    latencies.push_back(td::Time::now() - start_time);
+    if (td::stat(new_path).is_ok()) {
+      reindex_append_count++;
+    } else if (reindex_append_count > 0) {
+      break;
+    }
+  }
+  binlog.close().ensure();
+
+  std::sort(latencies.begin(), latencies.end());
+  auto get_percentile = [&](size_t permille) {
+    return latencies[td::min(latencies.size() - 1, latencies.size() * permille / 1000)] * 1e6;
+  };
+  LOG(PLAIN) << "Binlog append" << (db_key.is_empty() ? "" : " with encryption") << ": " << latencies.size()
+             << " appends, " << reindex_append_count << " of them during reindex, p50 " << get_percentile(500)
+             << "us, p99 " << get_percentile(990) << "us, p99.9 " << get_percentile(999) << "us, max "
+             << latencies.back() * 1e6 << "us";
+}
+
+int main(int argc, char **argv) {
   SET_VERBOSITY_LEVEL(VERBOSITY_NAME(WARNING));
+
+  int event_count = 500000;
+  if (argc > 1) {
+    event_count = td::max(std::atoi(argv[1]), 1);
+  }
+  td::CSlice binlog_path = "bench_binlog";
+  create_binlog(binlog_path, event_count);
+  // the first replay determines the peak resident memory; the second one is encrypted by the previous one
+  bench_binlog_replay(binlog_path, td::DbKey::empty());
+  {
+    td::Binlog binlog;
+    binlog.init(binlog_path.str(), [](const td::BinlogEvent &) {}, td::DbKey::raw_key(td::string(32, 'k'))).ensure();
+  }
+  bench_binlog_replay(binlog_path, td::DbKey::raw_key(td::string(32, 'k')));
+  bench_binlog_append_latency(binlog_path, td::DbKey::raw_key(td::string(32, 'k')));
+  create_binlog(binlog_path, event_count);
+  bench_binlog_append_latency(binlog_path, td::DbKey::empty());
+  td::Binlog::destroy(binlog_path).ignore();
+
   td::bench(MessageDbBench());
+  for (int read_thread_count : {0, 1, 2}) {
+    bench_message_db_mixed(read_thread_count, 40000);
+  }
+  for (int batch_size : {1, 100, 500}) {
+    bench_message_db_add_messages(100000, batch_size);
+  }
 }
@@ -0,0 +1,196 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/db/binlog/Binlog.h"
+#include "td/db/binlog/BinlogEvent.h"
+#include "td/db/TQueue.h"
+
+#include "td/utils/common.h"
+#include "td/utils/logging.h"
+#include "td/utils/port/Stat.h"
+#include "td/utils/Promise.h"
+#include "td/utils/Slice.h"
+#include "td/utils/Span.h"
+#include "td/utils/Time.h"
+
+#include <cstdlib>
+#include <memory>
+
+static constexpr td::TQueue::QueueId QUEUE_COUNT = 10;
+static constexpr int QUEUE_EVENT_COUNT = 100000;
+static constexpr td::int32 EXPIRES_AT = 1000000;
+
+static td::int64 get_resident_size() {
+  auto r_mem_stat = td::mem_stat();
+  if (r_mem_stat.is_error()) {
+    return 0;
+  }
+  return static_cast<td::int64>(r_mem_stat.ok().resident_size_);
+}
+
+// fills QUEUE_COUNT queues with QUEUE_EVENT_COUNT events each
+static void push_events(td::TQueue &tqueue, const td::string &data) {
+  for (int i = 0; i < QUEUE_EVENT_COUNT; i++) {
+    for (td::TQueue::QueueId queue_id = 1; queue_id <= QUEUE_COUNT; queue_id++) {
+      // events expire at different times to make garbage collection incremental
+      tqueue.push(queue_id, data, EXPIRES_AT + i, 0, td::TQueue::EventId()).ensure();
+    }
+  }
+}
+
+static void bench_tqueue(size_t data_size, bool need_print_memory) {
+  td::string data(data_size, 'a');
+  auto event_count = static_cast<double>(QUEUE_COUNT * QUEUE_EVENT_COUNT);
+  auto tqueue = td::TQueue::create();
+
+  auto resident_size = get_resident_size();
+  auto start_time = td::Time::now();
+  push_events(*tqueue, data);
+  auto push_time = td::Time::now() - start_time;
+  if (need_print_memory) {
+    LOG(PLAIN) << "Memory per event with " << data_size
+               << " bytes of data: " << static_cast<double>(get_resident_size() - resident_size) / event_count
+               << " bytes";
+  }
+
+  // read all events by 100, as bots do with getUpdates
+  td::TQueue::Event events[100];
+  start_time = td::Time::now();
+  size_t received_event_count = 0;
+  for (td::TQueue::QueueId queue_id = 1; queue_id <= QUEUE_COUNT; queue_id++) {
+    auto from_id = tqueue->get_head(queue_id);
+    while (true) {
+      td::MutableSpan<td::TQueue::Event> span(events, 100);
+      tqueue->get(queue_id, from_id, true, 0, span).ensure();
+      if (span.empty()) {
+        break;
+      }
+      received_event_count += span.size();
+      from_id = span.back().id.next().move_as_ok();
+    }
+  }
+  auto get_time = td::Time::now() - start_time;
+  CHECK(received_event_count == QUEUE_COUNT * QUEUE_EVENT_COUNT);
+
+  push_events(*tqueue, data);
+  start_time = td::Time::now();
+  td::int64 deleted_event_count = 0;
+  for (int i = 0; i < QUEUE_EVENT_COUNT; i += QUEUE_EVENT_COUNT / 10) {
+    while (true) {
+      auto result = tqueue->run_gc(EXPIRES_AT + i + QUEUE_EVENT_COUNT / 10);
+      deleted_event_count += result.first;
+      if (result.second) {
+        break;
+      }
+    }
+  }
+  auto gc_time = td::Time::now() - start_time;
+  CHECK(deleted_event_count == QUEUE_COUNT * QUEUE_EVENT_COUNT);
+
+  LOG(PLAIN) << "TQueue with " << data_size << " bytes of data: push " << event_count / push_time
+             << " events/s, get " << event_count / get_time << " events/s, gc " << event_count / gc_time
+             << " events/s";
+}
+
+// pushes rounds of events to 100 queues, reads all of them except the first queue and forgets the read events;
+// memory must grow only by the size of unread events
+static void bench_tqueue_mixed_lifetimes(size_t data_size) {
+  static constexpr td::TQueue::QueueId MIXED_QUEUE_COUNT = 100;
+  static constexpr int ROUND_COUNT = 5;
+  static constexpr int ROUND_EVENT_COUNT = 1000;
+  td::string data(data_size, 'a');
+  auto tqueue = td::TQueue::create();
+
+  auto resident_size = get_resident_size();
+  auto start_time = td::Time::now();
+  for (int round = 1; round <= ROUND_COUNT; round++) {
+    for (int i = 0; i < ROUND_EVENT_COUNT; i++) {
+      for (td::TQueue::QueueId queue_id = 1; queue_id <= MIXED_QUEUE_COUNT; queue_id++) {
+        tqueue->push(queue_id, data, EXPIRES_AT, 0, td::TQueue::EventId()).ensure();
+      }
+    }
+    for (td::TQueue::QueueId queue_id = 2; queue_id <= MIXED_QUEUE_COUNT; queue_id++) {
+      tqueue->forget_range(queue_id, tqueue->get_tail(queue_id));
+    }
+    LOG(PLAIN) << "Resident memory with " << data_size << " bytes of data after round " << round << ": "
+               << static_cast<double>(get_resident_size() - resident_size) / (1 << 20) << " MB";
+  }
+  auto passed_time = td::Time::now() - start_time;
+  LOG(PLAIN) << "TQueue with mixed lifetimes: "
+             << static_cast<double>(ROUND_COUNT * ROUND_EVENT_COUNT * MIXED_QUEUE_COUNT) / passed_time << " events/s";
+}
+
+// pushes events to a queue stored in a binlog by bursts of burst_size events and forgets them
+static void bench_tqueue_binlog(size_t data_size, size_t burst_size, bool use_batches, bool forget_one_by_one) {
+  td::CSlice binlog_path = "bench_tqueue.binlog";
+  td::Binlog::destroy(binlog_path).ensure();
+  auto binlog = std::make_shared<td::Binlog>();
+  binlog->init(binlog_path.str(), [](const td::BinlogEvent &) {}).ensure();
+  auto tqueue_binlog = td::make_unique<td::TQueueBinlog<td::Binlog>>();
+  tqueue_binlog->set_binlog(binlog);
+  auto tqueue = td::TQueue::create();
+  tqueue->set_callback(std::move(tqueue_binlog));
+
+  td::string data(data_size, 'a');
+  size_t event_count = 0;
+  auto start_time = td::Time::now();
+  while (event_count < static_cast<size_t>(QUEUE_EVENT_COUNT)) {
+    td::TQueue::EventId first_event_id;
+    if (use_batches) {
+      td::vector<td::TQueue::BatchEvent> events(burst_size);
+      for (auto &event : events) {
+        event.data = data;
+        event.expires_at = EXPIRES_AT;
+      }
+      first_event_id = tqueue->push_batch(1, std::move(events), td::TQueue::EventId()).move_as_ok();
+    } else {
+      for (size_t i = 0; i < burst_size; i++) {
+        auto event_id = tqueue->push(1, data, EXPIRES_AT, 0, td::TQueue::EventId()).move_as_ok();
+        if (i == 0) {
+          first_event_id = event_id;
+        }
+      }
+    }
+    if (!forget_one_by_one) {
+      tqueue->forget_range(1, first_event_id.advance(burst_size).move_as_ok());
+    } else {
+      for (size_t i = 0; i < burst_size; i++) {
+        tqueue->forget(1, first_event_id.advance(i).move_as_ok());
+      }
+    }
+    event_count += burst_size;
+  }
+  binlog->flush("bench");
+  auto passed_time = td::Time::now() - start_time;
+  tqueue->close(td::Promise<td::Unit>());
+  td::Binlog::destroy(binlog_path).ensure();
+
+  LOG(PLAIN) << "TQueue with binlog, bursts of " << burst_size << " events" << (use_batches ? " in batches" : "")
+             << (forget_one_by_one ? " forgotten one by one" : "") << ": "
+             << static_cast<double>(event_count) / passed_time << " events/s";
+}
+
+int main(int argc, char **argv) {
+  SET_VERBOSITY_LEVEL(VERBOSITY_NAME(ERROR));
+
+  size_t data_size = 200;
+  if (argc > 1) {
+    data_size = static_cast<size_t>(td::max(std::atoi(argv[1]), 1));
+  }
+  if (argc > 2 && td::Slice(argv[2]) == "mixed") {
+    // memory is measured only in a fresh process, because freed memory isn't returned to the system
+    bench_tqueue_mixed_lifetimes(data_size);
+    return 0;
+  }
+  for (int i = 0; i < 3; i++) {
+    bench_tqueue(data_size, i == 0);
+  }
+  for (size_t burst_size : {10, 100, 1000}) {
+    bench_tqueue_binlog(data_size, burst_size, false, true);
+    bench_tqueue_binlog(data_size, burst_size, true, false);
+    bench_tqueue_binlog(data_size, burst_size, true, true);
+  }
+}
@@ -31,7 +31,9 @@ void gen_to_json_constructor(StringBuilder &sb, const T *constructor, bool is_he
   }
   sb << " {\n";
   sb << "  auto jo = jv.enter_object();\n";
-  sb << "  jo(\"@type\", \"" << tl::simple::gen_cpp_name(constructor->name) << "\");\n";
+  // field names and type names never need escaping, so they are written as raw JSON strings
+  sb << "  jo(JsonRaw(\"\\\"@type\\\"\"), JsonRaw(\"\\\"" << tl::simple::gen_cpp_name(constructor->name)
+     << "\\\"\"));\n";
   for (auto &arg : constructor->args) {
     auto field_name = tl::simple::gen_cpp_field_name(arg.name);
     bool is_custom = arg.type->type == tl::simple::Type::Custom;
@@ -50,12 +52,13 @@ void gen_to_json_constructor(StringBuilder &sb, const T *constructor, bool is_he
                arg.type->vector_value_type->type == tl::simple::Type::Int64) {
       object = PSTRING() << "JsonVectorInt64{" << object << "}";
     }
+    auto field = PSTRING() << "JsonRaw(\"\\\"" << arg.name << "\\\"\")";
     if (is_custom) {
-      sb << "  jo(\"" << arg.name << "\", ToJson(*" << object << "));\n";
+      sb << "  jo(" << field << ", ToJson(*" << object << "));\n";
     } else if (arg.type->type == tl::simple::Type::Int64 || arg.type->type == tl::simple::Type::Vector) {
-      sb << "  jo(\"" << arg.name << "\", ToJson(" << object << "));\n";
+      sb << "  jo(" << field << ", ToJson(" << object << "));\n";
     } else {
-      sb << "  jo(\"" << arg.name << "\", " << object << ");\n";
+      sb << "  jo(" << field << ", " << object << ");\n";
     }
     if (is_custom) {
       sb << "  }\n";
@@ -96,17 +99,43 @@ void gen_to_json(StringBuilder &sb, const tl::simple::Schema &schema, bool is_he
 
 template <class T>
 void gen_from_json_constructor(StringBuilder &sb, const T *constructor, bool is_header) {
-  sb << "Status from_json(td_api::" << tl::simple::gen_cpp_name(constructor->name) << " &to, JsonObject &from)";
+  sb << "Status from_json(td_api::" << tl::simple::gen_cpp_name(constructor->name)
+     << " &to, JsonObjectStreamParser &from)";
   if (is_header) {
     sb << ";\n\n";
   } else {
     sb << " {\n";
-    for (auto &arg : constructor->args) {
-      sb << "  TRY_STATUS(from_json" << (arg.type->type == tl::simple::Type::Bytes ? "_bytes" : "") << "(to."
-         << tl::simple::gen_cpp_field_name(arg.name) << ", from.extract_field(\"" << tl::simple::gen_cpp_name(arg.name)
-         << "\")));\n";
+    if (constructor->args.empty()) {
+      sb << "  return from.skip_fields();\n";
+    } else {
+      CHECK(constructor->args.size() <= 64);
+      sb << "  static const Slice field_names[] = {";
+      bool is_first = true;
+      for (auto &arg : constructor->args) {
+        if (!is_first) {
+          sb << ", ";
+        }
+        is_first = false;
+        sb << "\"" << tl::simple::gen_cpp_name(arg.name) << "\"";
+      }
+      sb << "};\n";
+      sb << "  while (true) {\n";
+      sb << "    TRY_RESULT(field_index, from.next_field(field_names));\n";
+      sb << "    switch (field_index) {\n";
+      sb << "      case -1:\n";
+      sb << "        return Status::OK();\n";
+      int32 field_index = 0;
+      for (auto &arg : constructor->args) {
+        sb << "      case " << field_index++ << ":\n";
+        sb << "        TRY_STATUS(from.read" << (arg.type->type == tl::simple::Type::Bytes ? "_bytes" : "") << "(to."
+           << tl::simple::gen_cpp_field_name(arg.name) << "));\n";
+        sb << "        break;\n";
+      }
+      sb << "      default:\n";
+      sb << "        UNREACHABLE();\n";
+      sb << "    }\n";
+      sb << "  }\n";
     }
-    sb << "  return Status::OK();\n";
     sb << "}\n\n";
   }
 }
@@ -221,10 +250,14 @@ void gen_json_converter_file(const tl::simple::Schema &schema, const std::string
     sb << "#include <functional>\n\n";
   }
   sb << "namespace td {\n";
+  if (is_header) {
+    sb << "\nclass JsonObjectStreamParser;\n\n";
+  }
   sb << "namespace td_api {\n";
   if (is_header) {
     sb << "\nvoid to_json(JsonValueScope &jv, const tl_object_ptr<Object> &value);\n";
     sb << "\nStatus from_json(tl_object_ptr<Function> &to, td::JsonValue from);\n";
+    sb << "\nStatus from_json(tl_object_ptr<Function> &to, Parser &parser, string &extra);\n";
     sb << "\nvoid to_json(JsonValueScope &jv, const Object &object);\n";
     sb << "\nvoid to_json(JsonValueScope &jv, const Function &object);\n\n";
   } else {
@@ -237,6 +270,11 @@ Status from_json(tl_object_ptr<Function> &to, td::JsonValue from) {
   return td::from_json(to, std::move(from));
 }
 
+Status from_json(tl_object_ptr<Function> &to, Parser &parser, string &extra) {
+  const int32 DEFAULT_MAX_DEPTH = 100;
+  return td::from_json(to, parser, DEFAULT_MAX_DEPTH, &extra);
+}
+
 template <class T>
 auto lazy_to_json(JsonValueScope &jv, const T &t) -> decltype(td_api::to_json(jv, t)) {
   return td_api::to_json(jv, t);
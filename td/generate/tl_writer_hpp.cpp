@@ -19,13 +19,14 @@ bool TD_TL_writer_hpp::is_documentation_generated() const {
 }
 
 int TD_TL_writer_hpp::get_additional_function_type(const std::string &additional_function_name) const {
-  assert(additional_function_name == "downcast_call");
+  assert(additional_function_name == "downcast_call" || additional_function_name == "get_constructor_id");
   return 2;
 }
 
 std::vector<std::string> TD_TL_writer_hpp::get_additional_functions() const {
   std::vector<std::string> additional_functions;
   additional_functions.push_back("downcast_call");
+  additional_functions.push_back("get_constructor_id");
   return additional_functions;
 }
 
@@ -45,7 +46,8 @@ std::string TD_TL_writer_hpp::gen_output_begin(const std::string &additional_imp
          "/**\n"
          " * \\file\n"
          " * Contains downcast_call methods for calling a function object on downcasted to\n"
-         " * the most derived class TDLib API object.\n"
+         " * the most derived class TDLib API object and get_constructor_id methods for\n"
+         " * finding identifiers of TDLib API objects by their names.\n"
          " */\n"
 #endif
          "#include \"" +
@@ -197,7 +199,7 @@ std::string TD_TL_writer_hpp::gen_fetch_switch_end() const {
 
 std::string TD_TL_writer_hpp::gen_additional_function(const std::string &function_name, const tl::tl_combinator *t,
                                                       bool is_function) const {
-  assert(function_name == "downcast_call");
+  assert(function_name == "downcast_call" || function_name == "get_constructor_id");
   return "";
 }
 
@@ -205,6 +207,19 @@ std::string TD_TL_writer_hpp::gen_additional_proxy_function_begin(const std::str
                                                                   const tl::tl_type *type,
                                                                   const std::string &class_name, int arity,
                                                                   bool is_function) const {
+  if (function_name == "get_constructor_id") {
+    return
+#ifndef DISABLE_HPP_DOCUMENTATION
+        "/**\n"
+        " * Returns identifier of the constructor of a class derived from the given class by its name.\n"
+        " * \\param[in] name Name of the constructor.\n"
+        " * \\returns Identifier of the constructor or 0 if there is no constructor with the given name.\n"
+        " */\n"
+#endif
+        "inline std::int32_t get_constructor_id(const " +
+        class_name +
+        " *, const std::string &name) {\n";
+  }
   assert(function_name == "downcast_call");
   return
 #ifndef DISABLE_HPP_DOCUMENTATION
@@ -233,6 +248,9 @@ std::string TD_TL_writer_hpp::gen_additional_proxy_function_case(const std::stri
 std::string TD_TL_writer_hpp::gen_additional_proxy_function_case(const std::string &function_name,
                                                                  const tl::tl_type *type, const tl::tl_combinator *t,
                                                                  int arity, bool is_function) const {
+  if (function_name == "get_constructor_id") {
+    return "  if (name == \"" + t->name + "\") {\n    return " + gen_class_name(t->name) + "::ID;\n  }\n";
+  }
   assert(function_name == "downcast_call");
   return "    case " + gen_class_name(t->name) +
          "::ID:\n"
@@ -244,6 +262,10 @@ std::string TD_TL_writer_hpp::gen_additional_proxy_function_case(const std::stri
 
 std::string TD_TL_writer_hpp::gen_additional_proxy_function_end(const std::string &function_name,
                                                                 const tl::tl_type *type, bool is_function) const {
+  if (function_name == "get_constructor_id") {
+    return "  return 0;\n"
+           "}\n\n";
+  }
   assert(function_name == "downcast_call");
   return "    default:\n"
          "      return false;\n"
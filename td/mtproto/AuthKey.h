@@ -7,9 +7,13 @@
 #pragma once
 
 #include "td/utils/common.h"
+#include "td/utils/crypto.h"
 #include "td/utils/port/Clocks.h"
+#include "td/utils/Slice.h"
 #include "td/utils/Time.h"
 
+#include <memory>
+
 namespace td {
 namespace mtproto {
 
@@ -21,6 +25,7 @@ class AuthKey {
   void break_key() {
     auth_key_id_++;
     auth_key_[0]++;
+    prefix_states_ = nullptr;
   }
 
   bool empty() const {
@@ -32,6 +37,16 @@ class AuthKey {
   uint64 id() const {
     return auth_key_id_;
   }
+
+  // SHA-256 state after substr(auth_key, 88 + X, 32), which is hashed before every message to get msg_key
+  const Sha256State &get_message_key_prefix_state(int X) const {
+    return get_prefix_states().message_key[X == 0 ? 0 : 1];
+  }
+
+  // SHA-256 state after substr(auth_key, 40 + X, 36), which is hashed before msg_key in KDF2
+  const Sha256State &get_kdf_prefix_state(int X) const {
+    return get_prefix_states().kdf[X == 0 ? 0 : 1];
+  }
   bool auth_flag() const {
     return auth_flag_;
   }
@@ -67,6 +82,7 @@ class AuthKey {
   }
   void clear() {
     auth_key_.clear();
+    prefix_states_ = nullptr;
   }
 
   static constexpr int32 AUTH_FLAG = 1;
@@ -106,6 +122,7 @@ class AuthKey {
     auto flags = parser.fetch_int();
     auth_flag_ = (flags & AUTH_FLAG) != 0;
     auth_key_ = parser.template fetch_string<string>();
+    prefix_states_ = nullptr;
     if ((flags & HAS_CREATED_AT) != 0) {
       created_at_ = parser.fetch_double();
     }
@@ -128,6 +145,29 @@ class AuthKey {
   double header_expires_at_{0};
   double expires_at_{0};
   double created_at_{0};
+
+  struct PrefixStates {
+    Sha256State message_key[2];
+    Sha256State kdf[2];
+  };
+  // immutable after creation, so it can be shared between copies of the key
+  mutable std::shared_ptr<const PrefixStates> prefix_states_;
+
+  const PrefixStates &get_prefix_states() const {
+    if (prefix_states_ == nullptr) {
+      auto prefix_states = std::make_shared<PrefixStates>();
+      Slice key(auth_key_);
+      for (int i = 0; i < 2; i++) {
+        int X = i * 8;
+        prefix_states->message_key[i].init();
+        prefix_states->message_key[i].feed(key.substr(88 + X, 32));
+        prefix_states->kdf[i].init();
+        prefix_states->kdf[i].feed(key.substr(40 + X, 36));
+      }
+      prefix_states_ = std::move(prefix_states);
+    }
+    return *prefix_states_;
+  }
 };
 
 }  // namespace mtproto
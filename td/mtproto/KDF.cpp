@@ -10,6 +10,7 @@
 #include "td/utils/common.h"
 #include "td/utils/crypto.h"
 #include "td/utils/logging.h"
+#include "td/utils/port/thread_local.h"
 
 namespace td {
 namespace mtproto {
@@ -71,6 +72,20 @@ void tmp_KDF(const UInt128 &server_nonce, const UInt256 &new_nonce, UInt256 *tmp
   as<uint32>(tmp_aes_iv->raw + 28) = as<uint32>(new_nonce.raw);
 }
 
+static void combine_KDF2_hashes(Slice sha256_a, Slice sha256_b, UInt256 *aes_key, UInt256 *aes_iv) {
+  // aes_key = substr(sha256_a, 0, 8) + substr(sha256_b, 8, 16) + substr(sha256_a, 24, 8);
+  MutableSlice aes_key_slice(aes_key->raw, sizeof(aes_key->raw));
+  aes_key_slice.copy_from(sha256_a.substr(0, 8));
+  aes_key_slice.substr(8).copy_from(sha256_b.substr(8, 16));
+  aes_key_slice.substr(24).copy_from(sha256_a.substr(24, 8));
+
+  // aes_iv = substr(sha256_b, 0, 8) + substr(sha256_a, 8, 16) + substr(sha256_b, 24, 8);
+  MutableSlice aes_iv_slice(aes_iv->raw, sizeof(aes_iv->raw));
+  aes_iv_slice.copy_from(sha256_b.substr(0, 8));
+  aes_iv_slice.substr(8).copy_from(sha256_a.substr(8, 16));
+  aes_iv_slice.substr(24).copy_from(sha256_b.substr(24, 8));
+}
+
 void KDF2(Slice auth_key, const UInt128 &msg_key, int X, UInt256 *aes_key, UInt256 *aes_iv) {
   uint8 buf_raw[36 + 16];
   MutableSlice buf(buf_raw, 36 + 16);
@@ -90,17 +105,31 @@ void KDF2(Slice auth_key, const UInt128 &msg_key, int X, UInt256 *aes_key, UInt2
   MutableSlice sha256_b(sha256_b_raw, 32);
   sha256(buf, sha256_b);
 
-  // aes_key = substr(sha256_a, 0, 8) + substr(sha256_b, 8, 16) + substr(sha256_a, 24, 8);
-  MutableSlice aes_key_slice(aes_key->raw, sizeof(aes_key->raw));
-  aes_key_slice.copy_from(sha256_a.substr(0, 8));
-  aes_key_slice.substr(8).copy_from(sha256_b.substr(8, 16));
-  aes_key_slice.substr(24).copy_from(sha256_a.substr(24, 8));
+  combine_KDF2_hashes(sha256_a, sha256_b, aes_key, aes_iv);
+}
 
-  // aes_iv = substr(sha256_b, 0, 8) + substr(sha256_a, 8, 16) + substr(sha256_b, 24, 8);
-  MutableSlice aes_iv_slice(aes_iv->raw, sizeof(aes_iv->raw));
-  aes_iv_slice.copy_from(sha256_b.substr(0, 8));
-  aes_iv_slice.substr(8).copy_from(sha256_a.substr(8, 16));
-  aes_iv_slice.substr(24).copy_from(sha256_b.substr(24, 8));
+void KDF2(const AuthKey &auth_key, const UInt128 &msg_key, int X, UInt256 *aes_key, UInt256 *aes_iv) {
+  uint8 buf_raw[16 + 36];
+  MutableSlice buf(buf_raw, 16 + 36);
+  Slice msg_key_slice = as_slice(msg_key);
+
+  // sha256_a = SHA256 (msg_key + substr(auth_key, x, 36));
+  buf.copy_from(msg_key_slice);
+  buf.substr(16, 36).copy_from(Slice(auth_key.key()).substr(X, 36));
+  uint8 sha256_a_raw[32];
+  MutableSlice sha256_a(sha256_a_raw, 32);
+  sha256(buf, sha256_a);
+
+  // sha256_b = SHA256 (substr(auth_key, 40+x, 36) + msg_key);
+  static TD_THREAD_LOCAL Sha256State *state;
+  init_thread_local<Sha256State>(state);
+  state->init_from(auth_key.get_kdf_prefix_state(X));
+  state->feed(msg_key_slice);
+  uint8 sha256_b_raw[32];
+  MutableSlice sha256_b(sha256_b_raw, 32);
+  state->extract(sha256_b);
+
+  combine_KDF2_hashes(sha256_a, sha256_b, aes_key, aes_iv);
 }
 
 }  // namespace mtproto
@@ -6,6 +6,8 @@
 //
 #pragma once
 
+#include "td/mtproto/AuthKey.h"
+
 #include "td/utils/Slice.h"
 #include "td/utils/UInt.h"
 
@@ -18,5 +20,8 @@ void tmp_KDF(const UInt128 &server_nonce, const UInt256 &new_nonce, UInt256 *tmp
 
 void KDF2(Slice auth_key, const UInt128 &msg_key, int X, UInt256 *aes_key, UInt256 *aes_iv);
 
+// the same as KDF2, but uses SHA-256 state cached in the auth key
+void KDF2(const AuthKey &auth_key, const UInt128 &msg_key, int X, UInt256 *aes_key, UInt256 *aes_iv);
+
 }  // namespace mtproto
 }  // namespace td
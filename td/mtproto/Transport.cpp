@@ -14,6 +14,7 @@
 #include "td/utils/crypto.h"
 #include "td/utils/format.h"
 #include "td/utils/logging.h"
+#include "td/utils/port/thread_local.h"
 #include "td/utils/Random.h"
 #include "td/utils/SliceBuilder.h"
 #include "td/utils/Status.h"
@@ -147,14 +148,14 @@ size_t Transport::calc_crypto_size(size_t data_size) {
 // MTProto v2.0
 std::pair<uint32, UInt128> Transport::calc_message_key2(const AuthKey &auth_key, int X, Slice to_encrypt) {
   // msg_key_large = SHA256 (substr (auth_key, 88+x, 32) + plaintext + random_padding);
-  Sha256State state;
-  state.init();
-  state.feed(Slice(auth_key.key()).substr(88 + X, 32));
-  state.feed(to_encrypt);
+  static TD_THREAD_LOCAL Sha256State *state;
+  init_thread_local<Sha256State>(state);
+  state->init_from(auth_key.get_message_key_prefix_state(X));
+  state->feed(to_encrypt);
 
   uint8 msg_key_large_raw[32];
   MutableSlice msg_key_large(msg_key_large_raw, sizeof(msg_key_large_raw));
-  state.extract(msg_key_large, true);
+  state->extract(msg_key_large);
 
   // msg_key = substr (msg_key_large, 8, 16);
   UInt128 res;
@@ -235,7 +236,7 @@ Status Transport::read_crypto_impl(int X, MutableSlice message, const AuthKey &a
   if (packet_info->version == 1) {
     KDF(auth_key.key(), header->message_key, X, &aes_key, &aes_iv);
   } else {
-    KDF2(auth_key.key(), header->message_key, X, &aes_key, &aes_iv);
+    KDF2(auth_key, header->message_key, X, &aes_key, &aes_iv);
   }
 
   aes_ige_decrypt(as_slice(aes_key), as_mutable_slice(aes_iv), to_decrypt, to_decrypt);
@@ -359,7 +360,7 @@ void Transport::write_crypto_impl(int X, const Storer &storer, const AuthKey &au
     KDF(auth_key.key(), header->message_key, X, &aes_key, &aes_iv);
   } else {
     std::tie(packet_info->message_ack, header->message_key) = calc_message_key2(auth_key, X, to_encrypt);
-    KDF2(auth_key.key(), header->message_key, X, &aes_key, &aes_iv);
+    KDF2(auth_key, header->message_key, X, &aes_key, &aes_iv);
   }
 
   aes_ige_encrypt(as_slice(aes_key), as_mutable_slice(aes_iv), to_encrypt, to_encrypt);
@@ -26,6 +26,7 @@
 #include "td/utils/Slice.h"
 #include "td/utils/SliceBuilder.h"
 #include "td/utils/StringBuilder.h"
+#include "td/utils/Time.h"
 #include "td/utils/utf8.h"
 
 #include <algorithm>
@@ -171,6 +172,18 @@ class ClientManager::Impl final {
     return response;
   }
 
+  vector<Response> receive_batch(size_t max_count, double timeout) {
+    vector<Response> responses;
+    while (responses.size() < max_count) {
+      auto response = receive(responses.empty() ? timeout : 0.0);
+      if (response.object == nullptr) {
+        break;
+      }
+      responses.push_back(std::move(response));
+    }
+    return responses;
+  }
+
   Impl() = default;
   Impl(const Impl &) = delete;
   Impl &operator=(const Impl &) = delete;
@@ -278,23 +291,35 @@ class TdReceiver {
 
   ClientManager::Response receive(double timeout, bool from_manager) {
     VLOG(td_requests) << "Begin to wait for updates with timeout " << timeout;
-    auto is_locked = receive_lock_.exchange(true);
-    if (is_locked) {
-      if (from_manager) {
-        LOG(FATAL) << "Receive must not be called simultaneously from two different threads, but this has just "
-                      "happened. Call it from a fixed thread, dedicated for updates and response processing.";
-      } else {
-        LOG(FATAL) << "Receive is called after Client destroy, or simultaneously from different threads";
-      }
-    }
+    lock_receive(from_manager);
     auto response = receive_unlocked(clamp(timeout, 0.0, 1000000.0));
-    is_locked = receive_lock_.exchange(false);
-    CHECK(is_locked);
+    unlock_receive();
     VLOG(td_requests) << "End to wait for updates, returning object " << response.request_id << ' '
                       << response.object.get();
     return response;
   }
 
+  void receive_batch(size_t max_count, double timeout, vector<ClientManager::Response> &responses) {
+    VLOG(td_requests) << "Begin to wait for up to " << max_count << " updates with timeout " << timeout;
+    lock_receive(true);
+    auto response = receive_unlocked(clamp(timeout, 0.0, 1000000.0));
+    if (response.client_id != 0 || response.object != nullptr) {
+      responses.push_back(std::move(response));
+      while (responses.size() < max_count) {
+        if (output_queue_ready_cnt_ == 0) {
+          output_queue_ready_cnt_ = output_queue_->reader_wait_nonblock();
+          if (output_queue_ready_cnt_ == 0) {
+            break;
+          }
+        }
+        output_queue_ready_cnt_--;
+        responses.push_back(output_queue_->reader_get_unsafe());
+      }
+    }
+    unlock_receive();
+    VLOG(td_requests) << "End to wait for updates, returning " << responses.size() << " objects";
+  }
+
   unique_ptr<TdCallback> create_callback(ClientManager::ClientId client_id) {
     class Callback final : public TdCallback {
      public:
@@ -332,6 +357,23 @@ class TdReceiver {
   int output_queue_ready_cnt_{0};
   std::atomic<bool> receive_lock_{false};
 
+  void lock_receive(bool from_manager) {
+    auto is_locked = receive_lock_.exchange(true);
+    if (is_locked) {
+      if (from_manager) {
+        LOG(FATAL) << "Receive must not be called simultaneously from two different threads, but this has just "
+                      "happened. Call it from a fixed thread, dedicated for updates and response processing.";
+      } else {
+        LOG(FATAL) << "Receive is called after Client destroy, or simultaneously from different threads";
+      }
+    }
+  }
+
+  void unlock_receive() {
+    auto is_locked = receive_lock_.exchange(false);
+    CHECK(is_locked);
+  }
+
   ClientManager::Response receive_unlocked(double timeout) {
     if (output_queue_ready_cnt_ == 0) {
       output_queue_ready_cnt_ = output_queue_->reader_wait_nonblock();
@@ -352,8 +394,9 @@ class MultiImpl {
  public:
   static constexpr int32 ADDITIONAL_THREAD_COUNT = 3;
 
-  explicit MultiImpl(std::shared_ptr<NetQueryStats> net_query_stats) {
-    concurrent_scheduler_ = std::make_shared<ConcurrentScheduler>(ADDITIONAL_THREAD_COUNT, 0);
+  MultiImpl(std::shared_ptr<NetQueryStats> net_query_stats, int32 additional_thread_count,
+            uint64 thread_affinity_mask) {
+    concurrent_scheduler_ = std::make_shared<ConcurrentScheduler>(additional_thread_count, thread_affinity_mask);
     concurrent_scheduler_->start();
 
     {
@@ -363,7 +406,14 @@ class MultiImpl {
       multi_td_ = create_actor<MultiTd>("MultiTd", std::move(options));
     }
 
-    scheduler_thread_ = thread([concurrent_scheduler = concurrent_scheduler_] {
+    scheduler_thread_ = thread([concurrent_scheduler = concurrent_scheduler_, thread_affinity_mask] {
+#if TD_HAVE_THREAD_AFFINITY
+      if (thread_affinity_mask != 0) {
+        thread::set_affinity_mask(this_thread::get_id(), thread_affinity_mask).ignore();
+      }
+#else
+      (void)thread_affinity_mask;
+#endif
       while (concurrent_scheduler->run_main(10)) {
       }
     });
@@ -399,6 +449,29 @@ class MultiImpl {
     send_closure(multi_td_, &MultiTd::close, client_id);
   }
 
+  // returns the number of events per second recently processed by the schedulers of the instance
+  // must be called only by the owning MultiImplPool under its lock
+  double get_load(double now) {
+    if (now >= last_load_update_time_ + LOAD_UPDATE_PERIOD) {
+      auto event_count = concurrent_scheduler_->get_processed_event_count();
+      auto load = static_cast<double>(event_count - last_event_count_) / (now - last_load_update_time_);
+      load_ = load_ == 0.0 ? load : (load_ + load) * 0.5;
+      last_event_count_ = event_count;
+      last_load_update_time_ = now;
+      placed_client_count_ = 0;
+    }
+    return load_;
+  }
+
+  // the number of clients placed to the instance since the last load update
+  int32 get_placed_client_count() const {
+    return placed_client_count_;
+  }
+
+  void on_client_placed() {
+    placed_client_count_++;
+  }
+
   ~MultiImpl() {
     {
       auto guard = concurrent_scheduler_->get_send_guard();
@@ -418,35 +491,106 @@ class MultiImpl {
   thread scheduler_thread_;
   ActorOwn<MultiTd> multi_td_;
 
+  static constexpr double LOAD_UPDATE_PERIOD = 1.0;
+  double load_ = 0.0;
+  double last_load_update_time_ = Time::now();
+  uint64 last_event_count_ = 0;
+  int32 placed_client_count_ = 0;
+
   static std::atomic<uint32> current_id_;
 };
 
 constexpr int32 MultiImpl::ADDITIONAL_THREAD_COUNT;
+constexpr double MultiImpl::LOAD_UPDATE_PERIOD;
 std::atomic<uint32> MultiImpl::current_id_{1};
 
 class MultiImplPool {
  public:
+  static bool set_thread_topology(int32 instance_count, int32 thread_count, uint64 thread_affinity_mask) {
+    if (instance_count < 0 || thread_count < 0) {
+      return false;
+    }
+    auto &topology = get_thread_topology();
+    std::lock_guard<std::mutex> lock(topology.mutex);
+    if (topology.active_pool_count != 0) {
+      return false;
+    }
+    auto additional_thread_count = thread_count == 0 ? MultiImpl::ADDITIONAL_THREAD_COUNT : thread_count - 1;
+    // if the number of instances is chosen automatically, then at least one instance must fit
+    if (!check_thread_count(td::max(instance_count, 1), additional_thread_count)) {
+      return false;
+    }
+    topology.instance_count = instance_count;
+    topology.additional_thread_count = additional_thread_count;
+    topology.thread_affinity_mask = thread_affinity_mask;
+    return true;
+  }
+
   std::shared_ptr<MultiImpl> get() {
     std::unique_lock<std::mutex> lock(mutex_);
     if (impls_.empty()) {
       init_openssl_threads();
 
-      auto max_client_threads = clamp(thread::hardware_concurrency(), 8u, 20u) * 5 / 4;
+      auto &topology = get_thread_topology();
+      std::lock_guard<std::mutex> topology_lock(topology.mutex);
+      topology.active_pool_count++;
+      additional_thread_count_ = topology.additional_thread_count;
+      thread_affinity_mask_ = topology.thread_affinity_mask;
+
+      auto max_client_threads = static_cast<uint32>(topology.instance_count);
+      if (max_client_threads == 0) {
+        max_client_threads = clamp(thread::hardware_concurrency(), 8u, 20u) * 5 / 4;
 #if TD_OPENBSD
-      max_client_threads = td::min(max_client_threads, 4u);
+        max_client_threads = td::min(max_client_threads, 4u);
 #endif
+        while (max_client_threads > 1 &&
+               !check_thread_count(static_cast<int32>(max_client_threads), additional_thread_count_)) {
+          max_client_threads--;
+        }
+      }
       impls_.resize(max_client_threads);
-      CHECK(impls_.size() * (1 + MultiImpl::ADDITIONAL_THREAD_COUNT + 1 /* IOCP */) < 128);
+      CHECK(check_thread_count(static_cast<int32>(impls_.size()), additional_thread_count_));
 
       net_query_stats_ = std::make_shared<NetQueryStats>();
     }
-    auto &impl = *std::min_element(impls_.begin(), impls_.end(),
-                                   [](auto &a, auto &b) { return a.lock().use_count() < b.lock().use_count(); });
-    auto result = impl.lock();
+
+    // place the client to an unused instance if any, or to the instance with the smallest expected load otherwise;
+    // clients, which were placed after the last load update, are expected to produce average load
+    auto now = Time::now();
+    vector<std::shared_ptr<MultiImpl>> impls;
+    impls.reserve(impls_.size());
+    double total_load = 0.0;
+    int64 total_client_count = 0;
+    for (auto &impl : impls_) {
+      impls.push_back(impl.lock());
+      if (impls.back() != nullptr) {
+        total_load += impls.back()->get_load(now);
+        total_client_count += impls.back().use_count() - 1;
+      }
+    }
+    auto client_load =
+        td::max(total_load / static_cast<double>(td::max(total_client_count, static_cast<int64>(1))), 1.0);
+
+    size_t best_pos = 0;
+    double best_load = 0.0;
+    for (size_t i = 0; i < impls.size(); i++) {
+      if (impls[i] == nullptr) {
+        best_pos = i;
+        break;
+      }
+      auto load = impls[i]->get_load(now) + impls[i]->get_placed_client_count() * client_load;
+      if (i == 0 || load < best_load || (load == best_load && impls[i].use_count() < impls[best_pos].use_count())) {
+        best_pos = i;
+        best_load = load;
+      }
+    }
+
+    auto result = std::move(impls[best_pos]);
     if (!result) {
-      result = std::make_shared<MultiImpl>(net_query_stats_);
-      impl = result;
+      result = std::make_shared<MultiImpl>(net_query_stats_, additional_thread_count_, thread_affinity_mask_);
+      impls_[best_pos] = result;
     }
+    result->on_client_placed();
     return result;
   }
 
@@ -461,17 +605,45 @@ class MultiImplPool {
         return;
       }
     }
+    if (net_query_stats_.use_count() != 1) {
+      // the last MultiImpl is still being destroyed in another thread, which will call try_clear after that
+      return;
+    }
     reset_to_empty(impls_);
 
-    CHECK(net_query_stats_.use_count() == 1);
     CHECK(net_query_stats_->get_count() == 0);
     net_query_stats_ = nullptr;
+
+    auto &topology = get_thread_topology();
+    std::lock_guard<std::mutex> topology_lock(topology.mutex);
+    CHECK(topology.active_pool_count > 0);
+    topology.active_pool_count--;
   }
 
  private:
   std::mutex mutex_;
   std::vector<std::weak_ptr<MultiImpl>> impls_;
   std::shared_ptr<NetQueryStats> net_query_stats_;
+  int32 additional_thread_count_ = MultiImpl::ADDITIONAL_THREAD_COUNT;
+  uint64 thread_affinity_mask_ = 0;
+
+  struct ThreadTopology {
+    std::mutex mutex;
+    int32 active_pool_count = 0;
+    int32 instance_count = 0;  // 0 means default
+    int32 additional_thread_count = MultiImpl::ADDITIONAL_THREAD_COUNT;
+    uint64 thread_affinity_mask = 0;
+  };
+
+  static ThreadTopology &get_thread_topology() {
+    static ThreadTopology topology;
+    return topology;
+  }
+
+  static bool check_thread_count(int32 instance_count, int32 additional_thread_count) {
+    // ThreadLocalStorage supports at most 128 threads
+    return static_cast<int64>(instance_count) * (1 + additional_thread_count + 1 /* IOCP */) < 128;
+  }
 };
 
 class ClientManager::Impl final {
@@ -517,6 +689,36 @@ class ClientManager::Impl final {
 
   Response receive(double timeout) {
     auto response = receiver_.receive(timeout, true);
+    process_response(response);
+    return response;
+  }
+
+  vector<Response> receive_batch(size_t max_count, double timeout) {
+    vector<Response> responses;
+    auto deadline = Time::now() + clamp(timeout, 0.0, 1000000.0);
+    while (true) {
+      receiver_.receive_batch(max_count, timeout, responses);
+      size_t result_count = 0;
+      for (auto &response : responses) {
+        process_response(response);
+        if (response.object != nullptr) {
+          if (&responses[result_count] != &response) {
+            responses[result_count] = std::move(response);
+          }
+          result_count++;
+        }
+      }
+      responses.resize(result_count);
+
+      // if only internal responses were received, then wait for other responses until the timeout expires
+      timeout = deadline - Time::now();
+      if (!responses.empty() || timeout <= 0.0) {
+        return responses;
+      }
+    }
+  }
+
+  void process_response(Response &response) {
     if (response.request_id == 0 && response.object != nullptr &&
         response.object->get_id() == td_api::updateAuthorizationState::ID &&
         static_cast<const td_api::updateAuthorizationState *>(response.object.get())->authorization_state_->get_id() ==
@@ -542,7 +744,6 @@ class ClientManager::Impl final {
         pool_.try_clear();
       }
     }
-    return response;
   }
 
   void close_impl(ClientId client_id) {
@@ -589,8 +790,7 @@ class ClientManager::Impl final {
 class Client::Impl final {
  public:
   Impl() {
-    static MultiImplPool pool;
-    multi_impl_ = pool.get();
+    multi_impl_ = get_pool().get();
     td_id_ = MultiImpl::create_id();
     multi_impl_->create(td_id_, receiver_.create_callback(td_id_));
   }
@@ -625,12 +825,20 @@ class Client::Impl final {
         break;
       }
     }
+    // allow to change thread topology after all clients are closed
+    multi_impl_ = nullptr;
+    get_pool().try_clear();
   }
 
  private:
   std::shared_ptr<MultiImpl> multi_impl_;
   TdReceiver receiver_;
 
+  static MultiImplPool &get_pool() {
+    static MultiImplPool pool;
+    return pool;
+  }
+
   int32 td_id_;
 };
 #endif
@@ -672,6 +880,19 @@ ClientManager::Response ClientManager::receive(double timeout) {
   return impl_->receive(timeout);
 }
 
+std::vector<ClientManager::Response> ClientManager::receive_batch(std::size_t max_count, double timeout) {
+  CHECK(max_count > 0);
+  return impl_->receive_batch(max_count, timeout);
+}
+
+bool ClientManager::set_thread_topology(int instance_count, int thread_count, std::uint64_t thread_affinity_mask) {
+#if TD_THREAD_UNSUPPORTED || TD_EVENTFD_UNSUPPORTED
+  return false;
+#else
+  return MultiImplPool::set_thread_topology(instance_count, thread_count, thread_affinity_mask);
+#endif
+}
+
 td_api::object_ptr<td_api::Object> ClientManager::execute(td_api::object_ptr<td_api::Function> &&request) {
   return Td::static_request(std::move(request));
 }
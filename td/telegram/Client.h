@@ -11,8 +11,10 @@
 #include "td/telegram/td_api.h"
 #include "td/telegram/td_api.hpp"
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace td {
 
@@ -115,6 +117,17 @@ class ClientManager final {
    */
   Response receive(double timeout);
 
+  /**
+   * Receives multiple incoming updates and responses to requests from TDLib at once. Waits only for the first response,
+   * then returns all immediately available responses up to the specified limit. May be called from any thread, but
+   * must not be called simultaneously from two different threads or simultaneously with the method receive.
+   * \param[in] max_count The maximum number of responses to return; must be positive.
+   * \param[in] timeout The maximum number of seconds allowed for this function to wait for new data.
+   * \return Incoming updates and responses to requests in the order they were received. The vector is empty
+   *         if the timeout expires.
+   */
+  std::vector<Response> receive_batch(std::size_t max_count, double timeout);
+
   /**
    * Synchronously executes a TDLib request.
    * A request can be executed synchronously, only if it is documented with "Can be called synchronously".
@@ -123,6 +136,20 @@ class ClientManager final {
    */
   static td_api::object_ptr<td_api::Object> execute(td_api::object_ptr<td_api::Function> &&request);
 
+  /**
+   * Changes the layout of internal threads, which are used by TDLib client instances.
+   * TDLib client instances are distributed among a pool of instance groups, each having its own set of threads.
+   * The topology can be changed only while there are no active TDLib client instances, i.e., before the first request
+   * is sent to the first instance, or after all instances are closed.
+   * \param[in] instance_count The number of instance groups; pass 0 to choose it based on the number of CPU cores.
+   * \param[in] thread_count The number of threads in each instance group; pass 0 to use the default value of 4.
+   *                         If at least 5 threads are used, then the additional thread is dedicated to database reads.
+   * \param[in] thread_affinity_mask CPU affinity mask for all threads; pass 0 to not change thread affinity.
+   * \return True, if the topology was changed; false, if there are active instances or the topology is unsupported.
+   *         The total number of threads must be less than 128.
+   */
+  static bool set_thread_topology(int instance_count, int thread_count, std::uint64_t thread_affinity_mask);
+
   /**
    * A type of callback function that will be called when a message is added to the internal TDLib log.
    *
@@ -48,4 +48,12 @@ uint64 get_pending_network_query_count(NetQueryStats &stats) {
   return stats.get_count();
 }
 
+uint64 get_deduplicated_network_query_count(NetQueryStats &stats) {
+  return stats.get_deduplicated_query_count();
+}
+
+uint64 get_deduplicated_network_answer_size(NetQueryStats &stats) {
+  return stats.get_deduplicated_answer_size();
+}
+
 }  // namespace td
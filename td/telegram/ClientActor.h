@@ -105,4 +105,16 @@ void dump_pending_network_queries(NetQueryStats &stats);
  */
 uint64 get_pending_network_query_count(NetQueryStats &stats);
 
+/**
+ * Returns the number of network queries, which were completed with the result of an identical simultaneous query.
+ * \return Number of deduplicated network queries.
+ */
+uint64 get_deduplicated_network_query_count(NetQueryStats &stats);
+
+/**
+ * Returns the total size of answers received for deduplicated network queries without sending them.
+ * \return Total size of answers to deduplicated network queries in bytes.
+ */
+uint64 get_deduplicated_network_answer_size(NetQueryStats &stats);
+
 }  // namespace td
@@ -12,11 +12,12 @@
 #include "td/utils/common.h"
 #include "td/utils/FlatHashMap.h"
 #include "td/utils/JsonBuilder.h"
+#include "td/utils/Parser.h"
 #include "td/utils/port/thread_local.h"
 #include "td/utils/SliceBuilder.h"
-#include "td/utils/StackAllocator.h"
 #include "td/utils/StringBuilder.h"
 
+#include <cstring>
 #include <utility>
 
 namespace td {
@@ -26,7 +27,7 @@ static td_api::object_ptr<td_api::Function> get_return_error_function(Slice erro
   return td_api::make_object<td_api::testReturnError>(std::move(error));
 }
 
-static std::pair<td_api::object_ptr<td_api::Function>, string> to_request(Slice request) {
+static std::pair<td_api::object_ptr<td_api::Function>, string> to_request_slow(Slice request) {
   auto request_str = request.str();
   auto r_json_value = json_decode(request_str);
   if (r_json_value.is_error()) {
@@ -53,9 +54,25 @@ static std::pair<td_api::object_ptr<td_api::Function>, string> to_request(Slice
   return std::make_pair(std::move(func), std::move(extra));
 }
 
-static string from_response(const td_api::Object &object, const string &extra, int client_id) {
-  auto buf = StackAllocator::alloc(1 << 18);
-  JsonBuilder jb(StringBuilder(buf.as_slice(), true), -1);
+static std::pair<td_api::object_ptr<td_api::Function>, string> to_request(Slice request) {
+  // the request is parsed directly to a td_api object in one pass;
+  // in case of an error the request is parsed again through a JsonValue tree to get a detailed error message
+  auto request_str = request.str();
+  Parser parser(request_str);
+  td_api::object_ptr<td_api::Function> func;
+  string extra;
+  auto status = from_json(func, parser, extra);
+  if (status.is_error() || func == nullptr) {
+    return to_request_slow(request);
+  }
+  parser.skip_whitespaces();
+  if (!parser.empty()) {
+    return to_request_slow(request);
+  }
+  return std::make_pair(std::move(func), std::move(extra));
+}
+
+static void append_response(JsonBuilder &jb, const td_api::Object &object, const string &extra, int client_id) {
   jb.enter_value() << ToJson(object);
   auto &sb = jb.string_builder();
   auto slice = sb.as_cslice();
@@ -68,15 +85,31 @@ static string from_response(const td_api::Object &object, const string &extra, i
     sb << ",\"@client_id\":" << client_id;
   }
   sb << '}';
-  return sb.as_cslice().str();
 }
 
 static TD_THREAD_LOCAL string *current_output;
 
-static const char *store_string(string str) {
+// JSON is written directly to a reusable per-thread buffer, which grows to fit the written response;
+// a buffer that has grown too big is freed on the next call, when the previous response can no longer be used
+template <class F>
+static const char *store_json(F &&write_json) {
+  constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 14;
+  constexpr size_t MAX_REUSED_BUFFER_SIZE = 1 << 18;
   init_thread_local<string>(current_output);
-  *current_output = std::move(str);
-  return current_output->c_str();
+  auto &output = *current_output;
+  if (output.size() < DEFAULT_BUFFER_SIZE || output.size() > MAX_REUSED_BUFFER_SIZE) {
+    string(DEFAULT_BUFFER_SIZE, '\0').swap(output);
+  }
+  JsonBuilder jb(StringBuilder(MutableSlice(&output[0], output.size()), true), -1);
+  write_json(jb);
+  auto result = jb.string_builder().as_cslice();
+  if (result.begin() != output.data()) {
+    // the buffer was too small and the StringBuilder has allocated a new one
+    string new_output(result.size() * 2, '\0');
+    std::memcpy(&new_output[0], result.begin(), result.size() + 1);
+    output = std::move(new_output);
+  }
+  return output.data();
 }
 
 void ClientJson::send(Slice request) {
@@ -104,13 +137,13 @@ const char *ClientJson::receive(double timeout) {
       extra_.erase(it);
     }
   }
-  return store_string(from_response(*response.object, extra, 0));
+  return store_json([&](JsonBuilder &jb) { append_response(jb, *response.object, extra, 0); });
 }
 
 const char *ClientJson::execute(Slice request) {
   auto parsed_request = to_request(request);
-  return store_string(from_response(*Client::execute(Client::Request{0, std::move(parsed_request.first)}).object,
-                                    parsed_request.second, 0));
+  auto response = Client::execute(Client::Request{0, std::move(parsed_request.first)});
+  return store_json([&](JsonBuilder &jb) { append_response(jb, *response.object, parsed_request.second, 0); });
 }
 
 static ClientManager *get_manager() {
@@ -150,13 +183,45 @@ const char *json_receive(double timeout) {
       extra.erase(it);
     }
   }
-  return store_string(from_response(*response.object, extra_str, response.client_id));
+  return store_json([&](JsonBuilder &jb) { append_response(jb, *response.object, extra_str, response.client_id); });
+}
+
+const char *json_receive_batch(int max_count, double timeout) {
+  auto responses = get_manager()->receive_batch(static_cast<size_t>(td::max(max_count, 1)), timeout);
+  if (responses.empty()) {
+    return nullptr;
+  }
+
+  vector<string> extra_strs(responses.size());
+  {
+    std::lock_guard<std::mutex> guard(extra_mutex);
+    for (size_t i = 0; i < responses.size(); i++) {
+      if (responses[i].request_id != 0) {
+        auto it = extra.find(responses[i].request_id);
+        if (it != extra.end()) {
+          extra_strs[i] = std::move(it->second);
+          extra.erase(it);
+        }
+      }
+    }
+  }
+
+  return store_json([&](JsonBuilder &jb) {
+    jb.string_builder() << '[';
+    for (size_t i = 0; i < responses.size(); i++) {
+      if (i != 0) {
+        jb.string_builder() << ',';
+      }
+      append_response(jb, *responses[i].object, extra_strs[i], responses[i].client_id);
+    }
+    jb.string_builder() << ']';
+  });
 }
 
 const char *json_execute(Slice request) {
   auto parsed_request = to_request(request);
-  return store_string(
-      from_response(*ClientManager::execute(std::move(parsed_request.first)), parsed_request.second, 0));
+  auto response = ClientManager::execute(std::move(parsed_request.first));
+  return store_json([&](JsonBuilder &jb) { append_response(jb, *response, parsed_request.second, 0); });
 }
 
 }  // namespace td
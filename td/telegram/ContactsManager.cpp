@@ -2475,7 +2475,9 @@ class GetFullUserQuery final : public Td::ResultHandler {
   }
 
   void send(tl_object_ptr<telegram_api::InputUser> &&input_user) {
-    send_query(G()->net_query_creator().create(telegram_api::users_getFullUser(std::move(input_user))));
+    auto net_query = G()->net_query_creator().create(telegram_api::users_getFullUser(std::move(input_user)));
+    net_query->can_be_deduplicated_ = true;
+    send_query(std::move(net_query));
   }
 
   void on_result(BufferSlice packet) final {
@@ -2685,7 +2687,9 @@ class GetFullChannelQuery final : public Td::ResultHandler {
 
   void send(ChannelId channel_id, tl_object_ptr<telegram_api::InputChannel> &&input_channel) {
     channel_id_ = channel_id;
-    send_query(G()->net_query_creator().create(telegram_api::channels_getFullChannel(std::move(input_channel))));
+    auto net_query = G()->net_query_creator().create(telegram_api::channels_getFullChannel(std::move(input_channel)));
+    net_query->can_be_deduplicated_ = true;
+    send_query(std::move(net_query));
   }
 
   void on_result(BufferSlice packet) final {
@@ -2925,9 +2929,11 @@ void ContactsManager::on_user_online_timeout(UserId user_id) {
   CHECK(u->is_update_user_sent);
 
   LOG(INFO) << "Update " << user_id << " online status to offline";
-  send_closure(G()->td(), &Td::send_update,
-               td_api::make_object<td_api::updateUserStatus>(user_id.get(),
-                                                             get_user_status_object(user_id, u, G()->unix_time())));
+  if (td_->is_update_type_enabled(td_api::updateUserStatus::ID)) {
+    send_closure(G()->td(), &Td::send_update,
+                 td_api::make_object<td_api::updateUserStatus>(user_id.get(),
+                                                               get_user_status_object(user_id, u, G()->unix_time())));
+  }
 
   td_->dialog_participant_manager_->update_user_online_member_count(user_id);
 }
@@ -10195,9 +10201,11 @@ void ContactsManager::update_user(User *u, UserId user_id, bool from_binlog, boo
       u->is_status_saved = false;
     }
     CHECK(u->is_update_user_sent);
-    send_closure(
-        G()->td(), &Td::send_update,
-        make_tl_object<td_api::updateUserStatus>(user_id.get(), get_user_status_object(user_id, u, unix_time)));
+    if (td_->is_update_type_enabled(td_api::updateUserStatus::ID)) {
+      send_closure(
+          G()->td(), &Td::send_update,
+          make_tl_object<td_api::updateUserStatus>(user_id.get(), get_user_status_object(user_id, u, unix_time)));
+    }
     u->is_status_changed = false;
   }
   if (u->is_online_status_changed) {
@@ -16,6 +16,7 @@
 #include "td/actor/SchedulerLocalStorage.h"
 
 #include "td/utils/common.h"
+#include "td/utils/FlatHashSet.h"
 #include "td/utils/format.h"
 #include "td/utils/logging.h"
 #include "td/utils/misc.h"
@@ -23,6 +24,9 @@
 #include "td/utils/SliceBuilder.h"
 #include "td/utils/Time.h"
 
+#include <unordered_map>
+#include <utility>
+
 namespace td {
 // NB: must happen inside a transaction
 Status init_dialog_db(SqliteDb &db, int32 version, KeyValueSyncInterface &binlog_pmc, bool &was_created) {
@@ -168,6 +172,7 @@ class DialogDbImpl final : public DialogDbSyncInterface {
     }
 
     add_dialog_stmt_.step().ensure();
+    on_dialog_changed(dialog_id, folder_id, order);
 
     for (auto &to_add : notification_groups) {
       if (to_add.dialog_id.is_valid()) {
@@ -229,26 +234,46 @@ class DialogDbImpl final : public DialogDbSyncInterface {
   }
 
   DialogDbGetDialogsResult get_dialogs(FolderId folder_id, int64 order, DialogId dialog_id, int32 limit) final {
-    SCOPE_EXIT {
-      get_dialogs_stmt_.reset();
-    };
-
-    get_dialogs_stmt_.bind_int32(1, folder_id.get()).ensure();
-    get_dialogs_stmt_.bind_int64(2, order).ensure();
-    get_dialogs_stmt_.bind_int64(3, dialog_id.get()).ensure();
-    get_dialogs_stmt_.bind_int32(4, limit).ensure();
-
     DialogDbGetDialogsResult result;
     result.next_dialog_id = dialog_id;
     result.next_order = order;
-    get_dialogs_stmt_.step().ensure();
-    while (get_dialogs_stmt_.has_row()) {
-      BufferSlice data(get_dialogs_stmt_.view_blob(0));
-      result.next_dialog_id = DialogId(get_dialogs_stmt_.view_int64(1));
-      result.next_order = get_dialogs_stmt_.view_int64(2);
+    if (limit <= 0) {
+      return result;
+    }
+
+    DialogPosition position(order, dialog_id.get());
+    auto folder_it = folder_caches_.find(folder_id);
+    if (folder_it == folder_caches_.end() || folder_it->second.begin != position) {
+      // the request doesn't continue the previous one
+      if (folder_it != folder_caches_.end()) {
+        folder_caches_.erase(folder_it);
+      }
+      folder_it = folder_caches_.emplace(folder_id, FolderCache()).first;
+      folder_it->second.begin = position;
+      folder_it->second.end = position;
+      folder_it->second.next_chunk_size = limit;
+    }
+    auto &folder_cache = folder_it->second;
+
+    while (static_cast<int32>(result.dialogs.size()) < limit) {
+      if (folder_cache.next_dialog == folder_cache.dialogs.size()) {
+        if (folder_cache.is_complete) {
+          break;
+        }
+        load_folder_cache_chunk(folder_id, folder_cache);
+        continue;
+      }
+      auto &dialog = folder_cache.dialogs[folder_cache.next_dialog++];
+      folder_cache.begin = dialog.position;
+      folder_cache.dialog_ids.erase(DialogId(dialog.position.second));
+      result.next_dialog_id = DialogId(dialog.position.second);
+      result.next_order = dialog.position.first;
       LOG(INFO) << "Load " << result.next_dialog_id << " with order " << result.next_order;
-      result.dialogs.emplace_back(std::move(data));
-      get_dialogs_stmt_.step().ensure();
+      result.dialogs.push_back(std::move(dialog.data));
+    }
+    if (static_cast<int32>(result.dialogs.size()) < limit) {
+      // all chats have been returned
+      folder_caches_.erase(folder_id);
     }
 
     return result;
@@ -299,6 +324,77 @@ class DialogDbImpl final : public DialogDbSyncInterface {
   SqliteStatement get_notification_group_stmt_;
   SqliteStatement get_secret_chat_count_stmt_;
 
+  // (order, dialog_id); get_dialogs_stmt_ returns chats in descending order of their positions
+  using DialogPosition = std::pair<int64, int64>;
+
+  struct CachedDialog {
+    DialogPosition position;
+    BufferSlice data;
+  };
+
+  // chats, which are loaded in advance for the next get_dialogs request continuing the previous one;
+  // the cache contains all chats of the folder with positions less than begin and not less than end,
+  // or all chats with positions less than begin if the cache is complete
+  struct FolderCache {
+    DialogPosition begin;  // position of the last returned chat
+    DialogPosition end;    // position of the last loaded chat
+    bool is_complete = false;
+    int32 next_chunk_size = 0;
+    vector<CachedDialog> dialogs;
+    size_t next_dialog = 0;                          // index of the first chat, which wasn't returned yet
+    FlatHashSet<DialogId, DialogIdHash> dialog_ids;  // identifiers of the chats, which weren't returned yet
+  };
+  std::unordered_map<FolderId, FolderCache, FolderIdHash> folder_caches_;
+
+  static constexpr int32 MAX_DIALOG_CACHE_CHUNK_SIZE = 500;
+
+  void load_folder_cache_chunk(FolderId folder_id, FolderCache &folder_cache) {
+    SCOPE_EXIT {
+      get_dialogs_stmt_.reset();
+    };
+
+    // all previously loaded chats have been returned
+    folder_cache.dialogs.clear();
+    folder_cache.next_dialog = 0;
+
+    auto chunk_size = folder_cache.next_chunk_size;
+    get_dialogs_stmt_.bind_int32(1, folder_id.get()).ensure();
+    get_dialogs_stmt_.bind_int64(2, folder_cache.end.first).ensure();
+    get_dialogs_stmt_.bind_int64(3, folder_cache.end.second).ensure();
+    get_dialogs_stmt_.bind_int32(4, chunk_size).ensure();
+
+    get_dialogs_stmt_.step().ensure();
+    while (get_dialogs_stmt_.has_row()) {
+      DialogPosition position(get_dialogs_stmt_.view_int64(2), get_dialogs_stmt_.view_int64(1));
+      folder_cache.dialogs.push_back({position, BufferSlice(get_dialogs_stmt_.view_blob(0))});
+      folder_cache.dialog_ids.insert(DialogId(position.second));
+      folder_cache.end = position;
+      get_dialogs_stmt_.step().ensure();
+    }
+    if (static_cast<int32>(folder_cache.dialogs.size()) < chunk_size) {
+      folder_cache.is_complete = true;
+    }
+    // the first chunk is as big as the first request to not slow it down
+    if (chunk_size < MAX_DIALOG_CACHE_CHUNK_SIZE) {
+      folder_cache.next_chunk_size = min(2 * chunk_size, MAX_DIALOG_CACHE_CHUNK_SIZE);
+    }
+  }
+
+  void on_dialog_changed(DialogId dialog_id, FolderId folder_id, int64 order) {
+    DialogPosition position(order, dialog_id.get());
+    for (auto it = folder_caches_.begin(); it != folder_caches_.end();) {
+      const auto &folder_cache = it->second;
+      if (folder_cache.dialog_ids.count(dialog_id) != 0 ||
+          (order > 0 && it->first == folder_id && position < folder_cache.begin &&
+           (folder_cache.is_complete || !(position < folder_cache.end)))) {
+        // the old or the new position of the chat is covered by the cache
+        it = folder_caches_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
   static int32 get_last_notification_date(SqliteStatement &stmt, int id) {
     if (stmt.view_datatype(id) == SqliteStatement::Datatype::Null) {
       return 0;
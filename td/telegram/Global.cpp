@@ -30,6 +30,10 @@ Global::Global() {
   database_scheduler_id_ = min(current_scheduler_id + 1, max_scheduler_id);
   gc_scheduler_id_ = min(current_scheduler_id + 2, max_scheduler_id);
   slow_net_scheduler_id_ = min(current_scheduler_id + 3, max_scheduler_id);
+  // a scheduler for database reads exists only if more threads than the default number of threads are used
+  if (current_scheduler_id + 4 <= max_scheduler_id) {
+    database_reader_scheduler_id_ = current_scheduler_id + 4;
+  }
 }
 
 Global::~Global() = default;
@@ -533,6 +533,11 @@ class Global final : public ActorContext {
     return slow_net_scheduler_id_;
   }
 
+  // returns -1 if there is no scheduler dedicated to database reads
+  int32 get_database_reader_scheduler_id() const {
+    return database_reader_scheduler_id_;
+  }
+
   DcId get_webfile_dc_id() const;
 
   std::shared_ptr<DhConfig> get_dh_config() {
@@ -670,6 +675,7 @@ class Global final : public ActorContext {
   int32 database_scheduler_id_ = 0;
   int32 gc_scheduler_id_ = 0;
   int32 slow_net_scheduler_id_ = 0;
+  int32 database_reader_scheduler_id_ = -1;
 
   std::atomic<bool> store_all_files_in_files_directory_{false};
 
@@ -15,6 +15,7 @@
 #include "td/db/SqliteStatement.h"
 
 #include "td/actor/actor.h"
+#include "td/actor/MultiPromise.h"
 #include "td/actor/SchedulerLocalStorage.h"
 
 #include "td/utils/format.h"
@@ -187,6 +188,15 @@ class MessageDbImpl final : public MessageDbSyncInterface {
     TRY_RESULT_ASSIGN(
         add_message_stmt_,
         db_.get_statement("INSERT OR REPLACE INTO messages VALUES(?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11, ?12)"));
+    string add_messages_query = "INSERT OR REPLACE INTO messages VALUES";
+    for (size_t i = 0; i < ADD_MESSAGES_BATCH_SIZE; i++) {
+      add_messages_query += i == 0 ? "(" : ", (";
+      for (size_t j = 1; j <= MESSAGE_COLUMN_COUNT; j++) {
+        add_messages_query += PSTRING() << (j == 1 ? "?" : ", ?") << i * MESSAGE_COLUMN_COUNT + j;
+      }
+      add_messages_query += ')';
+    }
+    TRY_RESULT_ASSIGN(add_messages_stmt_, db_.get_statement(add_messages_query));
     TRY_RESULT_ASSIGN(delete_message_stmt_,
                       db_.get_statement("DELETE FROM messages WHERE dialog_id = ?1 AND message_id = ?2"));
     TRY_RESULT_ASSIGN(delete_all_dialog_messages_stmt_,
@@ -291,79 +301,37 @@ class MessageDbImpl final : public MessageDbSyncInterface {
                    int64 random_id, int32 ttl_expires_at, int32 index_mask, int64 search_id, string text,
                    NotificationId notification_id, MessageId top_thread_message_id, BufferSlice data) final {
     LOG(INFO) << "Add " << message_full_id << " to database";
-    auto dialog_id = message_full_id.get_dialog_id();
-    auto message_id = message_full_id.get_message_id();
-    LOG_CHECK(dialog_id.is_valid()) << dialog_id << ' ' << message_id << ' ' << message_full_id;
-    CHECK(message_id.is_valid());
+    MessageDbMessageToAdd message{message_full_id, unique_message_id,     sender_dialog_id, random_id,
+                                  ttl_expires_at,  index_mask,            search_id,        std::move(text),
+                                  notification_id, top_thread_message_id, std::move(data)};
     SCOPE_EXIT {
       add_message_stmt_.reset();
     };
-    add_message_stmt_.bind_int64(1, dialog_id.get()).ensure();
-    add_message_stmt_.bind_int64(2, message_id.get()).ensure();
-
-    if (unique_message_id.is_valid()) {
-      add_message_stmt_.bind_int32(3, unique_message_id.get()).ensure();
-    } else {
-      add_message_stmt_.bind_null(3).ensure();
-    }
-
-    if (sender_dialog_id.is_valid()) {
-      add_message_stmt_.bind_int64(4, sender_dialog_id.get()).ensure();
-    } else {
-      add_message_stmt_.bind_null(4).ensure();
-    }
-
-    if (random_id != 0) {
-      add_message_stmt_.bind_int64(5, random_id).ensure();
-    } else {
-      add_message_stmt_.bind_null(5).ensure();
-    }
-
-    add_message_stmt_.bind_blob(6, data.as_slice()).ensure();
-
-    if (ttl_expires_at != 0) {
-      add_message_stmt_.bind_int32(7, ttl_expires_at).ensure();
-    } else {
-      add_message_stmt_.bind_null(7).ensure();
-    }
+    bind_message(add_message_stmt_, 0, message);
+    add_message_stmt_.step().ensure();
+  }
 
-    if (index_mask != 0) {
-      add_message_stmt_.bind_int32(8, index_mask).ensure();
-    } else {
-      add_message_stmt_.bind_null(8).ensure();
-    }
-    if (search_id != 0) {
-      // add dialog_id to text
-      text += PSTRING() << " \a" << dialog_id.get();
-      if (index_mask != 0) {
-        for (int i = 0; i < MESSAGE_DB_INDEX_COUNT; i++) {
-          if ((index_mask & (1 << i))) {
-            text += PSTRING() << " \a\a" << i;
-          }
-        }
+  void add_messages(vector<MessageDbMessageToAdd> messages) final {
+    LOG(INFO) << "Add " << messages.size() << " messages to database";
+    // the caller is expected to run the whole batch in one transaction, so FTS5 keeps new index entries in memory
+    // and writes them only once on commit
+    size_t i = 0;
+    for (; i + ADD_MESSAGES_BATCH_SIZE <= messages.size(); i += ADD_MESSAGES_BATCH_SIZE) {
+      SCOPE_EXIT {
+        add_messages_stmt_.reset();
+      };
+      for (size_t j = 0; j < ADD_MESSAGES_BATCH_SIZE; j++) {
+        bind_message(add_messages_stmt_, static_cast<int>(j * MESSAGE_COLUMN_COUNT), messages[i + j]);
       }
-      add_message_stmt_.bind_int64(9, search_id).ensure();
-    } else {
-      text = "";
-      add_message_stmt_.bind_null(9).ensure();
-    }
-    if (!text.empty()) {
-      add_message_stmt_.bind_string(10, text).ensure();
-    } else {
-      add_message_stmt_.bind_null(10).ensure();
+      add_messages_stmt_.step().ensure();
     }
-    if (notification_id.is_valid()) {
-      add_message_stmt_.bind_int32(11, notification_id.get()).ensure();
-    } else {
-      add_message_stmt_.bind_null(11).ensure();
-    }
-    if (top_thread_message_id.is_valid()) {
-      add_message_stmt_.bind_int64(12, top_thread_message_id.get()).ensure();
-    } else {
-      add_message_stmt_.bind_null(12).ensure();
+    for (; i < messages.size(); i++) {
+      SCOPE_EXIT {
+        add_message_stmt_.reset();
+      };
+      bind_message(add_message_stmt_, 0, messages[i]);
+      add_message_stmt_.step().ensure();
     }
-
-    add_message_stmt_.step().ensure();
   }
 
   void add_scheduled_message(MessageFullId message_full_id, BufferSlice data) final {
@@ -824,9 +792,86 @@ class MessageDbImpl final : public MessageDbSyncInterface {
   }
 
  private:
+  // binds the message to parameters first_id + 1 ... first_id + MESSAGE_COLUMN_COUNT; the message must outlive step()
+  static void bind_message(SqliteStatement &stmt, int first_id, MessageDbMessageToAdd &message) {
+    auto dialog_id = message.message_full_id.get_dialog_id();
+    auto message_id = message.message_full_id.get_message_id();
+    LOG_CHECK(dialog_id.is_valid()) << dialog_id << ' ' << message_id << ' ' << message.message_full_id;
+    CHECK(message_id.is_valid());
+    stmt.bind_int64(first_id + 1, dialog_id.get()).ensure();
+    stmt.bind_int64(first_id + 2, message_id.get()).ensure();
+
+    if (message.unique_message_id.is_valid()) {
+      stmt.bind_int32(first_id + 3, message.unique_message_id.get()).ensure();
+    } else {
+      stmt.bind_null(first_id + 3).ensure();
+    }
+
+    if (message.sender_dialog_id.is_valid()) {
+      stmt.bind_int64(first_id + 4, message.sender_dialog_id.get()).ensure();
+    } else {
+      stmt.bind_null(first_id + 4).ensure();
+    }
+
+    if (message.random_id != 0) {
+      stmt.bind_int64(first_id + 5, message.random_id).ensure();
+    } else {
+      stmt.bind_null(first_id + 5).ensure();
+    }
+
+    stmt.bind_blob(first_id + 6, message.data.as_slice()).ensure();
+
+    if (message.ttl_expires_at != 0) {
+      stmt.bind_int32(first_id + 7, message.ttl_expires_at).ensure();
+    } else {
+      stmt.bind_null(first_id + 7).ensure();
+    }
+
+    if (message.index_mask != 0) {
+      stmt.bind_int32(first_id + 8, message.index_mask).ensure();
+    } else {
+      stmt.bind_null(first_id + 8).ensure();
+    }
+    if (message.search_id != 0) {
+      // add dialog_id to text
+      message.text += PSTRING() << " \a" << dialog_id.get();
+      if (message.index_mask != 0) {
+        for (int i = 0; i < MESSAGE_DB_INDEX_COUNT; i++) {
+          if ((message.index_mask & (1 << i))) {
+            message.text += PSTRING() << " \a\a" << i;
+          }
+        }
+      }
+      stmt.bind_int64(first_id + 9, message.search_id).ensure();
+    } else {
+      message.text = "";
+      stmt.bind_null(first_id + 9).ensure();
+    }
+    if (!message.text.empty()) {
+      stmt.bind_string(first_id + 10, message.text).ensure();
+    } else {
+      stmt.bind_null(first_id + 10).ensure();
+    }
+    if (message.notification_id.is_valid()) {
+      stmt.bind_int32(first_id + 11, message.notification_id.get()).ensure();
+    } else {
+      stmt.bind_null(first_id + 11).ensure();
+    }
+    if (message.top_thread_message_id.is_valid()) {
+      stmt.bind_int64(first_id + 12, message.top_thread_message_id.get()).ensure();
+    } else {
+      stmt.bind_null(first_id + 12).ensure();
+    }
+  }
+
+  static constexpr size_t MESSAGE_COLUMN_COUNT = 12;
+  // 384 parameters, which is less than the default SQLITE_MAX_VARIABLE_NUMBER of old SQLite versions
+  static constexpr size_t ADD_MESSAGES_BATCH_SIZE = 32;
+
   SqliteDb db_;
 
   SqliteStatement add_message_stmt_;
+  SqliteStatement add_messages_stmt_;
 
   SqliteStatement delete_message_stmt_;
   SqliteStatement delete_all_dialog_messages_stmt_;
@@ -984,8 +1029,13 @@ std::shared_ptr<MessageDbSyncSafeInterface> create_message_db_sync(
 
 class MessageDbAsync final : public MessageDbAsyncInterface {
  public:
-  MessageDbAsync(std::shared_ptr<MessageDbSyncSafeInterface> sync_db, int32 scheduler_id) {
-    impl_ = create_actor_on_scheduler<Impl>("MessageDbActor", scheduler_id, std::move(sync_db));
+  MessageDbAsync(std::shared_ptr<MessageDbSyncSafeInterface> sync_db, int32 scheduler_id,
+                 const vector<int32> &read_scheduler_ids) {
+    vector<ActorOwn<Reader>> readers;
+    for (auto read_scheduler_id : read_scheduler_ids) {
+      readers.push_back(create_actor_on_scheduler<Reader>("MessageDbReader", read_scheduler_id, sync_db));
+    }
+    impl_ = create_actor_on_scheduler<Impl>("MessageDbActor", scheduler_id, std::move(sync_db), std::move(readers));
   }
 
   void add_message(MessageFullId message_full_id, ServerMessageId unique_message_id, DialogId sender_dialog_id,
@@ -996,6 +1046,9 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
                        ttl_expires_at, index_mask, search_id, std::move(text), notification_id, top_thread_message_id,
                        std::move(data), std::move(promise));
   }
+  void add_messages(vector<MessageDbMessageToAdd> messages, Promise<> promise) final {
+    send_closure_later(impl_, &Impl::add_messages, std::move(messages), std::move(promise));
+  }
   void add_scheduled_message(MessageFullId message_full_id, BufferSlice data, Promise<> promise) final {
     send_closure_later(impl_, &Impl::add_scheduled_message, message_full_id, std::move(data), std::move(promise));
   }
@@ -1064,9 +1117,30 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
   }
 
  private:
+  // executes read queries on its own scheduler using a separate connection to the database
+  class Reader final : public Actor {
+   public:
+    explicit Reader(std::shared_ptr<MessageDbSyncSafeInterface> sync_db_safe) : sync_db_safe_(std::move(sync_db_safe)) {
+    }
+
+    void run_query(Promise<MessageDbSyncInterface *> query) {
+      query.set_value(&sync_db_safe_->get());
+    }
+
+    void close(Promise<> promise) {
+      sync_db_safe_.reset();
+      promise.set_value(Unit());
+      stop();
+    }
+
+   private:
+    std::shared_ptr<MessageDbSyncSafeInterface> sync_db_safe_;
+  };
+
   class Impl final : public Actor {
    public:
-    explicit Impl(std::shared_ptr<MessageDbSyncSafeInterface> sync_db_safe) : sync_db_safe_(std::move(sync_db_safe)) {
+    Impl(std::shared_ptr<MessageDbSyncSafeInterface> sync_db_safe, vector<ActorOwn<Reader>> readers)
+        : sync_db_safe_(std::move(sync_db_safe)), readers_(std::move(readers)) {
     }
     void add_message(MessageFullId message_full_id, ServerMessageId unique_message_id, DialogId sender_dialog_id,
                      int64 random_id, int32 ttl_expires_at, int32 index_mask, int64 search_id, string text,
@@ -1081,6 +1155,12 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
         on_write_result(std::move(promise));
       });
     }
+    void add_messages(vector<MessageDbMessageToAdd> messages, Promise<> promise) {
+      add_write_query([this, messages = std::move(messages), promise = std::move(promise)](Unit) mutable {
+        sync_db_->add_messages(std::move(messages));
+        on_write_result(std::move(promise));
+      });
+    }
     void add_scheduled_message(MessageFullId message_full_id, BufferSlice data, Promise<> promise) {
       add_write_query([this, message_full_id, promise = std::move(promise), data = std::move(data)](Unit) mutable {
         sync_db_->add_scheduled_message(message_full_id, std::move(data));
@@ -1101,78 +1181,113 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
     }
 
     void delete_all_dialog_messages(DialogId dialog_id, MessageId from_message_id, Promise<> promise) {
-      add_read_query();
-      sync_db_->delete_all_dialog_messages(dialog_id, from_message_id);
-      promise.set_value(Unit());
+      add_write_query([this, dialog_id, from_message_id, promise = std::move(promise)](Unit) mutable {
+        sync_db_->delete_all_dialog_messages(dialog_id, from_message_id);
+        on_write_result(std::move(promise));
+      });
+      do_flush();
     }
 
     void delete_dialog_messages_by_sender(DialogId dialog_id, DialogId sender_dialog_id, Promise<> promise) {
-      add_read_query();
-      sync_db_->delete_dialog_messages_by_sender(dialog_id, sender_dialog_id);
-      promise.set_value(Unit());
+      add_write_query([this, dialog_id, sender_dialog_id, promise = std::move(promise)](Unit) mutable {
+        sync_db_->delete_dialog_messages_by_sender(dialog_id, sender_dialog_id);
+        on_write_result(std::move(promise));
+      });
+      do_flush();
     }
 
     void get_message(MessageFullId message_full_id, Promise<MessageDbDialogMessage> promise) {
-      add_read_query();
-      promise.set_result(sync_db_->get_message(message_full_id));
+      add_read_query([message_full_id, promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_result(sync_db->get_message(message_full_id));
+      });
     }
     void get_message_by_unique_message_id(ServerMessageId unique_message_id, Promise<MessageDbMessage> promise) {
-      add_read_query();
-      promise.set_result(sync_db_->get_message_by_unique_message_id(unique_message_id));
+      add_read_query([unique_message_id, promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_result(sync_db->get_message_by_unique_message_id(unique_message_id));
+      });
     }
     void get_message_by_random_id(DialogId dialog_id, int64 random_id, Promise<MessageDbDialogMessage> promise) {
-      add_read_query();
-      promise.set_result(sync_db_->get_message_by_random_id(dialog_id, random_id));
+      add_read_query([dialog_id, random_id, promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_result(sync_db->get_message_by_random_id(dialog_id, random_id));
+      });
     }
     void get_dialog_message_by_date(DialogId dialog_id, MessageId first_message_id, MessageId last_message_id,
                                     int32 date, Promise<MessageDbDialogMessage> promise) {
-      add_read_query();
-      promise.set_result(sync_db_->get_dialog_message_by_date(dialog_id, first_message_id, last_message_id, date));
+      add_read_query([dialog_id, first_message_id, last_message_id, date,
+                      promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_result(sync_db->get_dialog_message_by_date(dialog_id, first_message_id, last_message_id, date));
+      });
     }
 
     void get_dialog_message_calendar(MessageDbDialogCalendarQuery query, Promise<MessageDbCalendar> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_dialog_message_calendar(std::move(query)));
+      add_read_query([query = std::move(query), promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_value(sync_db->get_dialog_message_calendar(std::move(query)));
+      });
     }
 
     void get_dialog_sparse_message_positions(MessageDbGetDialogSparseMessagePositionsQuery query,
                                              Promise<MessageDbMessagePositions> promise) {
-      add_read_query();
-      promise.set_result(sync_db_->get_dialog_sparse_message_positions(std::move(query)));
+      add_read_query([query = std::move(query), promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_result(sync_db->get_dialog_sparse_message_positions(std::move(query)));
+      });
     }
 
     void get_messages(MessageDbMessagesQuery query, Promise<vector<MessageDbDialogMessage>> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_messages(std::move(query)));
+      add_read_query([query = std::move(query), promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_value(sync_db->get_messages(std::move(query)));
+      });
     }
     void get_scheduled_messages(DialogId dialog_id, int32 limit, Promise<vector<MessageDbDialogMessage>> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_scheduled_messages(dialog_id, limit));
+      add_read_query([dialog_id, limit, promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_value(sync_db->get_scheduled_messages(dialog_id, limit));
+      });
     }
     void get_messages_from_notification_id(DialogId dialog_id, NotificationId from_notification_id, int32 limit,
                                            Promise<vector<MessageDbDialogMessage>> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_messages_from_notification_id(dialog_id, from_notification_id, limit));
+      add_read_query([dialog_id, from_notification_id, limit,
+                      promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_value(sync_db->get_messages_from_notification_id(dialog_id, from_notification_id, limit));
+      });
     }
     void get_calls(MessageDbCallsQuery query, Promise<MessageDbCallsResult> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_calls(std::move(query)));
+      add_read_query([query = std::move(query), promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_value(sync_db->get_calls(std::move(query)));
+      });
     }
     void get_messages_fts(MessageDbFtsQuery query, Promise<MessageDbFtsResult> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_messages_fts(std::move(query)));
+      add_read_query([query = std::move(query), promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_value(sync_db->get_messages_fts(std::move(query)));
+      });
     }
     void get_expiring_messages(int32 expires_till, int32 limit, Promise<vector<MessageDbMessage>> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_expiring_messages(expires_till, limit));
+      add_read_query([expires_till, limit, promise = std::move(promise)](MessageDbSyncInterface *sync_db) mutable {
+        promise.set_value(sync_db->get_expiring_messages(expires_till, limit));
+      });
     }
 
     void close(Promise<> promise) {
       do_flush();
-      sync_db_safe_.reset();
-      sync_db_ = nullptr;
-      promise.set_value(Unit());
-      stop();
+      if (readers_.empty()) {
+        return finish_close(std::move(promise));
+      }
+
+      // readers finish all queued queries before closing, so the changes can be committed after that
+      MultiPromiseActorSafe mpas{"MessageDbCloseMultiPromiseActor"};
+      mpas.add_promise(PromiseCreator::lambda([actor_id = actor_id(this), promise = std::move(promise)](Unit) mutable {
+        send_closure(actor_id, &Impl::finish_close, std::move(promise));
+      }));
+      auto lock = mpas.get_promise();
+      for (auto &reader : readers_) {
+        send_closure(reader.release(), &Reader::close, mpas.get_promise());
+      }
+      readers_.clear();
+      lock.set_value(Unit());
+    }
+
+    void on_read_query_finished() {
+      CHECK(running_read_query_count_ > 0);
+      running_read_query_count_--;
+      try_commit();
     }
 
     void force_flush() {
@@ -1183,6 +1298,10 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
    private:
     std::shared_ptr<MessageDbSyncSafeInterface> sync_db_safe_;
     MessageDbSyncInterface *sync_db_ = nullptr;
+    vector<ActorOwn<Reader>> readers_;
+    size_t next_reader_ = 0;
+    size_t running_read_query_count_ = 0;  // the number of queries sent to readers, which haven't finished yet
+    bool is_in_write_transaction_ = false;
 
     static constexpr size_t MAX_PENDING_QUERIES_COUNT{50};
     static constexpr double MAX_PENDING_QUERIES_DELAY{0.01};
@@ -1205,18 +1324,55 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
         set_timeout_at(wakeup_at_);
       }
     }
-    void add_read_query() {
+    template <class F>
+    void add_read_query(F &&f) {
+      // pending writes must be applied to be visible to the query
       do_flush();
+      if (readers_.empty() || is_in_write_transaction_) {
+        // uncommitted changes are visible only through the writing connection
+        f(sync_db_);
+        return;
+      }
+      running_read_query_count_++;
+      auto &reader = readers_[next_reader_++ % readers_.size()];
+      send_closure(reader, &Reader::run_query,
+                   PromiseCreator::lambda([actor_id = actor_id(this), f = std::forward<F>(f)](
+                                              MessageDbSyncInterface *sync_db) mutable {
+                     f(sync_db);
+                     send_closure(actor_id, &Impl::on_read_query_finished);
+                   }));
     }
     void do_flush() {
       if (pending_writes_.empty()) {
         return;
       }
-      sync_db_->begin_write_transaction().ensure();
+      if (!is_in_write_transaction_) {
+        sync_db_->begin_write_transaction().ensure();
+        is_in_write_transaction_ = true;
+      }
       set_promises(pending_writes_);
+      cancel_timeout();
+      try_commit();
+    }
+    // changes must not be visible to read queries sent before them,
+    // so they are committed only after all queries running on readers have finished
+    void try_commit() {
+      if (!is_in_write_transaction_ || running_read_query_count_ != 0) {
+        return;
+      }
       sync_db_->commit_transaction().ensure();
+      is_in_write_transaction_ = false;
       set_promises(finished_writes_);
-      cancel_timeout();
+    }
+    void finish_close(Promise<> promise) {
+      do_flush();
+      // all readers are closed, so there are no running queries
+      running_read_query_count_ = 0;
+      try_commit();
+      sync_db_safe_.reset();
+      sync_db_ = nullptr;
+      promise.set_value(Unit());
+      stop();
     }
     void timeout_expired() final {
       do_flush();
@@ -1230,8 +1386,8 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
 };
 
 std::shared_ptr<MessageDbAsyncInterface> create_message_db_async(std::shared_ptr<MessageDbSyncSafeInterface> sync_db,
-                                                                 int32 scheduler_id) {
-  return std::make_shared<MessageDbAsync>(std::move(sync_db), scheduler_id);
+                                                                 int32 scheduler_id, vector<int32> read_scheduler_ids) {
+  return std::make_shared<MessageDbAsync>(std::move(sync_db), scheduler_id, read_scheduler_ids);
 }
 
 }  // namespace td
@@ -97,6 +97,20 @@ struct MessageDbCallsResult {
   vector<MessageDbMessage> messages;
 };
 
+struct MessageDbMessageToAdd {
+  MessageFullId message_full_id;
+  ServerMessageId unique_message_id;
+  DialogId sender_dialog_id;
+  int64 random_id{0};
+  int32 ttl_expires_at{0};
+  int32 index_mask{0};
+  int64 search_id{0};
+  string text;
+  NotificationId notification_id;
+  MessageId top_thread_message_id;
+  BufferSlice data;
+};
+
 class MessageDbSyncInterface {
  public:
   MessageDbSyncInterface() = default;
@@ -107,6 +121,7 @@ class MessageDbSyncInterface {
   virtual void add_message(MessageFullId message_full_id, ServerMessageId unique_message_id, DialogId sender_dialog_id,
                            int64 random_id, int32 ttl_expires_at, int32 index_mask, int64 search_id, string text,
                            NotificationId notification_id, MessageId top_thread_message_id, BufferSlice data) = 0;
+  virtual void add_messages(vector<MessageDbMessageToAdd> messages) = 0;
   virtual void add_scheduled_message(MessageFullId message_full_id, BufferSlice data) = 0;
 
   virtual void delete_message(MessageFullId message_full_id) = 0;
@@ -159,6 +174,8 @@ class MessageDbAsyncInterface {
                            int64 random_id, int32 ttl_expires_at, int32 index_mask, int64 search_id, string text,
                            NotificationId notification_id, MessageId top_thread_message_id, BufferSlice data,
                            Promise<> promise) = 0;
+  // adds all messages in a single write query; the promise is set after all of them are committed
+  virtual void add_messages(vector<MessageDbMessageToAdd> messages, Promise<> promise) = 0;
   virtual void add_scheduled_message(MessageFullId message_full_id, BufferSlice data, Promise<> promise) = 0;
 
   virtual void delete_message(MessageFullId message_full_id, Promise<> promise) = 0;
@@ -199,7 +216,13 @@ Status drop_message_db(SqliteDb &db, int version) TD_WARN_UNUSED_RESULT;
 std::shared_ptr<MessageDbSyncSafeInterface> create_message_db_sync(
     std::shared_ptr<SqliteConnectionSafe> sqlite_connection);
 
+// read queries are executed on the schedulers from read_scheduler_ids if any, each using its own connection;
+// a read query sees all changes sent before it and none of the changes sent after it, because changes are committed
+// only after all read queries sent to the read schedulers have finished; while there are uncommitted changes,
+// read queries are executed on the writing connection; therefore, results of read queries
+// can be returned in a different order than the queries were sent
 std::shared_ptr<MessageDbAsyncInterface> create_message_db_async(std::shared_ptr<MessageDbSyncSafeInterface> sync_db,
-                                                                 int32 scheduler_id = -1);
+                                                                 int32 scheduler_id = -1,
+                                                                 vector<int32> read_scheduler_ids = {});
 
 }  // namespace td
@@ -8676,6 +8676,7 @@ void MessagesManager::on_get_history(DialogId dialog_id, MessageId from_message_
     }
   }
 
+  begin_add_messages_to_database();
   for (auto &message : messages) {
     auto expected_message_id = MessageId::get_message_id(message, false);
     if (!have_next && from_the_end && expected_message_id < d->last_message_id) {
@@ -8709,6 +8710,7 @@ void MessagesManager::on_get_history(DialogId dialog_id, MessageId from_message_
       first_added_message_id = message_id;
     }
   }
+  end_add_messages_to_database();
 
   if (from_the_end && last_added_message_id.is_valid() && last_added_message_id != last_received_message_id) {
     CHECK(last_added_message_id < last_received_message_id);
@@ -10378,8 +10380,7 @@ void MessagesManager::delete_dialog_messages_by_sender(DialogId dialog_id, Dialo
 
   if (G()->use_message_database()) {
     LOG(INFO) << "Delete all messages from " << sender_dialog_id << " in " << dialog_id << " from database";
-    G()->td_db()->get_message_db_async()->delete_dialog_messages_by_sender(dialog_id, sender_dialog_id,
-                                                                           Auto());  // TODO Promise
+    get_message_db_async()->delete_dialog_messages_by_sender(dialog_id, sender_dialog_id, Auto());  // TODO Promise
   }
 
   vector<MessageId> message_ids = find_dialog_messages(d, [sender_dialog_id, channel_status, is_bot](const Message *m) {
@@ -12500,7 +12501,7 @@ void MessagesManager::ttl_db_loop() {
 
   ttl_db_has_query_ = true;
   LOG(INFO) << "Send ttl_db query with limit " << ttl_db_next_limit_;
-  G()->td_db()->get_message_db_async()->get_expiring_messages(
+  get_message_db_async()->get_expiring_messages(
       G()->unix_time() - 1, ttl_db_next_limit_,
       PromiseCreator::lambda([actor_id = actor_id(this)](Result<std::vector<MessageDbMessage>> result) {
         send_closure(actor_id, &MessagesManager::ttl_db_on_result, std::move(result), false);
@@ -19072,7 +19073,7 @@ void MessagesManager::open_dialog(Dialog *d) {
 
       LOG(INFO) << "Send check has_scheduled_database_messages request";
       d->is_has_scheduled_database_messages_checked = true;
-      G()->td_db()->get_message_db_async()->get_scheduled_messages(
+      get_message_db_async()->get_scheduled_messages(
           dialog_id, 1,
           PromiseCreator::lambda([actor_id = actor_id(this), dialog_id](vector<MessageDbDialogMessage> messages) {
             if (messages.empty()) {
@@ -20118,7 +20119,7 @@ td_api::object_ptr<td_api::messageCalendar> MessagesManager::get_dialog_message_
       db_query.filter = filter;
       db_query.from_message_id = fixed_from_message_id;
       db_query.tz_offset = static_cast<int32>(td_->option_manager_->get_option_integer("utc_time_offset"));
-      G()->td_db()->get_message_db_async()->get_dialog_message_calendar(db_query, std::move(new_promise));
+      get_message_db_async()->get_dialog_message_calendar(db_query, std::move(new_promise));
       return {};
     }
   }
@@ -20353,7 +20354,7 @@ MessagesManager::FoundDialogMessages MessagesManager::search_dialog_messages(
       db_query.from_message_id = fixed_from_message_id;
       db_query.offset = offset;
       db_query.limit = limit;
-      G()->td_db()->get_message_db_async()->get_messages(db_query, std::move(new_promise));
+      get_message_db_async()->get_messages(db_query, std::move(new_promise));
       return result;
     }
   }
@@ -20453,7 +20454,7 @@ MessagesManager::FoundMessages MessagesManager::search_call_messages(const strin
       db_query.filter = filter;
       db_query.from_unique_message_id = fixed_from_message_id.get_server_message_id().get();
       db_query.limit = limit;
-      G()->td_db()->get_message_db_async()->get_calls(
+      get_message_db_async()->get_calls(
           db_query, PromiseCreator::lambda([random_id, first_db_message_id, filter, promise = std::move(promise)](
                                                Result<MessageDbCallsResult> calls_result) mutable {
             send_closure(G()->messages_manager(), &MessagesManager::on_message_db_calls_result, std::move(calls_result),
@@ -21054,7 +21055,7 @@ MessagesManager::FoundMessages MessagesManager::offline_search_messages(DialogId
   } while (random_id == 0 || found_fts_messages_.count(random_id) > 0);
   found_fts_messages_[random_id];  // reserve place for result
 
-  G()->td_db()->get_message_db_async()->get_messages_fts(
+  get_message_db_async()->get_messages_fts(
       std::move(fts_query),
       PromiseCreator::lambda([random_id, offset = std::move(offset), limit,
                               promise = std::move(promise)](Result<MessageDbFtsResult> fts_result) mutable {
@@ -21248,7 +21249,7 @@ int64 MessagesManager::get_dialog_message_by_date(DialogId dialog_id, int32 date
 
   if (G()->use_message_database() && d->last_database_message_id != MessageId()) {
     CHECK(d->first_database_message_id != MessageId());
-    G()->td_db()->get_message_db_async()->get_dialog_message_by_date(
+    get_message_db_async()->get_dialog_message_by_date(
         dialog_id, d->first_database_message_id, d->last_database_message_id, date,
         PromiseCreator::lambda([actor_id = actor_id(this), dialog_id, date, random_id,
                                 promise = std::move(promise)](Result<MessageDbDialogMessage> result) mutable {
@@ -21474,7 +21475,7 @@ void MessagesManager::get_dialog_sparse_message_positions(
     db_query.filter = filter;
     db_query.from_message_id = from_message_id;
     db_query.limit = limit;
-    G()->td_db()->get_message_db_async()->get_dialog_sparse_message_positions(db_query, std::move(new_promise));
+    get_message_db_async()->get_dialog_sparse_message_positions(db_query, std::move(new_promise));
     return;
   }
 
@@ -22076,7 +22077,7 @@ void MessagesManager::get_history_impl(const Dialog *d, MessageId from_message_i
     db_query.from_message_id = from_message_id;
     db_query.offset = offset;
     db_query.limit = limit;
-    G()->td_db()->get_message_db_async()->get_messages(
+    get_message_db_async()->get_messages(
         db_query,
         PromiseCreator::lambda([actor_id = actor_id(this), dialog_id, from_message_id,
                                 old_last_database_message_id = d->last_database_message_id, offset, limit, only_local,
@@ -22233,7 +22234,7 @@ void MessagesManager::load_dialog_scheduled_messages(DialogId dialog_id, bool fr
     auto &queries = load_scheduled_messages_from_database_queries_[dialog_id];
     queries.push_back(std::move(promise));
     if (queries.size() == 1) {
-      G()->td_db()->get_message_db_async()->get_scheduled_messages(
+      get_message_db_async()->get_scheduled_messages(
           dialog_id, 1000,
           PromiseCreator::lambda([actor_id = actor_id(this), dialog_id](vector<MessageDbDialogMessage> messages) {
             send_closure(actor_id, &MessagesManager::on_get_scheduled_messages_from_database, dialog_id,
@@ -27189,6 +27190,9 @@ void MessagesManager::send_update_new_message(const Dialog *d, const Message *m)
   CHECK(d != nullptr);
   CHECK(m != nullptr);
   CHECK(d->is_update_new_chat_sent);
+  if (!td_->is_update_type_enabled(td_api::updateNewMessage::ID)) {
+    return;
+  }
   send_closure(
       G()->td(), &Td::send_update,
       td_api::make_object<td_api::updateNewMessage>(get_message_object(d->dialog_id, m, "send_update_new_message")));
@@ -27795,7 +27799,7 @@ void MessagesManager::do_get_message_notifications_from_database(Dialog *d, bool
                      initial_from_notification_id, limit, std::move(result), std::move(promise));
       });
 
-  auto *db = G()->td_db()->get_message_db_async();
+  auto *db = get_message_db_async();
   if (!from_mentions) {
     VLOG(notifications) << "Trying to load " << limit << " messages with notifications in " << group_info.get_group_id()
                         << '/' << dialog_id << " from " << from_notification_id;
@@ -27961,7 +27965,7 @@ void MessagesManager::remove_message_notification(DialogId dialog_id, Notificati
   }
 
   if (G()->use_message_database()) {
-    G()->td_db()->get_message_db_async()->get_messages_from_notification_id(
+    get_message_db_async()->get_messages_from_notification_id(
         dialog_id, NotificationId(notification_id.get() + 1), 1,
         PromiseCreator::lambda([actor_id = actor_id(this), dialog_id, from_mentions,
                                 notification_id](vector<MessageDbDialogMessage> result) {
@@ -28499,6 +28503,9 @@ void MessagesManager::send_update_message_content_impl(DialogId dialog_id, const
     LOG(INFO) << "Skip updateMessageContent for " << m->message_id << " in " << dialog_id << " from " << source;
     return;
   }
+  if (!td_->is_update_type_enabled(td_api::updateMessageContent::ID)) {
+    return;
+  }
   LOG(INFO) << "Send updateMessageContent for " << m->message_id << " in " << dialog_id << " from " << source;
   send_closure(G()->td(), &Td::send_update,
                td_api::make_object<td_api::updateMessageContent>(get_chat_id_object(dialog_id, "updateMessageContent"),
@@ -28518,7 +28525,8 @@ void MessagesManager::send_update_message_edited(DialogId dialog_id, const Messa
 
 void MessagesManager::send_update_message_interaction_info(DialogId dialog_id, const Message *m) const {
   CHECK(m != nullptr);
-  if (td_->auth_manager_->is_bot() || !m->is_update_sent) {
+  if (td_->auth_manager_->is_bot() || !m->is_update_sent ||
+      !td_->is_update_type_enabled(td_api::updateMessageInteractionInfo::ID)) {
     return;
   }
 
@@ -33104,8 +33112,8 @@ void MessagesManager::add_message_to_database(const Dialog *d, const Message *m,
     LOG(INFO) << "Add " << MessageFullId(d->dialog_id, message_id) << " to database from " << source;
 
     set_dialog_has_scheduled_database_messages(d->dialog_id, true);
-    G()->td_db()->get_message_db_async()->add_scheduled_message({d->dialog_id, message_id}, log_event_store(*m),
-                                                                Auto());  // TODO Promise
+    get_message_db_async()->add_scheduled_message({d->dialog_id, message_id}, log_event_store(*m),
+                                                  Auto());  // TODO Promise
     return;
   }
   LOG_CHECK(message_id.is_server() || message_id.is_local()) << source;
@@ -33149,11 +33157,44 @@ void MessagesManager::add_message_to_database(const Dialog *d, const Message *m,
   if (m->ttl_period != 0 && (ttl_expires_at == 0 || m->date + m->ttl_period < ttl_expires_at)) {
     ttl_expires_at = m->date + m->ttl_period;
   }
-  G()->td_db()->get_message_db_async()->add_message({d->dialog_id, message_id}, unique_message_id,
-                                                    get_message_sender(m), random_id, ttl_expires_at,
-                                                    get_message_index_mask(d->dialog_id, m), search_id, text,
-                                                    m->notification_id, m->top_thread_message_id, log_event_store(*m),
-                                                    Auto());  // TODO Promise
+  if (add_messages_to_database_depth_ > 0) {
+    pending_database_messages_.push_back({{d->dialog_id, message_id}, unique_message_id, get_message_sender(m),
+                                          random_id, ttl_expires_at, get_message_index_mask(d->dialog_id, m),
+                                          search_id, std::move(text), m->notification_id, m->top_thread_message_id,
+                                          log_event_store(*m)});
+    return;
+  }
+  get_message_db_async()->add_message({d->dialog_id, message_id}, unique_message_id, get_message_sender(m), random_id,
+                                      ttl_expires_at, get_message_index_mask(d->dialog_id, m), search_id, text,
+                                      m->notification_id, m->top_thread_message_id, log_event_store(*m),
+                                      Auto());  // TODO Promise
+}
+
+void MessagesManager::begin_add_messages_to_database() {
+  add_messages_to_database_depth_++;
+}
+
+void MessagesManager::end_add_messages_to_database() {
+  CHECK(add_messages_to_database_depth_ > 0);
+  add_messages_to_database_depth_--;
+  if (add_messages_to_database_depth_ == 0) {
+    flush_pending_database_messages();
+  }
+}
+
+void MessagesManager::flush_pending_database_messages() {
+  if (pending_database_messages_.empty()) {
+    return;
+  }
+  LOG(INFO) << "Add " << pending_database_messages_.size() << " messages to database";
+  auto messages = std::move(pending_database_messages_);
+  pending_database_messages_.clear();
+  G()->td_db()->get_message_db_async()->add_messages(std::move(messages), Auto());  // TODO Promise
+}
+
+MessageDbAsyncInterface *MessagesManager::get_message_db_async() {
+  flush_pending_database_messages();
+  return G()->td_db()->get_message_db_async();
 }
 
 void MessagesManager::delete_all_dialog_notifications(Dialog *d, MessageId max_message_id, const char *source) {
@@ -33200,7 +33241,7 @@ void MessagesManager::delete_all_dialog_messages_from_database(Dialog *d, Messag
     }
   }
   */
-  G()->td_db()->get_message_db_async()->delete_all_dialog_messages(dialog_id, max_message_id, Auto());  // TODO Promise
+  get_message_db_async()->delete_all_dialog_messages(dialog_id, max_message_id, Auto());  // TODO Promise
 }
 
 class MessagesManager::DeleteMessageLogEvent {
@@ -33384,7 +33425,7 @@ void MessagesManager::delete_message_from_database(Dialog *d, MessageId message_
   on_message_deleted_from_database(d, m, source);
 }
 
-void MessagesManager::do_delete_message_log_event(const DeleteMessageLogEvent &log_event) const {
+void MessagesManager::do_delete_message_log_event(const DeleteMessageLogEvent &log_event) {
   CHECK(G()->use_message_database());
 
   Promise<Unit> db_promise;
@@ -33424,7 +33465,7 @@ void MessagesManager::do_delete_message_log_event(const DeleteMessageLogEvent &l
 
   // message may not exist in the dialog
   LOG(INFO) << "Delete " << log_event.message_full_id_ << " from database";
-  G()->td_db()->get_message_db_async()->delete_message(log_event.message_full_id_, std::move(db_promise));
+  get_message_db_async()->delete_message(log_event.message_full_id_, std::move(db_promise));
 }
 
 int64 MessagesManager::get_message_reply_to_random_id(const Dialog *d, const Message *m) const {
@@ -36169,6 +36210,7 @@ void MessagesManager::process_get_channel_difference_updates(
   bool need_repair_unread_count =
       !new_messages.empty() && get_message_date(new_messages[0]) < G()->unix_time() - 2 * 86400;
 
+  begin_add_messages_to_database();
   auto it = awaited_messages.begin();
   for (auto &message : new_messages) {
     auto message_id = MessageId::get_message_id(message, false);
@@ -36197,6 +36239,7 @@ void MessagesManager::process_get_channel_difference_updates(
     it->second.promise.set_value(Unit());
     ++it;
   }
+  end_add_messages_to_database();
 
   for (auto &update : other_updates) {
     if (update != nullptr) {
@@ -2171,6 +2171,16 @@ class MessagesManager final : public Actor {
 
   void add_message_to_database(const Dialog *d, const Message *m, const char *source);
 
+  // messages added to the database between the calls are stored by a single query
+  void begin_add_messages_to_database();
+
+  void end_add_messages_to_database();
+
+  void flush_pending_database_messages();
+
+  // all requests to the message database must be sent through the method to be handled after pending messages
+  MessageDbAsyncInterface *get_message_db_async();
+
   void delete_all_dialog_notifications(Dialog *d, MessageId max_message_id, const char *source);
 
   void delete_all_dialog_messages_from_database(Dialog *d, MessageId max_message_id, const char *source);
@@ -2208,7 +2218,7 @@ class MessagesManager final : public Actor {
                                           NotificationId prev_last_notification_id,
                                           Result<vector<Notification>> result);
 
-  void do_delete_message_log_event(const DeleteMessageLogEvent &log_event) const;
+  void do_delete_message_log_event(const DeleteMessageLogEvent &log_event);
 
   int64 get_message_reply_to_random_id(const Dialog *d, const Message *m) const;
 
@@ -3435,6 +3445,9 @@ class MessagesManager final : public Actor {
   DialogId being_added_new_dialog_id_;
 
   DialogId debug_channel_difference_dialog_;
+
+  int32 add_messages_to_database_depth_ = 0;
+  vector<MessageDbMessageToAdd> pending_database_messages_;
   DialogId debug_last_get_channel_difference_dialog_id_;
   const char *debug_last_get_channel_difference_source_ = "unknown";
 
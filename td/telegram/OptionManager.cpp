@@ -146,6 +146,10 @@ OptionManager::OptionManager(Td *td)
     update_premium_options();
   }
 
+  if (options.isset("binlog_sync_policy") || options.isset("binlog_sync_delay")) {
+    G()->td_db()->update_binlog_sync_policy();
+  }
+
   set_option_empty("archive_and_mute_new_chats_from_unknown_users");
   set_option_empty("channel_custom_accent_color_boost_level_min");
   set_option_empty("chat_filter_count_max");
@@ -471,6 +475,9 @@ void OptionManager::on_option_updated(Slice name) {
       if (name == "base_language_pack_version") {
         send_closure(td_->language_pack_manager_, &LanguagePackManager::on_language_pack_version_changed, true, -1);
       }
+      if (name == "binlog_sync_delay" || name == "binlog_sync_policy") {
+        G()->td_db()->update_binlog_sync_policy();
+      }
       break;
     case 'c':
       if (name == "connection_parameters") {
@@ -543,6 +550,11 @@ void OptionManager::on_option_updated(Slice name) {
         }
       }
       break;
+    case 'm':
+      if (name == "media_session_count_max" || name == "media_session_count_min") {
+        G()->net_query_dispatcher().update_media_session_count();
+      }
+      break;
     case 'n':
       if (name == "need_premium_for_story_caption_entities") {
         set_option_boolean(
@@ -766,6 +778,16 @@ void OptionManager::set_option(const string &name, td_api::object_ptr<td_api::Op
       }
       */
       break;
+    case 'b':
+      if (set_integer_option("binlog_sync_delay", 0, 1000)) {
+        return;
+      }
+      if (set_string_option("binlog_sync_policy", [](Slice value) {
+            return value == "always" || value == "group" || value == "interval";
+          })) {
+        return;
+      }
+      break;
     case 'c':
       if (!is_bot && set_string_option("connection_parameters", [](Slice value) {
             string value_copy = value.str();
@@ -860,6 +882,12 @@ void OptionManager::set_option(const string &name, td_api::object_ptr<td_api::Op
       }
       break;
     case 'm':
+      if (set_integer_option("media_session_count_max", 0, 100)) {
+        return;
+      }
+      if (set_integer_option("media_session_count_min", 0, 100)) {
+        return;
+      }
       if (set_integer_option("message_unload_delay", 60, 86400)) {
         return;
       }
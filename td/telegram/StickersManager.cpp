@@ -727,8 +727,10 @@ class GetStickerSetQuery final : public Td::ResultHandler {
       sticker_set_name_ =
           static_cast<const telegram_api::inputStickerSetShortName *>(input_sticker_set.get())->short_name_;
     }
-    send_query(
-        G()->net_query_creator().create(telegram_api::messages_getStickerSet(std::move(input_sticker_set), hash)));
+    auto net_query =
+        G()->net_query_creator().create(telegram_api::messages_getStickerSet(std::move(input_sticker_set), hash));
+    net_query->can_be_deduplicated_ = true;
+    send_query(std::move(net_query));
   }
 
   void on_result(BufferSlice packet) final {
@@ -2802,6 +2802,8 @@ bool Td::is_synchronous_request(const td_api::Function *function) {
     case td_api::setLogTagVerbosityLevel::ID:
     case td_api::getLogTagVerbosityLevel::ID:
     case td_api::addLogMessage::ID:
+    case td_api::toggleSchedulerStatistics::ID:
+    case td_api::getSchedulerStatistics::ID:
     case td_api::testReturnError::ID:
       return true;
     case td_api::getOption::ID:
@@ -2814,6 +2816,7 @@ bool Td::is_synchronous_request(const td_api::Function *function) {
 bool Td::is_preinitialization_request(int32 id) {
   switch (id) {
     case td_api::getCurrentState::ID:
+    case td_api::setReceivedUpdateTypes::ID:
     case td_api::setAlarm::ID:
     case td_api::testUseUpdate::ID:
     case td_api::testCallEmpty::ID:
@@ -3660,32 +3663,43 @@ void Td::init(Parameters parameters, Result<TdDb::OpenedDatabase> r_opened_datab
   return finish_set_parameters();
 }
 
+template <class F>
+static void replay_binlog_events(Slice name, vector<BinlogEvent> &events, F &&on_binlog_event) {
+  if (events.empty()) {
+    return;
+  }
+  Timer timer;
+  for (auto &event : events) {
+    on_binlog_event(std::move(event));
+  }
+  LOG(INFO) << "Replayed " << events.size() << " binlog events of " << name << timer;
+}
+
 void Td::process_binlog_events(TdDb::OpenedDatabase &&events) {
   VLOG(td_init) << "Send binlog events";
-  for (auto &event : events.user_events) {
-    contacts_manager_->on_binlog_user_event(std::move(event));
-  }
+  // binlog events are parsed and applied on the Td actor, because their parsing registers files and stickers
+  // in single-threaded managers, so the replay time of each group is logged to find the slowest one
+  Timer timer;
+  replay_binlog_events("users", events.user_events,
+                       [&](BinlogEvent &&event) { contacts_manager_->on_binlog_user_event(std::move(event)); });
 
-  for (auto &event : events.channel_events) {
-    contacts_manager_->on_binlog_channel_event(std::move(event));
-  }
+  replay_binlog_events("supergroups", events.channel_events,
+                       [&](BinlogEvent &&event) { contacts_manager_->on_binlog_channel_event(std::move(event)); });
 
   // chats may contain links to channels, so should be inited after
-  for (auto &event : events.chat_events) {
-    contacts_manager_->on_binlog_chat_event(std::move(event));
-  }
+  replay_binlog_events("basic groups", events.chat_events,
+                       [&](BinlogEvent &&event) { contacts_manager_->on_binlog_chat_event(std::move(event)); });
 
-  for (auto &event : events.secret_chat_events) {
+  replay_binlog_events("secret chats", events.secret_chat_events, [&](BinlogEvent &&event) {
     contacts_manager_->on_binlog_secret_chat_event(std::move(event));
-  }
+  });
 
-  for (auto &event : events.web_page_events) {
-    web_pages_manager_->on_binlog_web_page_event(std::move(event));
-  }
+  replay_binlog_events("web pages", events.web_page_events,
+                       [&](BinlogEvent &&event) { web_pages_manager_->on_binlog_web_page_event(std::move(event)); });
 
-  for (auto &event : events.save_app_log_events) {
-    on_save_app_log_binlog_event(this, std::move(event));
-  }
+  replay_binlog_events("application logs", events.save_app_log_events,
+                       [&](BinlogEvent &&event) { on_save_app_log_binlog_event(this, std::move(event)); });
+  LOG(INFO) << "Finished synchronous binlog replay" << timer;
 
   // Send binlog events to managers
   //
@@ -3704,6 +3718,12 @@ void Td::process_binlog_events(TdDb::OpenedDatabase &&events) {
   //
   // -- Use send_closure_later, so actors don't even start process binlog events, before all binlog events are sent
 
+  LOG(INFO) << "Send " << events.to_secret_chats_manager.size() << " binlog events to SecretChatsManager, "
+            << events.to_account_manager.size() << " to AccountManager, " << events.to_poll_manager.size()
+            << " to PollManager, " << events.to_messages_manager.size() << " to MessagesManager, "
+            << events.to_story_manager.size() << " to StoryManager, " << events.to_notification_manager.size()
+            << " to NotificationManager and " << events.to_notification_settings_manager.size()
+            << " to NotificationSettingsManager";
   for (auto &event : events.to_secret_chats_manager) {
     send_closure_later(secret_chats_manager_, &SecretChatsManager::replay_binlog_event, std::move(event));
   }
@@ -4007,6 +4027,9 @@ void Td::send_update(tl_object_ptr<td_api::Update> &&object) {
     // just in case
     return;
   }
+  if (!is_update_type_enabled(object_id)) {
+    return;
+  }
 
   switch (object_id) {
     case td_api::updateAccentColors::ID:
@@ -9113,6 +9136,19 @@ void Td::on_request(uint64 id, const td_api::setAlarm &request) {
   alarm_timeout_.set_timeout_in(alarm_id, request.seconds_);
 }
 
+void Td::on_request(uint64 id, const td_api::setReceivedUpdateTypes &request) {
+  FlatHashSet<int32> update_ids;
+  for (auto &update_type : request.update_types_) {
+    auto update_id = td_api::get_constructor_id(static_cast<const td_api::Update *>(nullptr), update_type);
+    if (update_id == 0) {
+      return send_error_raw(id, 400, "Unknown update type specified");
+    }
+    update_ids.insert(update_id);
+  }
+  received_update_ids_ = std::move(update_ids);
+  send_closure(actor_id(this), &Td::send_result, id, td_api::make_object<td_api::ok>());
+}
+
 void Td::on_request(uint64 id, td_api::searchHashtags &request) {
   CHECK_IS_USER();
   CLEAN_INPUT_STRING(request.prefix_);
@@ -9486,6 +9522,14 @@ void Td::on_request(uint64 id, const td_api::addLogMessage &request) {
   UNREACHABLE();
 }
 
+void Td::on_request(uint64 id, const td_api::toggleSchedulerStatistics &request) {
+  UNREACHABLE();
+}
+
+void Td::on_request(uint64 id, const td_api::getSchedulerStatistics &request) {
+  UNREACHABLE();
+}
+
 td_api::object_ptr<td_api::Object> Td::do_static_request(td_api::searchQuote &request) {
   if (request.text_ == nullptr || request.quote_ == nullptr) {
     return make_error(400, "Text and quote must be non-empty");
@@ -9760,6 +9804,26 @@ td_api::object_ptr<td_api::Object> Td::do_static_request(const td_api::addLogMes
   return td_api::make_object<td_api::ok>();
 }
 
+td_api::object_ptr<td_api::Object> Td::do_static_request(const td_api::toggleSchedulerStatistics &request) {
+  Scheduler::set_statistics_enabled(request.is_enabled_);
+  return td_api::make_object<td_api::ok>();
+}
+
+td_api::object_ptr<td_api::Object> Td::do_static_request(const td_api::getSchedulerStatistics &request) {
+  auto schedulers = transform(Scheduler::get_statistics(), [](const SchedulerStatistics &statistics) {
+    auto actors = transform(statistics.actors, [](const ActorStatistics &actor) {
+      return td_api::make_object<td_api::actorStatistics>(actor.name, static_cast<int64>(actor.event_count),
+                                                           actor.run_time,
+                                                           narrow_cast<int32>(actor.max_mailbox_size));
+    });
+    return td_api::make_object<td_api::schedulerStatistics>(
+        statistics.group_id, statistics.sched_id, static_cast<int64>(statistics.loop_count), statistics.busy_time,
+        statistics.poll_time, narrow_cast<int32>(statistics.timeout_count),
+        narrow_cast<int32>(statistics.max_timeout_count), std::move(actors));
+  });
+  return td_api::make_object<td_api::schedulersStatistics>(std::move(schedulers));
+}
+
 td_api::object_ptr<td_api::Object> Td::do_static_request(td_api::testReturnError &request) {
   if (request.error_ == nullptr) {
     return td_api::make_object<td_api::error>(404, "Not Found");
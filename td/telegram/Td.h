@@ -26,6 +26,7 @@
 #include "td/utils/common.h"
 #include "td/utils/Container.h"
 #include "td/utils/FlatHashMap.h"
+#include "td/utils/FlatHashSet.h"
 #include "td/utils/logging.h"
 #include "td/utils/Promise.h"
 #include "td/utils/Slice.h"
@@ -316,6 +317,12 @@ class Td final : public Actor {
 
   void send_update(tl_object_ptr<td_api::Update> &&object);
 
+  // returns false if updates of the type are known to be dropped, so they don't need to be created
+  bool is_update_type_enabled(int32 update_id) const {
+    return received_update_ids_.empty() || update_id == td_api::updateAuthorizationState::ID ||
+           received_update_ids_.count(update_id) != 0;
+  }
+
   static td_api::object_ptr<td_api::Object> static_request(td_api::object_ptr<td_api::Function> function);
 
  private:
@@ -371,6 +378,8 @@ class Td final : public Actor {
 
   bool can_ignore_background_updates_ = false;
 
+  FlatHashSet<int32> received_update_ids_;  // empty if all updates are sent
+
   bool reloading_promo_data_ = false;
   bool need_reload_promo_data_ = false;
 
@@ -1736,6 +1745,8 @@ class Td final : public Actor {
 
   void on_request(uint64 id, const td_api::setAlarm &request);
 
+  void on_request(uint64 id, const td_api::setReceivedUpdateTypes &request);
+
   void on_request(uint64 id, td_api::searchHashtags &request);
 
   void on_request(uint64 id, td_api::removeRecentHashtag &request);
@@ -1858,6 +1869,10 @@ class Td final : public Actor {
 
   void on_request(uint64 id, const td_api::addLogMessage &request);
 
+  void on_request(uint64 id, const td_api::toggleSchedulerStatistics &request);
+
+  void on_request(uint64 id, const td_api::getSchedulerStatistics &request);
+
   // test
   void on_request(uint64 id, const td_api::testNetwork &request);
   void on_request(uint64 id, td_api::testProxy &request);
@@ -1904,6 +1919,8 @@ class Td final : public Actor {
   static td_api::object_ptr<td_api::Object> do_static_request(const td_api::setLogTagVerbosityLevel &request);
   static td_api::object_ptr<td_api::Object> do_static_request(const td_api::getLogTagVerbosityLevel &request);
   static td_api::object_ptr<td_api::Object> do_static_request(const td_api::addLogMessage &request);
+  static td_api::object_ptr<td_api::Object> do_static_request(const td_api::toggleSchedulerStatistics &request);
+  static td_api::object_ptr<td_api::Object> do_static_request(const td_api::getSchedulerStatistics &request);
   static td_api::object_ptr<td_api::Object> do_static_request(td_api::testReturnError &request);
 
   static DbKey as_db_key(string key);
@@ -272,6 +272,19 @@ void TdDb::flush_all() {
   binlog_->force_flush();
 }
 
+void TdDb::update_binlog_sync_policy() {
+  CHECK(binlog_ != nullptr);
+  auto delay = static_cast<double>(G()->get_option_integer("binlog_sync_delay", 3)) * 0.001;
+  auto policy = G()->get_option_string("binlog_sync_policy", "group");
+  if (policy == "always") {
+    binlog_->set_sync_policy(ConcurrentBinlog::SyncPolicy::always());
+  } else if (policy == "interval") {
+    binlog_->set_sync_policy(ConcurrentBinlog::SyncPolicy::interval(delay));
+  } else {
+    binlog_->set_sync_policy(ConcurrentBinlog::SyncPolicy::group(delay));
+  }
+}
+
 void TdDb::close(int32 scheduler_id, bool destroy_flag, Promise<Unit> on_finished) {
   Scheduler::instance()->run_on_scheduler(scheduler_id,
                                           [this, destroy_flag, on_finished = std::move(on_finished)](Unit) mutable {
@@ -479,7 +492,13 @@ Status TdDb::init_sqlite(const Parameters &parameters, const DbKey &key, const D
 
   if (use_message_database) {
     message_db_sync_safe_ = create_message_db_sync(sql_connection_);
-    message_db_async_ = create_message_db_async(message_db_sync_safe_);
+    // reads must not share a scheduler with network queries, so they are executed in place if there is no dedicated one
+    vector<int32> read_scheduler_ids;
+    auto reader_scheduler_id = G()->get_database_reader_scheduler_id();
+    if (reader_scheduler_id != -1) {
+      read_scheduler_ids.push_back(reader_scheduler_id);
+    }
+    message_db_async_ = create_message_db_async(message_db_sync_safe_, -1, std::move(read_scheduler_ids));
   }
 
   if (use_story_database) {
@@ -134,6 +134,9 @@ class TdDb {
 
   void flush_all();
 
+  // applies options "binlog_sync_policy" and "binlog_sync_delay" to the binlog
+  void update_binlog_sync_policy();
+
   void close(int32 scheduler_id, bool destroy_flag, Promise<Unit> on_finished);
 
   MessageDbSyncInterface *get_message_db_sync();
@@ -2433,6 +2433,8 @@ class CliClient final : public Actor {
       send_request(td_api::make_object<td_api::confirmQrCodeAuthentication>(args));
     } else if (op == "gcs") {
       send_request(td_api::make_object<td_api::getCurrentState>());
+    } else if (op == "srut") {
+      send_request(td_api::make_object<td_api::setReceivedUpdateTypes>(autosplit_str(args)));
     } else if (op == "raea") {
       send_request(td_api::make_object<td_api::resetAuthenticationEmailAddress>());
     } else if (op == "rapr") {
@@ -6538,6 +6540,12 @@ class CliClient final : public Actor {
       } else {
         execute(std::move(request));
       }
+    } else if (op == "tss") {
+      bool is_enabled;
+      get_args(args, is_enabled);
+      execute(td_api::make_object<td_api::toggleSchedulerStatistics>(is_enabled));
+    } else if (op == "gss") {
+      execute(td_api::make_object<td_api::getSchedulerStatistics>());
     } else if (op == "alog" || op == "aloge") {
       int32 level;
       string text;
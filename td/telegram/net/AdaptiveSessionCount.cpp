@@ -0,0 +1,47 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/net/AdaptiveSessionCount.h"
+
+#include "td/utils/misc.h"
+
+namespace td {
+
+void AdaptiveSessionCount::set_limits(int32 min_session_count, int32 max_session_count) {
+  min_session_count_ = clamp(min_session_count, 1, 100);
+  max_session_count_ = clamp(max_session_count, min_session_count_, 100);
+}
+
+int32 AdaptiveSessionCount::on_period_finished(int32 session_count, const PeriodStatistics &statistics) {
+  if (statistics.rtt > 0.0) {
+    // the minimum slowly increases to follow network changes
+    min_rtt_ = min_rtt_ == 0.0 ? statistics.rtt : min(statistics.rtt, min_rtt_ * 1.02);
+  }
+  if (grow_delay_periods_ > 0) {
+    grow_delay_periods_--;
+  }
+
+  int32 change = 0;
+  if (last_session_count_change_ > 0 && statistics.throughput < last_throughput_ * 1.1) {
+    // the added session hasn't increased throughput; don't try to add it again for some time
+    change = -1;
+    grow_delay_periods_ = 6;
+  } else if (min_rtt_ > 0.0 && statistics.rtt > 3 * min_rtt_) {
+    // queries wait in network or server queues, so additional sessions would only increase the waiting time
+    change = -1;
+  } else if (statistics.busy_ratio >= 0.5 && grow_delay_periods_ == 0) {
+    change = 1;
+  } else if (statistics.busy_ratio < 0.1) {
+    change = -1;
+  }
+
+  auto new_session_count = clamp(session_count + change, min_session_count_, max_session_count_);
+  last_session_count_change_ = new_session_count - session_count;
+  last_throughput_ = statistics.throughput;
+  return new_session_count;
+}
+
+}  // namespace td
@@ -0,0 +1,59 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include "td/utils/common.h"
+
+namespace td {
+
+// chooses the number of active sessions of a SessionMultiProxy from statistics of the last period
+class AdaptiveSessionCount {
+ public:
+  struct PeriodStatistics {
+    double throughput = 0.0;  // bytes of finished queries per second
+    double rtt = 0.0;         // average RTT of finished queries or 0 if there are none
+    double busy_ratio = 0.0;  // share of sent queries for which even the least loaded session was busy
+  };
+
+  void set_limits(int32 min_session_count, int32 max_session_count);
+
+  int32 get_min_session_count() const {
+    return min_session_count_;
+  }
+
+  int32 get_max_session_count() const {
+    return max_session_count_;
+  }
+
+  double get_min_rtt() const {
+    return min_rtt_;
+  }
+
+  // returns the new number of active sessions
+  int32 on_period_finished(int32 session_count, const PeriodStatistics &statistics);
+
+  // returns the number of sessions to keep, if only the first active_session_count sessions receive new queries;
+  // other sessions are closed from the end after they finish all their queries
+  template <class GetQueryCountT>
+  static size_t get_kept_session_count(size_t session_count, size_t active_session_count,
+                                       const GetQueryCountT &get_query_count) {
+    while (session_count > active_session_count && get_query_count(session_count - 1) == 0) {
+      session_count--;
+    }
+    return max(session_count, active_session_count);
+  }
+
+ private:
+  int32 min_session_count_ = 1;
+  int32 max_session_count_ = 1;
+  double min_rtt_ = 0.0;
+  double last_throughput_ = 0.0;
+  int32 last_session_count_change_ = 0;
+  int32 grow_delay_periods_ = 0;
+};
+
+}  // namespace td
@@ -322,16 +322,17 @@ class NetQuery final : public TsListNode<NetQueryDebug> {
   static int32 tl_magic(const BufferSlice &buffer_slice);
 
  public:
-  int32 next_timeout_ = 1;          // for NetQueryDelayer
-  int32 total_timeout_ = 0;         // for NetQueryDelayer/SequenceDispatcher
-  int32 total_timeout_limit_ = 60;  // for NetQueryDelayer/SequenceDispatcher and to be set by caller
-  int32 last_timeout_ = 0;          // for NetQueryDelayer/SequenceDispatcher
-  string source_;                   // for NetQueryDelayer/SequenceDispatcher
-  int32 dispatch_ttl_ = -1;         // for NetQueryDispatcher and to be set by caller
-  int32 file_type_ = -1;            // to be set by caller
-  Slot cancel_slot_;                // for Session and to be set by caller
-  Promise<> quick_ack_promise_;     // for Session and to be set by caller
-  bool need_resend_on_503_ = true;  // for NetQueryDispatcher and to be set by caller
+  int32 next_timeout_ = 1;            // for NetQueryDelayer
+  int32 total_timeout_ = 0;           // for NetQueryDelayer/SequenceDispatcher
+  int32 total_timeout_limit_ = 60;    // for NetQueryDelayer/SequenceDispatcher and to be set by caller
+  int32 last_timeout_ = 0;            // for NetQueryDelayer/SequenceDispatcher
+  string source_;                     // for NetQueryDelayer/SequenceDispatcher
+  int32 dispatch_ttl_ = -1;           // for NetQueryDispatcher and to be set by caller
+  int32 file_type_ = -1;              // to be set by caller
+  Slot cancel_slot_;                  // for Session/NetQueryDeduplicator and to be set by caller
+  Promise<> quick_ack_promise_;       // for Session and to be set by caller
+  bool need_resend_on_503_ = true;    // for NetQueryDispatcher and to be set by caller
+  bool can_be_deduplicated_ = false;  // for NetQueryDispatcher and to be set by caller for read-only queries
 
   NetQuery(uint64 id, BufferSlice &&query, DcId dc_id, Type type, AuthFlag auth_flag, GzipFlag gzip_flag,
            int32 tl_constructor, int32 total_timeout_limit, NetQueryStats *stats, vector<ChainId> chain_ids);
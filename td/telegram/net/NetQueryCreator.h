@@ -41,6 +41,10 @@ class NetQueryCreator {
   NetQueryPtr create(uint64 id, const telegram_api::Function &function, vector<ChainId> &&chain_ids, DcId dc_id,
                      NetQuery::Type type, NetQuery::AuthFlag auth_flag);
 
+  NetQueryStats *get_net_query_stats() const {
+    return net_query_stats_.get();
+  }
+
  private:
   std::shared_ptr<NetQueryStats> net_query_stats_;
   ObjectPool<NetQuery> object_pool_;
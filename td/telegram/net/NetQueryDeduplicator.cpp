@@ -0,0 +1,115 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/net/NetQueryDeduplicator.h"
+
+#include "td/telegram/Global.h"
+
+#include "td/utils/algorithm.h"
+#include "td/utils/as.h"
+#include "td/utils/logging.h"
+#include "td/utils/Slice.h"
+#include "td/utils/Status.h"
+
+namespace td {
+
+string NetQueryDeduplicator::get_query_key(const NetQuery &query) {
+  auto query_slice = query.query().as_slice();
+  string key(8 + query_slice.size(), '\0');
+  MutableSlice key_slice(key);
+  as<int32>(key_slice.begin()) = query.dc_id().get_value();
+  key_slice[4] = static_cast<char>(query.dc_id().is_external());
+  key_slice[5] = static_cast<char>(query.type());
+  key_slice[6] = static_cast<char>(query.auth_flag());
+  key_slice[7] = static_cast<char>(query.gzip_flag());
+  key_slice.substr(8).copy_from(query_slice);
+  return key;
+}
+
+void NetQueryDeduplicator::add_query(NetQueryPtr query) {
+  CHECK(query->can_be_deduplicated_);
+  auto key = get_query_key(*query);
+  auto it = key_to_id_.find(key);
+  if (it != key_to_id_.end()) {
+    auto *group = container_.get(it->second);
+    CHECK(group != nullptr);
+    query->debug("wait for result of an identical query");
+    if (!query->cancel_slot_.empty()) {
+      // release the query as soon as it is canceled
+      query->cancel_slot_.set_event(EventCreator::raw(actor_id(), it->second));
+    }
+    group->waiting_queries_.push_back(std::move(query));
+    return;
+  }
+
+  // the query is sent as usual and its result is returned here after all resends
+  query->can_be_deduplicated_ = false;
+  QueryGroup group;
+  group.key_ = key;
+  group.callback_ = query->move_callback();
+  auto id = container_.create(std::move(group));
+  key_to_id_.emplace(std::move(key), id);
+  query->set_callback(actor_shared(this, id));
+  callback_->dispatch(std::move(query));
+}
+
+void NetQueryDeduplicator::on_result(NetQueryPtr query) {
+  auto id = get_link_token();
+  auto *group_ptr = container_.get(id);
+  CHECK(group_ptr != nullptr);
+  auto group = std::move(*group_ptr);
+  container_.erase(id);
+  key_to_id_.erase(group.key_);
+
+  query->can_be_deduplicated_ = true;  // restore the flag in case the query is resent by the callback
+  query->set_callback(std::move(group.callback_));
+
+  bool is_canceled = query->is_error() && query->error().code() == NetQuery::Canceled;
+  for (auto &waiting_query : group.waiting_queries_) {
+    waiting_query->cancel_slot_.clear_event();
+    if (is_canceled || waiting_query->update_is_ready()) {
+      // the waiting query will be sent again or is canceled itself
+    } else {
+      if (query->is_ok()) {
+        waiting_query->set_ok(query->ok().copy());
+      } else {
+        waiting_query->set_error(query->error().clone());
+      }
+      callback_->on_query_deduplicated(query->is_ok() ? query->ok().size() : 0);
+    }
+    callback_->dispatch(std::move(waiting_query));
+  }
+  LOG_IF(INFO, !group.waiting_queries_.empty())
+      << "Return result of " << query << " to " << group.waiting_queries_.size() << " identical queries";
+
+  callback_->dispatch(std::move(query));
+}
+
+void NetQueryDeduplicator::raw_event(const Event::Raw &event) {
+  auto *group = container_.get(event.u64);
+  if (group == nullptr) {
+    return;
+  }
+  for (auto &waiting_query : group->waiting_queries_) {
+    if (waiting_query->update_is_ready()) {
+      waiting_query->cancel_slot_.clear_event();
+      callback_->dispatch(std::move(waiting_query));
+    }
+  }
+  td::remove_if(group->waiting_queries_, [](const NetQueryPtr &waiting_query) { return waiting_query.empty(); });
+}
+
+void NetQueryDeduplicator::tear_down() {
+  container_.for_each([&](auto id, auto &group) {
+    for (auto &waiting_query : group.waiting_queries_) {
+      waiting_query->cancel_slot_.clear_event();
+      waiting_query->set_error(Global::request_aborted_error());
+      callback_->dispatch(std::move(waiting_query));
+    }
+  });
+}
+
+}  // namespace td
@@ -0,0 +1,61 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include "td/telegram/net/NetQuery.h"
+
+#include "td/actor/actor.h"
+
+#include "td/utils/common.h"
+#include "td/utils/Container.h"
+#include "td/utils/FlatHashMap.h"
+
+namespace td {
+
+// Sends only one of identical simultaneous queries with can_be_deduplicated_ flag
+// and completes the others with a copy of its result
+class NetQueryDeduplicator final : public NetQueryCallback {
+ public:
+  class Callback {
+   public:
+    Callback() = default;
+    Callback(const Callback &) = delete;
+    Callback &operator=(const Callback &) = delete;
+    virtual ~Callback() = default;
+
+    // the sent query, its result and the waiting queries are returned to NetQueryDispatcher
+    virtual void dispatch(NetQueryPtr query) = 0;
+
+    virtual void on_query_deduplicated(size_t answer_size) = 0;
+  };
+
+  NetQueryDeduplicator(ActorShared<> parent, unique_ptr<Callback> callback)
+      : parent_(std::move(parent)), callback_(std::move(callback)) {
+  }
+  void add_query(NetQueryPtr query);
+
+ private:
+  struct QueryGroup {
+    string key_;
+    ActorShared<NetQueryCallback> callback_;  // callback of the sent query
+    vector<NetQueryPtr> waiting_queries_;
+  };
+  Container<QueryGroup> container_;
+  FlatHashMap<string, uint64> key_to_id_;
+  ActorShared<> parent_;
+  unique_ptr<Callback> callback_;
+
+  static string get_query_key(const NetQuery &query);
+
+  void on_result(NetQueryPtr query) final;
+
+  void raw_event(const Event::Raw &event) final;
+
+  void tear_down() final;
+};
+
+}  // namespace td
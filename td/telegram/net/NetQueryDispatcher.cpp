@@ -10,7 +10,10 @@
 #include "td/telegram/net/AuthDataShared.h"
 #include "td/telegram/net/DcAuthManager.h"
 #include "td/telegram/net/NetQuery.h"
+#include "td/telegram/net/NetQueryCreator.h"
+#include "td/telegram/net/NetQueryDeduplicator.h"
 #include "td/telegram/net/NetQueryDelayer.h"
+#include "td/telegram/net/NetQueryStats.h"
 #include "td/telegram/net/PublicRsaKeySharedCdn.h"
 #include "td/telegram/net/PublicRsaKeySharedMain.h"
 #include "td/telegram/net/PublicRsaKeyWatchdog.h"
@@ -66,6 +69,12 @@ void NetQueryDispatcher::dispatch(NetQueryPtr net_query) {
     return;
   }
 
+  if (net_query->can_be_deduplicated_ && !net_query->is_ready() && net_query->invoke_after().empty()) {
+    net_query->debug("sent to NetQueryDeduplicator");
+    send_closure_later(deduplicator_, &NetQueryDeduplicator::add_query, std::move(net_query));
+    return;
+  }
+
   if (net_query->is_ready() && net_query->is_error()) {
     auto code = net_query->error().code();
     if (code == 303) {
@@ -173,6 +182,15 @@ Status NetQueryDispatcher::wait_dc_init(DcId dc_id, bool force) {
     int32 upload_session_count = (raw_dc_id != 2 && raw_dc_id != 4) || is_premium ? 8 : 4;
     int32 download_session_count = is_premium ? 8 : 2;
     int32 download_small_session_count = is_premium ? 8 : 2;
+    int32 media_session_count_min = get_media_session_count_min();
+    int32 media_session_count_max = get_media_session_count_max();
+    if (media_session_count_max > 0) {
+      // the session count will be adjusted to the load, so start within the bounds
+      upload_session_count = clamp(upload_session_count, media_session_count_min, media_session_count_max);
+      download_session_count = clamp(download_session_count, media_session_count_min, media_session_count_max);
+      download_small_session_count =
+          clamp(download_small_session_count, media_session_count_min, media_session_count_max);
+    }
     dc.main_session_ = create_actor_on_scheduler<SessionMultiProxy>(
         PSLICE() << "SessionMultiProxy:" << raw_dc_id << ":main", get_main_session_scheduler_id(), session_count,
         auth_data, true, raw_dc_id == main_dc_id_, use_pfs, false, false, is_cdn);
@@ -185,6 +203,14 @@ Status NetQueryDispatcher::wait_dc_init(DcId dc_id, bool force) {
     dc.download_small_session_ = create_actor_on_scheduler<SessionMultiProxy>(
         PSLICE() << "SessionMultiProxy:" << raw_dc_id << ":download_small", slow_net_scheduler_id,
         download_small_session_count, auth_data, false, false, use_pfs, true, true, is_cdn);
+    if (media_session_count_max > 0) {
+      send_closure_later(dc.upload_session_, &SessionMultiProxy::update_adaptive_session_count,
+                         media_session_count_min, media_session_count_max);
+      send_closure_later(dc.download_session_, &SessionMultiProxy::update_adaptive_session_count,
+                         media_session_count_min, media_session_count_max);
+      send_closure_later(dc.download_small_session_, &SessionMultiProxy::update_adaptive_session_count,
+                         media_session_count_min, media_session_count_max);
+    }
     dc.is_inited_ = true;
     if (dc_id.is_internal()) {
       send_closure_later(dc_auth_manager_, &DcAuthManager::add_dc, std::move(auth_data));
@@ -212,6 +238,7 @@ void NetQueryDispatcher::stop() {
   td_guard_.reset();
   stop_flag_ = true;
   delayer_.reset();
+  deduplicator_.reset();
   for (auto &dc : dcs_) {
     dc.main_session_.reset();
     dc.upload_session_.reset();
@@ -237,6 +264,23 @@ void NetQueryDispatcher::update_session_count() {
     }
   }
 }
+
+void NetQueryDispatcher::update_media_session_count() {
+  std::lock_guard<std::mutex> guard(main_dc_id_mutex_);
+  int32 media_session_count_min = get_media_session_count_min();
+  int32 media_session_count_max = get_media_session_count_max();
+  for (int32 i = 1; i < DcId::MAX_RAW_DC_ID; i++) {
+    if (is_dc_inited(i)) {
+      send_closure_later(dcs_[i - 1].upload_session_, &SessionMultiProxy::update_adaptive_session_count,
+                         media_session_count_min, media_session_count_max);
+      send_closure_later(dcs_[i - 1].download_session_, &SessionMultiProxy::update_adaptive_session_count,
+                         media_session_count_min, media_session_count_max);
+      send_closure_later(dcs_[i - 1].download_small_session_, &SessionMultiProxy::update_adaptive_session_count,
+                         media_session_count_min, media_session_count_max);
+    }
+  }
+}
+
 void NetQueryDispatcher::destroy_auth_keys(Promise<> promise) {
   for (int32 i = 1; i < DcId::MAX_RAW_DC_ID && i <= 5; i++) {
     auto dc_id = DcId::internal(i);
@@ -289,6 +333,19 @@ int32 NetQueryDispatcher::get_session_count() {
   return max(narrow_cast<int32>(G()->get_option_integer("session_count")), 1);
 }
 
+int32 NetQueryDispatcher::get_media_session_count_min() {
+  return clamp(narrow_cast<int32>(G()->get_option_integer("media_session_count_min", 1)), 1, 100);
+}
+
+// upload and download sessions use the adaptive session count only if the maximum is set
+int32 NetQueryDispatcher::get_media_session_count_max() {
+  auto max_count = narrow_cast<int32>(G()->get_option_integer("media_session_count_max"));
+  if (max_count <= 0) {
+    return 0;
+  }
+  return clamp(max_count, get_media_session_count_min(), 100);
+}
+
 bool NetQueryDispatcher::get_use_pfs() {
   return G()->get_option_boolean("use_pfs") || get_session_count() > 1;
 }
@@ -303,6 +360,21 @@ NetQueryDispatcher::NetQueryDispatcher(const std::function<ActorShared<>()> &cre
     main_dc_id_ = to_integer<int32>(s_main_dc_id);
   }
   delayer_ = create_actor<NetQueryDelayer>("NetQueryDelayer", create_reference());
+  class DeduplicatorCallback final : public NetQueryDeduplicator::Callback {
+   public:
+    void dispatch(NetQueryPtr query) final {
+      G()->net_query_dispatcher().dispatch(std::move(query));
+    }
+
+    void on_query_deduplicated(size_t answer_size) final {
+      auto *stats = G()->net_query_creator().get_net_query_stats();
+      if (stats != nullptr) {
+        stats->on_query_deduplicated(answer_size);
+      }
+    }
+  };
+  deduplicator_ = create_actor<NetQueryDeduplicator>("NetQueryDeduplicator", create_reference(),
+                                                     make_unique<DeduplicatorCallback>());
   dc_auth_manager_ =
       create_actor_on_scheduler<DcAuthManager>("DcAuthManager", get_main_session_scheduler_id(), create_reference());
   public_rsa_key_watchdog_ = create_actor<PublicRsaKeyWatchdog>("PublicRsaKeyWatchdog", create_reference());
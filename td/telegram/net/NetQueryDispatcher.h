@@ -26,6 +26,7 @@ namespace td {
 
 class DcAuthManager;
 class MultiSequenceDispatcher;
+class NetQueryDeduplicator;
 class NetQueryDelayer;
 class PublicRsaKeyWatchdog;
 class SessionMultiProxy;
@@ -45,6 +46,7 @@ class NetQueryDispatcher {
   void stop();
 
   void update_session_count();
+  void update_media_session_count();
   void destroy_auth_keys(Promise<> promise);
   void update_use_pfs();
   void update_mtproto_header();
@@ -60,6 +62,7 @@ class NetQueryDispatcher {
   std::atomic<bool> stop_flag_{false};
   bool need_destroy_auth_key_{false};
   ActorOwn<NetQueryDelayer> delayer_;
+  ActorOwn<NetQueryDeduplicator> deduplicator_;
   ActorOwn<DcAuthManager> dc_auth_manager_;
   ActorOwn<MultiSequenceDispatcher> sequence_dispatcher_;
   struct Dc {
@@ -87,6 +90,8 @@ class NetQueryDispatcher {
 
   static int32 get_main_session_scheduler_id();
   static int32 get_session_count();
+  static int32 get_media_session_count_min();
+  static int32 get_media_session_count_max();
   static bool get_use_pfs();
 
   static void complete_net_query(NetQueryPtr net_query);
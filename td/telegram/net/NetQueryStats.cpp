@@ -20,9 +20,18 @@ uint64 NetQueryStats::get_count() const {
   return count_.load(std::memory_order_relaxed);
 }
 
+uint64 NetQueryStats::get_deduplicated_query_count() const {
+  return deduplicated_query_count_.load(std::memory_order_relaxed);
+}
+
+uint64 NetQueryStats::get_deduplicated_answer_size() const {
+  return deduplicated_answer_size_.load(std::memory_order_relaxed);
+}
+
 void NetQueryStats::dump_pending_network_queries() {
   auto n = get_count();
-  LOG(WARNING) << tag("pending net queries", n);
+  LOG(WARNING) << tag("pending net queries", n) << tag("deduplicated net queries", get_deduplicated_query_count())
+               << tag("deduplicated answer size", format::as_size(get_deduplicated_answer_size()));
 
   if (!use_list_) {
     return;
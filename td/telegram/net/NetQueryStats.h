@@ -38,10 +38,21 @@ class NetQueryStats {
 
   uint64 get_count() const;
 
+  void on_query_deduplicated(size_t answer_size) {
+    deduplicated_query_count_.fetch_add(1, std::memory_order_relaxed);
+    deduplicated_answer_size_.fetch_add(answer_size, std::memory_order_relaxed);
+  }
+
+  uint64 get_deduplicated_query_count() const;
+
+  uint64 get_deduplicated_answer_size() const;
+
   void dump_pending_network_queries();
 
  private:
   NetQueryCounter::Counter count_{0};
+  std::atomic<uint64> deduplicated_query_count_{0};
+  std::atomic<uint64> deduplicated_answer_size_{0};
   std::atomic<bool> use_list_{true};
   TsList<NetQueryDebug> list_;
 };
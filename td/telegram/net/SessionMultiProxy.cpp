@@ -15,6 +15,7 @@
 #include "td/utils/Random.h"
 #include "td/utils/Slice.h"
 #include "td/utils/SliceBuilder.h"
+#include "td/utils/Time.h"
 
 namespace td {
 
@@ -37,20 +38,29 @@ SessionMultiProxy::SessionMultiProxy(int32 session_count, std::shared_ptr<AuthDa
 }
 
 void SessionMultiProxy::send(NetQueryPtr query) {
+  auto session_count = static_cast<size_t>(session_count_);
+  CHECK(session_count <= sessions_.size());
   size_t pos = 0;
+  bool is_balanced = false;
   if (query->auth_flag() == NetQuery::AuthFlag::On) {
     size_t session_rand = query->session_rand();
     if (session_rand) {
-      pos = session_rand % sessions_.size();
+      pos = session_rand % session_count;
     } else {
+      // in the adaptive mode queries are balanced by the number of bytes in flight instead of the number of queries
+      auto get_load = [&](size_t i) -> int64 {
+        return is_adaptive() ? sessions_[i].bytes_in_flight : sessions_[i].query_count;
+      };
+      is_balanced = true;
       size_t equal_count = 1;
-      int min_query_count = sessions_[pos].query_count;
-      for (size_t i = 1; i < sessions_.size(); i++) {
-        if (sessions_[i].query_count < min_query_count) {
+      int64 min_load = get_load(pos);
+      for (size_t i = 1; i < session_count; i++) {
+        auto load = get_load(i);
+        if (load < min_load) {
           pos = i;
-          min_query_count = sessions_[pos].query_count;
+          min_load = load;
           equal_count = 1;
-        } else if (sessions_[i].query_count == min_query_count) {
+        } else if (load == min_load) {
           equal_count++;
           if (Random::fast_uint32() % equal_count == 0) {
             pos = i;
@@ -60,8 +70,27 @@ void SessionMultiProxy::send(NetQueryPtr query) {
     }
   }
   // query->debug(PSTRING() << get_name() << ": send to proxy #" << pos);
-  sessions_[pos].query_count++;
-  send_closure(sessions_[pos].proxy, &SessionProxy::send, std::move(query));
+  auto &session = sessions_[pos];
+  if (is_adaptive()) {
+    if (!has_timeout()) {
+      reset_adaptive_period();
+      set_timeout_in(ADAPTIVE_PERIOD);
+    }
+    period_sent_query_count_++;
+    if (is_balanced && session.query_count > 0) {
+      // even the least loaded session is busy
+      period_busy_sent_query_count_++;
+    }
+
+    QueryInfo info;
+    info.query_size = static_cast<int64>(query->query().size());
+    info.expected_size = info.query_size + average_answer_size_;
+    info.sent_at = Time::now();
+    session.bytes_in_flight += info.expected_size;
+    session.queries[query->id()] = info;
+  }
+  session.query_count++;
+  send_closure(session.proxy, &SessionProxy::send, std::move(query));
 }
 
 void SessionMultiProxy::update_main_flag(bool is_main) {
@@ -80,6 +109,28 @@ void SessionMultiProxy::update_session_count(int32 session_count) {
   update_options(session_count, use_pfs_, need_destroy_auth_key_);
 }
 
+void SessionMultiProxy::update_adaptive_session_count(int32 min_session_count, int32 max_session_count) {
+  if (max_session_count <= 0) {
+    if (is_adaptive()) {
+      LOG(INFO) << "Disable adaptive session count";
+      is_adaptive_ = false;
+      cancel_timeout();
+      for (auto &session : sessions_) {
+        session.bytes_in_flight = 0;
+        session.queries.clear();
+      }
+    }
+    return;
+  }
+
+  is_adaptive_ = true;
+  adaptive_session_count_.set_limits(min_session_count, max_session_count);
+  auto min_count = adaptive_session_count_.get_min_session_count();
+  auto max_count = adaptive_session_count_.get_max_session_count();
+  LOG(INFO) << "Use adaptive session count from " << min_count << " to " << max_count;
+  set_active_session_count(clamp(session_count_, min_count, max_count));
+}
+
 void SessionMultiProxy::update_use_pfs(bool use_pfs) {
   update_options(session_count_, use_pfs, need_destroy_auth_key_);
 }
@@ -93,6 +144,10 @@ void SessionMultiProxy::update_options(int32 session_count, bool use_pfs, bool n
   bool is_changed = false;
 
   session_count = clamp(session_count, 1, 100);
+  if (is_adaptive()) {
+    session_count = clamp(session_count, adaptive_session_count_.get_min_session_count(),
+                          adaptive_session_count_.get_max_session_count());
+  }
   if (session_count != session_count_) {
     session_count_ = session_count;
     LOG(INFO) << "Update session_count to " << session_count_;
@@ -140,40 +195,128 @@ void SessionMultiProxy::init() {
     LOG(WARNING) << tag("session_count", session_count_);
   }
   for (int32 i = 0; i < session_count_; i++) {
-    string name = PSTRING() << "Session" << get_name().substr(Slice("SessionMulti").size())
-                            << format::cond(session_count_ > 1, format::concat("#", i));
-
-    SessionInfo info;
-    class Callback final : public SessionProxy::Callback {
-     public:
-      Callback(ActorId<SessionMultiProxy> parent, uint32 generation, int32 session_id)
-          : parent_(parent), generation_(generation), session_id_(session_id) {
-      }
-      void on_query_finished() final {
-        send_closure(parent_, &SessionMultiProxy::on_query_finished, generation_, session_id_);
-      }
+    create_session(i);
+  }
+}
+
+void SessionMultiProxy::create_session(int32 session_id) {
+  CHECK(static_cast<size_t>(session_id) == sessions_.size());
+  string name = PSTRING() << "Session" << get_name().substr(Slice("SessionMulti").size())
+                          << format::cond(session_count_ > 1 || is_adaptive(), format::concat("#", session_id));
+
+  SessionInfo info;
+  class Callback final : public SessionProxy::Callback {
+   public:
+    Callback(ActorId<SessionMultiProxy> parent, uint32 generation, int32 session_id)
+        : parent_(parent), generation_(generation), session_id_(session_id) {
+    }
+    void on_query_finished(uint64 query_id, size_t answer_size) final {
+      send_closure(parent_, &SessionMultiProxy::on_query_finished, generation_, session_id_, query_id, answer_size);
+    }
+
+   private:
+    ActorId<SessionMultiProxy> parent_;
+    uint32 generation_;
+    int32 session_id_;
+  };
+  info.proxy = create_actor<SessionProxy>(
+      name, make_unique<Callback>(actor_id(this), sessions_generation_, session_id), auth_data_, is_primary_, is_main_,
+      allow_media_only_, is_media_, get_pfs_flag(), session_count_ > 1 && is_primary_, is_cdn_,
+      need_destroy_auth_key_ && session_id == 0);
+  sessions_.push_back(std::move(info));
+}
+
+void SessionMultiProxy::set_active_session_count(int32 session_count) {
+  if (session_count == session_count_) {
+    return;
+  }
+  LOG(INFO) << "Change session count from " << session_count_ << " to " << session_count;
+  session_count_ = session_count;
+  if (sessions_.empty()) {
+    // sessions will be created in start_up
+    return;
+  }
+  update_sessions();
+}
 
-     private:
-      ActorId<SessionMultiProxy> parent_;
-      uint32 generation_;
-      int32 session_id_;
-    };
-    info.proxy =
-        create_actor<SessionProxy>(name, make_unique<Callback>(actor_id(this), sessions_generation_, i), auth_data_,
-                                   is_primary_, is_main_, allow_media_only_, is_media_, get_pfs_flag(),
-                                   session_count_ > 1 && is_primary_, is_cdn_, need_destroy_auth_key_ && i == 0);
-    sessions_.push_back(std::move(info));
+void SessionMultiProxy::update_sessions() {
+  // the last sessions receive no new queries after the session count is decreased and are closed when they become idle;
+  // if the session count is increased before that, they are reused
+  auto kept_session_count = AdaptiveSessionCount::get_kept_session_count(
+      sessions_.size(), static_cast<size_t>(session_count_), [&](size_t i) { return sessions_[i].query_count; });
+  while (sessions_.size() < kept_session_count) {
+    create_session(narrow_cast<int32>(sessions_.size()));
+  }
+  while (sessions_.size() > kept_session_count) {
+    sessions_.pop_back();
   }
 }
 
-void SessionMultiProxy::on_query_finished(uint32 generation, int session_id) {
+void SessionMultiProxy::reset_adaptive_period() {
+  period_start_time_ = Time::now();
+  period_finished_bytes_ = 0;
+  period_rtt_sum_ = 0.0;
+  period_finished_query_count_ = 0;
+  period_sent_query_count_ = 0;
+  period_busy_sent_query_count_ = 0;
+}
+
+void SessionMultiProxy::timeout_expired() {
+  adapt_session_count();
+}
+
+void SessionMultiProxy::adapt_session_count() {
+  if (!is_adaptive() || sessions_.empty()) {
+    return;
+  }
+  if (period_sent_query_count_ == 0 && period_finished_query_count_ == 0) {
+    // there is no load; the next query will start a new period
+    return;
+  }
+
+  double period = max(Time::now() - period_start_time_, 1e-3);
+  AdaptiveSessionCount::PeriodStatistics statistics;
+  statistics.throughput = static_cast<double>(period_finished_bytes_) / period;
+  statistics.rtt = period_finished_query_count_ == 0 ? 0.0 : period_rtt_sum_ / period_finished_query_count_;
+  statistics.busy_ratio = period_sent_query_count_ == 0
+                              ? 0.0
+                              : static_cast<double>(period_busy_sent_query_count_) / period_sent_query_count_;
+
+  auto new_session_count = adaptive_session_count_.on_period_finished(session_count_, statistics);
+  LOG(INFO) << "Have throughput " << static_cast<int64>(statistics.throughput / session_count_)
+            << " B/s per session, RTT " << statistics.rtt << " with minimum " << adaptive_session_count_.get_min_rtt()
+            << ", busy ratio " << statistics.busy_ratio << " with " << session_count_
+            << " sessions, new session count is " << new_session_count;
+  set_active_session_count(new_session_count);
+
+  reset_adaptive_period();
+  set_timeout_in(ADAPTIVE_PERIOD);
+}
+
+void SessionMultiProxy::on_query_finished(uint32 generation, int session_id, uint64 query_id, size_t answer_size) {
   if (generation != sessions_generation_) {
     return;
   }
   CHECK(static_cast<size_t>(session_id) < sessions_.size());
-  auto &query_count = sessions_[session_id].query_count;
-  CHECK(query_count > 0);
-  query_count--;
+  auto &session = sessions_[session_id];
+  CHECK(session.query_count > 0);
+  session.query_count--;
+
+  auto it = session.queries.find(query_id);
+  if (it != session.queries.end()) {
+    const auto &info = it->second;
+    session.bytes_in_flight -= info.expected_size;
+    if (answer_size > 0) {
+      auto size = static_cast<int64>(answer_size);
+      average_answer_size_ = average_answer_size_ == 0 ? size : (average_answer_size_ * 7 + size) / 8;
+      period_finished_bytes_ += info.query_size + size;
+      period_rtt_sum_ += Time::now() - info.sent_at;
+      period_finished_query_count_++;
+    }
+    session.queries.erase(it);
+  }
+
+  update_sessions();
 }
 
 }  // namespace td
@@ -6,11 +6,15 @@
 //
 #pragma once
 
+#include "td/telegram/net/AdaptiveSessionCount.h"
 #include "td/telegram/net/AuthDataShared.h"
 #include "td/telegram/net/NetQuery.h"
 
 #include "td/actor/actor.h"
 
+#include "td/utils/common.h"
+#include "td/utils/FlatHashMap.h"
+
 #include <memory>
 
 namespace td {
@@ -29,6 +33,9 @@ class SessionMultiProxy final : public Actor {
   void update_main_flag(bool is_main);
 
   void update_session_count(int32 session_count);
+  // the session count is adjusted to the load within [min_session_count, max_session_count];
+  // the adaptive mode is disabled if max_session_count is 0
+  void update_adaptive_session_count(int32 min_session_count, int32 max_session_count);
   void update_use_pfs(bool use_pfs);
   void update_options(int32 session_count, bool use_pfs, bool need_destroy_auth_key);
   void update_mtproto_header();
@@ -45,19 +52,48 @@ class SessionMultiProxy final : public Actor {
   bool is_media_ = false;
   bool is_cdn_ = false;
   bool need_destroy_auth_key_ = false;
+  struct QueryInfo {
+    int64 query_size{0};
+    int64 expected_size{0};
+    double sent_at{0};
+  };
   struct SessionInfo {
     ActorOwn<SessionProxy> proxy;
     int query_count{0};
+    int64 bytes_in_flight{0};
+    FlatHashMap<uint64, QueryInfo> queries;
   };
   uint32 sessions_generation_{0};
-  std::vector<SessionInfo> sessions_;
+  std::vector<SessionInfo> sessions_;  // sessions after the first session_count_ are closed after finishing queries
+
+  static constexpr double ADAPTIVE_PERIOD = 5.0;
+  bool is_adaptive_ = false;
+  AdaptiveSessionCount adaptive_session_count_;
+  int64 average_answer_size_ = 0;
+  double period_start_time_ = 0.0;
+  int64 period_finished_bytes_ = 0;
+  double period_rtt_sum_ = 0.0;
+  int32 period_finished_query_count_ = 0;
+  int32 period_sent_query_count_ = 0;
+  int32 period_busy_sent_query_count_ = 0;
 
   void start_up() final;
+  void timeout_expired() final;
   void init();
+  void create_session(int32 session_id);
 
   bool get_pfs_flag() const;
 
-  void on_query_finished(uint32 generation, int session_id);
+  bool is_adaptive() const {
+    return is_adaptive_;
+  }
+
+  void set_active_session_count(int32 session_count);
+  void update_sessions();
+  void reset_adaptive_period();
+  void adapt_session_count();
+
+  void on_query_finished(uint32 generation, int session_id, uint64 query_id, size_t answer_size);
 };
 
 }  // namespace td
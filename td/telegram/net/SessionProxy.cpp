@@ -78,7 +78,7 @@ class SessionCallback final : public Session::Callback {
 
   void on_result(NetQueryPtr query) final {
     if (UniqueId::extract_type(query->id()) != UniqueId::BindKey) {
-      send_closure(parent_, &SessionProxy::on_query_finished);
+      send_closure(parent_, &SessionProxy::on_query_finished, query->id(), query->is_ok() ? query->ok().size() : 0);
     }
     G()->net_query_dispatcher().dispatch(std::move(query));
   }
@@ -145,7 +145,7 @@ void SessionProxy::start_up() {
 void SessionProxy::tear_down() {
   for (auto &query : pending_queries_) {
     query->resend();
-    callback_->on_query_finished();
+    callback_->on_query_finished(query->id(), 0);
     G()->net_query_dispatcher().dispatch(std::move(query));
   }
   pending_queries_.clear();
@@ -274,8 +274,8 @@ void SessionProxy::on_server_salt_updated(std::vector<mtproto::ServerSalt> serve
   server_salts_ = std::move(server_salts);
 }
 
-void SessionProxy::on_query_finished() {
-  callback_->on_query_finished();
+void SessionProxy::on_query_finished(uint64 query_id, size_t answer_size) {
+  callback_->on_query_finished(query_id, answer_size);
 }
 
 }  // namespace td
@@ -29,7 +29,7 @@ class SessionProxy final : public Actor {
   class Callback {
    public:
     virtual ~Callback() = default;
-    virtual void on_query_finished() = 0;
+    virtual void on_query_finished(uint64 query_id, size_t answer_size) = 0;
   };
 
   SessionProxy(unique_ptr<Callback> callback, std::shared_ptr<AuthDataShared> shared_auth_data, bool is_primary,
@@ -69,7 +69,7 @@ class SessionProxy final : public Actor {
   void on_tmp_auth_key_updated(mtproto::AuthKey auth_key);
   void on_server_salt_updated(std::vector<mtproto::ServerSalt> server_salts);
 
-  void on_query_finished();
+  void on_query_finished(uint64 query_id, size_t answer_size);
 
   string tmp_auth_key_key() const;
 
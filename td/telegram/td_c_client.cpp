@@ -10,6 +10,7 @@
 #include "td/telegram/Log.h"
 #include "td/telegram/td_tdc_api_inner.h"
 
+#include <cstddef>
 #include <cstring>
 
 static td::ClientManager *GetClientManager() {
@@ -34,6 +35,19 @@ TdResponse TdCClientReceive(double timeout) {
   return c_response;
 }
 
+int TdCClientReceiveBatch(int max_count, double timeout, TdResponse *responses) {
+  if (max_count <= 0 || responses == nullptr) {
+    return 0;
+  }
+  auto batch = GetClientManager()->receive_batch(static_cast<std::size_t>(max_count), timeout);
+  for (std::size_t i = 0; i < batch.size(); i++) {
+    responses[i].client_id = batch[i].client_id;
+    responses[i].request_id = batch[i].request_id;
+    responses[i].object = TdConvertFromInternal(*batch[i].object);
+  }
+  return static_cast<int>(batch.size());
+}
+
 TdObject *TdCClientExecute(TdFunction *function) {
   auto result = td::ClientManager::execute(TdConvertToInternal(function));
   TdDestroyObjectFunction(function);
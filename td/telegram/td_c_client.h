@@ -34,6 +34,8 @@ void TdCClientSend(int client_id, struct TdRequest request);
 
 struct TdResponse TdCClientReceive(double timeout);
 
+int TdCClientReceiveBatch(int max_count, double timeout, struct TdResponse *responses);
+
 struct TdObject *TdCClientExecute(struct TdFunction *function);
 
 #ifdef __cplusplus
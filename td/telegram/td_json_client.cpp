@@ -43,10 +43,18 @@ const char *td_receive(double timeout) {
   return td::json_receive(timeout);
 }
 
+const char *td_receive_batch(int max_count, double timeout) {
+  return td::json_receive_batch(max_count, timeout);
+}
+
 const char *td_execute(const char *request) {
   return td::json_execute(td::Slice(request == nullptr ? "" : request));
 }
 
+int td_set_thread_topology(int instance_count, int thread_count, unsigned long long thread_affinity_mask) {
+  return td::ClientManager::set_thread_topology(instance_count, thread_count, thread_affinity_mask) ? 1 : 0;
+}
+
 void td_set_log_message_callback(int max_verbosity_level, td_log_message_callback_ptr callback) {
   td::ClientManager::set_log_message_callback(max_verbosity_level, callback);
 }
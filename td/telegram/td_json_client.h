@@ -76,6 +76,19 @@ TDJSON_EXPORT void td_send(int client_id, const char *request);
  */
 TDJSON_EXPORT const char *td_receive(double timeout);
 
+/**
+ * Receives multiple incoming updates and request responses at once. Waits only for the first update or response,
+ * then returns all immediately available updates and responses up to the specified limit.
+ * Must not be called simultaneously from two different threads or simultaneously with td_receive.
+ * The returned pointer can be used until the next call to td_receive, td_receive_batch or td_execute, after which it
+ * will be deallocated by TDLib.
+ * \param[in] max_count The maximum number of updates and responses to return.
+ * \param[in] timeout The maximum number of seconds allowed for this function to wait for new data.
+ * \return JSON-serialized null-terminated array of incoming updates and request responses in the order they were
+ *         received. May be NULL if the timeout expires.
+ */
+TDJSON_EXPORT const char *td_receive_batch(int max_count, double timeout);
+
 /**
  * Synchronously executes a TDLib request.
  * A request can be executed synchronously, only if it is documented with "Can be called synchronously".
@@ -85,6 +98,18 @@ TDJSON_EXPORT const char *td_receive(double timeout);
  */
 TDJSON_EXPORT const char *td_execute(const char *request);
 
+/**
+ * Changes the layout of internal threads, which are used by TDLib client instances.
+ * Can be called only while there are no active TDLib client instances, i.e., before the first request is sent through
+ * td_send, or after all client instances are closed. The total number of threads must be less than 128.
+ * \param[in] instance_count The number of instance groups, each having its own set of threads;
+ *                           pass 0 to choose it based on the number of CPU cores.
+ * \param[in] thread_count The number of threads in each instance group; pass 0 to use the default value.
+ * \param[in] thread_affinity_mask CPU affinity mask for all threads; pass 0 to not change thread affinity.
+ * \return 1 if the topology was changed, 0 otherwise.
+ */
+TDJSON_EXPORT int td_set_thread_topology(int instance_count, int thread_count, unsigned long long thread_affinity_mask);
+
 /**
  * A type of callback function that will be called when a message is added to the internal TDLib log.
  *
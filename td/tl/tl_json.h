@@ -13,11 +13,13 @@
 #include "td/utils/format.h"
 #include "td/utils/JsonBuilder.h"
 #include "td/utils/misc.h"
+#include "td/utils/Parser.h"
 #include "td/utils/Slice.h"
 #include "td/utils/SliceBuilder.h"
 #include "td/utils/Status.h"
 #include "td/utils/TlDowncastHelper.h"
 
+#include <limits>
 #include <type_traits>
 
 namespace td {
@@ -151,7 +153,7 @@ Status from_json(std::vector<T> &to, JsonValue from) {
 }
 
 template <class T>
-std::enable_if_t<!std::is_constructible<T>::value, Status> from_json(tl_object_ptr<T> &to, JsonValue from) {
+Status from_json(tl_object_ptr<T> &to, JsonValue from) {
   if (from.type() != JsonValue::Type::Object) {
     if (from.type() == JsonValue::Type::Null) {
       to = nullptr;
@@ -160,8 +162,237 @@ std::enable_if_t<!std::is_constructible<T>::value, Status> from_json(tl_object_p
     return Status::Error(PSLICE() << "Expected Object, but receive " << from.type());
   }
 
-  auto &object = from.get_object();
-  TRY_RESULT(constructor_value, object.extract_required_field("@type", JsonValue::Type::Null));
+  // TL objects are parsed only from a JSON string, so the already parsed JSON object is serialized back
+  auto json = json_encode<string>(from);
+  Parser parser(json);
+  return from_json(to, parser, std::numeric_limits<int32>::max());
+}
+
+// the following functions parse TL objects directly from a JSON string without building a JsonValue tree;
+// as in JsonObject, only the first occurrence of a field is used and all subsequent occurrences are ignored
+
+inline Status from_json(int32 &to, Parser &parser, int32 max_depth) {
+  TRY_RESULT(value, do_json_decode(parser, max_depth));
+  return from_json(to, std::move(value));
+}
+
+inline Status from_json(bool &to, Parser &parser, int32 max_depth) {
+  TRY_RESULT(value, do_json_decode(parser, max_depth));
+  return from_json(to, std::move(value));
+}
+
+inline Status from_json(int64 &to, Parser &parser, int32 max_depth) {
+  TRY_RESULT(value, do_json_decode(parser, max_depth));
+  return from_json(to, std::move(value));
+}
+
+inline Status from_json(double &to, Parser &parser, int32 max_depth) {
+  TRY_RESULT(value, do_json_decode(parser, max_depth));
+  return from_json(to, std::move(value));
+}
+
+inline Status from_json(string &to, Parser &parser, int32 max_depth) {
+  TRY_RESULT(value, do_json_decode(parser, max_depth));
+  return from_json(to, std::move(value));
+}
+
+inline Status from_json_bytes(string &to, Parser &parser, int32 max_depth) {
+  TRY_RESULT(value, do_json_decode(parser, max_depth));
+  return from_json_bytes(to, std::move(value));
+}
+
+// parses a value, which isn't an array or an object, so it must be null
+inline Status json_parse_null(Parser &parser, int32 max_depth, Slice expected_type) {
+  TRY_RESULT(value, do_json_decode(parser, max_depth));
+  if (value.type() != JsonValue::Type::Null) {
+    return Status::Error(PSLICE() << "Expected " << expected_type << ", but receive " << value.type());
+  }
+  return Status::OK();
+}
+
+// parses fields of a JSON object, whose opening '{' has already been skipped
+class JsonObjectStreamParser {
+ public:
+  static constexpr size_t MAX_FIELD_COUNT = 64;
+
+  JsonObjectStreamParser(Parser &parser, int32 max_depth, bool has_previous_field, string *extra)
+      : parser_(parser), max_depth_(max_depth), has_previous_field_(has_previous_field), extra_(extra) {
+  }
+
+  // returns index of the next not yet seen field from field_names or -1 if the object has ended;
+  // all other fields are skipped
+  template <size_t N>
+  Result<int32> next_field(const Slice (&field_names)[N]) {
+    static_assert(N <= MAX_FIELD_COUNT, "Too many fields");
+    return next_field(field_names, N);
+  }
+
+  Result<int32> next_field(const Slice *field_names, size_t field_count) {
+    while (true) {
+      parser_.skip_whitespaces();
+      if (parser_.try_skip('}')) {
+        return -1;
+      }
+      if (has_previous_field_) {
+        if (!parser_.try_skip(',')) {
+          return Status::Error("Unexpected symbol while parsing JSON Object");
+        }
+        parser_.skip_whitespaces();
+      }
+      has_previous_field_ = true;
+      TRY_RESULT(field, json_string_decode(parser_));
+      parser_.skip_whitespaces();
+      if (!parser_.try_skip(':')) {
+        return Status::Error("':' expected");
+      }
+
+      for (size_t i = 0; i < field_count; i++) {
+        if (field == field_names[i]) {
+          auto mask = static_cast<uint64>(1) << i;
+          if ((seen_fields_ & mask) != 0) {
+            break;
+          }
+          seen_fields_ |= mask;
+          return static_cast<int32>(i);
+        }
+      }
+      if (extra_ != nullptr && !has_extra_ && field == "@extra") {
+        has_extra_ = true;
+        TRY_RESULT(value, do_json_decode(parser_, max_depth_));
+        *extra_ = json_encode<string>(value);
+        continue;
+      }
+      TRY_STATUS(do_json_skip(parser_, max_depth_));
+    }
+  }
+
+  Status skip_fields() {
+    TRY_RESULT(field_index, next_field(nullptr, 0));
+    CHECK(field_index == -1);
+    return Status::OK();
+  }
+
+  template <class T>
+  Status read(T &to) {
+    return from_json(to, parser_, max_depth_);
+  }
+
+  Status read_bytes(string &to) {
+    return from_json_bytes(to, parser_, max_depth_);
+  }
+
+ private:
+  Parser &parser_;
+  int32 max_depth_;
+  bool has_previous_field_;
+  bool has_extra_ = false;
+  uint64 seen_fields_ = 0;
+  string *extra_;
+};
+
+// returns the raw value of the first field "@type" of a JSON object, whose opening '{' has already been skipped;
+// the string isn't changed
+inline Result<string> get_json_object_type_value(MutableSlice data, int32 max_depth) {
+  Parser parser(data);
+  parser.skip_whitespaces();
+  if (!parser.try_skip('}')) {
+    while (true) {
+      auto name_begin = parser.data().begin();
+      TRY_STATUS(json_string_skip(parser));
+      Slice name(name_begin, parser.data().begin());
+      bool is_type = name == "\"@type\"";
+      if (!is_type && name.find('\\') != Slice::npos) {
+        auto name_copy = name.str();
+        Parser name_parser(name_copy);
+        TRY_RESULT(decoded_name, json_string_decode(name_parser));
+        is_type = decoded_name == "@type";
+      }
+      parser.skip_whitespaces();
+      if (!parser.try_skip(':')) {
+        return Status::Error("':' expected");
+      }
+      parser.skip_whitespaces();
+      auto value_begin = parser.data().begin();
+      TRY_STATUS(do_json_skip(parser, max_depth));
+      if (is_type) {
+        return Slice(value_begin, parser.data().begin()).str();
+      }
+
+      parser.skip_whitespaces();
+      if (parser.try_skip('}')) {
+        break;
+      }
+      if (!parser.try_skip(',')) {
+        return Status::Error("Unexpected symbol while parsing JSON Object");
+      }
+      parser.skip_whitespaces();
+    }
+  }
+  return Status::Error(400, "Can't find field \"@type\"");
+}
+
+template <class T>
+Status from_json(std::vector<T> &to, Parser &parser, int32 max_depth) {
+  parser.skip_whitespaces();
+  if (parser.peek_char() != '[') {
+    return json_parse_null(parser, max_depth, "Array");
+  }
+  if (max_depth <= 0) {
+    return Status::Error("Too big object depth");
+  }
+  parser.skip('[');
+  parser.skip_whitespaces();
+  to.clear();
+  if (parser.try_skip(']')) {
+    return Status::OK();
+  }
+  while (true) {
+    T value{};
+    TRY_STATUS(from_json(value, parser, max_depth - 1));
+    to.push_back(std::move(value));
+
+    parser.skip_whitespaces();
+    if (parser.try_skip(']')) {
+      return Status::OK();
+    }
+    if (!parser.try_skip(',')) {
+      return Status::Error("Unexpected symbol while parsing JSON Array");
+    }
+  }
+}
+
+template <class T>
+std::enable_if_t<!std::is_constructible<T>::value, Status> from_json(tl_object_ptr<T> &to, Parser &parser,
+                                                                     int32 max_depth, string *extra = nullptr) {
+  parser.skip_whitespaces();
+  if (parser.peek_char() != '{') {
+    TRY_STATUS(json_parse_null(parser, max_depth, "Object"));
+    to = nullptr;
+    return Status::OK();
+  }
+  if (max_depth <= 0) {
+    return Status::Error("Too big object depth");
+  }
+  Parser object_parser(parser.data());
+  object_parser.skip('{');
+  object_parser.skip_whitespaces();
+  bool has_previous_field = true;
+  string type_value;
+  Result<JsonValue> r_constructor_value;
+  if (object_parser.try_skip("\"@type\"")) {
+    object_parser.skip_whitespaces();
+    if (!object_parser.try_skip(':')) {
+      return Status::Error("':' expected");
+    }
+    r_constructor_value = do_json_decode(object_parser, max_depth - 1);
+  } else {
+    // the field "@type" must be found first; the object is then parsed from the beginning
+    TRY_RESULT_ASSIGN(type_value, get_json_object_type_value(object_parser.data(), max_depth - 1));
+    Parser type_parser(type_value);
+    r_constructor_value = do_json_decode(type_parser, max_depth - 1);
+    has_previous_field = false;
+  }
+  TRY_RESULT(constructor_value, std::move(r_constructor_value));
   int32 constructor = 0;
   if (constructor_value.type() == JsonValue::Type::Number) {
     constructor = to_integer<int32>(constructor_value.get_number());
@@ -173,9 +404,10 @@ std::enable_if_t<!std::is_constructible<T>::value, Status> from_json(tl_object_p
 
   TlDowncastHelper<T> helper(constructor);
   Status status;
+  JsonObjectStreamParser fields(object_parser, max_depth - 1, has_previous_field, extra);
   bool ok = downcast_call(static_cast<T &>(helper), [&](auto &dummy) {
     auto result = make_tl_object<std::decay_t<decltype(dummy)>>();
-    status = from_json(*result, object);
+    status = from_json(*result, fields);
     to = std::move(result);
   });
   TRY_STATUS(std::move(status));
@@ -183,20 +415,26 @@ std::enable_if_t<!std::is_constructible<T>::value, Status> from_json(tl_object_p
     return Status::Error(PSLICE() << "Unknown constructor " << format::as_hex(constructor));
   }
 
+  parser.advance(object_parser.data().begin() - parser.data().begin());
   return Status::OK();
 }
 
 template <class T>
-std::enable_if_t<std::is_constructible<T>::value, Status> from_json(tl_object_ptr<T> &to, JsonValue from) {
-  if (from.type() != JsonValue::Type::Object) {
-    if (from.type() == JsonValue::Type::Null) {
-      to = nullptr;
-      return Status::OK();
-    }
-    return Status::Error(PSLICE() << "Expected Object, but receive " << from.type());
+std::enable_if_t<std::is_constructible<T>::value, Status> from_json(tl_object_ptr<T> &to, Parser &parser,
+                                                                    int32 max_depth) {
+  parser.skip_whitespaces();
+  if (parser.peek_char() != '{') {
+    TRY_STATUS(json_parse_null(parser, max_depth, "Object"));
+    to = nullptr;
+    return Status::OK();
+  }
+  if (max_depth <= 0) {
+    return Status::Error("Too big object depth");
   }
+  parser.skip('{');
   to = make_tl_object<T>();
-  return from_json(*to, from.get_object());
+  JsonObjectStreamParser fields(parser, max_depth - 1, false, nullptr);
+  return from_json(*to, fields);
 }
 
 }  // namespace td
@@ -11,6 +11,7 @@
 #include "td/utils/port/thread_local.h"
 #include "td/utils/ScopeGuard.h"
 
+#include <atomic>
 #include <memory>
 
 namespace td {
@@ -38,6 +39,9 @@ ConcurrentScheduler::ConcurrentScheduler(int32 additional_thread_count, uint64 t
   extra_scheduler_ = 0;
 #endif
 
+  static std::atomic<int32> next_group_id{0};
+  auto group_id = ++next_group_id;
+
   schedulers_.resize(additional_thread_count + extra_scheduler_);
   for (int32 i = 0; i < additional_thread_count + extra_scheduler_; i++) {
     auto &sched = schedulers_[i];
@@ -52,6 +56,7 @@ ConcurrentScheduler::ConcurrentScheduler(int32 additional_thread_count, uint64 t
 #endif
 
     sched->init(i, outbound, static_cast<Scheduler::Callback *>(this));
+    sched->set_group_id(group_id);
   }
 
 #if TD_PORT_WINDOWS
@@ -62,6 +67,26 @@ ConcurrentScheduler::ConcurrentScheduler(int32 additional_thread_count, uint64 t
   state_ = State::Start;
 }
 
+void ConcurrentScheduler::enable_work_stealing() {
+  CHECK(state_ == State::Start);
+  // the extra scheduler isn't run by any thread, so it can't take actors
+  vector<Scheduler *> peers;
+  for (size_t i = 0; i + extra_scheduler_ < schedulers_.size(); i++) {
+    peers.push_back(schedulers_[i].get());
+  }
+  for (auto *sched : peers) {
+    sched->init_work_stealing(peers);
+  }
+}
+
+uint64 ConcurrentScheduler::get_processed_event_count() const {
+  uint64 result = 0;
+  for (auto &sched : schedulers_) {
+    result += sched->get_processed_event_count();
+  }
+  return result;
+}
+
 void ConcurrentScheduler::test_one_thread_run() {
   do {
     for (auto &sched : schedulers_) {
@@ -44,8 +44,14 @@ class ConcurrentScheduler final : private Scheduler::Callback {
     return schedulers_.back()->get_const_guard();
   }
 
+  // allows idle schedulers to take over migratable actors from busy ones; must be called before start()
+  void enable_work_stealing();
+
   void test_one_thread_run();
 
+  // returns total number of events processed by all schedulers; can be called from any thread
+  uint64 get_processed_event_count() const;
+
   bool is_finished() const {
     return is_finished_.load(std::memory_order_relaxed);
   }
@@ -75,6 +75,10 @@ class Actor : public ObserverBase {
   void migrate(int32 sched_id);
   void do_migrate(int32 sched_id);
 
+  // allows idle schedulers to take the actor over, if work stealing is enabled
+  // the actor must not own file descriptors or rely on scheduler-local storage
+  void set_migratable(bool is_migratable);
+
   uint64 get_link_token();
   std::weak_ptr<ActorContext> get_context_weak_ptr() const;
   std::shared_ptr<ActorContext> set_context(std::shared_ptr<ActorContext> context);
@@ -23,6 +23,7 @@
 namespace td {
 
 class Actor;
+struct ActorStatisticsCounters;
 
 class ActorContext {
  public:
@@ -108,14 +109,22 @@ class ActorInfo final
   bool need_context() const;
   bool need_start_up() const;
 
+  void set_migratable(bool is_migratable);
+  bool is_migratable() const;
+
+  void set_statistics(ActorStatisticsCounters *statistics);
+  ActorStatisticsCounters *get_statistics() const;
+
  private:
   Deleter deleter_ = Deleter::None;
   bool need_context_ = true;
   bool need_start_up_ = true;
   bool is_running_ = false;
+  bool is_migratable_ = false;
 
   std::atomic<int32> sched_id_{0};
   Actor *actor_ = nullptr;
+  ActorStatisticsCounters *statistics_ = nullptr;  // owned by the scheduler
 
 #ifdef TD_DEBUG
   string name_;
@@ -50,6 +50,8 @@ inline void ActorInfo::init(int32 sched_id, Slice name, ObjectPool<ActorInfo>::O
   need_context_ = need_context;
   need_start_up_ = need_start_up;
   is_running_ = false;
+  is_migratable_ = false;
+  statistics_ = nullptr;
 }
 
 inline bool ActorInfo::need_context() const {
@@ -60,6 +62,22 @@ inline bool ActorInfo::need_start_up() const {
   return need_start_up_;
 }
 
+inline void ActorInfo::set_migratable(bool is_migratable) {
+  is_migratable_ = is_migratable;
+}
+
+inline bool ActorInfo::is_migratable() const {
+  return is_migratable_;
+}
+
+inline void ActorInfo::set_statistics(ActorStatisticsCounters *statistics) {
+  statistics_ = statistics;
+}
+
+inline ActorStatisticsCounters *ActorInfo::get_statistics() const {
+  return statistics_;
+}
+
 inline void ActorInfo::on_actor_moved(Actor *actor_new_ptr) {
   actor_ = actor_new_ptr;
 }
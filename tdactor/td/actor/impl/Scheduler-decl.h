@@ -28,6 +28,7 @@
 #include "td/utils/Time.h"
 #include "td/utils/type_traits.h"
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <type_traits>
@@ -41,6 +42,26 @@ class ActorInfo;
 
 enum class ActorSendType { Immediate, Later };
 
+struct ActorStatistics {
+  string name;
+  uint64 event_count = 0;
+  double run_time = 0.0;  // includes time spent in nested immediately executed events of other actors
+  size_t max_mailbox_size = 0;
+};
+
+struct SchedulerStatistics {
+  int32 group_id = 0;
+  int32 sched_id = 0;
+  uint64 loop_count = 0;
+  double busy_time = 0.0;
+  double poll_time = 0.0;
+  size_t timeout_count = 0;
+  size_t max_timeout_count = 0;
+  vector<ActorStatistics> actors;  // aggregated by actor name
+};
+
+class SchedulerStatisticsStorage;
+
 class Scheduler;
 class SchedulerGuard {
  public:
@@ -71,7 +92,7 @@ class Scheduler {
     virtual void on_finish() = 0;
     virtual void register_at_finish(std::function<void()>) = 0;
   };
-  Scheduler() = default;
+  Scheduler();
   Scheduler(const Scheduler &) = delete;
   Scheduler &operator=(const Scheduler &) = delete;
   Scheduler(Scheduler &&) = delete;
@@ -80,6 +101,12 @@ class Scheduler {
 
   void init(int32 id, std::vector<std::shared_ptr<MpscPollableQueue<EventFull>>> outbound, Callback *callback);
 
+  // must be called before the scheduler is run; peers must include the scheduler itself
+  void init_work_stealing(vector<Scheduler *> peers);
+
+  // must be called before the scheduler is run; schedulers of one ConcurrentScheduler have the same group identifier
+  void set_group_id(int32 group_id);
+
   int32 sched_id() const;
   int32 sched_count() const;
 
@@ -98,6 +125,25 @@ class Scheduler {
   void send_to_scheduler(int32 sched_id, const ActorId<> &actor_id, Event &&event);
   void send_to_other_scheduler(int32 sched_id, const ActorId<> &actor_id, Event &&event);
 
+  struct OutboundBatchStats {
+    uint64 batch_count = 0;   // number of flushed batches
+    uint64 event_count = 0;   // number of events sent in batches
+    uint64 wakeup_count = 0;  // number of event fd writes, caused by the batches
+  };
+  // can be called from any thread
+  OutboundBatchStats get_outbound_batch_stats() const;
+
+  // returns total number of events processed by actors of the scheduler; can be called from any thread
+  uint64 get_processed_event_count() const {
+    return processed_event_count_.load(std::memory_order_relaxed);
+  }
+
+  // statistics are collected by all running schedulers in the process while enabled
+  // actor names are known only for actors created after statistics were enabled or in debug builds;
+  // other actors aren't included in per-actor statistics
+  static void set_statistics_enabled(bool is_enabled);
+  static vector<SchedulerStatistics> get_statistics();
+
   void run_on_scheduler(int32 sched_id, Promise<Unit> action);  // TODO Action
 
   template <class T>
@@ -196,11 +242,21 @@ class Scheduler {
 
   void flush_mailbox(ActorInfo *actor_info);
 
+  void flush_outbound_batches();
+  void flush_outbound_batch(int32 sched_id);
+
+  void update_statistics_state();
+  void init_actor_statistics(ActorInfo *actor_info, Slice name);
+  void on_actor_run(ActorInfo *actor_info, size_t event_count, double run_time);
+
   template <ActorSendType send_type, class RunFuncT, class EventFuncT>
   void send_impl(const ActorId<> &actor_id, const RunFuncT &run_func, const EventFuncT &event_func);
 
   Timestamp run_timeout();
   void run_mailbox();
+  bool request_work();
+  void give_work(ListNode &actors_list);
+  void set_has_spare_actors(bool has_spare_actors);
   Timestamp run_events(Timestamp timeout);
   void run_poll(Timestamp timeout);
 
@@ -229,12 +285,36 @@ class Scheduler {
   bool close_flag_ = false;
 
   int32 sched_id_ = 0;
+  int32 group_id_ = 0;
   int32 sched_n_ = 0;
   std::shared_ptr<MpscPollableQueue<EventFull>> inbound_queue_;
   std::vector<std::shared_ptr<MpscPollableQueue<EventFull>>> outbound_queues_;
 
+  // events to other schedulers are buffered while the scheduler is locked and flushed once per loop iteration
+  static constexpr size_t MAX_OUTBOUND_BATCH_SIZE = 256;
+  vector<vector<EventFull>> outbound_batches_;
+  vector<int32> pending_outbound_sched_ids_;
+  std::atomic<uint64> outbound_batch_count_{0};
+  std::atomic<uint64> outbound_batch_event_count_{0};
+  std::atomic<uint64> outbound_batch_wakeup_count_{0};
+
+  std::atomic<uint64> processed_event_count_{0};  // changed only by the scheduler thread
+
   std::shared_ptr<ActorContext> save_context_;
 
+  static constexpr size_t MAX_STOLEN_ACTOR_SEARCH_DEPTH = 8;
+  static constexpr double MIN_STEAL_RETRY_TIMEOUT = 0.001;
+  static constexpr double MAX_STEAL_RETRY_TIMEOUT = 0.1;
+  vector<Scheduler *> steal_peers_;
+  size_t steal_victim_pos_ = 0;
+  double steal_retry_timeout_ = MIN_STEAL_RETRY_TIMEOUT;
+  std::atomic<int32> steal_request_{-1};        // identifier of an idle scheduler, which waits for an actor
+  std::atomic<bool> has_spare_actors_{false};  // the scheduler has ready actors, which can be given to others
+
+  static std::atomic<bool> is_statistics_enabled_;
+  unique_ptr<SchedulerStatisticsStorage> statistics_storage_;
+  SchedulerStatisticsStorage *statistics_ = nullptr;  // non-null if statistics are collected
+
   struct EventContext {
     int32 dest_sched_id{0};
     enum Flags { Stop = 1, Migrate = 2 };
@@ -15,6 +15,7 @@
 #include "td/utils/algorithm.h"
 #include "td/utils/common.h"
 #include "td/utils/ExitGuard.h"
+#include "td/utils/FlatHashMap.h"
 #include "td/utils/format.h"
 #include "td/utils/List.h"
 #include "td/utils/logging.h"
@@ -27,8 +28,11 @@
 #include "td/utils/SliceBuilder.h"
 #include "td/utils/Time.h"
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <utility>
 
 namespace td {
@@ -38,8 +42,119 @@ int VERBOSITY_NAME(actor) = VERBOSITY_NAME(DEBUG) + 10;
 TD_THREAD_LOCAL Scheduler *Scheduler::scheduler_;   // static zero-initialized
 TD_THREAD_LOCAL ActorContext *Scheduler::context_;  // static zero-initialized
 
+std::atomic<bool> Scheduler::is_statistics_enabled_{false};
+
+// all counters are changed only by the thread of the owning scheduler, but can be read from any thread
+template <class T>
+static void add_relaxed(std::atomic<T> &counter, T value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+template <class T>
+static void update_max_relaxed(std::atomic<T> &counter, T value) {
+  if (counter.load(std::memory_order_relaxed) < value) {
+    counter.store(value, std::memory_order_relaxed);
+  }
+}
+
+struct ActorStatisticsCounters {
+  explicit ActorStatisticsCounters(string name) : name(std::move(name)) {
+  }
+
+  const string name;
+  std::atomic<uint64> event_count{0};
+  std::atomic<double> run_time{0.0};
+  std::atomic<size_t> max_mailbox_size{0};
+};
+
+class SchedulerStatisticsStorage {
+ public:
+  SchedulerStatisticsStorage(int32 group_id, int32 sched_id) : group_id_(group_id), sched_id_(sched_id) {
+  }
+
+  // counters of actors with unknown name; aren't returned in statistics
+  ActorStatisticsCounters *get_unnamed_actor_counters() {
+    return &unnamed_actor_counters_;
+  }
+
+  // must be called only by the owning scheduler
+  ActorStatisticsCounters *get_actor_counters(Slice name) {
+    auto key = name.str();
+    auto it = actors_.find(key);
+    if (it != actors_.end()) {
+      return it->second.get();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &counters = actors_[key];
+    counters = td::make_unique<ActorStatisticsCounters>(std::move(key));
+    return counters.get();
+  }
+
+  void on_loop(double busy_time, double poll_time, size_t timeout_count) {
+    add_relaxed<uint64>(loop_count_, 1);
+    add_relaxed(busy_time_, busy_time);
+    add_relaxed(poll_time_, poll_time);
+    timeout_count_.store(timeout_count, std::memory_order_relaxed);
+    update_max_relaxed(max_timeout_count_, timeout_count);
+  }
+
+  SchedulerStatistics get_statistics() {
+    SchedulerStatistics result;
+    result.group_id = group_id_;
+    result.sched_id = sched_id_;
+    result.loop_count = loop_count_.load(std::memory_order_relaxed);
+    result.busy_time = busy_time_.load(std::memory_order_relaxed);
+    result.poll_time = poll_time_.load(std::memory_order_relaxed);
+    result.timeout_count = timeout_count_.load(std::memory_order_relaxed);
+    result.max_timeout_count = max_timeout_count_.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &it : actors_) {
+      auto &counters = *it.second;
+      ActorStatistics actor;
+      actor.name = counters.name;
+      actor.event_count = counters.event_count.load(std::memory_order_relaxed);
+      actor.run_time = counters.run_time.load(std::memory_order_relaxed);
+      actor.max_mailbox_size = counters.max_mailbox_size.load(std::memory_order_relaxed);
+      result.actors.push_back(std::move(actor));
+    }
+    std::sort(result.actors.begin(), result.actors.end(),
+              [](const ActorStatistics &lhs, const ActorStatistics &rhs) { return lhs.run_time > rhs.run_time; });
+    return result;
+  }
+
+  static std::mutex &get_registry_mutex() {
+    static std::mutex registry_mutex;
+    return registry_mutex;
+  }
+
+  static vector<SchedulerStatisticsStorage *> &get_registry() {
+    static vector<SchedulerStatisticsStorage *> registry;
+    return registry;
+  }
+
+ private:
+  int32 group_id_;
+  int32 sched_id_;
+  ActorStatisticsCounters unnamed_actor_counters_{string()};
+  std::mutex mutex_;  // protects insertions to actors_
+  FlatHashMap<string, unique_ptr<ActorStatisticsCounters>> actors_;
+
+  std::atomic<uint64> loop_count_{0};
+  std::atomic<double> busy_time_{0.0};
+  std::atomic<double> poll_time_{0.0};
+  std::atomic<size_t> timeout_count_{0};
+  std::atomic<size_t> max_timeout_count_{0};
+};
+
+Scheduler::Scheduler() = default;
+
 Scheduler::~Scheduler() {
   clear();
+  if (statistics_storage_ != nullptr) {
+    std::lock_guard<std::mutex> lock(SchedulerStatisticsStorage::get_registry_mutex());
+    td::remove(SchedulerStatisticsStorage::get_registry(), statistics_storage_.get());
+  }
 }
 
 Scheduler *Scheduler::instance() {
@@ -139,6 +254,9 @@ SchedulerGuard::SchedulerGuard(Scheduler *scheduler, bool lock) : scheduler_(sch
 
 SchedulerGuard::~SchedulerGuard() {
   if (is_valid_.get()) {
+    if (is_locked_) {
+      scheduler_->flush_outbound_batches();
+    }
     std::swap(save_context_, scheduler_->context());
     Scheduler::set_scheduler(save_scheduler_);
     if (is_locked_) {
@@ -151,6 +269,9 @@ SchedulerGuard::~SchedulerGuard() {
 
 /*** EventGuard ***/
 EventGuard::EventGuard(Scheduler *scheduler, ActorInfo *actor_info) : scheduler_(scheduler) {
+  if (scheduler_->statistics_ != nullptr) {
+    start_time_ = Time::now();
+  }
   actor_info->start_run();
   event_context_.actor_info = actor_info;
   event_context_ptr_ = &event_context_;
@@ -164,6 +285,10 @@ EventGuard::EventGuard(Scheduler *scheduler, ActorInfo *actor_info) : scheduler_
 
 EventGuard::~EventGuard() {
   auto info = event_context_.actor_info;
+  add_relaxed<uint64>(scheduler_->processed_event_count_, event_count_);
+  if (start_time_ != 0.0 && scheduler_->statistics_ != nullptr) {
+    scheduler_->on_actor_run(info, event_count_, Time::now() - start_time_);
+  }
   auto node = info->get_list_node();
   node->remove();
   if (info->mailbox_.empty()) {
@@ -229,10 +354,31 @@ void Scheduler::init(int32 id, std::vector<std::shared_ptr<MpscPollableQueue<Eve
   outbound_queues_ = std::move(outbound);
   sched_id_ = id;
   sched_n_ = static_cast<int32>(outbound_queues_.size());
+  outbound_batches_.clear();
+  outbound_batches_.resize(outbound_queues_.size());
+  pending_outbound_sched_ids_.clear();
   service_actor_.set_queue(inbound_queue_);
   register_actor(PSLICE() << "ServiceActor" << id, &service_actor_).release();
 }
 
+void Scheduler::set_group_id(int32 group_id) {
+  CHECK(!has_guard_);
+  group_id_ = group_id;
+}
+
+void Scheduler::init_work_stealing(vector<Scheduler *> peers) {
+  CHECK(!has_guard_);
+#if TD_THREAD_UNSUPPORTED || TD_EVENTFD_UNSUPPORTED
+  peers.clear();
+#endif
+  if (peers.size() <= 1) {
+    return;
+  }
+  CHECK(td::contains(peers, this));
+  steal_peers_ = std::move(peers);
+  steal_victim_pos_ = static_cast<size_t>(sched_id_);
+}
+
 void Scheduler::clear() {
   if (service_actor_.empty()) {
     return;
@@ -310,6 +456,15 @@ void Scheduler::register_migrated_actor(ActorInfo *actor_info) {
   CHECK(sched_id_ == actor_info->migrate_dest());
   // CHECK(!actor_info->is_running());
   actor_info->finish_migrate();
+  if (actor_info->get_statistics() != nullptr) {
+    // counters of the previous scheduler must not be changed from this thread
+    ActorStatisticsCounters *counters = nullptr;
+    if (statistics_ != nullptr) {
+      const auto &name = actor_info->get_statistics()->name;
+      counters = name.empty() ? statistics_->get_unnamed_actor_counters() : statistics_->get_actor_counters(name);
+    }
+    actor_info->set_statistics(counters);
+  }
   for (auto &event : actor_info->mailbox_) {
     finish_migrate(event);
   }
@@ -335,11 +490,54 @@ void Scheduler::send_to_other_scheduler(int32 sched_id, const ActorId<> &actor_i
       VLOG(actor) << "Send to scheduler " << sched_id << ": " << event;
     }
     start_migrate(event, sched_id);
-    outbound_queues_[sched_id]->writer_put(EventCreator::event_unsafe(actor_id, std::move(event)));
-    outbound_queues_[sched_id]->writer_flush();
+    if (!has_guard_) {
+      // the scheduler can be used simultaneously from several threads through a const guard
+      outbound_queues_[sched_id]->writer_put(EventCreator::event_unsafe(actor_id, std::move(event)));
+      outbound_queues_[sched_id]->writer_flush();
+      return;
+    }
+
+    auto &batch = outbound_batches_[sched_id];
+    if (batch.empty()) {
+      pending_outbound_sched_ids_.push_back(sched_id);
+    }
+    batch.push_back(EventCreator::event_unsafe(actor_id, std::move(event)));
+    if (batch.size() >= MAX_OUTBOUND_BATCH_SIZE) {
+      // all batches must be flushed to keep events, which were sent earlier to other schedulers, ahead of
+      // events sent by receivers of this batch
+      flush_outbound_batches();
+    }
   }
 }
 
+void Scheduler::flush_outbound_batch(int32 sched_id) {
+  auto &batch = outbound_batches_[sched_id];
+  if (batch.empty()) {
+    return;
+  }
+  outbound_batch_count_.fetch_add(1, std::memory_order_relaxed);
+  outbound_batch_event_count_.fetch_add(batch.size(), std::memory_order_relaxed);
+  if (outbound_queues_[sched_id]->writer_put_batch(batch)) {
+    outbound_batch_wakeup_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+  outbound_queues_[sched_id]->writer_flush();
+}
+
+void Scheduler::flush_outbound_batches() {
+  for (auto sched_id : pending_outbound_sched_ids_) {
+    flush_outbound_batch(sched_id);
+  }
+  pending_outbound_sched_ids_.clear();
+}
+
+Scheduler::OutboundBatchStats Scheduler::get_outbound_batch_stats() const {
+  OutboundBatchStats result;
+  result.batch_count = outbound_batch_count_.load(std::memory_order_relaxed);
+  result.event_count = outbound_batch_event_count_.load(std::memory_order_relaxed);
+  result.wakeup_count = outbound_batch_wakeup_count_.load(std::memory_order_relaxed);
+  return result;
+}
+
 void Scheduler::run_on_scheduler(int32 sched_id, Promise<Unit> action) {
   if (sched_id >= 0 && sched_id_ != sched_id) {
     class Worker final : public Actor {
@@ -385,6 +583,9 @@ void Scheduler::add_to_mailbox(ActorInfo *actor_info, Event &&event) {
   }
   VLOG(actor) << "Add to mailbox: " << *actor_info << " " << event;
   actor_info->mailbox_.push_back(std::move(event));
+  if (statistics_ != nullptr && actor_info->get_statistics() != nullptr) {
+    update_max_relaxed(actor_info->get_statistics()->max_mailbox_size, actor_info->mailbox_.size());
+  }
 }
 
 void Scheduler::do_stop_actor(Actor *actor) {
@@ -502,6 +703,7 @@ void Scheduler::flush_mailbox(ActorInfo *actor_info) {
   for (; i < mailbox_size && guard.can_run(); i++) {
     do_event(actor_info, std::move(mailbox[i]));
   }
+  guard.set_event_count(i);
   mailbox.erase(mailbox.begin(), mailbox.begin() + i);
 }
 
@@ -513,7 +715,11 @@ void Scheduler::run_mailbox() {
     CHECK(node);
     auto actor_info = ActorInfo::from_list_node(node);
     flush_mailbox(actor_info);
+    if (unlikely(!steal_peers_.empty())) {
+      give_work(actors_list);
+    }
   }
+  flush_outbound_batches();
   VLOG(actor) << "Run mailbox : finish " << actor_count_;
 
   //Useful for debug, but O(ActorsCount) check
@@ -534,6 +740,106 @@ void Scheduler::run_mailbox() {
   //LOG_CHECK(cnt == actor_count_) << cnt << " vs " << actor_count_;
 }
 
+void Scheduler::set_statistics_enabled(bool is_enabled) {
+  is_statistics_enabled_.store(is_enabled, std::memory_order_relaxed);
+}
+
+vector<SchedulerStatistics> Scheduler::get_statistics() {
+  vector<SchedulerStatistics> result;
+  std::lock_guard<std::mutex> lock(SchedulerStatisticsStorage::get_registry_mutex());
+  for (auto storage : SchedulerStatisticsStorage::get_registry()) {
+    result.push_back(storage->get_statistics());
+  }
+  return result;
+}
+
+void Scheduler::update_statistics_state() {
+  bool is_enabled = is_statistics_enabled_.load(std::memory_order_relaxed);
+  if (is_enabled == (statistics_ != nullptr)) {
+    return;
+  }
+  if (!is_enabled) {
+    statistics_ = nullptr;
+    return;
+  }
+  if (statistics_storage_ == nullptr) {
+    statistics_storage_ = make_unique<SchedulerStatisticsStorage>(group_id_, sched_id_);
+    std::lock_guard<std::mutex> lock(SchedulerStatisticsStorage::get_registry_mutex());
+    SchedulerStatisticsStorage::get_registry().push_back(statistics_storage_.get());
+  }
+  statistics_ = statistics_storage_.get();
+}
+
+void Scheduler::init_actor_statistics(ActorInfo *actor_info, Slice name) {
+  CHECK(statistics_ != nullptr);
+  actor_info->set_statistics(name.empty() ? statistics_->get_unnamed_actor_counters()
+                                          : statistics_->get_actor_counters(name));
+}
+
+void Scheduler::on_actor_run(ActorInfo *actor_info, size_t event_count, double run_time) {
+  CHECK(statistics_ != nullptr);
+  auto counters = actor_info->get_statistics();
+  if (counters == nullptr) {
+    // the actor was created before statistics were enabled; its name is known only in debug builds
+    auto name = actor_info->get_name();
+    counters = name.empty() ? statistics_->get_unnamed_actor_counters() : statistics_->get_actor_counters(name);
+    actor_info->set_statistics(counters);
+  }
+  add_relaxed<uint64>(counters->event_count, event_count);
+  add_relaxed(counters->run_time, run_time);
+}
+
+bool Scheduler::request_work() {
+  // ask one of busy schedulers to give us a ready actor; the actor will be received through the inbound queue
+  // idle schedulers never answer, so the request is sent only to a scheduler, which has spare ready actors
+  for (size_t i = 0; i < steal_peers_.size(); i++) {
+    auto victim = steal_peers_[steal_victim_pos_++ % steal_peers_.size()];
+    if (victim == this || !victim->has_spare_actors_.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    int32 expected = -1;
+    if (victim->steal_request_.compare_exchange_strong(expected, sched_id_, std::memory_order_relaxed) ||
+        expected == sched_id_) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Scheduler::set_has_spare_actors(bool has_spare_actors) {
+  if (has_spare_actors_.load(std::memory_order_relaxed) != has_spare_actors) {
+    has_spare_actors_.store(has_spare_actors, std::memory_order_relaxed);
+  }
+}
+
+void Scheduler::give_work(ListNode &actors_list) {
+  // the next actor to run is kept, so at least two ready actors are needed
+  bool has_spare_actors = !actors_list.empty() && actors_list.get_next()->get_next() != actors_list.end();
+  set_has_spare_actors(has_spare_actors);
+  if (!has_spare_actors) {
+    return;
+  }
+
+  auto thief_sched_id = steal_request_.load(std::memory_order_relaxed);
+  if (thief_sched_id < 0) {
+    return;
+  }
+
+  size_t depth = 0;
+  for (auto it = actors_list.get_next()->get_next();
+       it != actors_list.end() && depth < MAX_STOLEN_ACTOR_SEARCH_DEPTH; it = it->get_next(), depth++) {
+    auto actor_info = ActorInfo::from_list_node(it);
+    if (!actor_info->is_migratable() || actor_info->is_running() || actor_info->get_heap_node()->in_heap()) {
+      continue;
+    }
+    // only the victim resets the request, so there is no race with the thief
+    steal_request_.store(-1, std::memory_order_relaxed);
+    VLOG(actor) << "Give " << *actor_info << " to scheduler " << thief_sched_id;
+    do_migrate_actor(actor_info, thief_sched_id);
+    return;
+  }
+}
+
 Timestamp Scheduler::run_timeout() {
   double now = Time::now();
   //TODO: use Timestamp().is_in_past()
@@ -558,15 +864,37 @@ Timestamp Scheduler::run_events(Timestamp timeout) {
 
 void Scheduler::run_no_guard(Timestamp timeout) {
   CHECK(has_guard_);
+  update_statistics_state();
+  double start_time = statistics_ != nullptr ? Time::now() : 0.0;
+  double poll_time = 0.0;
   SCOPE_EXIT {
     yield_flag_ = false;
+    if (start_time != 0.0 && statistics_ != nullptr) {
+      statistics_->on_loop(Time::now() - start_time - poll_time, poll_time, timeout_queue_.size());
+    }
   };
 
   timeout.relax(run_events(timeout));
   if (yield_flag_) {
     return;
   }
-  run_poll(timeout);
+  if (!steal_peers_.empty() && ready_actors_list_.empty()) {
+    set_has_spare_actors(false);
+    // a busy scheduler can appear or the request can remain unanswered, so the request is repeated while idle
+    if (request_work()) {
+      steal_retry_timeout_ = MIN_STEAL_RETRY_TIMEOUT;
+    } else {
+      steal_retry_timeout_ = min(steal_retry_timeout_ * 2, MAX_STEAL_RETRY_TIMEOUT);
+    }
+    timeout.relax(Timestamp::in(steal_retry_timeout_));
+  }
+  if (start_time != 0.0) {
+    double poll_start_time = Time::now();
+    run_poll(timeout);
+    poll_time = Time::now() - poll_start_time;
+  } else {
+    run_poll(timeout);
+  }
   run_events(timeout);
 }
 
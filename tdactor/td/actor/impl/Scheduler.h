@@ -34,6 +34,10 @@ class EventGuard {
     return event_context_.flags == 0;
   }
 
+  void set_event_count(size_t event_count) {
+    event_count_ = event_count;
+  }
+
   EventGuard(const EventGuard &) = delete;
   EventGuard &operator=(const EventGuard &) = delete;
   EventGuard(EventGuard &&) = delete;
@@ -46,6 +50,8 @@ class EventGuard {
   Scheduler *scheduler_;
   ActorContext *save_context_;
   const char *save_log_tag2_;
+  double start_time_ = 0.0;
+  size_t event_count_ = 1;
 
   void swap_context(ActorInfo *info);
 };
@@ -105,6 +111,10 @@ ActorOwn<ActorT> Scheduler::register_actor_impl(Slice name, ActorT *actor_ptr, A
   actor_info->init(sched_id_, name, std::move(info), static_cast<Actor *>(actor_ptr), deleter,
                    ActorTraits<ActorT>::need_context, ActorTraits<ActorT>::need_start_up);
   VLOG(actor) << "Create actor " << *actor_info << " (actor_count = " << actor_count_ << ')';
+  update_statistics_state();
+  if (statistics_ != nullptr) {
+    init_actor_statistics(actor_info, name);
+  }
 
   ActorId<ActorT> actor_id = weak_info->actor_id(actor_ptr);
   if (sched_id != sched_id_) {
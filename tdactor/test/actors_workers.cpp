@@ -7,7 +7,9 @@
 #include "td/actor/actor.h"
 #include "td/actor/ConcurrentScheduler.h"
 
+#include "td/utils/algorithm.h"
 #include "td/utils/common.h"
+#include "td/utils/port/sleep.h"
 #include "td/utils/SliceBuilder.h"
 #include "td/utils/tests.h"
 #include "td/utils/Time.h"
@@ -186,3 +188,233 @@ TEST(Actors, send_closure_while_finish) {
   }
   sched.finish();
 }
+
+class StealCounterActor;
+
+class StealableActor final : public td::Actor {
+ public:
+  explicit StealableActor(td::ActorId<StealCounterActor> counter) : counter_(counter) {
+  }
+
+  void work(int n) {
+    left_ = n;
+    loop();
+  }
+
+ private:
+  td::ActorId<StealCounterActor> counter_;
+  int left_ = 0;
+
+  void start_up() final {
+    set_migratable(true);
+  }
+
+  void loop() final;
+};
+
+class StealCounterActor final : public td::Actor {
+ public:
+  explicit StealCounterActor(int left) : left_(left) {
+  }
+
+  void on_done(td::int32 sched_id) {
+    if (sched_id != 0 && !td::contains(thief_sched_ids_, sched_id)) {
+      thief_sched_ids_.push_back(sched_id);
+    }
+    if (--left_ == 0) {
+#if !TD_THREAD_UNSUPPORTED && !TD_EVENTFD_UNSUPPORTED
+      // requests of idle schedulers must not be lost, so more than one scheduler must receive actors
+      CHECK(thief_sched_ids_.size() >= 2);
+#endif
+      td::Scheduler::instance()->finish();
+      stop();
+    }
+  }
+
+ private:
+  int left_;
+  td::vector<td::int32> thief_sched_ids_;
+};
+
+void StealableActor::loop() {
+  if (--left_ > 0) {
+    td::usleep_for(10);
+    yield();
+  } else {
+    td::send_closure(counter_, &StealCounterActor::on_done, td::Scheduler::instance()->sched_id());
+    stop();
+  }
+}
+
+TEST(Actors, work_stealing) {
+  int actor_n = 100;
+  td::ConcurrentScheduler sched(3, 0);
+  sched.enable_work_stealing();
+
+  auto counter = sched.create_actor_unsafe<StealCounterActor>(0, "StealCounterActor", actor_n).release();
+  for (int i = 0; i < actor_n; i++) {
+    auto actor = sched.create_actor_unsafe<StealableActor>(0, PSLICE() << "StealableActor" << i, counter).release();
+    auto guard = sched.get_main_guard();
+    td::send_closure_later(actor, &StealableActor::work, 100);
+  }
+
+  sched.start();
+  while (sched.run_main(10)) {
+    // empty
+  }
+  sched.finish();
+}
+
+class BatchSenderActor;
+
+class BatchReceiverActor final : public td::Actor {
+ public:
+  BatchReceiverActor(int left, td::ActorId<BatchSenderActor> sender) : left_(left), sender_(sender) {
+  }
+
+  void receive();
+
+ private:
+  int left_;
+  td::ActorId<BatchSenderActor> sender_;
+};
+
+class BatchSenderActor final : public td::Actor {
+ public:
+  void send(td::ActorId<BatchReceiverActor> receiver, int n) {
+    for (int i = 0; i < n; i++) {
+      td::send_closure(receiver, &BatchReceiverActor::receive);
+    }
+  }
+
+  void on_received() {
+    auto stats = td::Scheduler::instance()->get_outbound_batch_stats();
+    CHECK(stats.batch_count < stats.event_count);
+    CHECK(stats.wakeup_count <= stats.batch_count);
+    td::Scheduler::instance()->finish();
+    stop();
+  }
+};
+
+void BatchReceiverActor::receive() {
+  if (--left_ == 0) {
+    td::send_closure(sender_, &BatchSenderActor::on_received);
+    stop();
+  }
+}
+
+TEST(Actors, outbound_batch) {
+  int n = 10000;
+  td::ConcurrentScheduler sched(1, 0);
+
+  auto sender = sched.create_actor_unsafe<BatchSenderActor>(0, "BatchSenderActor").release();
+  auto receiver = sched.create_actor_unsafe<BatchReceiverActor>(1, "BatchReceiverActor", n, sender).release();
+  {
+    auto guard = sched.get_main_guard();
+    td::send_closure_later(sender, &BatchSenderActor::send, receiver, n);
+  }
+
+  sched.start();
+  while (sched.run_main(10)) {
+    // empty
+  }
+  sched.finish();
+}
+
+class OrderedReceiverActor final : public td::Actor {
+ public:
+  void first() {
+    got_first_ = true;
+  }
+
+  void second() {
+    ASSERT_TRUE(got_first_);
+    td::Scheduler::instance()->finish();
+    stop();
+  }
+
+ private:
+  bool got_first_ = false;
+};
+
+class RelayActor final : public td::Actor {
+ public:
+  explicit RelayActor(td::ActorId<OrderedReceiverActor> receiver) : receiver_(receiver) {
+  }
+
+  void relay() {
+    if (!is_relayed_) {
+      is_relayed_ = true;
+      td::send_closure(receiver_, &OrderedReceiverActor::second);
+    }
+  }
+
+ private:
+  td::ActorId<OrderedReceiverActor> receiver_;
+  bool is_relayed_ = false;
+};
+
+class OrderedSenderActor final : public td::Actor {
+ public:
+  void send(td::ActorId<OrderedReceiverActor> receiver, td::ActorId<RelayActor> relay, int n) {
+    td::send_closure(receiver, &OrderedReceiverActor::first);
+    for (int i = 0; i < n; i++) {
+      td::send_closure(relay, &RelayActor::relay);
+    }
+    // give the relay time to answer before the end of the scheduler loop iteration
+    td::usleep_for(100000);
+  }
+};
+
+TEST(Actors, outbound_batch_order) {
+  td::ConcurrentScheduler sched(2, 0);
+
+  auto receiver = sched.create_actor_unsafe<OrderedReceiverActor>(1, "OrderedReceiverActor").release();
+  auto relay = sched.create_actor_unsafe<RelayActor>(2, "RelayActor", receiver).release();
+  auto sender = sched.create_actor_unsafe<OrderedSenderActor>(0, "OrderedSenderActor").release();
+  {
+    auto guard = sched.get_main_guard();
+    td::send_closure_later(sender, &OrderedSenderActor::send, receiver, relay, 1000);
+  }
+
+  sched.start();
+  while (sched.run_main(10)) {
+    // empty
+  }
+  sched.finish();
+}
+
+TEST(Actors, scheduler_statistics) {
+  td::Scheduler::set_statistics_enabled(true);
+  td::ConcurrentScheduler sched(2, 0);
+
+  td::vector<td::ActorId<PowerWorker>> workers;
+  for (int i = 0; i < 10; i++) {
+    workers.push_back(sched.create_actor_unsafe<PowerWorker>(2, "PowerWorker").release());
+  }
+  sched.create_actor_unsafe<Manager>(1, "Manager", 1000, 1, std::move(workers)).release();
+
+  sched.start();
+  while (sched.run_main(10)) {
+    // empty
+  }
+
+  td::uint64 worker_event_count = 0;
+  td::uint64 manager_event_count = 0;
+  for (auto &statistics : td::Scheduler::get_statistics()) {
+    for (auto &actor : statistics.actors) {
+      ASSERT_TRUE(!actor.name.empty());
+      if (actor.name == "PowerWorker") {
+        worker_event_count += actor.event_count;
+      }
+      if (actor.name == "Manager") {
+        manager_event_count += actor.event_count;
+      }
+    }
+  }
+  ASSERT_TRUE(worker_event_count >= 1000);
+  ASSERT_TRUE(manager_event_count >= 1000);
+
+  sched.finish();
+  td::Scheduler::set_statistics_enabled(false);
+}
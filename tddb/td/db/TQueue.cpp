@@ -11,6 +11,7 @@
 #include "td/db/binlog/BinlogHelper.h"
 #include "td/db/binlog/BinlogInterface.h"
 
+#include "td/utils/algorithm.h"
 #include "td/utils/FlatHashMap.h"
 #include "td/utils/logging.h"
 #include "td/utils/misc.h"
@@ -21,7 +22,8 @@
 #include "td/utils/tl_parsers.h"
 #include "td/utils/tl_storers.h"
 
-#include <set>
+#include <algorithm>
+#include <functional>
 
 namespace td {
 
@@ -86,6 +88,7 @@ class TQueueImpl final : public TQueue {
   static constexpr size_t MAX_EVENT_LENGTH = 65536 * 8;
   static constexpr size_t MAX_QUEUE_EVENTS = 100000;
   static constexpr size_t MAX_TOTAL_EVENT_LENGTH = 1 << 27;
+  static constexpr size_t MAX_BATCH_EVENT_LENGTH = 1 << 23;
 
  public:
   void set_callback(unique_ptr<StorageCallback> callback) final {
@@ -111,16 +114,7 @@ class TQueueImpl final : public TQueue {
       return false;
     }
 
-    if (!q.events.empty()) {
-      auto it = q.events.end();
-      --it;
-      if (it->second.data.empty()) {
-        if (callback_ != nullptr && it->second.log_event_id != 0) {
-          callback_->pop(it->second.log_event_id);
-        }
-        q.events.erase(it);
-      }
-    }
+    delete_empty_last_event(q);
     if (q.events.empty() && !raw_event.data.empty()) {
       schedule_queue_gc(queue_id, q, raw_event.expires_at);
     }
@@ -130,7 +124,74 @@ class TQueueImpl final : public TQueue {
     }
     q.tail_id = event_id.next().move_as_ok();
     q.total_event_length += raw_event.data.size();
-    q.events.emplace(event_id, std::move(raw_event));
+
+    StoredEvent event;
+    event.log_event_id = raw_event.log_event_id;
+    event.event_id = event_id;
+    event.expires_at = raw_event.expires_at;
+    event.extra = raw_event.extra;
+    event.data = std::move(raw_event.data);
+    q.events.push_back(std::move(event));
+    flush_changed_batches();
+    return true;
+  }
+
+  bool do_push_batch(QueueId queue_id, vector<RawEvent> &&raw_events) final {
+    if (raw_events.empty() || queue_id == 0) {
+      return false;
+    }
+    auto log_event_id = raw_events[0].log_event_id;
+    size_t total_event_length = 0;
+    int32 min_expires_at = 0;
+    for (size_t i = 0; i < raw_events.size(); i++) {
+      auto &raw_event = raw_events[i];
+      CHECK(raw_event.event_id.is_valid());
+      // raw_event.data can be empty when replaying binlog
+      if (raw_event.data.size() > MAX_EVENT_LENGTH || raw_event.expires_at <= 0 ||
+          raw_event.log_event_id != log_event_id || (i > 0 && !(raw_events[i - 1].event_id < raw_event.event_id))) {
+        return false;
+      }
+      total_event_length += raw_event.data.size();
+      if (!raw_event.data.empty() && (min_expires_at == 0 || raw_event.expires_at < min_expires_at)) {
+        min_expires_at = raw_event.expires_at;
+      }
+    }
+    auto &q = queues_[queue_id];
+    if (q.events.size() + raw_events.size() > MAX_QUEUE_EVENTS || total_event_length > MAX_TOTAL_EVENT_LENGTH ||
+        q.total_event_length > MAX_TOTAL_EVENT_LENGTH - total_event_length) {
+      return false;
+    }
+    if (raw_events[0].event_id < q.tail_id) {
+      return false;
+    }
+
+    delete_empty_last_event(q);
+    if (q.events.empty() && min_expires_at != 0) {
+      schedule_queue_gc(queue_id, q, min_expires_at);
+    }
+
+    if (log_event_id == 0 && callback_ != nullptr) {
+      log_event_id = callback_->push_batch(queue_id, raw_events);
+    }
+    q.tail_id = raw_events.back().event_id.next().move_as_ok();
+    q.total_event_length += total_event_length;
+    if (log_event_id != 0) {
+      auto &batch = batches_[log_event_id];
+      batch.queue_id = queue_id;
+      batch.first_event_id = raw_events[0].event_id;
+      batch.event_count = raw_events.size();
+      batch.stored_event_count = raw_events.size();
+    }
+    for (auto &raw_event : raw_events) {
+      StoredEvent event;
+      event.log_event_id = log_event_id;
+      event.event_id = raw_event.event_id;
+      event.expires_at = raw_event.expires_at;
+      event.extra = raw_event.extra;
+      event.data = std::move(raw_event.data);
+      q.events.push_back(std::move(event));
+    }
+    flush_changed_batches();
     return true;
   }
 
@@ -155,28 +216,7 @@ class TQueueImpl final : public TQueue {
     if (expires_at <= 0) {
       return Status::Error("Failed to add already expired event");
     }
-    EventId event_id;
-    while (true) {
-      if (q.tail_id.empty()) {
-        if (hint_new_id.empty()) {
-          q.tail_id = EventId::from_int32(
-                          Random::fast(2 * max(static_cast<int>(MAX_QUEUE_EVENTS), 1000000) + 1, EventId::MAX_ID / 2))
-                          .move_as_ok();
-        } else {
-          q.tail_id = hint_new_id;
-        }
-      }
-      event_id = q.tail_id;
-      CHECK(event_id.is_valid());
-      if (event_id.next().is_ok()) {
-        break;
-      }
-      for (auto it = q.events.begin(); it != q.events.end();) {
-        pop(q, queue_id, it, {});
-      }
-      q.tail_id = EventId();
-      CHECK(hint_new_id.next().is_ok());
-    }
+    auto event_id = get_new_event_id(queue_id, q, 1, hint_new_id);
 
     RawEvent raw_event;
     raw_event.event_id = event_id;
@@ -188,6 +228,80 @@ class TQueueImpl final : public TQueue {
     return event_id;
   }
 
+  Result<EventId> push_batch(QueueId queue_id, vector<BatchEvent> events, EventId hint_new_id) final {
+    if (events.empty()) {
+      return Status::Error("Events are empty");
+    }
+    size_t total_event_length = 0;
+    for (auto &event : events) {
+      if (event.data.empty()) {
+        return Status::Error("Data is empty");
+      }
+      if (event.data.size() > MAX_EVENT_LENGTH) {
+        return Status::Error("Data is too big");
+      }
+      if (event.expires_at <= 0) {
+        return Status::Error("Failed to add already expired event");
+      }
+      total_event_length += event.data.size();
+    }
+    if (total_event_length > MAX_BATCH_EVENT_LENGTH) {
+      return Status::Error("Batch is too big");
+    }
+    if (queue_id == 0) {
+      return Status::Error("Queue identifier is invalid");
+    }
+
+    auto &q = queues_[queue_id];
+    if (q.events.size() + events.size() > MAX_QUEUE_EVENTS) {
+      return Status::Error("Queue is full");
+    }
+    if (q.total_event_length > MAX_TOTAL_EVENT_LENGTH - total_event_length) {
+      return Status::Error("Queue size is too big");
+    }
+    auto first_event_id = get_new_event_id(queue_id, q, events.size(), hint_new_id);
+
+    vector<RawEvent> raw_events;
+    raw_events.reserve(events.size());
+    for (size_t i = 0; i < events.size(); i++) {
+      RawEvent raw_event;
+      raw_event.event_id = first_event_id.advance(i).move_as_ok();
+      raw_event.data = std::move(events[i].data);
+      raw_event.expires_at = events[i].expires_at;
+      raw_event.extra = events[i].extra;
+      raw_events.push_back(std::move(raw_event));
+    }
+    bool is_added = do_push_batch(queue_id, std::move(raw_events));
+    CHECK(is_added);
+    return first_event_id;
+  }
+
+  bool do_forget_batch_events(uint64 batch_log_event_id, uint64 log_event_id,
+                              const vector<EventIdRange> &event_id_ranges) final {
+    CHECK(log_event_id != 0);
+    auto it = batches_.find(batch_log_event_id);
+    if (it == batches_.end()) {
+      return false;
+    }
+    it->second.forget_log_event_ids.push_back(log_event_id);
+    auto &q = queues_[it->second.queue_id];
+    // the batch is deleted together with its last event, so it must not be accessed in the loop
+    for (auto &event_id_range : event_id_ranges) {
+      for (auto pos = q.events.lower_bound(event_id_range.first);
+           pos != q.events.end() && q.events[pos].event_id < event_id_range.second;) {
+        auto &event = q.events[pos];
+        if (event.log_event_id == batch_log_event_id) {
+          on_event_deleted(event);
+          remove_event(q, pos);
+        } else {
+          pos = q.events.next(pos);
+        }
+      }
+    }
+    flush_changed_batches();
+    return true;
+  }
+
   EventId get_head(QueueId queue_id) const final {
     auto it = queues_.find(queue_id);
     if (it == queues_.end()) {
@@ -211,11 +325,49 @@ class TQueueImpl final : public TQueue {
       return;
     }
     auto &q = q_it->second;
-    auto it = q.events.find(event_id);
-    if (it == q.events.end()) {
+    auto pos = q.events.find(event_id);
+    if (pos == q.events.end()) {
+      return;
+    }
+    pop(q, queue_id, pos, q.tail_id);
+    flush_changed_batches();
+  }
+
+  void forget_range(QueueId queue_id, EventId upto_id) final {
+    auto q_it = queues_.find(queue_id);
+    if (q_it == queues_.end()) {
+      return;
+    }
+    auto &q = q_it->second;
+    auto end_pos = q.events.lower_bound(upto_id);
+    if (end_pos == q.events.first()) {
       return;
     }
-    pop(q, queue_id, it, q.tail_id);
+    if (end_pos == q.events.end() && callback_ != nullptr) {
+      // the last event is kept to remember tail_id as pop does
+      auto &event = q.events.back();
+      if (event.log_event_id != 0 && event.event_id.next().ok() == q.tail_id) {
+        end_pos = q.events.last();
+        if (!event.data.empty()) {
+          clear_event_data(q, event);
+          on_event_data_cleared(queue_id, event);
+        }
+      }
+    }
+
+    vector<uint64> deleted_log_event_ids;
+    for (auto pos = q.events.first(); pos != end_pos; pos = q.events.next(pos)) {
+      auto &event = q.events[pos];
+      q.total_event_length -= event.data.size();
+      if (event.log_event_id != 0 && release_log_event(event.log_event_id, event.event_id) && callback_ != nullptr) {
+        deleted_log_event_ids.push_back(event.log_event_id);
+      }
+    }
+    q.events.erase_prefix(end_pos);
+    if (!deleted_log_event_ids.empty()) {
+      callback_->pop_batch(std::move(deleted_log_event_ids));
+    }
+    flush_changed_batches();
   }
 
   std::map<EventId, RawEvent> clear(QueueId queue_id, size_t keep_count) final {
@@ -232,54 +384,47 @@ class TQueueImpl final : public TQueue {
     auto start_time = Time::now();
     auto total_event_length = q.total_event_length;
 
-    auto end_it = q.events.end();
+    auto end_pos = q.events.end();
     for (size_t i = 0; i < keep_count; i++) {
-      --end_it;
+      end_pos = q.events.prev(end_pos);
     }
     if (keep_count == 0) {
-      --end_it;
-      auto &event = end_it->second;
+      end_pos = q.events.prev(end_pos);
+      auto &event = q.events[end_pos];
       if (callback_ == nullptr || event.log_event_id == 0) {
-        ++end_it;
+        end_pos = q.events.end();
       } else if (!event.data.empty()) {
         clear_event_data(q, event);
-        callback_->push(queue_id, event);
+        on_event_data_cleared(queue_id, event);
       }
     }
 
     auto collect_deleted_event_ids_time = 0.0;
+    vector<uint64> deleted_log_event_ids;
     if (callback_ != nullptr) {
-      vector<uint64> deleted_log_event_ids;
       deleted_log_event_ids.reserve(size - keep_count);
-      for (auto it = q.events.begin(); it != end_it; ++it) {
-        auto &event = it->second;
-        if (event.log_event_id != 0) {
-          deleted_log_event_ids.push_back(event.log_event_id);
-        }
+    }
+    for (auto pos = q.events.first(); pos != end_pos; pos = q.events.next(pos)) {
+      auto &event = q.events[pos];
+      if (event.log_event_id != 0 && release_log_event(event.log_event_id, event.event_id) && callback_ != nullptr) {
+        deleted_log_event_ids.push_back(event.log_event_id);
       }
+    }
+    if (callback_ != nullptr) {
       collect_deleted_event_ids_time = Time::now() - start_time;
       callback_->pop_batch(std::move(deleted_log_event_ids));
     }
     auto callback_clear_time = Time::now() - start_time;
 
     std::map<EventId, RawEvent> deleted_events;
-    if (keep_count > size / 2) {
-      for (auto it = q.events.begin(); it != end_it;) {
-        q.total_event_length -= it->second.data.size();
-        bool is_inserted = deleted_events.emplace(it->first, std::move(it->second)).second;
-        CHECK(is_inserted);
-        it = q.events.erase(it);
-      }
-    } else {
-      q.total_event_length = 0;
-      for (auto it = end_it; it != q.events.end();) {
-        q.total_event_length += it->second.data.size();
-        bool is_inserted = deleted_events.emplace(it->first, std::move(it->second)).second;
-        CHECK(is_inserted);
-        it = q.events.erase(it);
-      }
-      std::swap(deleted_events, q.events);
+    for (auto pos = q.events.first(); pos != end_pos; pos = q.events.next(pos)) {
+      auto &event = q.events[pos];
+      q.total_event_length -= event.data.size();
+      deleted_events.emplace_hint(deleted_events.end(), event.event_id, get_raw_event(event, true));
     }
+    q.events.erase_prefix(end_pos);
+    q.events.shrink();
+    flush_changed_batches();
 
     auto clear_time = Time::now() - start_time;
     if (clear_time > 0.02) {
@@ -309,6 +454,7 @@ class TQueueImpl final : public TQueue {
     }
 
     do_get(queue_id, q, from_id, forget_previous, unix_time_now, result_events);
+    flush_changed_batches();
     return get_size(q);
   }
 
@@ -317,19 +463,24 @@ class TQueueImpl final : public TQueue {
     auto max_finish_time = Time::now() + 0.05;
     int64 counter = 0;
     while (!queue_gc_at_.empty()) {
-      auto it = queue_gc_at_.begin();
-      if (it->first >= unix_time_now) {
+      auto gc_at = queue_gc_at_[0].first;
+      if (gc_at >= unix_time_now) {
         break;
       }
-      auto queue_id = it->second;
+      auto queue_id = queue_gc_at_[0].second;
+      std::pop_heap(queue_gc_at_.begin(), queue_gc_at_.end(), std::greater<std::pair<int32, QueueId>>());
+      queue_gc_at_.pop_back();
       auto &q = queues_[queue_id];
-      CHECK(q.gc_at == it->first);
+      if (q.gc_at != gc_at) {
+        // the queue was rescheduled
+        continue;
+      }
       int32 new_gc_at = 0;
 
       if (!q.events.empty()) {
         size_t size_before = get_size(q);
-        for (auto event_it = q.events.begin(); event_it != q.events.end();) {
-          auto &event = event_it->second;
+        for (auto pos = q.events.first(); pos != q.events.end();) {
+          auto &event = q.events[pos];
           if ((++counter & 128) == 0 && Time::now() >= max_finish_time) {
             if (new_gc_at == 0) {
               new_gc_at = event.expires_at;
@@ -337,24 +488,27 @@ class TQueueImpl final : public TQueue {
             break;
           }
           if (event.expires_at < unix_time_now || event.data.empty()) {
-            pop(q, queue_id, event_it, q.tail_id);
+            pop(q, queue_id, pos, q.tail_id);
           } else {
             if (new_gc_at != 0) {
               break;
             }
             new_gc_at = event.expires_at;
-            ++event_it;
+            pos = q.events.next(pos);
           }
         }
+        q.events.shrink();
         size_t size_after = get_size(q);
         CHECK(size_after <= size_before);
         deleted_events += size_before - size_after;
       }
       schedule_queue_gc(queue_id, q, new_gc_at);
       if (Time::now() >= max_finish_time) {
+        flush_changed_batches();
         return {deleted_events, false};
       }
     }
+    flush_changed_batches();
     return {deleted_events, true};
   }
 
@@ -374,22 +528,239 @@ class TQueueImpl final : public TQueue {
   }
 
  private:
+  struct StoredEvent {
+    uint64 log_event_id{0};
+    EventId event_id;
+    int32 expires_at{0};  // 0 for deleted events
+    int64 extra{0};
+    string data;
+  };
+
+  // events of a queue sorted by their identifiers in a contiguous ring buffer
+  // deleted events are kept as tombstones until they reach an end of the buffer or the buffer is reallocated
+  // positions are offsets from the first stored event and are invalidated by addition of new events
+  class EventRing {
+   public:
+    bool empty() const {
+      return size_ == 0;
+    }
+
+    size_t size() const {
+      return size_;
+    }
+
+    size_t first() const {
+      return 0;
+    }
+
+    size_t last() const {
+      CHECK(!empty());
+      return stored_size_ - 1;
+    }
+
+    size_t end() const {
+      return stored_size_;
+    }
+
+    size_t next(size_t pos) const {
+      do {
+        pos++;
+      } while (pos < stored_size_ && is_deleted(pos));
+      return pos;
+    }
+
+    size_t prev(size_t pos) const {
+      do {
+        CHECK(pos > 0);
+        pos--;
+      } while (is_deleted(pos));
+      return pos;
+    }
+
+    StoredEvent &operator[](size_t pos) {
+      return events_[get_index(pos)];
+    }
+    const StoredEvent &operator[](size_t pos) const {
+      return events_[get_index(pos)];
+    }
+
+    StoredEvent &back() {
+      return (*this)[last()];
+    }
+    const StoredEvent &front() const {
+      return (*this)[first()];
+    }
+
+    // returns position of the first event with identifier not less than event_id
+    size_t lower_bound(EventId event_id) const {
+      if (empty()) {
+        return end();
+      }
+      auto offset = static_cast<int64>(event_id.value()) - front().event_id.value();
+      if (offset <= 0) {
+        return first();
+      }
+      size_t left = 0;
+      size_t right = stored_size_;
+      if (offset < static_cast<int64>(stored_size_)) {
+        // identifiers are usually consecutive, so the event is likely to be at the offset
+        auto pos = static_cast<size_t>(offset);
+        if ((*this)[pos].event_id == event_id) {
+          return is_deleted(pos) ? next(pos) : pos;
+        }
+        if (event_id < (*this)[pos].event_id) {
+          right = pos;
+        } else {
+          left = pos;
+        }
+      }
+      while (left < right) {
+        auto middle = left + (right - left) / 2;
+        if ((*this)[middle].event_id < event_id) {
+          left = middle + 1;
+        } else {
+          right = middle;
+        }
+      }
+      return left < stored_size_ && is_deleted(left) ? next(left) : left;
+    }
+
+    size_t find(EventId event_id) const {
+      auto pos = lower_bound(event_id);
+      if (pos == end() || (*this)[pos].event_id != event_id) {
+        return end();
+      }
+      return pos;
+    }
+
+    void push_back(StoredEvent &&event) {
+      CHECK(event.expires_at > 0);
+      CHECK(empty() || (*this)[last()].event_id < event.event_id);
+      if (stored_size_ == events_.size()) {
+        reallocate(size_ * 2);
+      }
+      events_[get_index(stored_size_)] = std::move(event);
+      stored_size_++;
+      size_++;
+    }
+
+    // returns position of the next event
+    size_t erase(size_t pos) {
+      CHECK(pos < stored_size_ && !is_deleted(pos));
+      auto &event = (*this)[pos];
+      event.expires_at = 0;
+      event.data = {};
+      size_--;
+      if (pos == 0) {
+        erase_prefix(1);
+        return 0;
+      }
+      if (pos + 1 == stored_size_) {
+        do {
+          stored_size_--;
+        } while (stored_size_ > 0 && is_deleted(stored_size_ - 1));
+        return stored_size_;
+      }
+      return next(pos);
+    }
+
+    // deletes all events before the position
+    void erase_prefix(size_t pos) {
+      CHECK(pos <= stored_size_);
+      for (size_t i = 0; i < pos; i++) {
+        auto &event = (*this)[i];
+        if (event.expires_at != 0) {
+          size_--;
+        }
+        event = StoredEvent();
+      }
+      while (pos < stored_size_ && is_deleted(pos)) {
+        pos++;
+      }
+      begin_ = get_index(pos);
+      stored_size_ -= pos;
+      if (stored_size_ == 0) {
+        begin_ = 0;
+      }
+    }
+
+    // frees memory occupied by tombstones and unused capacity
+    void shrink() {
+      if (events_.size() > MIN_CAPACITY && (stored_size_ <= events_.size() / 4 || stored_size_ >= size_ * 2)) {
+        reallocate(size_ * 2);
+      }
+    }
+
+   private:
+    static constexpr size_t MIN_CAPACITY = 8;
+
+    vector<StoredEvent> events_;
+    size_t begin_ = 0;
+    size_t stored_size_ = 0;  // including tombstones
+    size_t size_ = 0;
+
+    size_t get_index(size_t pos) const {
+      return (begin_ + pos) & (events_.size() - 1);
+    }
+
+    bool is_deleted(size_t pos) const {
+      return (*this)[pos].expires_at == 0;
+    }
+
+    // the new capacity is the least power of two, which is at least MIN_CAPACITY and min_capacity
+    void reallocate(size_t min_capacity) {
+      size_t capacity = MIN_CAPACITY;
+      while (capacity < min_capacity) {
+        capacity *= 2;
+      }
+      vector<StoredEvent> new_events(capacity);
+      size_t new_size = 0;
+      for (size_t pos = 0; pos < stored_size_; pos++) {
+        auto &event = (*this)[pos];
+        if (event.expires_at != 0) {
+          new_events[new_size++] = std::move(event);
+        }
+      }
+      CHECK(new_size == size_);
+      events_ = std::move(new_events);
+      begin_ = 0;
+      stored_size_ = size_;
+    }
+  };
+
   struct Queue {
     EventId tail_id;
-    std::map<EventId, RawEvent> events;
+    EventRing events;
     size_t total_event_length = 0;
     int32 gc_at = 0;
   };
 
+  // a log event with several events of a queue
+  // deleted events are logged separately and the batch is rewritten only after a half of its stored events is deleted
+  struct Batch {
+    QueueId queue_id = 0;
+    EventId first_event_id;
+    size_t event_count = 0;         // the number of events, which weren't deleted yet
+    size_t stored_event_count = 0;  // the number of events in the log event
+    vector<EventId> deleted_event_ids;    // identifiers of events deleted since the last flush
+    vector<uint64> forget_log_event_ids;  // log events with identifiers of events deleted from the batch
+    bool is_changed = false;
+    bool need_rewrite = false;
+  };
+
   FlatHashMap<QueueId, Queue> queues_;
-  std::set<std::pair<int32, QueueId>> queue_gc_at_;
+  FlatHashMap<uint64, Batch> batches_;
+  vector<uint64> changed_batch_log_event_ids_;
+  // binary heap of (gc_at, queue_id); entries with outdated gc_at are skipped
+  vector<std::pair<int32, QueueId>> queue_gc_at_;
+  size_t gc_queue_count_ = 0;
   unique_ptr<StorageCallback> callback_;
 
   static EventId get_queue_head(const Queue &q) {
     if (q.events.empty()) {
       return q.tail_id;
     }
-    return q.events.begin()->first;
+    return q.events.front().event_id;
   }
 
   static size_t get_size(const Queue &q) {
@@ -397,34 +768,198 @@ class TQueueImpl final : public TQueue {
       return 0;
     }
 
-    return q.events.size() - (q.events.rbegin()->second.data.empty() ? 1 : 0);
+    return q.events.size() - (q.events[q.events.last()].data.empty() ? 1 : 0);
+  }
+
+  static RawEvent get_raw_event(const StoredEvent &event, bool need_data) {
+    RawEvent raw_event;
+    raw_event.log_event_id = event.log_event_id;
+    raw_event.event_id = event.event_id;
+    raw_event.expires_at = event.expires_at;
+    if (need_data) {
+      raw_event.data = event.data;
+    }
+    raw_event.extra = event.extra;
+    return raw_event;
+  }
+
+  EventId get_new_event_id(QueueId queue_id, Queue &q, size_t event_count, EventId hint_new_id) {
+    while (true) {
+      if (q.tail_id.empty()) {
+        if (hint_new_id.empty()) {
+          q.tail_id = EventId::from_int32(
+                          Random::fast(2 * max(static_cast<int>(MAX_QUEUE_EVENTS), 1000000) + 1, EventId::MAX_ID / 2))
+                          .move_as_ok();
+        } else {
+          q.tail_id = hint_new_id;
+        }
+      }
+      auto event_id = q.tail_id;
+      CHECK(event_id.is_valid());
+      if (event_id.advance(event_count).is_ok()) {
+        return event_id;
+      }
+      for (auto pos = q.events.first(); pos != q.events.end();) {
+        pop(q, queue_id, pos, {});
+      }
+      q.tail_id = EventId();
+      CHECK(hint_new_id.advance(event_count).is_ok());
+    }
+  }
+
+  // returns whether the log event must be deleted from the storage
+  bool release_log_event(uint64 log_event_id, EventId event_id) {
+    CHECK(log_event_id != 0);
+    if (batches_.empty()) {
+      return true;
+    }
+    auto it = batches_.find(log_event_id);
+    if (it == batches_.end()) {
+      return true;
+    }
+    auto &batch = it->second;
+    CHECK(batch.event_count > 0);
+    batch.event_count--;
+    if (batch.event_count == 0) {
+      if (!batch.forget_log_event_ids.empty() && callback_ != nullptr) {
+        // they are deleted before the batch, so they are never replayed without it
+        callback_->pop_batch(std::move(batch.forget_log_event_ids));
+      }
+      batches_.erase(it);
+      return true;
+    }
+    if (callback_ != nullptr) {
+      batch.deleted_event_ids.push_back(event_id);
+      mark_batch_changed(log_event_id, batch);
+    }
+    return false;
+  }
+
+  void mark_batch_changed(uint64 log_event_id, Batch &batch) {
+    if (!batch.is_changed) {
+      batch.is_changed = true;
+      changed_batch_log_event_ids_.push_back(log_event_id);
+    }
   }
 
-  void pop(Queue &q, QueueId queue_id, std::map<EventId, RawEvent>::iterator &it, EventId tail_id) {
-    auto &event = it->second;
+  void on_event_deleted(const StoredEvent &event) {
+    if (event.log_event_id != 0 && release_log_event(event.log_event_id, event.event_id) && callback_ != nullptr) {
+      callback_->pop(event.log_event_id);
+    }
+  }
+
+  void on_event_data_cleared(QueueId queue_id, const StoredEvent &event) {
+    CHECK(callback_ != nullptr);
+    auto it = batches_.find(event.log_event_id);
+    if (it == batches_.end()) {
+      callback_->push(queue_id, get_raw_event(event, false));
+      return;
+    }
+    // the event must be kept with empty data, which can't be expressed by identifiers of deleted events
+    it->second.need_rewrite = true;
+    mark_batch_changed(event.log_event_id, it->second);
+  }
+
+  static vector<EventIdRange> get_event_id_ranges(vector<EventId> &event_ids) {
+    std::sort(event_ids.begin(), event_ids.end());
+    vector<EventIdRange> result;
+    for (auto event_id : event_ids) {
+      auto next_event_id = event_id.next().move_as_ok();
+      if (!result.empty() && result.back().second == event_id) {
+        result.back().second = next_event_id;
+      } else {
+        result.emplace_back(event_id, next_event_id);
+      }
+    }
+    return result;
+  }
+
+  // logs identifiers of events deleted from batches or rewrites the batches if they have shrunk at least twice
+  void flush_changed_batches() {
+    if (changed_batch_log_event_ids_.empty()) {
+      return;
+    }
+    for (auto log_event_id : changed_batch_log_event_ids_) {
+      auto it = batches_.find(log_event_id);
+      if (it == batches_.end() || !it->second.is_changed) {
+        continue;
+      }
+      auto &batch = it->second;
+      batch.is_changed = false;
+      if (callback_ == nullptr) {
+        batch.deleted_event_ids.clear();
+        batch.need_rewrite = false;
+        continue;
+      }
+      if (!batch.need_rewrite && batch.event_count * 2 > batch.stored_event_count) {
+        CHECK(!batch.deleted_event_ids.empty());
+        batch.forget_log_event_ids.push_back(
+            callback_->forget_batch_events(log_event_id, get_event_id_ranges(batch.deleted_event_ids)));
+        batch.deleted_event_ids.clear();
+        continue;
+      }
+
+      auto &q = queues_[batch.queue_id];
+      vector<RawEvent> raw_events;
+      raw_events.reserve(batch.event_count);
+      for (auto pos = q.events.lower_bound(batch.first_event_id);
+           pos != q.events.end() && raw_events.size() < batch.event_count; pos = q.events.next(pos)) {
+        auto &event = q.events[pos];
+        if (event.log_event_id == log_event_id) {
+          raw_events.push_back(get_raw_event(event, true));
+        }
+      }
+      CHECK(raw_events.size() == batch.event_count);
+      batch.first_event_id = raw_events[0].event_id;
+      batch.stored_event_count = batch.event_count;
+      batch.deleted_event_ids.clear();
+      batch.need_rewrite = false;
+      callback_->push_batch(batch.queue_id, raw_events);
+      if (!batch.forget_log_event_ids.empty()) {
+        // the log events are obsolete after the batch is rewritten
+        callback_->pop_batch(std::move(batch.forget_log_event_ids));
+        batch.forget_log_event_ids.clear();
+      }
+    }
+    changed_batch_log_event_ids_.clear();
+  }
+
+  void delete_empty_last_event(Queue &q) {
+    if (!q.events.empty()) {
+      auto &last_event = q.events.back();
+      if (last_event.data.empty()) {
+        on_event_deleted(last_event);
+        q.events.erase(q.events.last());
+      }
+    }
+  }
+
+  void pop(Queue &q, QueueId queue_id, size_t &pos, EventId tail_id) {
+    auto &event = q.events[pos];
     if (callback_ == nullptr || event.log_event_id == 0) {
-      remove_event(q, it);
+      on_event_deleted(event);
+      remove_event(q, pos);
       return;
     }
 
     if (event.event_id.next().ok() == tail_id) {
       if (!event.data.empty()) {
         clear_event_data(q, event);
-        callback_->push(queue_id, event);
+        on_event_data_cleared(queue_id, event);
       }
-      ++it;
+      pos = q.events.next(pos);
     } else {
-      callback_->pop(event.log_event_id);
-      remove_event(q, it);
+      on_event_deleted(event);
+      remove_event(q, pos);
     }
   }
 
-  static void remove_event(Queue &q, std::map<EventId, RawEvent>::iterator &it) {
-    q.total_event_length -= it->second.data.size();
-    it = q.events.erase(it);
+  static void remove_event(Queue &q, size_t &pos) {
+    q.total_event_length -= q.events[pos].data.size();
+    pos = q.events.erase(pos);
   }
 
-  static void clear_event_data(Queue &q, RawEvent &event) {
+  static void clear_event_data(Queue &q, StoredEvent &event) {
     q.total_event_length -= event.data.size();
     event.data = {};
   }
@@ -432,16 +967,16 @@ class TQueueImpl final : public TQueue {
   void do_get(QueueId queue_id, Queue &q, EventId from_id, bool forget_previous, int32 unix_time_now,
               MutableSpan<Event> &result_events) {
     if (forget_previous) {
-      for (auto it = q.events.begin(); it != q.events.end() && it->first < from_id;) {
-        pop(q, queue_id, it, q.tail_id);
+      for (auto pos = q.events.first(); pos != q.events.end() && q.events[pos].event_id < from_id;) {
+        pop(q, queue_id, pos, q.tail_id);
       }
     }
 
     size_t ready_n = 0;
-    for (auto it = q.events.lower_bound(from_id); it != q.events.end();) {
-      auto &event = it->second;
+    for (auto pos = q.events.lower_bound(from_id); pos != q.events.end();) {
+      auto &event = q.events[pos];
       if (event.expires_at < unix_time_now || event.data.empty()) {
-        pop(q, queue_id, it, q.tail_id);
+        pop(q, queue_id, pos, q.tail_id);
       } else {
         CHECK(!(event.event_id < from_id));
         if (ready_n == result_events.size()) {
@@ -454,7 +989,7 @@ class TQueueImpl final : public TQueue {
         to.expires_at = event.expires_at;
         to.extra = event.extra;
         ready_n++;
-        ++it;
+        pos = q.events.next(pos);
       }
     }
 
@@ -463,13 +998,25 @@ class TQueueImpl final : public TQueue {
 
   void schedule_queue_gc(QueueId queue_id, Queue &q, int32 gc_at) {
     if (q.gc_at != 0) {
-      bool is_deleted = queue_gc_at_.erase({q.gc_at, queue_id}) > 0;
-      CHECK(is_deleted);
+      gc_queue_count_--;
     }
     q.gc_at = gc_at;
-    if (q.gc_at != 0) {
-      bool is_inserted = queue_gc_at_.emplace(gc_at, queue_id).second;
-      CHECK(is_inserted);
+    if (q.gc_at == 0) {
+      return;
+    }
+    gc_queue_count_++;
+    queue_gc_at_.emplace_back(gc_at, queue_id);
+    std::push_heap(queue_gc_at_.begin(), queue_gc_at_.end(), std::greater<std::pair<int32, QueueId>>());
+
+    if (queue_gc_at_.size() > 2 * gc_queue_count_ + 1000) {
+      // delete outdated entries
+      remove_if(queue_gc_at_, [&](const std::pair<int32, QueueId> &entry) {
+        auto it = queues_.find(entry.second);
+        return it == queues_.end() || it->second.gc_at != entry.first;
+      });
+      std::sort(queue_gc_at_.begin(), queue_gc_at_.end());
+      queue_gc_at_.erase(std::unique(queue_gc_at_.begin(), queue_gc_at_.end()), queue_gc_at_.end());
+      std::make_heap(queue_gc_at_.begin(), queue_gc_at_.end(), std::greater<std::pair<int32, QueueId>>());
     }
   }
 };
@@ -524,6 +1071,64 @@ struct TQueueLogEvent final : public Storer {
   }
 };
 
+struct TQueueBatchLogEvent final : public Storer {
+  int64 queue_id;
+  const vector<TQueue::RawEvent> *events;
+
+  template <class StorerT>
+  void store(StorerT &&storer) const {
+    using td::store;
+    store(queue_id, storer);
+    store(narrow_cast<int32>(events->size()), storer);
+    for (auto &event : *events) {
+      store(event.event_id.value(), storer);
+      store(event.expires_at, storer);
+      store(event.data, storer);
+      store(event.extra, storer);
+    }
+  }
+
+  size_t size() const final {
+    TlStorerCalcLength storer;
+    store(storer);
+    return storer.get_length();
+  }
+
+  size_t store(uint8 *ptr) const final {
+    TlStorerUnsafe storer(ptr);
+    store(storer);
+    return static_cast<size_t>(storer.get_buf() - ptr);
+  }
+};
+
+struct TQueueForgetBatchEventsLogEvent final : public Storer {
+  int64 batch_log_event_id;
+  const vector<TQueue::EventIdRange> *event_id_ranges;
+
+  template <class StorerT>
+  void store(StorerT &&storer) const {
+    using td::store;
+    store(batch_log_event_id, storer);
+    store(narrow_cast<int32>(event_id_ranges->size()), storer);
+    for (auto &event_id_range : *event_id_ranges) {
+      store(event_id_range.first.value(), storer);
+      store(event_id_range.second.value(), storer);
+    }
+  }
+
+  size_t size() const final {
+    TlStorerCalcLength storer;
+    store(storer);
+    return storer.get_length();
+  }
+
+  size_t store(uint8 *ptr) const final {
+    TlStorerUnsafe storer(ptr);
+    store(storer);
+    return static_cast<size_t>(storer.get_buf() - ptr);
+  }
+};
+
 template <class BinlogT>
 uint64 TQueueBinlog<BinlogT>::push(QueueId queue_id, const RawEvent &event) {
   TQueueLogEvent log_event;
@@ -540,6 +1145,30 @@ uint64 TQueueBinlog<BinlogT>::push(QueueId queue_id, const RawEvent &event) {
   return event.log_event_id;
 }
 
+template <class BinlogT>
+uint64 TQueueBinlog<BinlogT>::push_batch(QueueId queue_id, const vector<RawEvent> &events) {
+  CHECK(!events.empty());
+  TQueueBatchLogEvent log_event;
+  log_event.queue_id = queue_id;
+  log_event.events = &events;
+  auto log_event_id = events[0].log_event_id;
+  if (log_event_id == 0) {
+    return binlog_->add(BATCH_BINLOG_EVENT_TYPE, log_event);
+  }
+  binlog_->rewrite(log_event_id, BATCH_BINLOG_EVENT_TYPE, log_event);
+  return log_event_id;
+}
+
+template <class BinlogT>
+uint64 TQueueBinlog<BinlogT>::forget_batch_events(uint64 batch_log_event_id,
+                                                  const vector<EventIdRange> &event_id_ranges) {
+  CHECK(!event_id_ranges.empty());
+  TQueueForgetBatchEventsLogEvent log_event;
+  log_event.batch_log_event_id = static_cast<int64>(batch_log_event_id);
+  log_event.event_id_ranges = &event_id_ranges;
+  return binlog_->add(FORGET_BATCH_EVENTS_BINLOG_EVENT_TYPE, log_event);
+}
+
 template <class BinlogT>
 void TQueueBinlog<BinlogT>::pop(uint64 log_event_id) {
   binlog_->erase(log_event_id);
@@ -552,6 +1181,13 @@ void TQueueBinlog<BinlogT>::pop_batch(std::vector<uint64> log_event_ids) {
 
 template <class BinlogT>
 Status TQueueBinlog<BinlogT>::replay(const BinlogEvent &binlog_event, TQueue &q) const {
+  if (binlog_event.type_ == BATCH_BINLOG_EVENT_TYPE) {
+    return replay_batch(binlog_event, q);
+  }
+  if (binlog_event.type_ == FORGET_BATCH_EVENTS_BINLOG_EVENT_TYPE) {
+    return replay_forget_batch_events(binlog_event, q);
+  }
+
   TQueueLogEvent event;
   TlParser parser(binlog_event.get_data());
   int32 has_extra = binlog_event.type_ - BINLOG_EVENT_TYPE;
@@ -574,6 +1210,60 @@ Status TQueueBinlog<BinlogT>::replay(const BinlogEvent &binlog_event, TQueue &q)
   return Status::OK();
 }
 
+template <class BinlogT>
+Status TQueueBinlog<BinlogT>::replay_batch(const BinlogEvent &binlog_event, TQueue &q) const {
+  TlParser parser(binlog_event.get_data());
+  int64 queue_id;
+  int32 event_count;
+  parse(queue_id, parser);
+  parse(event_count, parser);
+  vector<RawEvent> raw_events;
+  for (int32 i = 0; i < event_count; i++) {
+    int32 event_id;
+    RawEvent raw_event;
+    raw_event.log_event_id = binlog_event.id_;
+    parse(event_id, parser);
+    parse(raw_event.expires_at, parser);
+    raw_event.data = parser.fetch_string<string>();
+    parse(raw_event.extra, parser);
+    TRY_STATUS(parser.get_status());
+    TRY_RESULT_ASSIGN(raw_event.event_id, EventId::from_int32(event_id));
+    raw_events.push_back(std::move(raw_event));
+  }
+  parser.fetch_end();
+  TRY_STATUS(parser.get_status());
+  if (!q.do_push_batch(queue_id, std::move(raw_events))) {
+    return Status::Error("Failed to add events");
+  }
+  return Status::OK();
+}
+
+template <class BinlogT>
+Status TQueueBinlog<BinlogT>::replay_forget_batch_events(const BinlogEvent &binlog_event, TQueue &q) const {
+  TlParser parser(binlog_event.get_data());
+  int64 batch_log_event_id;
+  int32 range_count;
+  parse(batch_log_event_id, parser);
+  parse(range_count, parser);
+  vector<EventIdRange> event_id_ranges;
+  for (int32 i = 0; i < range_count; i++) {
+    int32 first_event_id;
+    int32 end_event_id;
+    parse(first_event_id, parser);
+    parse(end_event_id, parser);
+    TRY_STATUS(parser.get_status());
+    TRY_RESULT(first, EventId::from_int32(first_event_id));
+    TRY_RESULT(end, EventId::from_int32(end_event_id));
+    event_id_ranges.emplace_back(first, end);
+  }
+  parser.fetch_end();
+  TRY_STATUS(parser.get_status());
+  if (!q.do_forget_batch_events(static_cast<uint64>(batch_log_event_id), binlog_event.id_, event_id_ranges)) {
+    return Status::Error("Failed to forget events");
+  }
+  return Status::OK();
+}
+
 template <class BinlogT>
 void TQueueBinlog<BinlogT>::close(Promise<> promise) {
   binlog_->close(std::move(promise));
@@ -588,20 +1278,60 @@ uint64 TQueueMemoryStorage::push(QueueId queue_id, const RawEvent &event) {
   return log_event_id;
 }
 
+uint64 TQueueMemoryStorage::push_batch(QueueId queue_id, const vector<RawEvent> &events) {
+  CHECK(!events.empty());
+  auto log_event_id = events[0].log_event_id == 0 ? next_log_event_id_++ : events[0].log_event_id;
+  batches_[log_event_id] = std::make_pair(queue_id, events);
+  return log_event_id;
+}
+
+uint64 TQueueMemoryStorage::forget_batch_events(uint64 batch_log_event_id,
+                                                const vector<EventIdRange> &event_id_ranges) {
+  // the events are deleted from the stored batch immediately, so the returned log event is never replayed
+  auto it = batches_.find(batch_log_event_id);
+  CHECK(it != batches_.end());
+  td::remove_if(it->second.second, [&event_id_ranges](const RawEvent &event) {
+    for (auto &event_id_range : event_id_ranges) {
+      if (!(event.event_id < event_id_range.first) && event.event_id < event_id_range.second) {
+        return true;
+      }
+    }
+    return false;
+  });
+  CHECK(!it->second.second.empty());
+  return next_log_event_id_++;
+}
+
 void TQueueMemoryStorage::pop(uint64 log_event_id) {
   events_.erase(log_event_id);
+  batches_.erase(log_event_id);
 }
 
 void TQueueMemoryStorage::replay(TQueue &q) const {
-  for (auto &e : events_) {
-    auto x = e.second;
-    x.second.log_event_id = e.first;
-    bool is_added = q.do_push(x.first, std::move(x.second));
-    CHECK(is_added);
+  // replay single events and batches in the order of their log event identifiers
+  auto event_it = events_.begin();
+  auto batch_it = batches_.begin();
+  while (event_it != events_.end() || batch_it != batches_.end()) {
+    if (batch_it == batches_.end() || (event_it != events_.end() && event_it->first < batch_it->first)) {
+      auto x = event_it->second;
+      x.second.log_event_id = event_it->first;
+      bool is_added = q.do_push(x.first, std::move(x.second));
+      CHECK(is_added);
+      ++event_it;
+    } else {
+      auto x = batch_it->second;
+      for (auto &event : x.second) {
+        event.log_event_id = batch_it->first;
+      }
+      bool is_added = q.do_push_batch(x.first, std::move(x.second));
+      CHECK(is_added);
+      ++batch_it;
+    }
   }
 }
 void TQueueMemoryStorage::close(Promise<> promise) {
   events_.clear();
+  batches_.clear();
   promise.set_value({});
 }
 
@@ -66,12 +66,23 @@ class TQueue {
     int64 extra{0};
   };
 
+  // an event to be added by push_batch
+  struct BatchEvent {
+    string data;
+    int32 expires_at{0};
+    int64 extra{0};
+  };
+
   using QueueId = int64;
 
+  // identifiers of events from first inclusive to second exclusive
+  using EventIdRange = std::pair<EventId, EventId>;
+
   class StorageCallback {
    public:
     using QueueId = TQueue::QueueId;
     using RawEvent = TQueue::RawEvent;
+    using EventIdRange = TQueue::EventIdRange;
 
     StorageCallback() = default;
     StorageCallback(const StorageCallback &) = delete;
@@ -81,6 +92,10 @@ class TQueue {
     virtual ~StorageCallback() = default;
 
     virtual uint64 push(QueueId queue_id, const RawEvent &event) = 0;
+    // stores all events in one log event; the events must have the same log_event_id, which is 0 for a new log event
+    virtual uint64 push_batch(QueueId queue_id, const vector<RawEvent> &events) = 0;
+    // stores identifiers of events deleted from a batch in a new log event without rewriting the batch
+    virtual uint64 forget_batch_events(uint64 batch_log_event_id, const vector<EventIdRange> &event_id_ranges) = 0;
     virtual void pop(uint64 log_event_id) = 0;
     virtual void close(Promise<> promise) = 0;
     virtual void pop_batch(std::vector<uint64> log_event_ids);
@@ -103,8 +118,20 @@ class TQueue {
 
   virtual Result<EventId> push(QueueId queue_id, string data, int32 expires_at, int64 extra, EventId hint_new_id) = 0;
 
+  virtual bool do_push_batch(QueueId queue_id, vector<RawEvent> &&raw_events) = 0;
+
+  // adds events with consecutive identifiers, which are stored in a single log event
+  // returns identifier of the first added event
+  virtual Result<EventId> push_batch(QueueId queue_id, vector<BatchEvent> events, EventId hint_new_id) = 0;
+
+  virtual bool do_forget_batch_events(uint64 batch_log_event_id, uint64 log_event_id,
+                                      const vector<EventIdRange> &event_id_ranges) = 0;
+
   virtual void forget(QueueId queue_id, EventId event_id) = 0;
 
+  // forgets all events with identifiers less than upto_id
+  virtual void forget_range(QueueId queue_id, EventId upto_id) = 0;
+
   virtual std::map<EventId, RawEvent> clear(QueueId queue_id, size_t keep_count) = 0;
 
   virtual EventId get_head(QueueId queue_id) const = 0;
@@ -128,6 +155,8 @@ template <class BinlogT>
 class TQueueBinlog final : public TQueue::StorageCallback {
  public:
   uint64 push(QueueId queue_id, const RawEvent &event) final;
+  uint64 push_batch(QueueId queue_id, const vector<RawEvent> &events) final;
+  uint64 forget_batch_events(uint64 batch_log_event_id, const vector<EventIdRange> &event_id_ranges) final;
   void pop(uint64 log_event_id) final;
   void pop_batch(std::vector<uint64> log_event_ids) final;
   Status replay(const BinlogEvent &binlog_event, TQueue &q) const TD_WARN_UNUSED_RESULT;
@@ -140,11 +169,18 @@ class TQueueBinlog final : public TQueue::StorageCallback {
  private:
   std::shared_ptr<BinlogT> binlog_;
   static constexpr int32 BINLOG_EVENT_TYPE = 2314;
+  static constexpr int32 BATCH_BINLOG_EVENT_TYPE = 2316;
+  static constexpr int32 FORGET_BATCH_EVENTS_BINLOG_EVENT_TYPE = 2317;
+
+  Status replay_batch(const BinlogEvent &binlog_event, TQueue &q) const TD_WARN_UNUSED_RESULT;
+  Status replay_forget_batch_events(const BinlogEvent &binlog_event, TQueue &q) const TD_WARN_UNUSED_RESULT;
 };
 
 class TQueueMemoryStorage final : public TQueue::StorageCallback {
  public:
   uint64 push(QueueId queue_id, const RawEvent &event) final;
+  uint64 push_batch(QueueId queue_id, const vector<RawEvent> &events) final;
+  uint64 forget_batch_events(uint64 batch_log_event_id, const vector<EventIdRange> &event_id_ranges) final;
   void pop(uint64 log_event_id) final;
   void replay(TQueue &q) const;
   void close(Promise<> promise) final;
@@ -152,6 +188,7 @@ class TQueueMemoryStorage final : public TQueue::StorageCallback {
  private:
   uint64 next_log_event_id_{1};
   std::map<uint64, std::pair<QueueId, RawEvent>> events_;
+  std::map<uint64, std::pair<QueueId, vector<RawEvent>>> batches_;
 };
 
 }  // namespace td
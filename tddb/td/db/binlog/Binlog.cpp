@@ -14,6 +14,7 @@
 #include "td/utils/misc.h"
 #include "td/utils/port/Clocks.h"
 #include "td/utils/port/FileFd.h"
+#include "td/utils/port/MemoryMapping.h"
 #include "td/utils/port/path.h"
 #include "td/utils/port/PollFlags.h"
 #include "td/utils/port/sleep.h"
@@ -165,6 +166,174 @@ static int64 file_size(CSlice path) {
   }
   return r_stat.ok().size_;
 }
+
+// maps the binlog file window by window, so only a small part of it is mapped to memory simultaneously
+class BinlogFileMapping {
+ public:
+  BinlogFileMapping(const FileFd &fd, int64 file_size) : fd_(fd), file_size_(file_size) {
+  }
+
+  int64 file_size() const {
+    return file_size_;
+  }
+
+  Result<Slice> get_data(int64 offset, size_t size) {
+    auto end = offset + static_cast<int64>(size);
+    CHECK(offset >= 0 && end <= file_size_);
+    if (mapping_ == nullptr || offset < begin_ || end > begin_ + static_cast<int64>(data_.size())) {
+      mapping_ = nullptr;
+      auto mapping_size = min(file_size_ - offset, max(static_cast<int64>(size), WINDOW_SIZE));
+      TRY_RESULT(mapping, MemoryMapping::create_from_file(
+                              fd_, MemoryMapping::Options().with_offset(offset).with_size(mapping_size)));
+      mapping_ = make_unique<MemoryMapping>(std::move(mapping));
+      begin_ = offset;
+      data_ = mapping_->as_slice();
+    }
+    return data_.substr(narrow_cast<size_t>(offset - begin_), size);
+  }
+
+ private:
+  static constexpr int64 WINDOW_SIZE = 1 << 22;
+
+  const FileFd &fd_;
+  int64 file_size_;
+  unique_ptr<MemoryMapping> mapping_;
+  int64 begin_ = 0;
+  Slice data_;
+};
+
+// writes the events existing at the start of the reindex to a new file in small steps, which are interleaved with
+// addition of new events to the old file; the new events are appended to the new file after all the old events
+class BinlogBackgroundReindex {
+ public:
+  static constexpr size_t STEP_SIZE = 1 << 16;
+  static constexpr int64 SYNC_SIZE = 1 << 24;
+
+  BinlogBackgroundReindex(FileFd fd, string path, uint64 end_event_id, int64 start_size, uint64 start_events)
+      : fd_(std::move(fd))
+      , path_(std::move(path))
+      , end_event_id_(end_event_id)
+      , start_time_(Clocks::monotonic())
+      , start_size_(start_size)
+      , start_events_(start_events) {
+  }
+
+  Status init_encryption(string key_salt, Slice key) {
+    AesCtrEncryptionEvent event;
+    event.key_salt_ = std::move(key_salt);
+    event.iv_.resize(AesCtrEncryptionEvent::iv_size());
+    Random::secure_bytes(event.iv_);
+    event.key_hash_ = AesCtrEncryptionEvent::generate_hash(key);
+
+    auto raw_event =
+        BinlogEvent::create_raw(0, BinlogEvent::ServiceTypes::AesCtrEncryption, 0, create_default_storer(event));
+    TRY_STATUS(write(raw_event.as_mutable_slice()));
+    events_++;
+
+    aes_ctr_state_.init(key, event.iv_);
+    is_encrypted_ = true;
+    return Status::OK();
+  }
+
+  // returns true if all old events have been written
+  Result<bool> write_old_events(const BinlogEventsProcessor &processor) {
+    bool is_finished = true;
+    buffer_.clear();
+    processor.for_each_in_range(last_written_event_id_ + 1, end_event_id_, [&](const BinlogEvent &event) {
+      if (buffer_.size() >= STEP_SIZE) {
+        is_finished = false;
+        return false;
+      }
+      buffer_ += event.raw_event_;
+      last_written_event_id_ = event.id_;
+      events_++;
+      return true;
+    });
+    TRY_STATUS(write(buffer_));
+    if (size_ - synced_size_ >= SYNC_SIZE) {
+      // sync the file gradually to avoid a long sync after the last step
+      TRY_STATUS(fd_.sync_barrier());
+      synced_size_ = size_;
+    }
+    return is_finished;
+  }
+
+  void on_new_event(const BinlogEvent &event) {
+    if ((event.flags_ & BinlogEvent::Flags::Rewrite) && last_written_event_id_ < event.id_ &&
+        event.id_ <= end_event_id_) {
+      // the rewritten event isn't written yet, so its new version will be written instead
+      return;
+    }
+    new_events_ += event.raw_event_;
+    events_++;
+  }
+
+  Status write_new_events() {
+    TRY_STATUS(write(new_events_));
+    new_events_ = string();
+    return fd_.sync_barrier();
+  }
+
+  FileFd &fd() {
+    return fd_;
+  }
+
+  const string &path() const {
+    return path_;
+  }
+
+  int64 size() const {
+    return size_;
+  }
+
+  uint64 events() const {
+    return events_;
+  }
+
+  double start_time() const {
+    return start_time_;
+  }
+
+  int64 start_size() const {
+    return start_size_;
+  }
+
+  uint64 start_events() const {
+    return start_events_;
+  }
+
+  AesCtrState move_aes_ctr_state() {
+    return std::move(aes_ctr_state_);
+  }
+
+ private:
+  FileFd fd_;
+  string path_;
+  uint64 end_event_id_;
+  uint64 last_written_event_id_ = 0;
+  double start_time_;
+  int64 start_size_;
+  uint64 start_events_;
+  int64 size_ = 0;
+  int64 synced_size_ = 0;
+  uint64 events_ = 0;
+  bool is_encrypted_ = false;
+  AesCtrState aes_ctr_state_;
+  string buffer_;
+  string new_events_;
+
+  Status write(MutableSlice data) {
+    if (is_encrypted_) {
+      aes_ctr_state_.encrypt(data, data);
+    }
+    size_ += static_cast<int64>(data.size());
+    while (!data.empty()) {
+      TRY_RESULT(written_size, fd_.write(data));
+      data.remove_prefix(written_size);
+    }
+    return Status::OK();
+  }
+};
 }  // namespace detail
 
 int32 VERBOSITY_NAME(binlog) = VERBOSITY_NAME(DEBUG) + 8;
@@ -239,6 +408,10 @@ void Binlog::add_event(BinlogEvent &&event) {
   lazy_flush();
 
   if (state_ == State::Run) {
+    if (background_reindex_ != nullptr) {
+      return continue_background_reindex();
+    }
+
     auto fd_size = fd_size_;
     if (events_buffer_) {
       fd_size += events_buffer_->size();
@@ -249,7 +422,7 @@ void Binlog::add_event(BinlogEvent &&event) {
     if (need_reindex(50000, 5) || need_reindex(100000, 4) || need_reindex(300000, 3) || need_reindex(500000, 2)) {
       LOG(INFO) << tag("fd_size", format::as_size(fd_size))
                 << tag("total events size", format::as_size(processor_->total_raw_events_size()));
-      do_reindex();
+      start_background_reindex();
     }
   }
 }
@@ -285,6 +458,9 @@ Status Binlog::close(bool need_sync) {
   if (fd_.empty()) {
     return Status::OK();
   }
+  if (background_reindex_ != nullptr) {
+    cancel_background_reindex();
+  }
   if (need_sync) {
     sync("close");
   } else {
@@ -335,6 +511,9 @@ void Binlog::do_event(BinlogEvent &&event) {
     VLOG(binlog) << "Write binlog event: " << format::cond(state_ == State::Reindex, "[reindex] ")
                  << event.public_to_string();
     buffer_writer_.append(as_slice(event.raw_event_));
+    if (background_reindex_ != nullptr) {
+      background_reindex_->on_new_event(event);
+    }
   }
 
   if (event.type_ < 0) {
@@ -404,6 +583,15 @@ void Binlog::do_event(BinlogEvent &&event) {
   fd_size_ += event_size;
 }
 
+bool Binlog::has_event(uint64 event_id) const {
+  return processor_ != nullptr && processor_->has_event(event_id);
+}
+
+void Binlog::for_each_event(const Callback &callback) {
+  CHECK(processor_ != nullptr);
+  processor_->for_each([&](BinlogEvent &event) { callback(event); });
+}
+
 void Binlog::sync(const char *source) {
   flush(source);
   if (need_sync_) {
@@ -457,7 +645,10 @@ void Binlog::lazy_flush() {
 }
 
 void Binlog::update_read_encryption() {
-  CHECK(binlog_reader_ptr_);
+  if (binlog_reader_ptr_ == nullptr) {
+    // the binlog is loaded from memory mapping, which is decrypted in load_mapped_events
+    return;
+  }
   switch (encryption_type_) {
     case EncryptionType::None: {
       auto r_file_size = fd_.get_size();
@@ -503,7 +694,58 @@ void Binlog::update_write_encryption() {
 
 Status Binlog::load_binlog(const Callback &callback, const Callback &debug_callback) {
   state_ = State::Load;
+  info_.wrong_password = false;
+
+  // memory mapping can't be created for empty files and isn't supported on some platforms
+  TRY_RESULT(file_size, fd_.get_size());
+  bool is_mapped = false;
+  {
+    detail::BinlogFileMapping mapping(fd_, file_size);
+    if (file_size >= 4 && mapping.get_data(0, 4).is_ok()) {
+      is_mapped = true;
+      TRY_STATUS(load_mapped_events(mapping, debug_callback));
+    }
+  }
+  if (!is_mapped) {
+    TRY_STATUS(read_events(debug_callback));
+  }
+  if (info_.wrong_password) {
+    return Status::OK();
+  }
+
+  auto offset = processor_->offset();
+  CHECK(offset >= 0);
+  processor_->for_each([&](BinlogEvent &event) {
+    VLOG(binlog) << "Replay binlog event: " << event.public_to_string();
+    if (callback) {
+      callback(event);
+    }
+  });
+
+  TRY_RESULT(fd_size, fd_.get_size());
+  if (offset != fd_size) {
+    LOG(ERROR) << "Truncate " << tag("path", path_) << tag("old_size", fd_size) << tag("new_size", offset);
+    fd_.seek(offset).ensure();
+    fd_.truncate_to_current_position(offset).ensure();
+    db_key_used_ = false;  // force reindex
+  }
+  LOG_CHECK(fd_size_ == offset) << fd_size << " " << fd_size_ << " " << offset;
+  binlog_reader_ptr_ = nullptr;
+  state_ = State::Run;
+
+  buffer_writer_ = ChainBufferWriter();
+  buffer_reader_ = buffer_writer_.extract_reader();
+
+  // reuse aes_ctr_state_
+  if (encryption_type_ == EncryptionType::AesCtr && !is_mapped) {
+    aes_ctr_state_ = aes_xcode_byte_flow_.move_aes_ctr_state();
+  }
+  update_write_encryption();
+
+  return Status::OK();
+}
 
+Status Binlog::read_events(const Callback &debug_callback) {
   buffer_writer_ = ChainBufferWriter();
   buffer_reader_ = buffer_writer_.extract_reader();
   fd_.set_input_writer(&buffer_writer_);
@@ -513,7 +755,6 @@ Status Binlog::load_binlog(const Callback &callback, const Callback &debug_callb
   update_read_encryption();
 
   fd_.get_poll_info().add_flags(PollFlags::Read());
-  info_.wrong_password = false;
   while (true) {
     BinlogEvent event;
     auto r_need_size = reader.read_next(&event);
@@ -554,37 +795,86 @@ Status Binlog::load_binlog(const Callback &callback, const Callback &debug_callb
       }
     }
   }
+  return Status::OK();
+}
 
-  auto offset = processor_->offset();
-  CHECK(offset >= 0);
-  processor_->for_each([&](BinlogEvent &event) {
-    VLOG(binlog) << "Replay binlog event: " << event.public_to_string();
-    if (callback) {
-      callback(event);
+Status Binlog::load_mapped_events(detail::BinlogFileMapping &mapping, const Callback &debug_callback) {
+  // events are copied or decrypted directly from the mapped file without intermediate buffers
+  bool is_encrypted = false;
+  auto copy_data = [&](Slice from, MutableSlice to) {
+    if (is_encrypted) {
+      aes_ctr_state_.decrypt(from, to);
+    } else {
+      to.copy_from(from);
     }
-  });
+  };
 
-  TRY_RESULT(fd_size, fd_.get_size());
-  if (offset != fd_size) {
-    LOG(ERROR) << "Truncate " << tag("path", path_) << tag("old_size", fd_size) << tag("new_size", offset);
-    fd_.seek(offset).ensure();
-    fd_.truncate_to_current_position(offset).ensure();
-    db_key_used_ = false;  // force reindex
-  }
-  LOG_CHECK(fd_size_ == offset) << fd_size << " " << fd_size_ << " " << offset;
-  binlog_reader_ptr_ = nullptr;
-  state_ = State::Run;
+  auto file_size = mapping.file_size();
+  int64 offset = 0;
+  while (file_size - offset >= 4) {
+    char size_buf[4];
+    TRY_RESULT(size_data, mapping.get_data(offset, 4));
+    copy_data(size_data, MutableSlice(size_buf, 4));
+    auto size = static_cast<size_t>(TlParser(Slice(size_buf, 4)).fetch_int());
+    if (size > BinlogEvent::MAX_SIZE) {
+      LOG(ERROR) << "Too big event " << tag("size", size);
+      break;
+    }
+    if (size < BinlogEvent::MIN_SIZE) {
+      LOG(ERROR) << "Too small event " << tag("size", size);
+      break;
+    }
+    if (size % 4 != 0) {
+      auto old_size = detail::file_size(path_);
+      auto debug_data = debug_get_binlog_data(offset, old_size);
+      fd_.seek(offset).ensure();
+      fd_.truncate_to_current_position(offset).ensure();
+      if (debug_data.empty()) {
+        return Status::OK();
+      }
+      LOG(FATAL) << "Truncate binlog \"" << path_ << "\" from size " << old_size << " to size " << offset
+                 << " due to error: event of size " << size << " out of " << file_size << ' '
+                 << tag("is_encrypted", is_encrypted) << " after reading " << debug_data;
+    }
+    if (file_size - offset < static_cast<int64>(size)) {
+      break;
+    }
 
-  buffer_writer_ = ChainBufferWriter();
-  buffer_reader_ = buffer_writer_.extract_reader();
+    string raw_event(size, '\0');
+    MutableSlice(raw_event).copy_from(Slice(size_buf, 4));
+    TRY_RESULT(event_data, mapping.get_data(offset + 4, size - 4));
+    copy_data(event_data, MutableSlice(raw_event).substr(4));
+    BinlogEvent event;
+    event.debug_info_ = BinlogDebugInfo{__FILE__, __LINE__};
+    event.init(std::move(raw_event));
+    auto status = event.validate();
+    if (status.is_error()) {
+      LOG(ERROR) << status;
+      break;
+    }
+    offset += static_cast<int64>(size);
+    event.offset_ = offset;
 
-  // reuse aes_ctr_state_
-  if (encryption_type_ == EncryptionType::AesCtr) {
-    aes_ctr_state_ = aes_xcode_byte_flow_.move_aes_ctr_state();
+    bool is_encryption_event = event.type_ == BinlogEvent::ServiceTypes::AesCtrEncryption;
+    if (debug_callback) {
+      debug_callback(event);
+    }
+    do_add_event(std::move(event));
+    if (info_.wrong_password) {
+      return Status::OK();
+    }
+    if (pending_events_.empty() && fd_size_ != offset) {
+      // the binlog has been truncated after the last processed event, so the rest of the mapping is invalid
+      break;
+    }
+    if (is_encryption_event) {
+      // the rest of the file is encrypted with the new aes_ctr_state_
+      is_encrypted = true;
+    }
   }
-  update_write_encryption();
 
-  return Status::OK();
+  // continue writing after the last processed event; the rest of the file is truncated by the caller if needed
+  return fd_.seek(fd_size_);
 }
 
 void Binlog::update_encryption(Slice key, Slice iv) {
@@ -628,6 +918,9 @@ void Binlog::reset_encryption() {
 
 void Binlog::do_reindex() {
   flush_events_buffer(true);
+  if (background_reindex_ != nullptr) {
+    cancel_background_reindex();
+  }
   // start reindex
   CHECK(state_ == State::Run);
   state_ = State::Reindex;
@@ -670,7 +963,20 @@ void Binlog::do_reindex() {
     need_sync_ = false;
   }
 
-  // finish_reindex
+  finish_reindex(std::move(old_fd), new_path, start_time, start_size, start_events);
+
+  buffer_writer_ = ChainBufferWriter();
+  buffer_reader_ = buffer_writer_.extract_reader();
+
+  // reuse aes_ctr_state_
+  if (encryption_type_ == EncryptionType::AesCtr) {
+    aes_ctr_state_ = aes_xcode_byte_flow_.move_aes_ctr_state();
+  }
+  update_write_encryption();
+}
+
+void Binlog::finish_reindex(BufferedFdBase<FileFd> old_fd, const string &new_path, double start_time, int64 start_size,
+                            uint64 start_events) {
   auto status = unlink(path_);
   LOG_IF(FATAL, status.is_error()) << "Failed to unlink old binlog: " << status;
   old_fd.close();  // now we can close old file and release the system lock
@@ -707,17 +1013,77 @@ void Binlog::do_reindex() {
   }(PSLICE() << "Regenerate index " << tag("name", path_) << tag("time", format::as_time(finish_time - start_time))
              << tag("before_size", format::as_size(start_size)) << tag("after_size", format::as_size(finish_size))
              << tag("ratio", ratio) << tag("before_events", start_events) << tag("after_events", finish_events));
+}
+
+void Binlog::start_background_reindex() {
+  flush_events_buffer(true);
+  CHECK(state_ == State::Run);
+  CHECK(background_reindex_ == nullptr);
+
+  string new_path = path_ + ".new";
+  auto r_opened_file = open_binlog(new_path, FileFd::Flags::Write | FileFd::Flags::Create | FileFd::Truncate);
+  if (r_opened_file.is_error()) {
+    LOG(ERROR) << "Can't open new binlog for regenerate: " << r_opened_file.error();
+    return;
+  }
+  background_reindex_ = td::make_unique<detail::BinlogBackgroundReindex>(
+      r_opened_file.move_as_ok(), std::move(new_path), processor_->last_event_id(), fd_size_, fd_events_);
+  if (encryption_type_ == EncryptionType::AesCtr) {
+    auto status = background_reindex_->init_encryption(aes_ctr_key_salt_, as_slice(aes_ctr_key_));
+    if (status.is_error()) {
+      LOG(ERROR) << "Failed to regenerate binlog: " << status;
+      return cancel_background_reindex();
+    }
+  }
+  continue_background_reindex();
+}
+
+void Binlog::continue_background_reindex() {
+  CHECK(background_reindex_ != nullptr);
+  auto r_is_finished = background_reindex_->write_old_events(*processor_);
+  if (r_is_finished.is_error()) {
+    LOG(ERROR) << "Failed to regenerate binlog: " << r_is_finished.error();
+    return cancel_background_reindex();
+  }
+  if (r_is_finished.ok()) {
+    finish_background_reindex();
+  }
+}
+
+void Binlog::finish_background_reindex() {
+  CHECK(background_reindex_ != nullptr);
+  auto status = background_reindex_->write_new_events();
+  if (status.is_error()) {
+    LOG(ERROR) << "Failed to regenerate binlog: " << status;
+    return cancel_background_reindex();
+  }
 
+  auto reindex = std::move(background_reindex_);
+  auto old_fd = std::move(fd_);  // can't close fd_ now, because it will release file lock
+  fd_ = BufferedFdBase<FileFd>(std::move(reindex->fd()));
+  fd_size_ = reindex->size();
+  fd_events_ = reindex->events();
+  need_sync_ = false;  // all events have already been synced to the new file
+  finish_reindex(std::move(old_fd), reindex->path(), reindex->start_time(), reindex->start_size(),
+                 reindex->start_events());
+
+  // data buffered for the old file is already written to the new file
   buffer_writer_ = ChainBufferWriter();
   buffer_reader_ = buffer_writer_.extract_reader();
-
-  // reuse aes_ctr_state_
   if (encryption_type_ == EncryptionType::AesCtr) {
-    aes_ctr_state_ = aes_xcode_byte_flow_.move_aes_ctr_state();
+    aes_ctr_state_ = reindex->move_aes_ctr_state();
   }
   update_write_encryption();
 }
 
+void Binlog::cancel_background_reindex() {
+  auto reindex = std::move(background_reindex_);
+  CHECK(reindex != nullptr);
+  reindex->fd().lock(FileFd::LockFlags::Unlock, reindex->path(), 1).ignore();
+  reindex->fd().close();
+  unlink(reindex->path()).ignore();
+}
+
 string Binlog::debug_get_binlog_data(int64 begin_offset, int64 end_offset) {
   if (begin_offset > end_offset) {
     return "Begin offset is bigger than end_offset";
@@ -38,6 +38,8 @@ struct BinlogInfo {
 };
 
 namespace detail {
+class BinlogBackgroundReindex;
+class BinlogFileMapping;
 class BinlogReader;
 class BinlogEventsProcessor;
 class BinlogEventsBuffer;
@@ -109,6 +111,13 @@ class Binlog {
   }
 
   void add_event(BinlogEvent &&event);
+
+  // returns whether there is a non-deleted event with the given identifier
+  bool has_event(uint64 event_id) const;
+
+  // calls callback for each non-deleted event in the order of their identifiers
+  void for_each_event(const Callback &callback);
+
   void sync(const char *source);
   void flush(const char *source);
   void lazy_flush();
@@ -158,6 +167,7 @@ class Binlog {
   vector<BinlogEvent> pending_events_;
   unique_ptr<detail::BinlogEventsProcessor> processor_;
   unique_ptr<detail::BinlogEventsBuffer> events_buffer_;
+  unique_ptr<detail::BinlogBackgroundReindex> background_reindex_;
   bool in_flush_events_buffer_{false};
   uint64 last_event_id_{0};
   double need_flush_since_ = 0;
@@ -170,7 +180,16 @@ class Binlog {
   void do_add_event(BinlogEvent &&event);
   void do_event(BinlogEvent &&event);
   Status load_binlog(const Callback &callback, const Callback &debug_callback = Callback()) TD_WARN_UNUSED_RESULT;
+  Status read_events(const Callback &debug_callback) TD_WARN_UNUSED_RESULT;
+  Status load_mapped_events(detail::BinlogFileMapping &mapping, const Callback &debug_callback) TD_WARN_UNUSED_RESULT;
   void do_reindex();
+  void finish_reindex(BufferedFdBase<FileFd> old_fd, const string &new_path, double start_time, int64 start_size,
+                      uint64 start_events);
+
+  void start_background_reindex();
+  void continue_background_reindex();
+  void finish_background_reindex();
+  void cancel_background_reindex();
 
   void update_encryption(Slice key, Slice iv);
   void reset_encryption();
@@ -12,23 +12,35 @@
 #include "td/utils/SliceBuilder.h"
 #include "td/utils/Time.h"
 
+#include <functional>
 #include <map>
+#include <queue>
+#include <utility>
 
 namespace td {
 namespace detail {
 class BinlogActor final : public Actor {
  public:
-  BinlogActor(unique_ptr<Binlog> binlog, uint64 seq_no) : binlog_(std::move(binlog)), processor_(seq_no) {
+  BinlogActor(vector<unique_ptr<Binlog>> binlogs, ConcurrentBinlog::GetSegment get_segment, uint64 seq_no)
+      : binlogs_(std::move(binlogs)), get_segment_(std::move(get_segment)), processor_(seq_no) {
+    CHECK(!binlogs_.empty());
+    CHECK(binlogs_.size() == 1 || get_segment_ != nullptr);
   }
   void close(Promise<> promise) {
-    binlog_->close().ensure();
+    for (auto &binlog : binlogs_) {
+      binlog->close().ensure();
+    }
+    LOG(INFO) << "Binlog was synced " << sync_count_ << " times for " << sync_request_count_ << " requests with "
+              << synced_event_count_ << " events in " << Time::now() - start_time_ << " seconds";
     LOG(INFO) << "Finished to close binlog";
     stop();
 
     promise.set_value(Unit());  // setting promise can complete closing and destroy the current actor context
   }
   void close_and_destroy(Promise<> promise) {
-    binlog_->close_and_destroy().ensure();
+    for (auto &binlog : binlogs_) {
+      binlog->close_and_destroy().ensure();
+    }
     LOG(INFO) << "Finished to destroy binlog";
     stop();
 
@@ -73,17 +85,43 @@ class BinlogActor final : public Actor {
 
   void force_flush() {
     // TODO: use same logic as in force_sync
-    binlog_->flush("force_flush");
+    for (auto &binlog : binlogs_) {
+      binlog->flush("force_flush");
+    }
     flush_flag_ = false;
   }
 
   void change_key(DbKey db_key, Promise<> promise) {
-    binlog_->change_key(std::move(db_key));
+    for (auto &binlog : binlogs_) {
+      binlog->change_key(db_key);
+    }
     promise.set_value(Unit());
   }
 
+  void set_sync_policy(ConcurrentBinlog::SyncPolicy sync_policy) {
+    sync_policy_ = sync_policy;
+  }
+
+  void get_sync_statistics(Promise<ConcurrentBinlog::SyncStatistics> promise) {
+    ConcurrentBinlog::SyncStatistics result;
+    result.sync_count = sync_count_;
+    result.sync_request_count = sync_request_count_;
+    result.synced_event_count = synced_event_count_;
+    result.passed_time = Time::now() - start_time_;
+    promise.set_value(std::move(result));
+  }
+
  private:
-  unique_ptr<Binlog> binlog_;
+  vector<unique_ptr<Binlog>> binlogs_;
+  ConcurrentBinlog::GetSegment get_segment_;
+
+  ConcurrentBinlog::SyncPolicy sync_policy_;
+  double last_sync_time_ = 0.0;
+  double start_time_ = Time::now();
+  uint64 sync_count_ = 0;
+  uint64 sync_request_count_ = 0;
+  uint64 synced_event_count_ = 0;
+  uint64 unsynced_event_count_ = 0;
 
   OrderedEventsProcessor<Event> processor_;
 
@@ -108,19 +146,56 @@ class BinlogActor final : public Actor {
     }
   }
 
+  size_t get_segment(const BinlogEvent &event) const {
+    if (binlogs_.size() == 1) {
+      return 0;
+    }
+    if ((event.flags_ & BinlogEvent::Flags::Rewrite) != 0) {
+      for (size_t i = 0; i < binlogs_.size(); i++) {
+        if (binlogs_[i]->has_event(event.id_)) {
+          return i;
+        }
+      }
+      // the event is unknown; the first segment will fail to rewrite it as a non-segmented binlog does
+      return 0;
+    }
+    auto segment = get_segment_(event.type_);
+    LOG_CHECK(segment < binlogs_.size()) << event.public_to_string();
+    return segment;
+  }
+
   void do_add_raw_event(BufferSlice &&raw_event, BinlogDebugInfo info) {
-    binlog_->add_raw_event(std::move(raw_event), info);
+    BinlogEvent event(std::move(raw_event), info);
+    auto segment = get_segment(event);
+    binlogs_[segment]->add_event(std::move(event));
+    unsynced_event_count_++;
+  }
+
+  void do_sync(const char *source) {
+    // only segments with written, but not synced events are synced
+    for (auto &binlog : binlogs_) {
+      binlog->sync(source);
+    }
+    if (unsynced_event_count_ > 0) {
+      sync_count_++;
+      synced_event_count_ += unsynced_event_count_;
+      unsynced_event_count_ = 0;
+    }
+    last_sync_time_ = Time::now();
+    set_promises(sync_promises_);
   }
 
   void try_flush() {
-    auto need_flush_since = binlog_->need_flush_since();
     auto now = Time::now_cached();
-    if (now > need_flush_since + FLUSH_TIMEOUT - 1e-9) {
-      binlog_->flush("try_flush");
-    } else {
-      if (!force_sync_flag_) {
-        flush_flag_ = true;
-        wakeup_at(need_flush_since + FLUSH_TIMEOUT);
+    for (auto &binlog : binlogs_) {
+      auto need_flush_since = binlog->need_flush_since();
+      if (now > need_flush_since + FLUSH_TIMEOUT - 1e-9) {
+        binlog->flush("try_flush");
+      } else {
+        if (!force_sync_flag_) {
+          flush_flag_ = true;
+          wakeup_at(need_flush_since + FLUSH_TIMEOUT);
+        }
       }
     }
   }
@@ -137,9 +212,24 @@ class BinlogActor final : public Actor {
     if (promise) {
       sync_promises_.emplace_back(std::move(promise));
     }
-    if (!force_sync_flag_) {
-      force_sync_flag_ = true;
-      wakeup_after(0.003);
+    sync_request_count_++;
+    switch (sync_policy_.type_) {
+      case ConcurrentBinlog::SyncPolicy::Type::Always:
+        return do_sync("do_immediate_sync");
+      case ConcurrentBinlog::SyncPolicy::Type::Group:
+        if (!force_sync_flag_) {
+          force_sync_flag_ = true;
+          wakeup_after(sync_policy_.delay_);
+        }
+        break;
+      case ConcurrentBinlog::SyncPolicy::Type::Interval:
+        if (!force_sync_flag_) {
+          force_sync_flag_ = true;
+          wakeup_at(max(Time::now_cached(), last_sync_time_ + sync_policy_.delay_));
+        }
+        break;
+      default:
+        UNREACHABLE();
     }
   }
 
@@ -147,6 +237,9 @@ class BinlogActor final : public Actor {
     if (!promise) {
       return;
     }
+    if (sync_policy_.type_ == ConcurrentBinlog::SyncPolicy::Type::Always) {
+      return do_immediate_sync(std::move(promise));
+    }
     sync_promises_.emplace_back(std::move(promise));
     if (!lazy_sync_flag_ && !force_sync_flag_) {
       wakeup_after(30);
@@ -162,9 +255,7 @@ class BinlogActor final : public Actor {
     flush_flag_ = false;
     wakeup_at_ = 0;
     if (need_sync) {
-      binlog_->sync("timeout_expired");
-      // LOG(ERROR) << "BINLOG SYNC";
-      set_promises(sync_promises_);
+      do_sync("timeout_expired");
     } else if (need_flush) {
       try_flush();
       // LOG(ERROR) << "BINLOG FLUSH";
@@ -176,7 +267,12 @@ class BinlogActor final : public Actor {
 ConcurrentBinlog::ConcurrentBinlog() = default;
 ConcurrentBinlog::~ConcurrentBinlog() = default;
 ConcurrentBinlog::ConcurrentBinlog(unique_ptr<Binlog> binlog, int scheduler_id) {
-  init_impl(std::move(binlog), scheduler_id);
+  vector<unique_ptr<Binlog>> binlogs;
+  binlogs.push_back(std::move(binlog));
+  init_impl(std::move(binlogs), nullptr, scheduler_id);
+}
+ConcurrentBinlog::ConcurrentBinlog(vector<unique_ptr<Binlog>> binlogs, GetSegment get_segment, int scheduler_id) {
+  init_impl(std::move(binlogs), std::move(get_segment), scheduler_id);
 }
 
 Result<BinlogInfo> ConcurrentBinlog::init(string path, const Callback &callback, DbKey db_key, DbKey old_db_key,
@@ -184,15 +280,98 @@ Result<BinlogInfo> ConcurrentBinlog::init(string path, const Callback &callback,
   auto binlog = make_unique<Binlog>();
   TRY_STATUS(binlog->init(std::move(path), callback, std::move(db_key), std::move(old_db_key)));
   auto info = binlog->get_info();
-  init_impl(std::move(binlog), scheduler_id);
+  vector<unique_ptr<Binlog>> binlogs;
+  binlogs.push_back(std::move(binlog));
+  init_impl(std::move(binlogs), nullptr, scheduler_id);
+  return info;
+}
+
+Result<BinlogInfo> ConcurrentBinlog::init_segmented(string path, size_t segment_count, GetSegment get_segment,
+                                                    const Callback &callback, DbKey db_key, DbKey old_db_key,
+                                                    int scheduler_id) {
+  CHECK(segment_count > 0);
+  BinlogInfo info;
+  vector<unique_ptr<Binlog>> binlogs;
+  for (size_t i = 0; i < segment_count; i++) {
+    auto binlog = make_unique<Binlog>();
+    auto status = binlog->init(get_segment_path(path, i), Callback(), db_key, old_db_key);
+    if (status.is_error()) {
+      for (auto &opened_binlog : binlogs) {
+        opened_binlog->close(false).ignore();
+      }
+      return std::move(status);
+    }
+    auto segment_info = binlog->get_info();
+    if (i == 0) {
+      info = segment_info;
+    } else {
+      info.was_created &= segment_info.was_created;
+      info.last_event_id = max(info.last_event_id, segment_info.last_event_id);
+      info.is_encrypted |= segment_info.is_encrypted;
+      info.wrong_password |= segment_info.wrong_password;
+      info.is_opened &= segment_info.is_opened;
+    }
+    binlogs.push_back(std::move(binlog));
+  }
+
+  if (callback) {
+    // identifiers are shared by all segments and events of each segment are already sorted by them,
+    // so a merge of the segments replays the events in the same order as from a single binlog
+    vector<vector<const BinlogEvent *>> segment_events(segment_count);
+    for (size_t i = 0; i < segment_count; i++) {
+      binlogs[i]->for_each_event([&](const BinlogEvent &event) { segment_events[i].push_back(&event); });
+    }
+    using QueueItem = std::pair<uint64, size_t>;
+    std::priority_queue<QueueItem, vector<QueueItem>, std::greater<QueueItem>> queue;
+    vector<size_t> positions(segment_count, 0);
+    for (size_t i = 0; i < segment_count; i++) {
+      if (!segment_events[i].empty()) {
+        queue.emplace(segment_events[i][0]->id_, i);
+      }
+    }
+    while (!queue.empty()) {
+      auto segment = queue.top().second;
+      queue.pop();
+      auto &events = segment_events[segment];
+      auto &position = positions[segment];
+      callback(*events[position]);
+      if (++position < events.size()) {
+        queue.emplace(events[position]->id_, segment);
+      }
+    }
+  }
+  init_impl(std::move(binlogs), std::move(get_segment), scheduler_id);
   return info;
 }
 
-void ConcurrentBinlog::init_impl(unique_ptr<Binlog> binlog, int32 scheduler_id) {
-  path_ = binlog->get_path().str();
-  last_event_id_ = binlog->peek_next_event_id();
-  binlog_actor_ = create_actor_on_scheduler<detail::BinlogActor>(PSLICE() << "Binlog " << path_, scheduler_id,
-                                                                 std::move(binlog), last_event_id_);
+string ConcurrentBinlog::get_segment_path(Slice path, size_t segment) {
+  if (segment == 0) {
+    return path.str();
+  }
+  return PSTRING() << path << '.' << segment;
+}
+
+Status ConcurrentBinlog::destroy_segmented(Slice path, size_t segment_count) {
+  Status result;
+  for (size_t i = 0; i < segment_count; i++) {
+    auto status = Binlog::destroy(get_segment_path(path, i));
+    if (status.is_error() && result.is_ok()) {
+      result = std::move(status);
+    }
+  }
+  return result;
+}
+
+void ConcurrentBinlog::init_impl(vector<unique_ptr<Binlog>> binlogs, GetSegment get_segment, int32 scheduler_id) {
+  path_ = binlogs[0]->get_path().str();
+  uint64 next_event_id = 0;
+  for (auto &binlog : binlogs) {
+    // event identifiers are shared by all segments to allow erasing events without knowing their segment
+    next_event_id = max(next_event_id, binlog->peek_next_event_id());
+  }
+  last_event_id_ = next_event_id;
+  binlog_actor_ = create_actor_on_scheduler<detail::BinlogActor>(
+      PSLICE() << "Binlog " << path_, scheduler_id, std::move(binlogs), std::move(get_segment), last_event_id_);
 }
 
 void ConcurrentBinlog::close_impl(Promise<> promise) {
@@ -218,6 +397,14 @@ void ConcurrentBinlog::change_key(DbKey db_key, Promise<> promise) {
   send_closure(binlog_actor_, &detail::BinlogActor::change_key, std::move(db_key), std::move(promise));
 }
 
+void ConcurrentBinlog::set_sync_policy(SyncPolicy sync_policy) {
+  send_closure(binlog_actor_, &detail::BinlogActor::set_sync_policy, sync_policy);
+}
+
+void ConcurrentBinlog::get_sync_statistics(Promise<SyncStatistics> promise) {
+  send_closure(binlog_actor_, &detail::BinlogActor::get_sync_statistics, std::move(promise));
+}
+
 uint64 ConcurrentBinlog::erase_batch(vector<uint64> event_ids) {
   auto shift = narrow_cast<int32>(event_ids.size());
   if (shift == 0) {
@@ -30,11 +30,60 @@ class BinlogActor;
 class ConcurrentBinlog final : public BinlogInterface {
  public:
   using Callback = std::function<void(const BinlogEvent &)>;
+
+  // returns index of the segment, in which events of the given type must be stored
+  using GetSegment = std::function<size_t(int32 type)>;
+
+  // defines when the binlog is synced after force_sync or addition of an event with a promise
+  struct SyncPolicy {
+    enum class Type : int32 { Always, Group, Interval };
+    Type type_ = Type::Group;
+    double delay_ = 0.003;
+
+    // the binlog is synced immediately after each request
+    static SyncPolicy always() {
+      return SyncPolicy{Type::Always, 0.0};
+    }
+
+    // the binlog is synced once for all forced requests received within window seconds after the first of them
+    static SyncPolicy group(double window) {
+      return SyncPolicy{Type::Group, window};
+    }
+
+    // the binlog is synced for forced requests at most once in interval seconds
+    static SyncPolicy interval(double interval) {
+      return SyncPolicy{Type::Interval, interval};
+    }
+  };
+
+  struct SyncStatistics {
+    uint64 sync_count = 0;
+    uint64 sync_request_count = 0;
+    uint64 synced_event_count = 0;
+    double passed_time = 0.0;
+  };
   Result<BinlogInfo> init(string path, const Callback &callback, DbKey db_key = DbKey::empty(),
                           DbKey old_db_key = DbKey::empty(), int scheduler_id = -1) TD_WARN_UNUSED_RESULT;
 
+  // events are split between segment_count files, which are reindexed and synced independently
+  // rewrites and deletions are stored in the segment with the original event
+  // events of all segments are loaded before the callback is called for them in the order of their identifiers
+  // this is only scaffolding: no database uses the segmented layout, because there is no type-to-segment mapping
+  // for TdDb and no migration of the existing single-file binlog
+  // a sync makes durable only events of the segments, which have unsynced writes at the moment of the sync,
+  // so after a crash a segment may lose events, which were added before events already durable in other segments;
+  // events depending on each other must be stored in the same segment
+  Result<BinlogInfo> init_segmented(string path, size_t segment_count, GetSegment get_segment,
+                                    const Callback &callback, DbKey db_key = DbKey::empty(),
+                                    DbKey old_db_key = DbKey::empty(), int scheduler_id = -1) TD_WARN_UNUSED_RESULT;
+
+  static string get_segment_path(Slice path, size_t segment);
+
+  static Status destroy_segmented(Slice path, size_t segment_count) TD_WARN_UNUSED_RESULT;
+
   ConcurrentBinlog();
   explicit ConcurrentBinlog(unique_ptr<Binlog> binlog, int scheduler_id = -1);
+  ConcurrentBinlog(vector<unique_ptr<Binlog>> binlogs, GetSegment get_segment, int scheduler_id = -1);
   ConcurrentBinlog(const ConcurrentBinlog &) = delete;
   ConcurrentBinlog &operator=(const ConcurrentBinlog &) = delete;
   ConcurrentBinlog(ConcurrentBinlog &&) = delete;
@@ -45,6 +94,10 @@ class ConcurrentBinlog final : public BinlogInterface {
   void force_flush() final;
   void change_key(DbKey db_key, Promise<> promise) final;
 
+  // TDLib sets the policy from the options "binlog_sync_policy" and "binlog_sync_delay"
+  void set_sync_policy(SyncPolicy sync_policy);
+  void get_sync_statistics(Promise<SyncStatistics> promise);
+
   uint64 next_event_id() final {
     return last_event_id_.fetch_add(1, std::memory_order_relaxed);
   }
@@ -59,7 +112,7 @@ class ConcurrentBinlog final : public BinlogInterface {
   uint64 erase_batch(vector<uint64> event_ids) final;
 
  private:
-  void init_impl(unique_ptr<Binlog> binlog, int scheduler_id);
+  void init_impl(vector<unique_ptr<Binlog>> binlogs, GetSegment get_segment, int scheduler_id);
   void close_impl(Promise<> promise) final;
   void close_and_destroy_impl(Promise<> promise) final;
   void add_raw_event_impl(uint64 event_id, BufferSlice &&raw_event, Promise<> promise, BinlogDebugInfo info) final;
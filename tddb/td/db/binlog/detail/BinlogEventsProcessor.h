@@ -12,6 +12,8 @@
 #include "td/utils/logging.h"
 #include "td/utils/Status.h"
 
+#include <algorithm>
+
 namespace td {
 namespace detail {
 
@@ -33,6 +35,25 @@ class BinlogEventsProcessor {
     }
   }
 
+  // calls callback for events with identifiers from begin_event_id to end_event_id inclusive until it returns false
+  template <class CallbackT>
+  void for_each_in_range(uint64 begin_event_id, uint64 end_event_id, CallbackT &&callback) const {
+    auto it = std::lower_bound(event_ids_.begin(), event_ids_.end(), begin_event_id * 2);
+    for (auto i = static_cast<size_t>(it - event_ids_.begin()); i < event_ids_.size(); i++) {
+      if (event_ids_[i] / 2 > end_event_id) {
+        break;
+      }
+      if ((event_ids_[i] & 1) == 0 && !callback(events_[i])) {
+        break;
+      }
+    }
+  }
+
+  bool has_event(uint64 event_id) const {
+    auto it = std::lower_bound(event_ids_.begin(), event_ids_.end(), event_id * 2);
+    return it != event_ids_.end() && *it == event_id * 2;
+  }
+
   uint64 last_event_id() const {
     return last_event_id_;
   }
@@ -15,11 +15,19 @@ TcpListener::TcpListener(int port, ActorShared<Callback> callback, Slice server_
     : port_(port), callback_(std::move(callback)), server_address_(server_address.str()) {
 }
 
+TcpListener::TcpListener(ServerSocketFd server_fd, ActorShared<Callback> callback)
+    : port_(0), server_fd_(std::move(server_fd)), callback_(std::move(callback)) {
+}
+
 void TcpListener::hangup() {
   stop();
 }
 
 void TcpListener::start_up() {
+  if (!server_fd_.empty()) {
+    Scheduler::subscribe(server_fd_.get_poll_info().extract_pollable_fd(this));
+    return;
+  }
   auto r_socket = ServerSocketFd::open(port_, server_address_);
   if (r_socket.is_error()) {
     LOG(ERROR) << "Can't open server socket: " << r_socket.error();
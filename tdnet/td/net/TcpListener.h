@@ -23,6 +23,7 @@ class TcpListener final : public Actor {
   };
 
   TcpListener(int port, ActorShared<Callback> callback, Slice server_address = Slice("0.0.0.0"));
+  TcpListener(ServerSocketFd server_fd, ActorShared<Callback> callback);
   void hangup() final;
 
  private:
@@ -6,11 +6,22 @@
 //
 #include "td/utils/JsonBuilder.h"
 
+#include "td/utils/bits.h"
 #include "td/utils/misc.h"
 #include "td/utils/ScopeGuard.h"
 #include "td/utils/SliceBuilder.h"
 #include "td/utils/utf8.h"
 
+#include <cstring>
+
+#if defined(__SSE2__) || (TD_MSVC && (defined(_M_X64) || (defined(_M_IX86) && _M_IX86_FP >= 2)))
+#define TD_SSE2 1
+#endif
+
+#if TD_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace td {
 
 StringBuilder &operator<<(StringBuilder &sb, const JsonRawString &val) {
@@ -135,6 +146,63 @@ StringBuilder &operator<<(StringBuilder &sb, const JsonString &val) {
   return sb;
 }
 
+// returns pointer to the first '"' or '\\' in [ptr, end) or end, if there are no such characters
+static unsigned char *find_json_string_special_char(unsigned char *ptr, unsigned char *end) {
+#if TD_SSE2
+  const auto quote = _mm_set1_epi8('"');
+  const auto backslash = _mm_set1_epi8('\\');
+  while (end - ptr >= 16) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+    auto mask = static_cast<uint32>(
+        _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash))));
+    if (mask != 0) {
+      return ptr + count_trailing_zeroes32(mask);
+    }
+    ptr += 16;
+  }
+#endif
+  while (ptr != end && *ptr != '"' && *ptr != '\\') {
+    ptr++;
+  }
+  return ptr;
+}
+
+static bool is_json_whitespace(unsigned char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// the same as parser.skip_whitespaces(), but optimized for long indentations in pretty-printed JSON
+static void skip_json_whitespaces(Parser &parser) {
+  auto data = parser.data();
+  auto *begin = data.ubegin();
+  auto *ptr = begin;
+  auto *end = data.uend();
+  if (ptr == end || !is_json_whitespace(*ptr)) {
+    return;
+  }
+#if TD_SSE2
+  const auto space = _mm_set1_epi8(' ');
+  const auto tab = _mm_set1_epi8('\t');
+  const auto cr = _mm_set1_epi8('\r');
+  const auto lf = _mm_set1_epi8('\n');
+  while (end - ptr >= 16) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+    auto is_whitespace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, lf)));
+    auto mask = static_cast<uint32>(_mm_movemask_epi8(is_whitespace)) ^ 0xFFFF;
+    if (mask != 0) {
+      parser.advance(ptr + count_trailing_zeroes32(mask) - begin);
+      return;
+    }
+    ptr += 16;
+  }
+#endif
+  while (ptr != end && is_json_whitespace(*ptr)) {
+    ptr++;
+  }
+  parser.advance(ptr - begin);
+}
+
 Result<MutableSlice> json_string_decode(Parser &parser) {
   if (!parser.try_skip('"')) {
     return Status::Error("Opening '\"' expected");
@@ -146,6 +214,15 @@ Result<MutableSlice> json_string_decode(Parser &parser) {
   auto *end = data.uend();
 
   while (true) {
+    auto *special = find_json_string_special_char(cur_src, end);
+    if (special != cur_src) {
+      auto length = static_cast<size_t>(special - cur_src);
+      if (cur_dest != cur_src) {
+        std::memmove(cur_dest, cur_src, length);
+      }
+      cur_dest += length;
+      cur_src = special;
+    }
     if (cur_src == end) {
       return Status::Error("Closing '\"' not found");
     }
@@ -235,6 +312,7 @@ Status json_string_skip(Parser &parser) {
   auto *end = data.uend();
 
   while (true) {
+    cur_src = find_json_string_special_char(cur_src, end);
     if (cur_src == end) {
       return Status::Error("Closing '\"' not found");
     }
@@ -298,7 +376,7 @@ Result<JsonValue> do_json_decode(Parser &parser, int32 max_depth) {
     return Status::Error("Too big object depth");
   }
 
-  parser.skip_whitespaces();
+  skip_json_whitespaces(parser);
   switch (parser.peek_char()) {
     case 'f':
       if (parser.try_skip("false")) {
@@ -321,7 +399,7 @@ Result<JsonValue> do_json_decode(Parser &parser, int32 max_depth) {
     }
     case '[': {
       parser.skip('[');
-      parser.skip_whitespaces();
+      skip_json_whitespaces(parser);
       vector<JsonValue> res;
       if (parser.try_skip(']')) {
         return JsonValue::create_array(std::move(res));
@@ -333,12 +411,12 @@ Result<JsonValue> do_json_decode(Parser &parser, int32 max_depth) {
         TRY_RESULT(value, do_json_decode(parser, max_depth - 1));
         res.emplace_back(std::move(value));
 
-        parser.skip_whitespaces();
+        skip_json_whitespaces(parser);
         if (parser.try_skip(']')) {
           break;
         }
         if (parser.try_skip(',')) {
-          parser.skip_whitespaces();
+          skip_json_whitespaces(parser);
           continue;
         }
         if (parser.empty()) {
@@ -350,7 +428,7 @@ Result<JsonValue> do_json_decode(Parser &parser, int32 max_depth) {
     }
     case '{': {
       parser.skip('{');
-      parser.skip_whitespaces();
+      skip_json_whitespaces(parser);
       if (parser.try_skip('}')) {
         return JsonValue::make_object(JsonObject());
       }
@@ -360,19 +438,19 @@ Result<JsonValue> do_json_decode(Parser &parser, int32 max_depth) {
           return Status::Error("Unexpected string end");
         }
         TRY_RESULT(field, json_string_decode(parser));
-        parser.skip_whitespaces();
+        skip_json_whitespaces(parser);
         if (!parser.try_skip(':')) {
           return Status::Error("':' expected");
         }
         TRY_RESULT(value, do_json_decode(parser, max_depth - 1));
         field_values.emplace_back(field, std::move(value));
 
-        parser.skip_whitespaces();
+        skip_json_whitespaces(parser);
         if (parser.try_skip('}')) {
           break;
         }
         if (parser.try_skip(',')) {
-          parser.skip_whitespaces();
+          skip_json_whitespaces(parser);
           continue;
         }
         if (parser.empty()) {
@@ -418,7 +496,7 @@ Status do_json_skip(Parser &parser, int32 max_depth) {
     return Status::Error("Too big object depth");
   }
 
-  parser.skip_whitespaces();
+  skip_json_whitespaces(parser);
   switch (parser.peek_char()) {
     case 'f':
       if (parser.try_skip("false")) {
@@ -440,7 +518,7 @@ Status do_json_skip(Parser &parser, int32 max_depth) {
     }
     case '[': {
       parser.skip('[');
-      parser.skip_whitespaces();
+      skip_json_whitespaces(parser);
       if (parser.try_skip(']')) {
         return Status::OK();
       }
@@ -450,12 +528,12 @@ Status do_json_skip(Parser &parser, int32 max_depth) {
         }
         TRY_STATUS(do_json_skip(parser, max_depth - 1));
 
-        parser.skip_whitespaces();
+        skip_json_whitespaces(parser);
         if (parser.try_skip(']')) {
           break;
         }
         if (parser.try_skip(',')) {
-          parser.skip_whitespaces();
+          skip_json_whitespaces(parser);
           continue;
         }
         return Status::Error("Unexpected symbol");
@@ -464,7 +542,7 @@ Status do_json_skip(Parser &parser, int32 max_depth) {
     }
     case '{': {
       parser.skip('{');
-      parser.skip_whitespaces();
+      skip_json_whitespaces(parser);
       if (parser.try_skip('}')) {
         return Status::OK();
       }
@@ -473,18 +551,18 @@ Status do_json_skip(Parser &parser, int32 max_depth) {
           return Status::Error("Unexpected end");
         }
         TRY_STATUS(json_string_skip(parser));
-        parser.skip_whitespaces();
+        skip_json_whitespaces(parser);
         if (!parser.try_skip(':')) {
           return Status::Error("':' expected");
         }
         TRY_STATUS(do_json_skip(parser, max_depth - 1));
 
-        parser.skip_whitespaces();
+        skip_json_whitespaces(parser);
         if (parser.try_skip('}')) {
           break;
         }
         if (parser.try_skip(',')) {
-          parser.skip_whitespaces();
+          skip_json_whitespaces(parser);
           continue;
         }
         return Status::Error("Unexpected symbol");
@@ -403,19 +403,18 @@ class JsonObjectScope final : public JsonScope {
   }
   template <class T>
   JsonObjectScope &operator()(Slice field, T &&value) {
-    CHECK(is_active());
-    if (is_first_) {
-      *sb_ << ",";
-    } else {
-      is_first_ = true;
-    }
-    jb_->print_offset();
+    begin_field();
     jb_->enter_value() << field;
-    if (jb_->is_pretty()) {
-      *sb_ << " : ";
-    } else {
-      *sb_ << ":";
-    }
+    end_field_name();
+    jb_->enter_value() << value;
+    return *this;
+  }
+  // the field name must be already quoted and must not need escaping
+  template <class T>
+  JsonObjectScope &operator()(const JsonRaw &field, T &&value) {
+    begin_field();
+    *sb_ << field;
+    end_field_name();
     jb_->enter_value() << value;
     return *this;
   }
@@ -428,6 +427,24 @@ class JsonObjectScope final : public JsonScope {
 
  private:
   bool is_first_ = false;
+
+  void begin_field() {
+    CHECK(is_active());
+    if (is_first_) {
+      *sb_ << ",";
+    } else {
+      is_first_ = true;
+    }
+    jb_->print_offset();
+  }
+
+  void end_field_name() {
+    if (jb_->is_pretty()) {
+      *sb_ << " : ";
+    } else {
+      *sb_ << ":";
+    }
+  }
 };
 
 inline JsonArrayScope JsonValueScope::enter_array() {
@@ -14,6 +14,7 @@
 
 #include "td/utils/port/Mutex.h"
 
+#include <iterator>
 #include <utility>
 
 namespace td {
@@ -63,6 +64,27 @@ class MpscPollableQueue {
       event_fd_.release();
     }
   }
+  // moves all values to the queue at once; returns whether the reader was woken up
+  bool writer_put_batch(std::vector<ValueType> &values) {
+    if (values.empty()) {
+      return false;
+    }
+    auto guard = lock_.lock();
+    if (writer_vector_.empty()) {
+      std::swap(writer_vector_, values);
+    } else {
+      writer_vector_.insert(writer_vector_.end(), std::make_move_iterator(values.begin()),
+                            std::make_move_iterator(values.end()));
+    }
+    values.clear();
+    if (wait_event_fd_) {
+      wait_event_fd_ = false;
+      guard.reset();
+      event_fd_.release();
+      return true;
+    }
+    return false;
+  }
   EventFd &reader_get_event_fd() {
     return event_fd_;
   }
@@ -128,6 +150,12 @@ class MpscPollableQueue {
     UNREACHABLE();
   }
 
+  template <class PutValueType>
+  bool writer_put_batch(PutValueType &values) {
+    UNREACHABLE();
+    return false;
+  }
+
   void writer_flush() {
     UNREACHABLE();
   }
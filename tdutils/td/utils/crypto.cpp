@@ -48,6 +48,15 @@
 #include "crc32c/crc32c.h"
 #endif
 
+#if (TD_GCC || TD_CLANG) && (defined(__x86_64__) || defined(__i386__)) && !TD_EMSCRIPTEN
+#define TD_HAVE_AES_NI 1
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#else
+#define TD_HAVE_AES_NI 0
+#endif
+
 #include <algorithm>
 #include <cerrno>
 #include <cstring>
@@ -462,15 +471,174 @@ void AesState::decrypt(const uint8 *src, uint8 *dst, int size) {
   impl_->evp.decrypt(src, dst, size);
 }
 
+#if TD_HAVE_AES_NI
+// AES-256 with AES-NI instructions; IGE chaining makes every block depend on the previous one,
+// so the gain comes from keeping the round keys in registers and avoiding EVP calls per block
+class AesNi {
+ public:
+  static bool is_supported() {
+    static const bool is_supported = [] {
+      unsigned int eax = 0;
+      unsigned int ebx = 0;
+      unsigned int ecx = 0;
+      unsigned int edx = 0;
+      if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+        return false;
+      }
+      return (ecx & bit_AES) != 0 && (edx & bit_SSE2) != 0;
+    }();
+    return is_supported;
+  }
+
+  __attribute__((target("aes,sse2"))) void init_encrypt(Slice key) {
+    expand_key(key);
+  }
+
+  __attribute__((target("aes,sse2"))) void init_decrypt(Slice key) {
+    expand_key(key);
+    __m128i round_keys[ROUND_KEY_COUNT];
+    for (size_t i = 0; i < ROUND_KEY_COUNT; i++) {
+      round_keys[i] = load_round_key(i);
+    }
+    store_round_key(0, round_keys[ROUND_KEY_COUNT - 1]);
+    for (size_t i = 1; i + 1 < ROUND_KEY_COUNT; i++) {
+      store_round_key(i, _mm_aesimc_si128(round_keys[ROUND_KEY_COUNT - 1 - i]));
+    }
+    store_round_key(ROUND_KEY_COUNT - 1, round_keys[0]);
+  }
+
+  __attribute__((target("aes,sse2"))) void ige_encrypt(const uint8 *in, uint8 *out, size_t block_count,
+                                                        AesBlock &encrypted_iv, AesBlock &plaintext_iv) const {
+    __m128i k[ROUND_KEY_COUNT];
+    for (size_t i = 0; i < ROUND_KEY_COUNT; i++) {
+      k[i] = load_round_key(i);
+    }
+    auto prev_encrypted = load_block(encrypted_iv.raw());
+    auto prev_plaintext = load_block(plaintext_iv.raw());
+    for (size_t i = 0; i < block_count; i++) {
+      auto plaintext = load_block(in);
+      auto x = _mm_xor_si128(_mm_xor_si128(plaintext, prev_encrypted), k[0]);
+      for (size_t j = 1; j + 1 < ROUND_KEY_COUNT; j++) {
+        x = _mm_aesenc_si128(x, k[j]);
+      }
+      x = _mm_xor_si128(_mm_aesenclast_si128(x, k[ROUND_KEY_COUNT - 1]), prev_plaintext);
+      store_block(out, x);
+
+      prev_encrypted = x;
+      prev_plaintext = plaintext;
+      in += AES_BLOCK_SIZE;
+      out += AES_BLOCK_SIZE;
+    }
+    store_block(encrypted_iv.raw(), prev_encrypted);
+    store_block(plaintext_iv.raw(), prev_plaintext);
+  }
+
+  __attribute__((target("aes,sse2"))) void ige_decrypt(const uint8 *in, uint8 *out, size_t block_count,
+                                                        AesBlock &encrypted_iv, AesBlock &plaintext_iv) const {
+    __m128i k[ROUND_KEY_COUNT];
+    for (size_t i = 0; i < ROUND_KEY_COUNT; i++) {
+      k[i] = load_round_key(i);
+    }
+    auto prev_encrypted = load_block(encrypted_iv.raw());
+    auto prev_plaintext = load_block(plaintext_iv.raw());
+    for (size_t i = 0; i < block_count; i++) {
+      auto encrypted = load_block(in);
+      auto x = _mm_xor_si128(_mm_xor_si128(encrypted, prev_plaintext), k[0]);
+      for (size_t j = 1; j + 1 < ROUND_KEY_COUNT; j++) {
+        x = _mm_aesdec_si128(x, k[j]);
+      }
+      x = _mm_xor_si128(_mm_aesdeclast_si128(x, k[ROUND_KEY_COUNT - 1]), prev_encrypted);
+      store_block(out, x);
+
+      prev_encrypted = encrypted;
+      prev_plaintext = x;
+      in += AES_BLOCK_SIZE;
+      out += AES_BLOCK_SIZE;
+    }
+    store_block(encrypted_iv.raw(), prev_encrypted);
+    store_block(plaintext_iv.raw(), prev_plaintext);
+  }
+
+ private:
+  static constexpr size_t ROUND_KEY_COUNT = 15;
+  AesBlock round_keys_[ROUND_KEY_COUNT];
+
+  __attribute__((target("aes,sse2"))) static __m128i load_block(const uint8 *from) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(from));
+  }
+
+  __attribute__((target("aes,sse2"))) static void store_block(uint8 *to, __m128i block) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(to), block);
+  }
+
+  __attribute__((target("aes,sse2"))) __m128i load_round_key(size_t i) const {
+    return load_block(round_keys_[i].raw());
+  }
+
+  __attribute__((target("aes,sse2"))) void store_round_key(size_t i, __m128i round_key) {
+    store_block(round_keys_[i].raw(), round_key);
+  }
+
+  __attribute__((target("aes,sse2"))) static __m128i expand_key_even(__m128i key, __m128i assist) {
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 8));
+    return _mm_xor_si128(key, assist);
+  }
+
+  __attribute__((target("aes,sse2"))) static __m128i expand_key_odd(__m128i key, __m128i prev_key) {
+    auto assist = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(prev_key, 0x00), 0xaa);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 8));
+    return _mm_xor_si128(key, assist);
+  }
+
+  __attribute__((target("aes,sse2"))) void expand_key(Slice key) {
+    CHECK(key.size() == 32);
+    auto a = load_block(key.ubegin());
+    auto b = load_block(key.ubegin() + AES_BLOCK_SIZE);
+    store_round_key(0, a);
+    store_round_key(1, b);
+#define TD_AES_NI_EXPAND_KEY(i, rcon)                              \
+  a = expand_key_even(a, _mm_aeskeygenassist_si128(b, rcon));     \
+  store_round_key(i, a);                                          \
+  if (i + 1 < ROUND_KEY_COUNT) {                                  \
+    b = expand_key_odd(b, a);                                     \
+    store_round_key(i + 1, b);                                    \
+  }
+    TD_AES_NI_EXPAND_KEY(2, 0x01)
+    TD_AES_NI_EXPAND_KEY(4, 0x02)
+    TD_AES_NI_EXPAND_KEY(6, 0x04)
+    TD_AES_NI_EXPAND_KEY(8, 0x08)
+    TD_AES_NI_EXPAND_KEY(10, 0x10)
+    TD_AES_NI_EXPAND_KEY(12, 0x20)
+    TD_AES_NI_EXPAND_KEY(14, 0x40)
+#undef TD_AES_NI_EXPAND_KEY
+  }
+};
+#endif
+
 class AesIgeStateImpl {
  public:
   void init(Slice key, Slice iv, bool encrypt) {
     CHECK(key.size() == 32);
     CHECK(iv.size() == 32);
-    if (encrypt) {
-      evp_.init_encrypt_cbc(key);
-    } else {
-      evp_.init_decrypt_ecb(key);
+#if TD_HAVE_AES_NI
+    use_aes_ni_ = AesNi::is_supported();
+    if (use_aes_ni_) {
+      if (encrypt) {
+        aes_ni_.init_encrypt(key);
+      } else {
+        aes_ni_.init_decrypt(key);
+      }
+    }
+#endif
+    if (!use_aes_ni_) {
+      if (encrypt) {
+        evp_.init_encrypt_cbc(key);
+      } else {
+        evp_.init_decrypt_ecb(key);
+      }
     }
 
     encrypted_iv_.load(iv.ubegin());
@@ -489,6 +657,12 @@ class AesIgeStateImpl {
     auto len = to.size() / AES_BLOCK_SIZE;
     auto in = from.ubegin();
     auto out = to.ubegin();
+#if TD_HAVE_AES_NI
+    if (use_aes_ni_) {
+      aes_ni_.ige_encrypt(in, out, len, encrypted_iv_, plaintext_iv_);
+      return;
+    }
+#endif
 
     static constexpr size_t BLOCK_COUNT = 31;
     while (len != 0) {
@@ -529,6 +703,12 @@ class AesIgeStateImpl {
     auto len = to.size() / AES_BLOCK_SIZE;
     auto in = from.ubegin();
     auto out = to.ubegin();
+#if TD_HAVE_AES_NI
+    if (use_aes_ni_) {
+      aes_ni_.ige_decrypt(in, out, len, encrypted_iv_, plaintext_iv_);
+      return;
+    }
+#endif
 
     AesBlock encrypted;
 
@@ -550,6 +730,10 @@ class AesIgeStateImpl {
 
  private:
   Evp evp_;
+#if TD_HAVE_AES_NI
+  AesNi aes_ni_;
+#endif
+  bool use_aes_ni_ = false;
   AesBlock encrypted_iv_;
   AesBlock plaintext_iv_;
 };
@@ -575,15 +759,22 @@ void AesIgeState::decrypt(Slice from, MutableSlice to) {
   impl_->decrypt(from, to);
 }
 
+static AesIgeStateImpl &get_thread_local_aes_ige_state() {
+  // the state is reused to avoid cipher context creation for every packet
+  static TD_THREAD_LOCAL AesIgeStateImpl *state;
+  init_thread_local<AesIgeStateImpl>(state);
+  return *state;
+}
+
 void aes_ige_encrypt(Slice aes_key, MutableSlice aes_iv, Slice from, MutableSlice to) {
-  AesIgeStateImpl state;
+  auto &state = get_thread_local_aes_ige_state();
   state.init(aes_key, aes_iv, true);
   state.encrypt(from, to);
   state.get_iv(aes_iv);
 }
 
 void aes_ige_decrypt(Slice aes_key, MutableSlice aes_iv, Slice from, MutableSlice to) {
-  AesIgeStateImpl state;
+  auto &state = get_thread_local_aes_ige_state();
   state.init(aes_key, aes_iv, false);
   state.decrypt(from, to);
   state.get_iv(aes_iv);
@@ -876,6 +1067,22 @@ void Sha256State::init() {
   is_inited_ = true;
 }
 
+void Sha256State::init_from(const Sha256State &other) {
+  CHECK(other.impl_);
+  CHECK(other.is_inited_);
+  if (!impl_) {
+    impl_ = make_unique<Sha256State::Impl>();
+  }
+  CHECK(!is_inited_);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+  int err = EVP_MD_CTX_copy_ex(impl_->ctx_, other.impl_->ctx_);
+  LOG_IF(FATAL, err != 1);
+#else
+  impl_->ctx_ = other.impl_->ctx_;
+#endif
+  is_inited_ = true;
+}
+
 void Sha256State::feed(Slice data) {
   CHECK(impl_);
   CHECK(is_inited_);
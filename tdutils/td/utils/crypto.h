@@ -139,6 +139,9 @@ class Sha256State {
 
   void init();
 
+  // initializes the state as a copy of another inited state, for example with an already fed constant prefix
+  void init_from(const Sha256State &other);
+
   void feed(Slice data);
 
   void extract(MutableSlice output, bool destroy = false);
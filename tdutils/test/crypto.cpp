@@ -234,6 +234,16 @@ TEST(Crypto, Sha256State) {
     td::UInt256 result;
     state.extract(as_mutable_slice(result));
     ASSERT_TRUE(baseline == result);
+
+    td::Sha256State prefix_state;
+    prefix_state.init();
+    prefix_state.feed(td::Slice(s).substr(0, length / 2));
+    for (int i = 0; i < 2; i++) {
+      state.init_from(prefix_state);
+      state.feed(td::Slice(s).substr(length / 2));
+      state.extract(as_mutable_slice(result));
+      ASSERT_TRUE(baseline == result);
+    }
   }
 }
 
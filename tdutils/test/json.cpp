@@ -55,6 +55,21 @@ TEST(JSON, object) {
   decode_encode(encoded);
 }
 
+TEST(JSON, object_raw_field) {
+  char tmp[1000];
+  td::StringBuilder sb(td::MutableSlice{tmp, sizeof(tmp)});
+  td::JsonBuilder jb(std::move(sb));
+  auto c = jb.enter_object();
+  c(td::JsonRaw("\"@type\""), td::JsonRaw("\"test\""));
+  c("key", "value");
+  c(td::JsonRaw("\"1\""), 2);
+  c.leave();
+  ASSERT_EQ(jb.string_builder().is_error(), false);
+  auto encoded = jb.string_builder().as_cslice().str();
+  ASSERT_EQ("{\"@type\":\"test\",\"key\":\"value\",\"1\":2}", encoded);
+  decode_encode(encoded);
+}
+
 TEST(JSON, nested) {
   char tmp[1000];
   td::StringBuilder sb(td::MutableSlice{tmp, sizeof(tmp)});
@@ -90,6 +105,9 @@ TEST(JSON, kphp) {
       "qrstuvwxyz\"]], \n  \"one_time_keyboard\"\n:\ntrue\n}\n   \n",
       "{\"keyboard\":[[\"\\u2022 abcdefg\"],[\"\\u2022 hijklmnop\"],[\"\\u2022 "
       "qrstuvwxyz\"]],\"one_time_keyboard\":true}");
+  decode_encode("{\n" + td::string(40, ' ') + "\"key\"\t\r\n" + td::string(17, ' ') + ":" + td::string(16, '\n') +
+                    "[1,\n" + td::string(100, '\t') + "2]}",
+                "{\"key\":[1,2]}");
 }
 
 TEST(JSON, json_object_get_field) {
@@ -282,6 +300,12 @@ TEST(JSON, string_decode) {
       "1a\bcde\fghijklm\nopq\rs\t 1vwxyzU\"\\/+-");
   test_string_decode("\"\\u0373\\ud7FB\\uD840\\uDC04\\uD840a\\uD840\\u0373\"",
                      "\xCD\xB3\xED\x9F\xBB\xF0\xA0\x80\x84\xed\xa1\x80\x61\xed\xa1\x80\xCD\xB3");
+  for (size_t prefix_length = 0; prefix_length < 40; prefix_length++) {
+    td::string prefix(prefix_length, 'a');
+    td::string suffix(40 - prefix_length, 'b');
+    test_string_decode("\"" + prefix + "\\n" + suffix + "\\\"" + prefix + "\"", prefix + "\n" + suffix + "\"" + prefix);
+    test_string_decode_error("\"" + prefix + suffix);
+  }
 
   test_string_decode_error(" \"\"");
   test_string_decode_error("\"");
@@ -0,0 +1,207 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/net/AdaptiveSessionCount.h"
+
+#include "td/utils/common.h"
+#include "td/utils/tests.h"
+
+#include <utility>
+
+static td::AdaptiveSessionCount::PeriodStatistics get_statistics(double throughput, double rtt, double busy_ratio) {
+  td::AdaptiveSessionCount::PeriodStatistics statistics;
+  statistics.throughput = throughput;
+  statistics.rtt = rtt;
+  statistics.busy_ratio = busy_ratio;
+  return statistics;
+}
+
+TEST(AdaptiveSessionCount, limits) {
+  td::AdaptiveSessionCount adaptive_session_count;
+  adaptive_session_count.set_limits(0, 1000);
+  ASSERT_EQ(1, adaptive_session_count.get_min_session_count());
+  ASSERT_EQ(100, adaptive_session_count.get_max_session_count());
+
+  adaptive_session_count.set_limits(5, 3);
+  ASSERT_EQ(5, adaptive_session_count.get_min_session_count());
+  ASSERT_EQ(5, adaptive_session_count.get_max_session_count());
+  ASSERT_EQ(5, adaptive_session_count.on_period_finished(5, get_statistics(1000.0, 0.1, 1.0)));
+  ASSERT_EQ(5, adaptive_session_count.on_period_finished(5, get_statistics(1000.0, 0.1, 0.0)));
+}
+
+TEST(AdaptiveSessionCount, grow_while_throughput_increases) {
+  td::AdaptiveSessionCount adaptive_session_count;
+  adaptive_session_count.set_limits(1, 3);
+
+  ASSERT_EQ(2, adaptive_session_count.on_period_finished(1, get_statistics(100.0, 0.1, 0.8)));
+  ASSERT_EQ(3, adaptive_session_count.on_period_finished(2, get_statistics(150.0, 0.1, 0.8)));
+  // the maximum is reached
+  ASSERT_EQ(3, adaptive_session_count.on_period_finished(3, get_statistics(200.0, 0.1, 0.8)));
+  ASSERT_EQ(3, adaptive_session_count.on_period_finished(3, get_statistics(200.0, 0.1, 0.8)));
+  // the load is moderate
+  ASSERT_EQ(3, adaptive_session_count.on_period_finished(3, get_statistics(200.0, 0.1, 0.3)));
+  // there is almost no load
+  ASSERT_EQ(2, adaptive_session_count.on_period_finished(3, get_statistics(200.0, 0.1, 0.05)));
+  ASSERT_EQ(1, adaptive_session_count.on_period_finished(2, get_statistics(200.0, 0.1, 0.05)));
+  ASSERT_EQ(1, adaptive_session_count.on_period_finished(1, get_statistics(200.0, 0.1, 0.05)));
+}
+
+TEST(AdaptiveSessionCount, useless_session_is_removed) {
+  td::AdaptiveSessionCount adaptive_session_count;
+  adaptive_session_count.set_limits(1, 10);
+
+  ASSERT_EQ(2, adaptive_session_count.on_period_finished(1, get_statistics(100.0, 0.1, 0.8)));
+  // throughput has increased by less than 10%
+  ASSERT_EQ(1, adaptive_session_count.on_period_finished(2, get_statistics(105.0, 0.1, 0.8)));
+  // the session isn't added again for 6 periods even if all sessions are busy
+  for (int i = 0; i < 5; i++) {
+    ASSERT_EQ(1, adaptive_session_count.on_period_finished(1, get_statistics(105.0, 0.1, 1.0)));
+  }
+  ASSERT_EQ(2, adaptive_session_count.on_period_finished(1, get_statistics(105.0, 0.1, 1.0)));
+  ASSERT_EQ(3, adaptive_session_count.on_period_finished(2, get_statistics(200.0, 0.1, 1.0)));
+}
+
+TEST(AdaptiveSessionCount, high_rtt) {
+  td::AdaptiveSessionCount adaptive_session_count;
+  adaptive_session_count.set_limits(1, 10);
+
+  ASSERT_EQ(5, adaptive_session_count.on_period_finished(5, get_statistics(100.0, 0.1, 0.3)));
+  ASSERT_EQ(0.1, adaptive_session_count.get_min_rtt());
+  // queries wait in queues, so the session count is decreased even if all sessions are busy
+  ASSERT_EQ(4, adaptive_session_count.on_period_finished(5, get_statistics(100.0, 0.35, 1.0)));
+  ASSERT_EQ(3, adaptive_session_count.on_period_finished(4, get_statistics(100.0, 0.35, 1.0)));
+
+  // the minimum RTT follows the new network conditions, so the session count stops to decrease
+  td::int32 session_count = 3;
+  for (int i = 0; i < 20; i++) {
+    auto min_rtt = adaptive_session_count.get_min_rtt();
+    session_count = adaptive_session_count.on_period_finished(session_count, get_statistics(100.0, 0.35, 0.3));
+    ASSERT_TRUE(adaptive_session_count.get_min_rtt() > min_rtt);
+    ASSERT_TRUE(adaptive_session_count.get_min_rtt() <= 0.35);
+  }
+  ASSERT_TRUE(session_count >= 1);
+  ASSERT_EQ(session_count, adaptive_session_count.on_period_finished(session_count, get_statistics(100.0, 0.35, 0.3)));
+  ASSERT_EQ(session_count + 1,
+            adaptive_session_count.on_period_finished(session_count, get_statistics(100.0, 0.35, 1.0)));
+
+  // a lower RTT immediately becomes the new minimum
+  adaptive_session_count.on_period_finished(session_count + 1, get_statistics(200.0, 0.05, 0.3));
+  ASSERT_EQ(0.05, adaptive_session_count.get_min_rtt());
+}
+
+namespace {
+// emulates the sessions of SessionMultiProxy; only the first active sessions receive new queries
+class TestSessions {
+ public:
+  explicit TestSessions(td::vector<int> query_counts) : query_counts_(std::move(query_counts)) {
+  }
+
+  void set_active_session_count(size_t active_session_count) {
+    active_session_count_ = active_session_count;
+    update();
+  }
+
+  void finish_queries(size_t session_id) {
+    ASSERT_TRUE(session_id < query_counts_.size());
+    query_counts_[session_id] = 0;
+    update();
+  }
+
+  const td::vector<int> &get_query_counts() const {
+    return query_counts_;
+  }
+
+  size_t get_created_session_count() const {
+    return created_session_count_;
+  }
+
+ private:
+  td::vector<int> query_counts_;
+  size_t active_session_count_ = 0;
+  size_t created_session_count_ = 0;
+
+  void update() {
+    auto kept_session_count = td::AdaptiveSessionCount::get_kept_session_count(
+        query_counts_.size(), active_session_count_, [&](size_t i) { return query_counts_[i]; });
+    while (query_counts_.size() < kept_session_count) {
+      query_counts_.push_back(0);
+      created_session_count_++;
+    }
+    query_counts_.resize(kept_session_count);
+  }
+};
+}  // namespace
+
+TEST(AdaptiveSessionCount, draining_sessions) {
+  TestSessions sessions({3, 1, 2, 5});
+  sessions.set_active_session_count(4);
+  ASSERT_EQ(4u, sessions.get_query_counts().size());
+
+  // the removed sessions are kept until they finish their queries
+  sessions.set_active_session_count(2);
+  ASSERT_EQ(4u, sessions.get_query_counts().size());
+  // sessions are closed only from the end
+  sessions.finish_queries(2);
+  ASSERT_EQ(4u, sessions.get_query_counts().size());
+
+  // the draining sessions are reused, if the count goes back up
+  sessions.set_active_session_count(3);
+  ASSERT_EQ(4u, sessions.get_query_counts().size());
+  ASSERT_EQ(0u, sessions.get_created_session_count());
+  ASSERT_EQ(5, sessions.get_query_counts()[3]);
+
+  sessions.finish_queries(3);
+  ASSERT_EQ(3u, sessions.get_query_counts().size());
+
+  sessions.set_active_session_count(1);
+  ASSERT_EQ(2u, sessions.get_query_counts().size());
+  ASSERT_EQ(1, sessions.get_query_counts()[1]);
+
+  // the draining session is reused and missing sessions are created
+  sessions.set_active_session_count(4);
+  ASSERT_EQ(4u, sessions.get_query_counts().size());
+  ASSERT_EQ(2u, sessions.get_created_session_count());
+  ASSERT_EQ(1, sessions.get_query_counts()[1]);
+
+  // idle sessions are closed immediately
+  sessions.set_active_session_count(2);
+  ASSERT_EQ(2u, sessions.get_query_counts().size());
+  sessions.finish_queries(1);
+  sessions.set_active_session_count(1);
+  ASSERT_EQ(1u, sessions.get_query_counts().size());
+  ASSERT_EQ(2u, sessions.get_created_session_count());
+}
+
+TEST(AdaptiveSessionCount, draining_sessions_with_adaptation) {
+  td::AdaptiveSessionCount adaptive_session_count;
+  adaptive_session_count.set_limits(1, 4);
+  TestSessions sessions({2, 2, 2, 2});
+  td::int32 session_count = 4;
+  sessions.set_active_session_count(session_count);
+
+  // there is almost no load, but all removed sessions still have queries
+  for (int i = 0; i < 3; i++) {
+    session_count = adaptive_session_count.on_period_finished(session_count, get_statistics(100.0, 0.1, 0.0));
+    sessions.set_active_session_count(session_count);
+  }
+  ASSERT_EQ(1, session_count);
+  ASSERT_EQ(4u, sessions.get_query_counts().size());
+
+  sessions.finish_queries(3);
+  ASSERT_EQ(3u, sessions.get_query_counts().size());
+
+  // the load grows back before the other removed sessions have finished their queries
+  session_count = adaptive_session_count.on_period_finished(session_count, get_statistics(100.0, 0.1, 1.0));
+  sessions.set_active_session_count(session_count);
+  session_count = adaptive_session_count.on_period_finished(session_count, get_statistics(200.0, 0.1, 1.0));
+  sessions.set_active_session_count(session_count);
+  session_count = adaptive_session_count.on_period_finished(session_count, get_statistics(300.0, 0.1, 1.0));
+  sessions.set_active_session_count(session_count);
+  ASSERT_EQ(4, session_count);
+  ASSERT_EQ(4u, sessions.get_query_counts().size());
+  // only the closed session was recreated
+  ASSERT_EQ(1u, sessions.get_created_session_count());
+}
@@ -6,6 +6,16 @@
 //
 #include "data.h"
 
+#include "td/telegram/DialogDb.h"
+#include "td/telegram/DialogId.h"
+#include "td/telegram/FolderId.h"
+#include "td/telegram/MessageDb.h"
+#include "td/telegram/MessageFullId.h"
+#include "td/telegram/MessageId.h"
+#include "td/telegram/NotificationId.h"
+#include "td/telegram/ServerMessageId.h"
+#include "td/telegram/UserId.h"
+
 #include "td/db/binlog/BinlogHelper.h"
 #include "td/db/binlog/ConcurrentBinlog.h"
 #include "td/db/BinlogKeyValue.h"
@@ -21,21 +31,30 @@
 #include "td/actor/ConcurrentScheduler.h"
 
 #include "td/utils/base64.h"
+#include "td/utils/buffer.h"
 #include "td/utils/common.h"
 #include "td/utils/filesystem.h"
 #include "td/utils/FlatHashMap.h"
 #include "td/utils/logging.h"
+#include "td/utils/misc.h"
 #include "td/utils/port/FileFd.h"
+#include "td/utils/port/Stat.h"
 #include "td/utils/port/thread.h"
+#include "td/utils/Promise.h"
 #include "td/utils/Random.h"
 #include "td/utils/Slice.h"
+#include "td/utils/SliceBuilder.h"
 #include "td/utils/Status.h"
 #include "td/utils/StringBuilder.h"
 #include "td/utils/tests.h"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <limits>
 #include <map>
 #include <memory>
+#include <utility>
 
 template <class ContainerT>
 static typename ContainerT::value_type &rand_elem(ContainerT &cont) {
@@ -138,6 +157,151 @@ TEST(DB, binlog_encryption) {
   td::Binlog::destroy(binlog_name).ignore();
 }
 
+TEST(DB, binlog_replay) {
+  td::CSlice binlog_name = "test_binlog";
+  for (auto &db_key : {td::DbKey::empty(), td::DbKey::raw_key(td::string(32, 'A'))}) {
+    td::Binlog::destroy(binlog_name).ignore();
+
+    td::vector<td::string> expected_data;
+    for (int restart = 0; restart < 4; restart++) {
+      td::vector<td::string> data;
+      td::Binlog binlog;
+      binlog
+          .init(
+              binlog_name.str(), [&](const td::BinlogEvent &event) { data.push_back(event.get_data().str()); },
+              db_key)
+          .ensure();
+      ASSERT_TRUE(data == expected_data);
+
+      // the binlog must become bigger than the size of a memory mapping window
+      for (int i = 0; i < 400; i++) {
+        auto event_data = td::rand_string('a', 'z', td::Random::fast(0, 4000) * 4);
+        binlog.add_raw_event(td::BinlogEvent::create_raw(binlog.next_event_id(), 1, 0, td::create_storer(event_data)),
+                             td::BinlogDebugInfo{__FILE__, __LINE__});
+        expected_data.push_back(std::move(event_data));
+      }
+      binlog.close().ensure();
+
+      if (restart == 1) {
+        // incomplete event at the end of the binlog must be truncated
+        auto fd = td::FileFd::open(binlog_name, td::FileFd::Flags::Write | td::FileFd::Flags::Append).move_as_ok();
+        fd.write("abacabadaba").ensure();
+      }
+    }
+  }
+  td::Binlog::destroy(binlog_name).ignore();
+}
+
+TEST(DB, binlog_replay_corrupted) {
+  td::CSlice binlog_name = "test_binlog";
+  for (auto &db_key : {td::DbKey::empty(), td::DbKey::raw_key(td::string(32, 'A'))}) {
+    td::Binlog::destroy(binlog_name).ignore();
+
+    td::vector<td::string> expected_data;
+    {
+      td::Binlog binlog;
+      binlog.init(binlog_name.str(), [](const td::BinlogEvent &event) {}, db_key).ensure();
+      for (int i = 0; i < 100; i++) {
+        auto event_data = td::rand_string('a', 'z', td::Random::fast(1, 50) * 4);
+        binlog.add(1, td::create_storer(event_data));
+        expected_data.push_back(std::move(event_data));
+      }
+      binlog.close().ensure();
+    }
+
+    // corrupt an event in the middle of the binlog
+    {
+      auto fd = td::FileFd::open(binlog_name, td::FileFd::Flags::Read | td::FileFd::Flags::Write).move_as_ok();
+      auto offset = fd.get_size().move_as_ok() / 2;
+      char c;
+      ASSERT_EQ(1u, fd.pread(td::MutableSlice(&c, 1), offset).move_as_ok());
+      c = static_cast<char>(c ^ 0x55);
+      ASSERT_EQ(1u, fd.pwrite(td::Slice(&c, 1), offset).move_as_ok());
+    }
+
+    for (int restart = 0; restart < 2; restart++) {
+      td::vector<td::string> data;
+      td::Binlog binlog;
+      binlog
+          .init(
+              binlog_name.str(), [&](const td::BinlogEvent &event) { data.push_back(event.get_data().str()); },
+              db_key)
+          .ensure();
+      if (restart == 0) {
+        // only events before the corrupted one must be replayed
+        ASSERT_TRUE(!data.empty());
+        ASSERT_TRUE(data.size() < expected_data.size());
+        ASSERT_TRUE(std::equal(data.begin(), data.end(), expected_data.begin()));
+        expected_data.resize(data.size());
+      }
+      ASSERT_TRUE(data == expected_data);
+
+      // new events must be appended right after the last replayed event
+      for (int i = 0; i < 10; i++) {
+        auto event_data = td::rand_string('a', 'z', td::Random::fast(1, 50) * 4);
+        binlog.add(1, td::create_storer(event_data));
+        expected_data.push_back(std::move(event_data));
+      }
+      binlog.close().ensure();
+    }
+  }
+  td::Binlog::destroy(binlog_name).ignore();
+}
+
+TEST(DB, binlog_background_reindex) {
+  td::CSlice binlog_name = "test_binlog";
+  for (auto &db_key : {td::DbKey::empty(), td::DbKey::raw_key(td::string(32, 'A'))}) {
+    td::Binlog::destroy(binlog_name).ignore();
+
+    std::map<td::uint64, td::string> expected_events;
+    td::vector<td::uint64> event_ids;
+    td::int64 total_size = 0;
+    for (int restart = 0; restart < 5; restart++) {
+      std::map<td::uint64, td::string> events;
+      td::Binlog binlog;
+      binlog
+          .init(
+              binlog_name.str(), [&](const td::BinlogEvent &event) { events[event.id_] = event.get_data().str(); },
+              db_key)
+          .ensure();
+      ASSERT_TRUE(events == expected_events);
+
+      for (int i = 0; i < 20000; i++) {
+        if (restart % 2 == 1 && i >= 10000 && td::stat(binlog_name.str() + ".new").is_ok()) {
+          // close the binlog in the middle of a reindex
+          break;
+        }
+        auto event_data = td::rand_string('a', 'z', td::Random::fast(1, 100) * 4);
+        total_size += static_cast<td::int64>(event_data.size());
+        auto type = td::Random::fast(0, 9);
+        if (event_ids.size() < 3000 || type < 3) {
+          auto event_id = binlog.add(1, td::create_storer(event_data));
+          event_ids.push_back(event_id);
+          expected_events[event_id] = std::move(event_data);
+          continue;
+        }
+
+        auto pos = static_cast<size_t>(td::Random::fast(0, static_cast<int>(event_ids.size()) - 1));
+        auto event_id = event_ids[pos];
+        if (type < 7) {
+          binlog.rewrite(event_id, 1, td::create_storer(event_data));
+          expected_events[event_id] = std::move(event_data);
+        } else {
+          binlog.erase(event_id);
+          expected_events.erase(event_id);
+          event_ids[pos] = event_ids.back();
+          event_ids.pop_back();
+        }
+      }
+      binlog.close().ensure();
+
+      auto binlog_size = td::FileFd::open(binlog_name, td::FileFd::Flags::Read).move_as_ok().get_size().move_as_ok();
+      ASSERT_TRUE(binlog_size < total_size / 2);
+    }
+  }
+  td::Binlog::destroy(binlog_name).ignore();
+}
+
 TEST(DB, sqlite_lfs) {
   td::string path = "test_sqlite_db";
   td::SqliteDb::destroy(path).ignore();
@@ -807,3 +971,494 @@ TEST(DB, persistent_key_value) {
   }
   td::SqliteDb::destroy(path).ignore();
 }
+
+TEST(DB, concurrent_binlog_sync_policy) {
+  td::CSlice binlog_name = "test_binlog";
+  for (auto &sync_policy : {td::ConcurrentBinlog::SyncPolicy::always(), td::ConcurrentBinlog::SyncPolicy::group(0.01),
+                            td::ConcurrentBinlog::SyncPolicy::interval(0.01)}) {
+    td::Binlog::destroy(binlog_name).ignore();
+
+    class Main final : public td::Actor {
+     public:
+      Main(td::CSlice binlog_name, td::ConcurrentBinlog::SyncPolicy sync_policy)
+          : binlog_name_(binlog_name), sync_policy_(sync_policy) {
+      }
+
+      void start_up() final {
+        binlog_ = std::make_shared<td::ConcurrentBinlog>();
+        binlog_->init(binlog_name_.str(), [](const td::BinlogEvent &) {}).ensure();
+        binlog_->set_sync_policy(sync_policy_);
+        for (int i = 0; i < request_count_; i++) {
+          binlog_->add(1, td::create_storer("data"));
+          binlog_->force_sync(td::PromiseCreator::lambda([actor_id = actor_id(this)](td::Unit) {
+                                send_closure(actor_id, &Main::on_sync);
+                              }),
+                              "test");
+        }
+      }
+
+      void on_sync() {
+        synced_request_count_++;
+        if (synced_request_count_ == request_count_) {
+          binlog_->get_sync_statistics(
+              td::PromiseCreator::lambda([actor_id = actor_id(this)](td::ConcurrentBinlog::SyncStatistics statistics) {
+                send_closure(actor_id, &Main::on_get_sync_statistics, statistics);
+              }));
+        }
+      }
+
+      void on_get_sync_statistics(td::ConcurrentBinlog::SyncStatistics statistics) {
+        ASSERT_EQ(static_cast<td::uint64>(request_count_), statistics.sync_request_count);
+        ASSERT_EQ(static_cast<td::uint64>(request_count_), statistics.synced_event_count);
+        if (sync_policy_.type_ == td::ConcurrentBinlog::SyncPolicy::Type::Always) {
+          ASSERT_EQ(static_cast<td::uint64>(request_count_), statistics.sync_count);
+        } else {
+          ASSERT_TRUE(statistics.sync_count < static_cast<td::uint64>(request_count_ / 10));
+        }
+        binlog_->close(td::PromiseCreator::lambda([](td::Unit) { td::Scheduler::instance()->finish(); }));
+        stop();
+      }
+
+     private:
+      td::CSlice binlog_name_;
+      td::ConcurrentBinlog::SyncPolicy sync_policy_;
+      std::shared_ptr<td::ConcurrentBinlog> binlog_;
+      int request_count_ = 100;
+      int synced_request_count_ = 0;
+    };
+
+    td::ConcurrentScheduler sched(0, 0);
+    sched.create_actor_unsafe<Main>(0, "Main", binlog_name, sync_policy).release();
+    sched.start();
+    while (sched.run_main(10)) {
+      // empty
+    }
+    sched.finish();
+  }
+  td::Binlog::destroy(binlog_name).ignore();
+}
+
+TEST(DB, segmented_binlog) {
+  td::CSlice binlog_name = "test_binlog";
+  const size_t segment_count = 3;
+  td::ConcurrentBinlog::destroy_segmented(binlog_name, segment_count).ignore();
+  auto get_segment = [](td::int32 type) {
+    return static_cast<size_t>(type) % segment_count;
+  };
+
+  class Main final : public td::Actor {
+   public:
+    Main(td::CSlice binlog_name, td::ConcurrentBinlog::GetSegment get_segment,
+         td::vector<td::string> *replayed_events)
+        : binlog_name_(binlog_name), get_segment_(std::move(get_segment)), replayed_events_(replayed_events) {
+    }
+
+    void start_up() final {
+      binlog_ = std::make_shared<td::ConcurrentBinlog>();
+      if (replayed_events_ != nullptr) {
+        td::uint64 last_event_id = 0;
+        binlog_
+            ->init_segmented(binlog_name_.str(), segment_count, get_segment_,
+                             [&](const td::BinlogEvent &event) {
+                               ASSERT_TRUE(last_event_id < event.id_);
+                               last_event_id = event.id_;
+                               replayed_events_->push_back(event.get_data().str());
+                             })
+            .ensure();
+        binlog_->close(td::PromiseCreator::lambda([](td::Unit) { td::Scheduler::instance()->finish(); }));
+        stop();
+        return;
+      }
+      binlog_->init_segmented(binlog_name_.str(), segment_count, get_segment_, [](const td::BinlogEvent &) {}).ensure();
+      td::vector<td::uint64> event_ids;
+      for (td::int32 type = 1; type <= 9; type++) {
+        event_ids.push_back(binlog_->add(type, td::create_storer(PSLICE() << "event #" << type)));
+      }
+      binlog_->rewrite(event_ids[3], 4, td::create_storer("new event #4"));
+      binlog_->erase(event_ids[4]);
+      binlog_->erase_batch({event_ids[7], event_ids[8]});
+      binlog_->close(td::PromiseCreator::lambda([](td::Unit) { td::Scheduler::instance()->finish(); }));
+      stop();
+    }
+
+   private:
+    td::CSlice binlog_name_;
+    td::ConcurrentBinlog::GetSegment get_segment_;
+    td::vector<td::string> *replayed_events_;
+    std::shared_ptr<td::ConcurrentBinlog> binlog_;
+  };
+
+  auto run = [&](td::vector<td::string> *replayed_events) {
+    td::ConcurrentScheduler sched(0, 0);
+    sched.create_actor_unsafe<Main>(0, "Main", binlog_name, get_segment, replayed_events).release();
+    sched.start();
+    while (sched.run_main(10)) {
+      // empty
+    }
+    sched.finish();
+  };
+  run(nullptr);
+
+  td::vector<td::string> events;
+  for (size_t segment = 0; segment < segment_count; segment++) {
+    td::Binlog binlog;
+    binlog
+        .init(td::ConcurrentBinlog::get_segment_path(binlog_name, segment),
+              [&](const td::BinlogEvent &event) {
+                ASSERT_EQ(segment, get_segment(event.type_));
+                events.push_back(event.get_data().str());
+              })
+        .ensure();
+    binlog.close().ensure();
+  }
+  std::sort(events.begin(), events.end());
+  ASSERT_EQ("event #1,event #2,event #3,event #6,event #7,new event #4", td::implode(events, ','));
+
+  // events are replayed in the order of their identifiers regardless of their segment
+  td::vector<td::string> replayed_events;
+  run(&replayed_events);
+  ASSERT_EQ("event #1,event #2,event #3,new event #4,event #6,event #7", td::implode(replayed_events, ','));
+
+  // a wrong password for any segment fails the initialization
+  {
+    td::Binlog binlog;
+    binlog
+        .init(td::ConcurrentBinlog::get_segment_path(binlog_name, segment_count - 1), td::Binlog::Callback(),
+              td::DbKey::password("password"))
+        .ensure();
+    binlog.close().ensure();
+  }
+  {
+    td::ConcurrentBinlog binlog;
+    auto r_info = binlog.init_segmented(binlog_name.str(), segment_count, get_segment, td::ConcurrentBinlog::Callback());
+    ASSERT_TRUE(r_info.is_error());
+    ASSERT_EQ(static_cast<int>(td::Binlog::Error::WrongPassword), r_info.error().code());
+  }
+
+  td::ConcurrentBinlog::destroy_segmented(binlog_name, segment_count).ignore();
+}
+
+TEST(DB, message_db_read_order) {
+  td::CSlice db_name = "test_message_db.sqlite";
+  td::SqliteDb::destroy(db_name).ignore();
+  td::SqliteDb::open_with_key(db_name, true, td::DbKey::empty()).move_as_ok();
+
+  // the writer works on the main scheduler and the only reader works on scheduler 1
+  td::ConcurrentScheduler sched(1, 0);
+  std::shared_ptr<td::SqliteConnectionSafe> sql_connection;
+  std::shared_ptr<td::MessageDbSyncSafeInterface> message_db_sync_safe;
+  std::shared_ptr<td::MessageDbAsyncInterface> message_db_async;
+  const td::DialogId dialog_id(td::UserId(static_cast<td::int64>(1)));
+  auto get_message_full_id = [dialog_id](int i) {
+    return td::MessageFullId(dialog_id, td::MessageId(td::ServerMessageId(i + 1)));
+  };
+
+  const int message_count = 100;
+  std::atomic<int> left_count{2 * message_count + 4};
+  // whether the message was found by the i-th read query; each query is executed either by the writer or by the reader
+  td::vector<int> is_found(message_count + 5, -1);
+  int query_count = 0;
+  auto get_message = [&](int i) {
+    auto query_id = query_count++;
+    message_db_async->get_message(
+        get_message_full_id(i),
+        td::PromiseCreator::lambda([&, query_id](td::Result<td::MessageDbDialogMessage> r_message) {
+          is_found[query_id] = r_message.is_ok();
+          left_count--;
+        }));
+  };
+  auto run_until_finished = [&] {
+    while (left_count.load() > 0) {
+      sched.run_main(0.01);
+    }
+  };
+  {
+    auto guard = sched.get_main_guard();
+    sql_connection = std::make_shared<td::SqliteConnectionSafe>(db_name.str(), td::DbKey::empty());
+    auto &db = sql_connection->get();
+    db.exec("PRAGMA journal_mode=WAL").ensure();
+    td::init_message_db(db, 0).ensure();
+    message_db_sync_safe = td::create_message_db_sync(sql_connection);
+    message_db_async = td::create_message_db_async(message_db_sync_safe, 0, {1});
+
+    // a read query doesn't see a message added after it
+    get_message(message_count / 2);
+
+    // a read query sees all messages added before it
+    for (int i = 0; i < message_count; i++) {
+      message_db_async->add_message(get_message_full_id(i), td::ServerMessageId(), td::DialogId(), 0, 0, 0, 0, "",
+                                    td::NotificationId(), td::MessageId(), td::BufferSlice("data"),
+                                    td::PromiseCreator::lambda([&](td::Unit) { left_count--; }));
+      get_message(i);
+    }
+
+    // a read query doesn't see a message deleted before it
+    message_db_async->delete_message(get_message_full_id(0),
+                                     td::PromiseCreator::lambda([&](td::Unit) { left_count--; }));
+    get_message(0);
+    get_message(1);
+  }
+  sched.start();
+  run_until_finished();
+
+  ASSERT_EQ(message_count + 3, query_count);
+  ASSERT_EQ(0, is_found[0]);
+  for (int i = 0; i < message_count; i++) {
+    ASSERT_EQ(1, is_found[i + 1]);
+  }
+  ASSERT_EQ(0, is_found[message_count + 1]);
+  ASSERT_EQ(1, is_found[message_count + 2]);
+
+  // all changes are committed, so the next query is executed by the reader and must not see the deletion sent after it
+  left_count = 3;
+  {
+    auto guard = sched.get_main_guard();
+    get_message(1);
+    message_db_async->delete_message(get_message_full_id(1),
+                                     td::PromiseCreator::lambda([&](td::Unit) { left_count--; }));
+    get_message(1);
+  }
+  run_until_finished();
+  ASSERT_EQ(1, is_found[message_count + 3]);
+  ASSERT_EQ(0, is_found[message_count + 4]);
+
+  {
+    auto guard = sched.get_main_guard();
+    message_db_sync_safe.reset();
+    message_db_async->close(
+        td::PromiseCreator::lambda([&, sql_connection = std::move(sql_connection)](td::Unit) mutable {
+          sql_connection->close_and_destroy();
+          sql_connection.reset();
+          message_db_async.reset();
+          td::Scheduler::instance()->finish();
+        }));
+  }
+  while (sched.run_main(10)) {
+    // empty
+  }
+  sched.finish();
+}
+
+TEST(DB, message_db_add_messages) {
+  // SqliteConnectionSafe requires a scheduler
+  td::ConcurrentScheduler sched(0, 0);
+  auto guard = sched.get_main_guard();
+
+  // the same messages are added one by one to the first database and by add_messages to the second database
+  td::vector<std::shared_ptr<td::SqliteConnectionSafe>> sql_connections;
+  td::vector<std::shared_ptr<td::MessageDbSyncSafeInterface>> message_dbs;
+  for (int i = 0; i < 2; i++) {
+    td::string db_name = PSTRING() << "test_message_db_" << i << ".sqlite";
+    td::SqliteDb::destroy(db_name).ignore();
+    td::SqliteDb::open_with_key(db_name, true, td::DbKey::empty()).move_as_ok();
+    auto sql_connection = std::make_shared<td::SqliteConnectionSafe>(db_name, td::DbKey::empty());
+    auto &db = sql_connection->get();
+    db.begin_write_transaction().ensure();
+    td::init_message_db(db, 0).ensure();
+    db.commit_transaction().ensure();
+    message_dbs.push_back(td::create_message_db_sync(sql_connection));
+    sql_connections.push_back(std::move(sql_connection));
+  }
+
+  td::vector<td::string> words{"apple", "banana", "cherry", "date", "elderberry"};
+  auto get_random_message = [&](int search_id) {
+    td::MessageDbMessageToAdd message;
+    td::DialogId dialog_id(td::UserId(static_cast<td::int64>(td::Random::fast(1, 2))));
+    // message identifiers are chosen from a small range to have duplicates inside and between batches
+    message.message_full_id = {dialog_id, td::MessageId(td::ServerMessageId(td::Random::fast(1, 40)))};
+    if (td::Random::fast_bool()) {
+      message.unique_message_id = td::ServerMessageId(td::Random::fast(1, 1000000));
+    }
+    if (td::Random::fast_bool()) {
+      message.sender_dialog_id = td::DialogId(td::UserId(static_cast<td::int64>(td::Random::fast(1, 100))));
+    }
+    if (td::Random::fast_bool()) {
+      message.random_id = td::Random::fast(1, 1000000);
+    }
+    if (td::Random::fast_bool()) {
+      message.ttl_expires_at = td::Random::fast(1, 1000000);
+    }
+    message.index_mask = td::Random::fast(0, 31);
+    if (td::Random::fast_bool()) {
+      message.search_id = search_id;
+      for (int i = td::Random::fast(1, 3); i > 0; i--) {
+        message.text += rand_elem(words) + " ";
+      }
+    }
+    if (td::Random::fast_bool()) {
+      message.notification_id = td::NotificationId(td::Random::fast(1, 1000000));
+    }
+    message.data = td::BufferSlice(td::rand_string('a', 'z', td::Random::fast(1, 100)));
+    return message;
+  };
+
+  const int message_count = 70;
+  td::vector<td::MessageDbMessageToAdd> messages;
+  for (int i = 0; i < message_count; i++) {
+    messages.push_back(get_random_message(i + 1));
+  }
+
+  {
+    auto &message_db = message_dbs[0]->get();
+    message_db.begin_write_transaction().ensure();
+    for (auto &message : messages) {
+      message_db.add_message(message.message_full_id, message.unique_message_id, message.sender_dialog_id,
+                             message.random_id, message.ttl_expires_at, message.index_mask, message.search_id,
+                             message.text, message.notification_id, message.top_thread_message_id,
+                             message.data.clone());
+    }
+    message_db.commit_transaction().ensure();
+  }
+  {
+    auto &message_db = message_dbs[1]->get();
+    message_db.begin_write_transaction().ensure();
+    message_db.add_messages(std::move(messages));
+    message_db.commit_transaction().ensure();
+  }
+
+  auto get_rows = [&](int db_index, td::Slice query, int column_count) {
+    auto stmt = sql_connections[db_index]->get().get_statement(PSLICE() << query).move_as_ok();
+    td::vector<td::string> rows;
+    stmt.step().ensure();
+    while (stmt.has_row()) {
+      td::string row;
+      for (int i = 0; i < column_count; i++) {
+        switch (stmt.view_datatype(i)) {
+          case td::SqliteStatement::Datatype::Null:
+            row += "NULL";
+            break;
+          case td::SqliteStatement::Datatype::Integer:
+            row += td::to_string(stmt.view_int64(i));
+            break;
+          case td::SqliteStatement::Datatype::Text:
+            row += stmt.view_string(i).str();
+            break;
+          default:
+            row += stmt.view_blob(i).str();
+            break;
+        }
+        row += '|';
+      }
+      rows.push_back(std::move(row));
+      stmt.step().ensure();
+    }
+    return rows;
+  };
+  auto check_rows = [&](td::Slice query, int column_count) {
+    auto rows = get_rows(0, query, column_count);
+    ASSERT_EQ(rows, get_rows(1, query, column_count));
+    return rows.size();
+  };
+
+  ASSERT_TRUE(check_rows("SELECT * FROM messages ORDER BY dialog_id, message_id", 12) > 0);
+  for (auto &word : words) {
+    check_rows(PSLICE() << "SELECT rowid FROM messages_fts WHERE messages_fts MATCH '" << word << "' ORDER BY rowid",
+               1);
+  }
+  for (int i = 0; i < 5; i++) {
+    check_rows(PSLICE() << "SELECT dialog_id, message_id FROM messages INDEXED BY message_index_" << i
+                        << " WHERE (index_mask & " << (1 << i) << ") != 0 ORDER BY dialog_id, message_id",
+               2);
+  }
+  check_rows(
+      "SELECT dialog_id, notification_id, message_id FROM messages INDEXED BY message_by_notification_id WHERE "
+      "notification_id IS NOT NULL ORDER BY dialog_id, notification_id",
+      3);
+
+  message_dbs.clear();
+  for (auto &sql_connection : sql_connections) {
+    sql_connection->close_and_destroy();
+  }
+}
+
+TEST(DB, dialog_db_get_dialogs) {
+  td::CSlice db_name = "test_dialog_db.sqlite";
+  td::CSlice binlog_name = "test_dialog_db_binlog";
+  td::SqliteDb::destroy(db_name).ignore();
+  td::Binlog::destroy(binlog_name).ignore();
+  td::SqliteDb::open_with_key(db_name, true, td::DbKey::empty()).move_as_ok();
+
+  // SqliteConnectionSafe requires a scheduler
+  td::ConcurrentScheduler sched(0, 0);
+  auto guard = sched.get_main_guard();
+  auto sql_connection = std::make_shared<td::SqliteConnectionSafe>(db_name.str(), td::DbKey::empty());
+  td::BinlogKeyValue<td::Binlog> binlog_pmc;
+  binlog_pmc.init(binlog_name.str()).ensure();
+  {
+    auto &db = sql_connection->get();
+    bool was_created = false;
+    db.begin_write_transaction().ensure();
+    td::init_dialog_db(db, 0, binlog_pmc, was_created).ensure();
+    db.commit_transaction().ensure();
+  }
+  auto dialog_db_safe = td::create_dialog_db_sync(sql_connection);
+  auto &dialog_db = dialog_db_safe->get();
+
+  using DialogPosition = std::pair<td::int64, td::int64>;
+  // dialog_id -> (folder_id, order)
+  std::map<td::int64, std::pair<td::int32, td::int64>> dialogs;
+  auto get_data = [](td::int64 dialog_id, td::int64 order) {
+    return PSTRING() << dialog_id << ' ' << order;
+  };
+  auto add_dialog = [&](td::int64 dialog_id, td::int32 folder_id, td::int64 order) {
+    dialogs[dialog_id] = {folder_id, order};
+    dialog_db.add_dialog(td::DialogId(dialog_id), td::FolderId(folder_id), order,
+                         td::BufferSlice(get_data(dialog_id, order)), {});
+  };
+  auto get_expected_dialogs = [&](td::int32 folder_id, DialogPosition from, size_t limit) {
+    td::vector<DialogPosition> positions;
+    for (auto &it : dialogs) {
+      DialogPosition position(it.second.second, it.first);
+      if (it.second.first == folder_id && position.first > 0 && position < from) {
+        positions.push_back(position);
+      }
+    }
+    std::sort(positions.begin(), positions.end(), std::greater<DialogPosition>());
+    td::vector<td::string> result;
+    for (size_t i = 0; i < positions.size() && i < limit; i++) {
+      result.push_back(get_data(positions[i].second, positions[i].first));
+    }
+    return result;
+  };
+
+  const int dialog_count = 300;
+  auto add_random_dialog = [&] {
+    // non-positive orders remove chats from chat lists; equal orders check ordering by dialog_id
+    add_dialog(td::Random::fast(1, dialog_count), td::Random::fast(0, 1), td::Random::fast(-100, 1000));
+  };
+  for (int i = 1; i <= dialog_count; i++) {
+    add_dialog(i, td::Random::fast(0, 1), td::Random::fast(1, 1000));
+  }
+
+  for (int iteration = 0; iteration < 100; iteration++) {
+    auto folder_id = td::Random::fast(0, 1);
+    DialogPosition position(std::numeric_limits<td::int64>::max(), std::numeric_limits<td::int64>::max());
+    while (true) {
+      auto limit = td::Random::fast(1, 30);
+      auto result =
+          dialog_db.get_dialogs(td::FolderId(folder_id), position.first, td::DialogId(position.second), limit);
+      auto expected_dialogs = get_expected_dialogs(folder_id, position, limit);
+      ASSERT_EQ(expected_dialogs.size(), result.dialogs.size());
+      for (size_t i = 0; i < expected_dialogs.size(); i++) {
+        ASSERT_EQ(expected_dialogs[i], result.dialogs[i].as_slice().str());
+      }
+      if (static_cast<int>(result.dialogs.size()) < limit) {
+        break;
+      }
+      position = DialogPosition(result.next_order, result.next_dialog_id.get());
+
+      // chats are changed between requests, and sometimes pagination continues from an arbitrary position
+      for (int i = td::Random::fast(0, 3); i > 0; i--) {
+        add_random_dialog();
+      }
+      if (td::Random::fast(0, 9) == 0) {
+        position = DialogPosition(td::Random::fast(1, 1000), td::Random::fast(1, dialog_count));
+      }
+    }
+  }
+
+  dialog_db_safe.reset();
+  sql_connection->close_and_destroy();
+  binlog_pmc.close();
+  td::Binlog::destroy(binlog_name).ignore();
+}
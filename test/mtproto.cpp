@@ -11,16 +11,19 @@
 #include "td/telegram/telegram_api.h"
 
 #include "td/mtproto/AuthData.h"
+#include "td/mtproto/AuthKey.h"
 #include "td/mtproto/DhCallback.h"
 #include "td/mtproto/DhHandshake.h"
 #include "td/mtproto/Handshake.h"
 #include "td/mtproto/HandshakeActor.h"
+#include "td/mtproto/KDF.h"
 #include "td/mtproto/Ping.h"
 #include "td/mtproto/PingConnection.h"
 #include "td/mtproto/ProxySecret.h"
 #include "td/mtproto/RawConnection.h"
 #include "td/mtproto/RSA.h"
 #include "td/mtproto/TlsInit.h"
+#include "td/mtproto/Transport.h"
 #include "td/mtproto/TransportType.h"
 
 #include "td/net/GetHostByNameActor.h"
@@ -30,6 +33,7 @@
 #include "td/actor/actor.h"
 #include "td/actor/ConcurrentScheduler.h"
 
+#include "td/utils/as.h"
 #include "td/utils/base64.h"
 #include "td/utils/BufferedFd.h"
 #include "td/utils/common.h"
@@ -45,7 +49,9 @@
 #include "td/utils/Status.h"
 #include "td/utils/tests.h"
 #include "td/utils/Time.h"
+#include "td/utils/UInt.h"
 
+#include <limits>
 #include <memory>
 
 TEST(Mtproto, GetHostByNameActor) {
@@ -740,3 +746,28 @@ TEST(Mtproto, RSA) {
   rsa.encrypt(pem.substr(0, 256), to);
   ASSERT_EQ("U2nJEtB2AgpHrm3HB0yhpTQgb0wbesi9Pv/W1v/vULU=", td::base64_encode(td::sha256(to)));
 }
+
+TEST(Mtproto, KDF2) {
+  td::mtproto::AuthKey auth_key(
+      0, td::rand_string(std::numeric_limits<char>::min(), std::numeric_limits<char>::max(), 256));
+  for (int i = 0; i < 3; i++) {
+    for (int X : {0, 8}) {
+      td::UInt128 message_key;
+      td::Random::secure_bytes(as_mutable_slice(message_key));
+      td::UInt256 aes_key;
+      td::UInt256 aes_iv;
+      td::mtproto::KDF2(auth_key, message_key, X, &aes_key, &aes_iv);
+      td::UInt256 expected_aes_key;
+      td::UInt256 expected_aes_iv;
+      td::mtproto::KDF2(auth_key.key(), message_key, X, &expected_aes_key, &expected_aes_iv);
+      ASSERT_TRUE(aes_key == expected_aes_key);
+      ASSERT_TRUE(aes_iv == expected_aes_iv);
+
+      auto data = td::rand_string('a', 'z', 16 * i + 32);
+      auto message_key_large = td::sha256(PSLICE() << td::Slice(auth_key.key()).substr(88 + X, 32) << data);
+      td::UInt128 expected_message_key = td::as<td::UInt128>(message_key_large.data() + 8);
+      ASSERT_TRUE(td::mtproto::Transport::calc_message_key2(auth_key, X, data).second == expected_message_key);
+    }
+    auth_key.break_key();
+  }
+}
@@ -0,0 +1,332 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/net/DcId.h"
+#include "td/telegram/net/NetQuery.h"
+#include "td/telegram/net/NetQueryDeduplicator.h"
+
+#include "td/actor/actor.h"
+#include "td/actor/ConcurrentScheduler.h"
+
+#include "td/utils/algorithm.h"
+#include "td/utils/buffer.h"
+#include "td/utils/common.h"
+#include "td/utils/ObjectPool.h"
+#include "td/utils/Slice.h"
+#include "td/utils/Status.h"
+#include "td/utils/tests.h"
+
+#include <map>
+#include <utility>
+
+namespace {
+
+// emulates NetQueryDispatcher: ready queries are returned to the caller, queries which can be deduplicated are sent
+// to the deduplicator again and all other queries are sent to the server
+class DeduplicatorTest {
+ public:
+  DeduplicatorTest() {
+    sched_.start();
+    auto guard = sched_.get_main_guard();
+    deduplicator_ = td::create_actor<td::NetQueryDeduplicator>("NetQueryDeduplicator", td::ActorShared<>(),
+                                                               td::make_unique<TestCallback>(this));
+  }
+  DeduplicatorTest(const DeduplicatorTest &) = delete;
+  DeduplicatorTest &operator=(const DeduplicatorTest &) = delete;
+  DeduplicatorTest(DeduplicatorTest &&) = delete;
+  DeduplicatorTest &operator=(DeduplicatorTest &&) = delete;
+  ~DeduplicatorTest() {
+    close_deduplicator();
+    {
+      auto guard = sched_.get_main_guard();
+      for (auto &query : sent_queries_) {
+        query->set_error(td::Status::Error(500, "Test finished"));
+      }
+      sent_queries_.clear();
+      results_.clear();
+      cancel_signals_.clear();
+    }
+    run();
+    sched_.finish();
+  }
+
+  // identical queries must be sent to the same DC
+  td::NetQuery *add_query(td::int32 dc_id) {
+    auto query = query_pool_.create();
+    query->resend(td::DcId::internal(dc_id));
+    query->can_be_deduplicated_ = true;
+    auto result = query.get();
+    {
+      auto guard = sched_.get_main_guard();
+      cancel_signals_.emplace(result, query->cancel_slot_.get_signal_new());
+      td::send_closure(deduplicator_, &td::NetQueryDeduplicator::add_query, std::move(query));
+    }
+    run();
+    return result;
+  }
+
+  void cancel_query(td::NetQuery *query) {
+    {
+      auto guard = sched_.get_main_guard();
+      auto it = cancel_signals_.find(query);
+      CHECK(it != cancel_signals_.end());
+      cancel_signals_.erase(it);
+    }
+    run();
+  }
+
+  void set_ok(td::NetQuery *query, td::Slice answer) {
+    finish_query(query, [&](td::NetQuery &sent_query) { sent_query.set_ok(td::BufferSlice(answer)); });
+  }
+
+  void set_error(td::NetQuery *query, td::Status status) {
+    finish_query(query, [&](td::NetQuery &sent_query) { sent_query.set_error(std::move(status)); });
+  }
+
+  void set_canceled(td::NetQuery *query) {
+    finish_query(query, [](td::NetQuery &sent_query) { sent_query.set_error_canceled(); });
+  }
+
+  void close_deduplicator() {
+    {
+      auto guard = sched_.get_main_guard();
+      deduplicator_.reset();
+    }
+    run();
+  }
+
+  const td::vector<td::NetQueryPtr> &get_sent_queries() const {
+    return sent_queries_;
+  }
+
+  td::NetQueryPtr get_result(td::NetQuery *query) {
+    for (auto &result : results_) {
+      if (result.get() == query) {
+        auto query_ptr = std::move(result);
+        td::remove_if(results_, [](const td::NetQueryPtr &result) { return result.empty(); });
+        return query_ptr;
+      }
+    }
+    return td::NetQueryPtr();
+  }
+
+  size_t get_result_count() const {
+    return results_.size();
+  }
+
+  size_t get_deduplicated_query_count() const {
+    return deduplicated_query_count_;
+  }
+
+  size_t get_deduplicated_answer_size() const {
+    return deduplicated_answer_size_;
+  }
+
+  // the query must be destroyed on the main scheduler, because it has a registered cancel slot
+  void destroy(td::NetQueryPtr query) {
+    auto guard = sched_.get_main_guard();
+    cancel_signals_.erase(query.get());
+    query.reset();
+  }
+
+ private:
+  class TestCallback final : public td::NetQueryDeduplicator::Callback {
+   public:
+    explicit TestCallback(DeduplicatorTest *test) : test_(test) {
+    }
+
+    void dispatch(td::NetQueryPtr query) final {
+      if (query->is_ready()) {
+        test_->results_.push_back(std::move(query));
+      } else if (query->can_be_deduplicated_) {
+        td::send_closure_later(test_->deduplicator_, &td::NetQueryDeduplicator::add_query, std::move(query));
+      } else {
+        test_->sent_queries_.push_back(std::move(query));
+      }
+    }
+
+    void on_query_deduplicated(size_t answer_size) final {
+      test_->deduplicated_query_count_++;
+      test_->deduplicated_answer_size_ += answer_size;
+    }
+
+   private:
+    DeduplicatorTest *test_;
+  };
+
+  td::ObjectPool<td::NetQuery> query_pool_;
+  td::ConcurrentScheduler sched_{0, 0};
+  td::ActorOwn<td::NetQueryDeduplicator> deduplicator_;
+  std::map<td::NetQuery *, td::ActorShared<>> cancel_signals_;
+  td::vector<td::NetQueryPtr> sent_queries_;
+  td::vector<td::NetQueryPtr> results_;
+  size_t deduplicated_query_count_ = 0;
+  size_t deduplicated_answer_size_ = 0;
+
+  void run() {
+    for (int i = 0; i < 10; i++) {
+      sched_.run_main(0);
+    }
+  }
+
+  template <class F>
+  void finish_query(td::NetQuery *query, F &&f) {
+    for (auto &sent_query : sent_queries_) {
+      if (sent_query.get() == query) {
+        auto guard = sched_.get_main_guard();
+        f(*sent_query);
+        auto callback = sent_query->move_callback();
+        td::send_closure(std::move(callback), &td::NetQueryCallback::on_result, std::move(sent_query));
+        td::remove_if(sent_queries_, [](const td::NetQueryPtr &sent_query) { return sent_query.empty(); });
+        break;
+      }
+    }
+    run();
+  }
+};
+
+}  // namespace
+
+TEST(NetQueryDeduplicator, identical_queries) {
+  DeduplicatorTest test;
+  td::vector<td::NetQuery *> queries;
+  for (int i = 0; i < 5; i++) {
+    queries.push_back(test.add_query(2));
+  }
+  auto other_query = test.add_query(4);
+  ASSERT_EQ(2u, test.get_sent_queries().size());
+  ASSERT_TRUE(test.get_sent_queries()[0].get() == queries[0]);
+  ASSERT_TRUE(test.get_sent_queries()[1].get() == other_query);
+  ASSERT_TRUE(!test.get_sent_queries()[0]->can_be_deduplicated_);
+  ASSERT_EQ(0u, test.get_result_count());
+
+  test.set_ok(queries[0], "answer");
+  ASSERT_EQ(1u, test.get_sent_queries().size());
+  ASSERT_EQ(5u, test.get_result_count());
+  ASSERT_EQ(4u, test.get_deduplicated_query_count());
+  ASSERT_EQ(4 * td::Slice("answer").size(), test.get_deduplicated_answer_size());
+  for (auto query : queries) {
+    auto result = test.get_result(query);
+    ASSERT_TRUE(!result.empty());
+    ASSERT_TRUE(result->is_ok());
+    ASSERT_EQ("answer", result->ok().as_slice());
+    ASSERT_TRUE(result->can_be_deduplicated_);
+    test.destroy(std::move(result));
+  }
+
+  // the next identical query is sent again
+  auto new_query = test.add_query(2);
+  ASSERT_EQ(2u, test.get_sent_queries().size());
+  ASSERT_TRUE(test.get_sent_queries()[1].get() == new_query);
+}
+
+TEST(NetQueryDeduplicator, error) {
+  DeduplicatorTest test;
+  td::vector<td::NetQuery *> queries;
+  for (int i = 0; i < 3; i++) {
+    queries.push_back(test.add_query(2));
+  }
+  ASSERT_EQ(1u, test.get_sent_queries().size());
+
+  test.set_error(queries[0], td::Status::Error(400, "TEST_ERROR"));
+  ASSERT_EQ(0u, test.get_sent_queries().size());
+  ASSERT_EQ(3u, test.get_result_count());
+  ASSERT_EQ(2u, test.get_deduplicated_query_count());
+  for (auto query : queries) {
+    auto result = test.get_result(query);
+    ASSERT_TRUE(!result.empty());
+    ASSERT_TRUE(result->is_error());
+    ASSERT_EQ(400, result->error().code());
+    ASSERT_EQ("TEST_ERROR", result->error().message());
+    test.destroy(std::move(result));
+  }
+}
+
+TEST(NetQueryDeduplicator, cancel_sent_query) {
+  DeduplicatorTest test;
+  td::vector<td::NetQuery *> queries;
+  for (int i = 0; i < 4; i++) {
+    queries.push_back(test.add_query(2));
+  }
+  ASSERT_EQ(1u, test.get_sent_queries().size());
+
+  // the waiting queries aren't canceled with the sent query and form a new group
+  test.set_canceled(queries[0]);
+  ASSERT_EQ(1u, test.get_result_count());
+  ASSERT_EQ(0u, test.get_deduplicated_query_count());
+  auto result = test.get_result(queries[0]);
+  ASSERT_TRUE(!result.empty());
+  ASSERT_TRUE(result->is_error());
+  test.destroy(std::move(result));
+
+  ASSERT_EQ(1u, test.get_sent_queries().size());
+  ASSERT_TRUE(test.get_sent_queries()[0].get() == queries[1]);
+
+  test.set_ok(queries[1], "answer");
+  ASSERT_EQ(0u, test.get_sent_queries().size());
+  ASSERT_EQ(3u, test.get_result_count());
+  ASSERT_EQ(2u, test.get_deduplicated_query_count());
+  for (size_t i = 1; i < queries.size(); i++) {
+    result = test.get_result(queries[i]);
+    ASSERT_TRUE(!result.empty());
+    ASSERT_TRUE(result->is_ok());
+    ASSERT_EQ("answer", result->ok().as_slice());
+    test.destroy(std::move(result));
+  }
+}
+
+TEST(NetQueryDeduplicator, cancel_waiting_query) {
+  DeduplicatorTest test;
+  td::vector<td::NetQuery *> queries;
+  for (int i = 0; i < 3; i++) {
+    queries.push_back(test.add_query(2));
+  }
+
+  // the canceled query is returned immediately without waiting for the sent query
+  test.cancel_query(queries[1]);
+  ASSERT_EQ(1u, test.get_sent_queries().size());
+  ASSERT_EQ(1u, test.get_result_count());
+  auto result = test.get_result(queries[1]);
+  ASSERT_TRUE(!result.empty());
+  ASSERT_TRUE(result->is_error());
+  ASSERT_EQ(static_cast<td::int32>(td::NetQuery::Error::Canceled), result->error().code());
+  test.destroy(std::move(result));
+
+  test.set_ok(queries[0], "answer");
+  ASSERT_EQ(2u, test.get_result_count());
+  ASSERT_EQ(1u, test.get_deduplicated_query_count());
+  ASSERT_TRUE(test.get_result(queries[1]).empty());
+  for (auto query : {queries[0], queries[2]}) {
+    result = test.get_result(query);
+    ASSERT_TRUE(!result.empty());
+    ASSERT_TRUE(result->is_ok());
+    test.destroy(std::move(result));
+  }
+}
+
+TEST(NetQueryDeduplicator, tear_down) {
+  DeduplicatorTest test;
+  td::vector<td::NetQuery *> queries;
+  for (int i = 0; i < 3; i++) {
+    queries.push_back(test.add_query(2));
+  }
+  queries.push_back(test.add_query(4));
+  queries.push_back(test.add_query(4));
+  ASSERT_EQ(2u, test.get_sent_queries().size());
+
+  // the waiting queries fail, while the sent queries are finished as usual
+  test.close_deduplicator();
+  ASSERT_EQ(2u, test.get_sent_queries().size());
+  ASSERT_EQ(3u, test.get_result_count());
+  for (auto query : {queries[1], queries[2], queries[4]}) {
+    auto result = test.get_result(query);
+    ASSERT_TRUE(!result.empty());
+    ASSERT_TRUE(result->is_error());
+    ASSERT_EQ(500, result->error().code());
+    test.destroy(std::move(result));
+  }
+  ASSERT_EQ(0u, test.get_deduplicated_query_count());
+}
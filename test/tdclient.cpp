@@ -865,6 +865,22 @@ TEST(Client, Simple) {
   }
 }
 
+TEST(Client, SetThreadTopology) {
+  // even one instance group can't have that many threads
+  ASSERT_TRUE(!td::ClientManager::set_thread_topology(0, 200, 0));
+  ASSERT_TRUE(!td::ClientManager::set_thread_topology(-1, 0, 0));
+  {
+    td::Client client;
+    client.send({3, td::make_tl_object<td::td_api::testSquareInt>(3)});
+    while (client.receive(10).id != 3) {
+      // empty
+    }
+    ASSERT_TRUE(!td::ClientManager::set_thread_topology(0, 0, 0));
+  }
+  // the topology can be changed again after all clients are closed
+  ASSERT_TRUE(td::ClientManager::set_thread_topology(0, 0, 0));
+}
+
 TEST(Client, SimpleMulti) {
   std::vector<td::Client> clients(7);
   //for (auto &client : clients) {
@@ -970,6 +986,55 @@ TEST(Client, Manager) {
   }
 }
 
+TEST(Client, ManagerReceiveBatch) {
+  td::ClientManager client_manager;
+  td::vector<td::ClientManager::ClientId> client_ids;
+  for (int i = 0; i < 10; i++) {
+    client_ids.push_back(client_manager.create_client_id());
+  }
+  int requests_n = 100;
+  for (int i = 0; i < requests_n; i++) {
+    for (auto client_id : client_ids) {
+      client_manager.send(client_id, static_cast<td::uint64>(i + 2), td::make_tl_object<td::td_api::testSquareInt>(i));
+    }
+  }
+
+  std::map<td::int32, int> next_request;
+  size_t receive_count = 0;
+  while (receive_count != client_ids.size() * requests_n) {
+    auto responses = client_manager.receive_batch(64, 10.0);
+    ASSERT_TRUE(!responses.empty());
+    ASSERT_TRUE(responses.size() <= 64u);
+    for (auto &response : responses) {
+      ASSERT_TRUE(response.object != nullptr);
+      if (response.request_id == 0) {
+        continue;
+      }
+      // responses to requests of the same client must be received in order
+      auto &request = next_request[response.client_id];
+      ASSERT_EQ(static_cast<td::uint64>(request + 2), response.request_id);
+      ASSERT_EQ(td::td_api::testInt::ID, response.object->get_id());
+      ASSERT_EQ(request * request, static_cast<td::td_api::testInt &>(*response.object).value_);
+      request++;
+      receive_count++;
+    }
+  }
+
+  for (auto client_id : client_ids) {
+    client_manager.send(client_id, 1, td::make_tl_object<td::td_api::close>());
+  }
+  size_t closed_count = 0;
+  while (closed_count != client_ids.size()) {
+    for (auto &response : client_manager.receive_batch(64, 10.0)) {
+      if (response.request_id == 0 && response.object->get_id() == td::td_api::updateAuthorizationState::ID &&
+          static_cast<const td::td_api::updateAuthorizationState *>(response.object.get())
+                  ->authorization_state_->get_id() == td::td_api::authorizationStateClosed::ID) {
+        closed_count++;
+      }
+    }
+  }
+}
+
 #if !TD_EVENTFD_UNSUPPORTED  // Client must be used from a single thread if there is no EventFd
 TEST(Client, Close) {
   std::atomic<bool> stop_send{false};
@@ -20,6 +20,7 @@
 #include "td/utils/tests.h"
 #include "td/utils/Time.h"
 
+#include <map>
 #include <memory>
 #include <utility>
 
@@ -119,6 +120,34 @@ class TestTQueue {
     return a_id;
   }
 
+  EventId push_batch(td::TQueue::QueueId queue_id, const td::vector<td::string> &data, td::int32 expires_at,
+                     EventId new_id = EventId()) {
+    auto get_events = [&] {
+      td::vector<td::TQueue::BatchEvent> events;
+      for (auto &event_data : data) {
+        events.push_back({event_data, expires_at, 0});
+      }
+      return events;
+    };
+    auto a_id = baseline_->push_batch(queue_id, get_events(), new_id).move_as_ok();
+    auto b_id = memory_->push_batch(queue_id, get_events(), new_id).move_as_ok();
+    auto c_id = binlog_->push_batch(queue_id, get_events(), new_id).move_as_ok();
+    ASSERT_EQ(a_id, b_id);
+    ASSERT_EQ(a_id, c_id);
+    return a_id;
+  }
+
+  void forget_range(td::TQueue::QueueId queue_id, td::Random::Xorshift128plus &rnd) {
+    auto upto_id = baseline_->get_head(queue_id);
+    auto r_upto_id = upto_id.advance(rnd.fast(0, 20));
+    if (r_upto_id.is_ok()) {
+      upto_id = r_upto_id.move_as_ok();
+    }
+    baseline_->forget_range(queue_id, upto_id);
+    memory_->forget_range(queue_id, upto_id);
+    binlog_->forget_range(queue_id, upto_id);
+  }
+
   void check_head_tail(td::TQueue::QueueId qid) {
     //ASSERT_EQ(baseline_->get_head(qid), memory_->get_head(qid));
     //ASSERT_EQ(baseline_->get_head(qid), binlog_->get_head(qid));
@@ -258,3 +287,216 @@ TEST(TQueue, clear) {
   CHECK(tqueue->get_tail(1) == tail_id);
   CHECK(deleted_events.size() == 100000 - keep_count);
 }
+
+TEST(TQueue, ring_buffer) {
+  auto tqueue = td::TQueue::create();
+  td::Random::Xorshift128plus rnd(123);
+  // event_id -> (data, expires_at)
+  std::map<td::int32, std::pair<td::string, td::int32>> events;
+  td::int32 now = 1;
+  td::TQueue::QueueId qid = 1;
+
+  auto check_get = [&](td::TQueue::EventId from_id, size_t limit) {
+    td::vector<td::TQueue::Event> result(limit);
+    td::MutableSpan<td::TQueue::Event> result_span(result);
+    auto size = tqueue->get(qid, from_id, false, now, result_span).move_as_ok();
+    size_t i = 0;
+    for (auto it = events.lower_bound(from_id.value()); it != events.end() && i < limit;) {
+      if (it->second.second < now) {
+        // expired events are deleted when they are found
+        it = events.erase(it);
+        continue;
+      }
+      ASSERT_TRUE(i < result_span.size());
+      ASSERT_EQ(it->first, result_span[i].id.value());
+      ASSERT_EQ(it->second.first, result_span[i].data);
+      ASSERT_EQ(it->second.second, result_span[i].expires_at);
+      ++it;
+      i++;
+    }
+    ASSERT_EQ(i, result_span.size());
+    return size;
+  };
+
+  for (int i = 0; i < 200000; i++) {
+    auto type = rnd.fast(0, 99);
+    if (type < 50) {
+      auto data = PSTRING() << rnd();
+      auto expires_at = now + rnd.fast(1, 1000);
+      auto event_id = tqueue->push(qid, data, expires_at, 0, td::TQueue::EventId()).move_as_ok();
+      events[event_id.value()] = std::make_pair(data, expires_at);
+    } else if (type < 75) {
+      if (events.empty()) {
+        continue;
+      }
+      auto event_id = events.begin()->first + rnd.fast(0, static_cast<int>(events.size()) * 2);
+      tqueue->forget(qid, td::TQueue::EventId::from_int32(event_id).move_as_ok());
+      events.erase(event_id);
+    } else if (type < 95) {
+      auto head_id = tqueue->get_head(qid);
+      auto from_id =
+          head_id.advance(rnd.fast(0, tqueue->get_tail(qid).value() - head_id.value() + 10)).move_as_ok();
+      check_get(from_id, rnd.fast(1, 10));
+    } else if (type < 99) {
+      now += rnd.fast(1, 100);
+      while (!tqueue->run_gc(now).second) {
+      }
+    } else {
+      // events before the head must have been deleted by the garbage collector
+      auto head_id = tqueue->get_head(qid);
+      while (!events.empty() && events.begin()->first < head_id.value()) {
+        ASSERT_TRUE(events.begin()->second.second < now);
+        events.erase(events.begin());
+      }
+      // all expired events are deleted after a full scan
+      auto size = check_get(tqueue->get_head(qid), events.size() + 1);
+      ASSERT_EQ(events.size(), size);
+    }
+  }
+}
+
+TEST(TQueue, random_batches) {
+  using EventId = td::TQueue::EventId;
+  td::Random::Xorshift128plus rnd(123);
+  auto next_queue_id = [&rnd] {
+    return rnd.fast(1, 10);
+  };
+  auto next_first_id = [&rnd] {
+    if (rnd.fast(0, 3) == 0) {
+      return EventId::from_int32(EventId::MAX_ID - 20).move_as_ok();
+    }
+    return EventId::from_int32(rnd.fast(1000000000, 1500000000)).move_as_ok();
+  };
+
+  TestTQueue q;
+  td::int32 now = 1000;
+  auto push_event = [&] {
+    q.push(next_queue_id(), PSTRING() << rnd(), now + rnd.fast(-10, 10) * 10 + 5, next_first_id());
+  };
+  auto push_batch = [&] {
+    td::vector<td::string> data(rnd.fast(1, 10));
+    for (auto &event_data : data) {
+      event_data = PSTRING() << rnd();
+    }
+    q.push_batch(next_queue_id(), data, now + rnd.fast(-10, 10) * 10 + 5, next_first_id());
+  };
+  auto forget_range = [&] {
+    q.forget_range(next_queue_id(), rnd);
+  };
+  auto inc_now = [&] {
+    now += 10;
+  };
+  auto check_head_tail = [&] {
+    q.check_head_tail(next_queue_id());
+  };
+  auto restart = [&] {
+    q.restart(rnd, now);
+  };
+  auto get = [&] {
+    q.check_get(next_queue_id(), rnd, now);
+  };
+  td::RandomSteps steps({{push_event, 20},
+                         {push_batch, 30},
+                         {forget_range, 10},
+                         {check_head_tail, 10},
+                         {get, 40},
+                         {inc_now, 5},
+                         {restart, 1}});
+  for (int i = 0; i < 100000; i++) {
+    steps.step(rnd);
+  }
+}
+
+TEST(TQueue, batch_binlog) {
+  td::CSlice binlog_path = "test_tqueue_batch.binlog";
+  td::Binlog::destroy(binlog_path).ensure();
+
+  auto open_tqueue = [&](size_t &log_event_count) {
+    auto tqueue = td::TQueue::create();
+    auto tqueue_binlog = td::make_unique<td::TQueueBinlog<td::Binlog>>();
+    auto binlog = std::make_shared<td::Binlog>();
+    log_event_count = 0;
+    binlog
+        ->init(binlog_path.str(),
+               [&](const td::BinlogEvent &event) {
+                 log_event_count++;
+                 tqueue_binlog->replay(event, *tqueue).ensure();
+               })
+        .ensure();
+    tqueue_binlog->set_binlog(std::move(binlog));
+    tqueue->set_callback(std::move(tqueue_binlog));
+    return tqueue;
+  };
+  auto close_tqueue = [](td::unique_ptr<td::TQueue> tqueue) {
+    tqueue->close(td::Promise<td::Unit>());
+  };
+
+  const td::TQueue::QueueId qid = 1;
+  size_t log_event_count;
+  auto tqueue = open_tqueue(log_event_count);
+  td::vector<td::TQueue::BatchEvent> events;
+  for (int i = 0; i < 1000; i++) {
+    events.push_back({PSTRING() << "event " << i, 1000000, i});
+  }
+  auto first_id = tqueue->push_batch(qid, std::move(events), td::TQueue::EventId()).move_as_ok();
+  auto tail_id = tqueue->get_tail(qid);
+  ASSERT_EQ(first_id.advance(1000).ok(), tail_id);
+  close_tqueue(std::move(tqueue));
+
+  tqueue = open_tqueue(log_event_count);
+  ASSERT_EQ(1u, log_event_count);
+  ASSERT_EQ(1000u, tqueue->get_size(qid));
+  ASSERT_EQ(first_id, tqueue->get_head(qid));
+  tqueue->forget_range(qid, first_id.advance(600).ok());
+  ASSERT_EQ(400u, tqueue->get_size(qid));
+  close_tqueue(std::move(tqueue));
+
+  tqueue = open_tqueue(log_event_count);
+  ASSERT_EQ(1u, log_event_count);
+  ASSERT_EQ(400u, tqueue->get_size(qid));
+  ASSERT_EQ(first_id.advance(600).ok(), tqueue->get_head(qid));
+  td::TQueue::Event event;
+  td::MutableSpan<td::TQueue::Event> span(&event, 1);
+  tqueue->get(qid, first_id.advance(999).ok(), false, 0, span).ensure();
+  ASSERT_EQ(1u, span.size());
+  ASSERT_EQ("event 999", span[0].data);
+  ASSERT_EQ(999, span[0].extra);
+  // deletion of less than a half of the stored events doesn't rewrite the batch
+  tqueue->forget_range(qid, first_id.advance(700).ok());
+  tqueue->forget(qid, first_id.advance(800).ok());
+  tqueue->forget(qid, first_id.advance(801).ok());
+  ASSERT_EQ(298u, tqueue->get_size(qid));
+  close_tqueue(std::move(tqueue));
+
+  tqueue = open_tqueue(log_event_count);
+  ASSERT_EQ(4u, log_event_count);
+  ASSERT_EQ(298u, tqueue->get_size(qid));
+  ASSERT_EQ(first_id.advance(700).ok(), tqueue->get_head(qid));
+  tqueue->get(qid, first_id.advance(800).ok(), false, 0, span).ensure();
+  ASSERT_EQ(1u, span.size());
+  ASSERT_EQ(first_id.advance(802).ok(), span[0].id);
+  tqueue->forget_range(qid, first_id.advance(900).ok());
+  close_tqueue(std::move(tqueue));
+
+  tqueue = open_tqueue(log_event_count);
+  ASSERT_EQ(1u, log_event_count);
+  ASSERT_EQ(100u, tqueue->get_size(qid));
+  tqueue->forget_range(qid, tail_id);
+  ASSERT_EQ(0u, tqueue->get_size(qid));
+  close_tqueue(std::move(tqueue));
+
+  // only the last event is kept to remember the tail identifier
+  tqueue = open_tqueue(log_event_count);
+  ASSERT_EQ(1u, log_event_count);
+  ASSERT_EQ(0u, tqueue->get_size(qid));
+  ASSERT_EQ(tail_id, tqueue->get_tail(qid));
+  ASSERT_EQ(tail_id, tqueue->push(qid, "next", 1000000, 0, td::TQueue::EventId()).move_as_ok());
+  close_tqueue(std::move(tqueue));
+
+  tqueue = open_tqueue(log_event_count);
+  ASSERT_EQ(1u, log_event_count);
+  ASSERT_EQ(1u, tqueue->get_size(qid));
+  close_tqueue(std::move(tqueue));
+
+  td::Binlog::destroy(binlog_path).ensure();
+}